@@ -0,0 +1,17 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>  // For size_t
+#include <stdint.h>  // For uint32_t
+
+/**
+ * @brief 计算 CRC32C (Castagnoli 多项式) 校验和。
+ *        支持分段累加：将上一次的返回值作为 crc 传入即可继续计算。
+ * @param crc 初始校验值，首次计算传 0
+ * @param buf 数据缓冲区
+ * @param len 数据长度，单位字节
+ * @return 累加后的 CRC32C 值
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+#endif
@@ -1,11 +1,13 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-#include <errno.h>   // 错误码定义，用于 errno, EINTR
-#include <stdint.h>  // 标准整数类型定义，如 uint16_t, uint32_t
-#include <stdio.h>   // 标准输入输出库，用于 fprintf, perror 等
-#include <stdlib.h>  // 标准库，用于 exit, malloc, free 等
-#include <unistd.h>  // POSIX 系统调用，用于 close
+#include <arpa/inet.h>  // 字节序转换，用于 htonl, ntohl, htons, ntohs
+#include <errno.h>      // 错误码定义，用于 errno, EINTR
+#include <stdint.h>     // 标准整数类型定义，如 uint16_t, uint32_t
+#include <stdio.h>      // 标准输入输出库，用于 fprintf, perror 等
+#include <stdlib.h>     // 标准库，用于 exit, malloc, free 等
+#include <string.h>     // 内存操作，用于 memcpy, memset
+#include <unistd.h>     // POSIX 系统调用，用于 close
 
 /**
  * @brief 操作状态码：错误
@@ -17,9 +19,26 @@
 #define STATUS_SUCCESS 0
 
 /**
- * @brief 协议版本号
+ * @brief 第一版协议：头部长度字段 16 位，列表响应的记录数 16 位
  */
-#define PROTO_VER 100
+#define PROTO_VER_V1 100
+
+/**
+ * @brief 第二版协议：头部长度字段 32 位，列表响应的记录数 64 位
+ */
+#define PROTO_VER_V2 200
+
+/**
+ * @brief 第三版协议：头部与 V2 相同，列表响应只发送有效记录，
+ *        每条记录使用与数据库文件相同的紧凑变长编码（见 record.h）
+ */
+#define PROTO_VER_V3 300
+
+/**
+ * @brief 客户端使用的协议版本。服务器同时支持 V1、V2 和 V3，
+ *        由客户端在 Hello 请求的 proto 字段中选择。
+ */
+#define PROTO_VER PROTO_VER_V3
 
 /**
  * @brief 客户端/服务器通信缓冲区大小
@@ -56,28 +75,97 @@ static inline void _cleanup_ptr_(void *p_ptr) {
  * @brief 数据库协议消息类型枚举
  */
 typedef enum {
-    MSG_HELLO_REQ,           ///< 客户端发送的 Hello 请求
-    MSG_HELLO_RESP,          ///< 服务器发送的 Hello 响应
-    MSG_EMPLOYEE_LIST_REQ,   ///< 客户端发送的列出员工请求
-    MSG_EMPLOYEE_LIST_RESP,  ///< 服务器发送的列出员工响应
-                             ///< (包含数量，后跟员工数据)
-    MSG_EMPLOYEE_ADD_REQ,    ///< 客户端发送的添加员工请求
-    MSG_EMPLOYEE_ADD_RESP,   ///< 服务器发送的添加员工响应
-    MSG_EMPLOYEE_DEL_REQ,    ///< 客户端发送的删除员工请求
-    MSG_EMPLOYEE_DEL_RESP,   ///< 服务器发送的删除员工响应
-    MSG_ERROR,               ///< 通用错误消息
-    MSG_MAX                  ///< 消息类型最大值，用于范围检查
+    MSG_HELLO_REQ,                  ///< 客户端发送的 Hello 请求
+    MSG_HELLO_RESP,                 ///< 服务器发送的 Hello 响应
+    MSG_EMPLOYEE_LIST_REQ,          ///< 客户端发送的列出员工请求
+    MSG_EMPLOYEE_LIST_RESP,         ///< 服务器发送的列出员工响应
+                                    ///< (包含数量，后跟员工数据)
+    MSG_EMPLOYEE_ADD_REQ,           ///< 客户端发送的添加员工请求
+    MSG_EMPLOYEE_ADD_RESP,          ///< 服务器发送的添加员工响应
+    MSG_EMPLOYEE_DEL_REQ,           ///< 客户端发送的删除员工请求
+    MSG_EMPLOYEE_DEL_RESP,          ///< 服务器发送的删除员工响应
+    MSG_ERROR,                      ///< 通用错误消息
+    MSG_EMPLOYEE_GET_BY_NAME_REQ,   ///< 客户端发送的按名字查找请求
+    MSG_EMPLOYEE_GET_BY_NAME_RESP,  ///< 服务器发送的按名字查找响应
+                                    ///< (格式同列出员工响应)
+    MSG_EMPLOYEE_RANGE_HOURS_REQ,   ///< 客户端发送的按工时范围查找请求
+    MSG_EMPLOYEE_RANGE_HOURS_RESP,  ///< 服务器发送的按工时范围查找响应
+                                    ///< (格式同列出员工响应)
+    MSG_EMPLOYEE_UPDATE_REQ,        ///< 客户端发送的按 id 更新员工请求
+    MSG_EMPLOYEE_UPDATE_RESP,       ///< 服务器发送的更新员工响应
+    MSG_EMPLOYEE_DEL_BY_ID_REQ,     ///< 客户端发送的按 id 删除员工请求
+    MSG_EMPLOYEE_DEL_BY_ID_RESP,    ///< 服务器发送的按 id 删除员工响应
+    MSG_EMPLOYEE_DEL_BY_NAME_REQ,   ///< 客户端发送的按名字删除员工请求
+    MSG_EMPLOYEE_DEL_BY_NAME_RESP,  ///< 服务器发送的按名字删除员工响应
+    MSG_EMPLOYEE_LIST_PAGE_REQ,     ///< 客户端发送的分页列出员工请求 (V3)
+    MSG_EMPLOYEE_LIST_CHUNK,        ///< 服务器发送的分页列表中的一块
+    MSG_BATCH_REQ,                  ///< 客户端发送的批量添加/删除请求
+    MSG_BATCH_RESP,                 ///< 服务器发送的批量操作响应
+    MSG_EMPLOYEE_ADD_V2_REQ,        ///< 客户端发送的二进制添加员工请求
+    MSG_SNAPSHOT_REQ,               ///< 客户端发送的在线快照请求
+    MSG_SNAPSHOT_RESP,              ///< 服务器发送的在线快照响应
+    MSG_REPL_SYNC_REQ,              ///< 副本发送的复制订阅请求
+    MSG_REPL_SYNC_RESP,             ///< 主库发送的订阅响应，后跟数据库镜像
+    MSG_REPL_WAL,                   ///< 主库推送给副本的一段日志流
+    MSG_REPL_ACK,                   ///< 副本确认已应用的 LSN（无响应）
+    MSG_REPL_STATS_REQ,             ///< 客户端发送的复制状态请求
+    MSG_REPL_STATS_RESP,            ///< 服务器发送的复制状态响应
+    MSG_STATS_REQ,                  ///< 客户端发送的服务器统计请求
+    MSG_STATS_RESP,                 ///< 服务器发送的统计响应
+    MSG_MAX                         ///< 消息类型最大值，用于范围检查
 } dbproto_type_e;
 
 /**
- * @brief 数据库协议消息头部结构
- * 所有字段在网络传输时需要进行字节序转换。
+ * @brief 数据库协议消息头部结构，各版本都是 8 字节，消息体紧随其后。
+ * 所有字段在网络传输时需要进行字节序转换，应使用 dbproto_hdr_pack /
+ * dbproto_hdr_unpack 按协议版本编解码：
+ * - V1：len 的前 2 字节是 16 位长度，后 2 字节为填充；
+ * - V2 与 V3：len 是完整的 32 位长度。
+ * Hello 请求与响应总是使用 V1 格式，之后的消息使用协商的版本。
+ * 列表形式的响应是流式帧：len 只覆盖定长部分，其中的记录数决定随后
+ * 连续发送的员工记录流的长度（V3 还给出字节数），因此响应大小不受 len
+ * 的宽度限制。
  */
 typedef struct {
-    dbproto_type_e type;  ///< 消息类型
-    uint16_t len;  ///< 消息体（payload）的长度，不包括头部，单位字节
+    uint32_t type;  ///< 消息类型，见 dbproto_type_e
+    uint32_t len;   ///< 消息体（payload）的长度，不包括头部，单位字节
 } dbproto_hdr_t;
 
+/**
+ * @brief 按协议版本填写头部并转换为网络字节序。
+ * @param hdr 要填写的头部
+ * @param proto 协议版本
+ * @param type 消息类型
+ * @param len 消息体长度，V1 中必须小于 65536
+ */
+static inline void dbproto_hdr_pack(dbproto_hdr_t *hdr, uint16_t proto,
+                                    uint32_t type, uint32_t len) {
+    hdr->type = htonl(type);
+    if (proto == PROTO_VER_V1) {
+        uint16_t len16 = htons((uint16_t)len);
+        memset(&hdr->len, 0, sizeof(hdr->len));
+        memcpy(&hdr->len, &len16, sizeof(len16));
+    } else {
+        hdr->len = htonl(len);
+    }
+}
+
+/**
+ * @brief 按协议版本把收到的头部就地转换为主机字节序。
+ * @param hdr 收到的头部
+ * @param proto 协议版本
+ */
+static inline void dbproto_hdr_unpack(dbproto_hdr_t *hdr, uint16_t proto) {
+    hdr->type = ntohl(hdr->type);
+    if (proto == PROTO_VER_V1) {
+        uint16_t len16;
+        memcpy(&len16, &hdr->len, sizeof(len16));
+        hdr->len = ntohs(len16);
+    } else {
+        hdr->len = ntohl(hdr->len);
+    }
+}
+
 /**
  * @brief Hello 请求的消息体
  */
@@ -104,6 +192,18 @@ typedef struct {
     char data[MAX_EMPLOYEE_ADD_DATA];  ///< 格式为 "name-address-hours" 的字符串
 } dbproto_employee_add_req_t;
 
+/**
+ * @brief 二进制添加员工请求的消息体结构（MSG_EMPLOYEE_ADD_V2_REQ）
+ * 之后紧跟 (name_len) 字节的名字和 (address_len) 字节的地址，都不含 '\0'
+ * 也不转义，长度为 1 到 255。字段已经拆分好，服务器不做字符串解析。
+ * 响应与 MSG_EMPLOYEE_ADD_REQ 相同。所有字段使用网络字节序。
+ */
+typedef struct {
+    uint32_t hours;        ///< 员工工作小时数
+    uint16_t name_len;     ///< 名字的字节数
+    uint16_t address_len;  ///< 地址的字节数
+} __attribute__((__packed__)) dbproto_employee_add_req_v2_t;
+
 /**
  * @brief 添加员工响应的消息体结构
  */
@@ -120,12 +220,67 @@ typedef struct {
 } dbproto_employee_list_req_t;
 
 /**
- * @brief 列出员工响应的消息体结构
+ * @brief 列出员工响应的消息体结构（V2）
  * 响应头部后紧跟此结构，之后是 (count) 个 struct employee_t 结构体。
+ * LIST 发送全部槽位，第 i 个记录的 id 为 i；名字为空的记录是已删除的槽位，
+ * 其内容全部为 0。
+ */
+typedef struct {
+    uint64_t count;  ///< 响应中的记录数（LIST 为槽位数）
+} __attribute__((__packed__)) dbproto_employee_list_resp_t;
+
+/**
+ * @brief 列出员工响应的消息体结构（V3）
+ * 响应头部后紧跟此结构，之后是 (bytes) 字节的紧凑记录（见 record.h），
+ * 共 (count) 条。只发送有效记录，员工 id 由每条记录中的槽位给出。
+ */
+typedef struct {
+    uint64_t count;  ///< 响应中的记录数
+    uint64_t bytes;  ///< 之后的记录数据的总字节数
+} __attribute__((__packed__)) dbproto_employee_list_resp_v3_t;
+
+/**
+ * @brief 分页游标的特殊取值：扫描已经到达表尾，没有更多记录
+ */
+#define DBPROTO_CURSOR_END UINT64_MAX
+
+/**
+ * @brief 分页列表每块的默认记录数与服务器允许的最大记录数
+ */
+#define DBPROTO_LIST_CHUNK_DEFAULT 256
+#define DBPROTO_LIST_CHUNK_MAX 4096
+
+/**
+ * @brief 分页列出员工请求的消息体结构（只用于 V3）
+ * 服务器从 cursor 开始按 id 顺序扫描，以若干 MSG_EMPLOYEE_LIST_CHUNK
+ * 流式发送有效记录，每块单独持有读锁，块之间可以处理其他连接和修改。
+ * 每个 id 至多出现一次；扫描期间新增或删除的记录可能出现也可能不出现。
+ * 所有字段使用网络字节序。
  */
 typedef struct {
-    uint16_t count;  ///< 数据库中员工的总数
-} dbproto_employee_list_resp_t;
+    uint64_t cursor;  ///< 续传令牌：0 从头开始，否则为上次最后一块的 next
+    uint64_t limit;   ///< 本次最多返回的记录数，0 表示不限
+    uint32_t chunk;   ///< 每块最多的记录数，0 使用服务器默认值
+} __attribute__((__packed__)) dbproto_employee_list_page_req_t;
+
+/**
+ * @brief 分页列表中一块的消息体结构，之后是 (bytes) 字节的紧凑记录，
+ *        共 (count) 条，格式与 V3 的列表响应相同。
+ */
+typedef struct {
+    uint64_t count;  ///< 本块的记录数
+    uint64_t bytes;  ///< 之后的记录数据的总字节数
+    uint64_t next;   ///< 续传令牌，DBPROTO_CURSOR_END 表示已经到达表尾
+    uint32_t last;   ///< 非 0 表示这是本次请求的最后一块
+} __attribute__((__packed__)) dbproto_employee_list_chunk_t;
+
+/**
+ * @brief 列出员工响应的消息体结构（V1），记录数超过 UINT16_MAX 时
+ *        服务器改为回复 MSG_ERROR。
+ */
+typedef struct {
+    uint16_t count;  ///< 响应中的记录数（LIST 为槽位数）
+} dbproto_employee_list_resp_v1_t;
 
 /**
  * @brief 删除员工请求的消息体结构
@@ -142,6 +297,235 @@ typedef struct {
     int status;  ///< 操作结果状态：STATUS_SUCCESS 或 STATUS_ERROR
 } dbproto_employee_del_resp_t;
 
+/**
+ * @brief 按 id 更新员工请求的消息体结构
+ * 响应使用 dbproto_employee_add_resp_t。
+ */
+typedef struct {
+    uint32_t id;                       ///< 员工 id（槽位下标）
+    char data[MAX_EMPLOYEE_ADD_DATA];  ///< 格式为 "name-address-hours" 的新内容
+} dbproto_employee_update_req_t;
+
+/**
+ * @brief 按 id 删除员工请求的消息体结构
+ * 响应使用 dbproto_employee_del_resp_t。
+ */
+typedef struct {
+    uint32_t id;  ///< 员工 id（槽位下标）
+} dbproto_employee_del_by_id_req_t;
+
+/**
+ * @brief 按名字删除员工请求的消息体结构，删除所有同名的员工
+ */
+typedef struct {
+    char name[256];  ///< 要删除的名字，以 '\0' 结尾
+} dbproto_employee_del_by_name_req_t;
+
+/**
+ * @brief 按名字删除员工响应的消息体结构
+ */
+typedef struct {
+    int status;      ///< 操作结果状态：STATUS_SUCCESS 或 STATUS_ERROR
+    uint32_t count;  ///< 删除的员工数
+} dbproto_employee_del_by_name_resp_t;
+
+/**
+ * @brief 一个批量请求最多包含的操作数。整批操作写成一条 WAL 记录，
+ *        受 WAL_MAX_PAYLOAD 限制；整个请求还必须能放入 CLIENT_BUFFER_SIZE。
+ */
+#define DBPROTO_BATCH_MAX_OPS 100
+
+/**
+ * @brief 批量请求中的操作类型
+ */
+typedef enum {
+    BATCH_OP_ADD = 1,     ///< 添加员工，参数为 "name-address-hours"（不含 '\0'）
+    BATCH_OP_DEL = 2,     ///< 按 id 删除员工，参数为 uint32_t id
+    BATCH_OP_ADD_V2 = 3,  ///< 添加员工，参数同 MSG_EMPLOYEE_ADD_V2_REQ 的消息体
+} dbproto_batch_op_e;
+
+/**
+ * @brief 批量请求的消息体结构，之后是 (count) 个操作，每个操作为
+ *        dbproto_batch_op_t 加上 (len) 字节的参数。整批操作是原子的：
+ *        先全部验证，任何一个操作无效时什么也不做；全部成功后写成
+ *        一条 WAL 记录，崩溃恢复时要么全部重做，要么全部丢弃。
+ *        DEL 的 id 必须在请求开始时存在且不重复；ADD 按顺序分配 id，
+ *        可以复用同一批中之前删除的槽位。所有字段使用网络字节序。
+ */
+typedef struct {
+    uint32_t count;  ///< 操作数，1 到 DBPROTO_BATCH_MAX_OPS
+} __attribute__((__packed__)) dbproto_batch_req_t;
+
+/**
+ * @brief 批量请求中一个操作的头部
+ */
+typedef struct {
+    uint8_t op;        ///< 操作类型，见 dbproto_batch_op_e
+    uint8_t reserved;  ///< 保留，写 0
+    uint16_t len;      ///< 之后的参数字节数
+} __attribute__((__packed__)) dbproto_batch_op_t;
+
+/**
+ * @brief 批量操作响应的消息体结构
+ */
+typedef struct {
+    int status;         ///< 操作结果状态：STATUS_SUCCESS 或 STATUS_ERROR
+    uint32_t applied;   ///< 执行的操作数，失败时为 0
+    uint32_t failed;    ///< 失败时第一个无效操作的下标，无法归因时为 count
+} dbproto_batch_resp_t;
+
+/**
+ * @brief 在线快照请求没有消息体。服务器把所有已确认的修改落盘后 fork
+ *        子进程，把此刻的数据库写成 <db>.snap 与校验和文件 <db>.snap.sum，
+ *        不等子进程结束就回复。已有快照在进行时不启动新的快照，响应中
+ *        返回正在进行的快照；.sum 出现时快照才算完整。
+ */
+typedef struct {
+    // 快照请求没有消息体
+} dbproto_snapshot_req_t;
+
+/**
+ * @brief 在线快照响应的消息体结构，所有字段使用网络字节序
+ */
+typedef struct {
+    int status;      ///< 操作结果状态：STATUS_SUCCESS 或 STATUS_ERROR
+    uint64_t lsn;    ///< 快照包含的最大 LSN
+    uint64_t count;  ///< 快照中的槽位数（含已删除的槽位）
+    uint64_t bytes;  ///< 快照镜像文件的大小
+} __attribute__((__packed__)) dbproto_snapshot_resp_t;
+
+/**
+ * @brief 复制订阅请求没有消息体。主库持有读锁提交 WAL，记下此刻的 LSN，
+ *        回复 MSG_REPL_SYNC_RESP，随后（不在 len 之内）连续发送 bytes 字节
+ *        的数据库镜像（格式与 <db>.snap 相同），之后用 MSG_REPL_WAL 推送
+ *        LSN 更大的每一条已落盘的日志记录。副本每应用一段日志就回复一个
+ *        MSG_REPL_ACK。副本落后超出主库的复制积压缓冲区时，主库回复
+ *        MSG_ERROR 并断开，副本需要重新订阅。
+ */
+typedef struct {
+    // 复制订阅请求没有消息体
+} dbproto_repl_sync_req_t;
+
+/**
+ * @brief 复制订阅响应的消息体结构，所有字段使用网络字节序
+ */
+typedef struct {
+    int status;      ///< 操作结果状态：STATUS_SUCCESS 或 STATUS_ERROR
+    uint64_t lsn;    ///< 镜像包含的最大 LSN，日志流从下一条记录开始
+    uint64_t bytes;  ///< 随后发送的镜像字节数
+} __attribute__((__packed__)) dbproto_repl_sync_resp_t;
+
+/**
+ * @brief 日志流消息的定长部分，后跟 len - sizeof(dbproto_repl_wal_t)
+ *        字节的 WAL 记录（与日志段中的编码相同）。记录可能跨越两条消息，
+ *        副本应把各条消息的数据当作连续的字节流。使用网络字节序。
+ */
+typedef struct {
+    uint64_t primary_lsn;  ///< 发送时主库已落盘的最大 LSN
+} __attribute__((__packed__)) dbproto_repl_wal_t;
+
+/**
+ * @brief 副本确认消息的消息体结构，使用网络字节序
+ */
+typedef struct {
+    uint64_t lsn;  ///< 副本已经应用的最大 LSN
+} __attribute__((__packed__)) dbproto_repl_ack_t;
+
+/**
+ * @brief 复制状态中的角色
+ */
+typedef enum {
+    REPL_ROLE_PRIMARY = 0,  ///< 主库（包括没有副本的独立服务器）
+    REPL_ROLE_REPLICA = 1,  ///< 只读副本
+} dbproto_repl_role_e;
+
+/**
+ * @brief 复制状态请求没有消息体
+ */
+typedef struct {
+    // 复制状态请求没有消息体
+} dbproto_repl_stats_req_t;
+
+/**
+ * @brief 复制状态响应的消息体结构，所有字段使用网络字节序。
+ *        主库报告最慢的副本：它落后的 LSN 数，以及它从开始落后到现在
+ *        经过的毫秒数；副本报告自己相对主库最近一次通告的落后程度。
+ */
+typedef struct {
+    uint32_t role;         ///< 见 dbproto_repl_role_e
+    uint32_t links;        ///< 主库：已连接的副本数；副本：与主库连接时为 1
+    uint64_t lsn;          ///< 主库：已落盘的最大 LSN；副本：已应用的最大 LSN
+    uint64_t primary_lsn;  ///< 主库最近一次通告的已落盘 LSN
+    uint64_t lag_lsn;      ///< 落后的 LSN 数
+    uint64_t lag_ms;       ///< 已经落后了多少毫秒，追上时为 0
+} __attribute__((__packed__)) dbproto_repl_stats_resp_t;
+
+/**
+ * @brief 服务器统计请求没有消息体
+ */
+typedef struct {
+    // 服务器统计请求没有消息体
+} dbproto_stats_req_t;
+
+/**
+ * @brief 服务器统计响应的消息体结构，所有字段使用网络字节序。
+ *        统计自服务器启动以来累计，汇总所有事件循环；之后紧跟 ntypes 个
+ *        dbproto_stats_op_t，每种处理过的请求一个。时间以纳秒计，
+ *        百分位数的相对误差不超过 1/64。
+ */
+typedef struct {
+    uint64_t uptime_ms;       ///< 事件循环启动以来的毫秒数
+    uint32_t reactors;        ///< 事件循环线程数
+    uint32_t ntypes;          ///< 之后的 dbproto_stats_op_t 个数
+    uint64_t conns_open;      ///< 当前的连接数
+    uint64_t conns_accepted;  ///< 累计接受的连接数
+    uint64_t bytes_in;        ///< 从套接字读取的字节数
+    uint64_t bytes_out;       ///< 写到套接字的字节数（包括 sendfile）
+    uint64_t errors;          ///< 回复 MSG_ERROR 并断开的次数
+    uint64_t loop_iters;      ///< 事件循环的轮数（每次从 epoll 返回算一轮）
+    uint64_t loop_mean_ns;    ///< 每轮处理时间（不含等待事件）的平均值
+    uint64_t loop_p99_ns;     ///< 每轮处理时间的 99 百分位
+    uint64_t loop_max_ns;     ///< 每轮处理时间的最大值
+    uint64_t events;          ///< 处理的就绪事件总数
+    uint64_t events_max;      ///< 一轮中最多的就绪事件数
+    uint64_t commits;         ///< 有连接等待时做的 WAL 组提交次数
+    uint64_t commit_waiters;  ///< 这些组提交累计放行的连接数
+    uint64_t commit_waiters_max;  ///< 一次组提交最多放行的连接数
+} __attribute__((__packed__)) dbproto_stats_resp_t;
+
+/**
+ * @brief 统计响应中一种请求的处理时间：从收到完整消息到处理函数返回，
+ *        不包括等待 WAL 落盘与发送的时间。所有字段使用网络字节序。
+ */
+typedef struct {
+    uint32_t type;      ///< 请求的消息类型（dbproto_type_e）
+    uint32_t reserved;  ///< 保留，总是 0
+    uint64_t count;     ///< 处理的次数
+    uint64_t mean_ns;   ///< 平均值
+    uint64_t p50_ns;    ///< 50 百分位
+    uint64_t p90_ns;    ///< 90 百分位
+    uint64_t p99_ns;    ///< 99 百分位
+    uint64_t p999_ns;   ///< 99.9 百分位
+    uint64_t max_ns;    ///< 最大值
+} __attribute__((__packed__)) dbproto_stats_op_t;
+
+/**
+ * @brief 按名字查找请求的消息体结构
+ * 响应与 LIST 的格式相同（按协议版本），之后是匹配的员工数据。
+ */
+typedef struct {
+    char name[256];  ///< 要查找的名字，以 '\0' 结尾
+} dbproto_employee_get_by_name_req_t;
+
+/**
+ * @brief 按工时范围查找请求的消息体结构
+ * 响应与 LIST 的格式相同（按协议版本），之后是按 hours 升序的员工数据。
+ */
+typedef struct {
+    uint32_t min_hours;  ///< 工时下界（含）
+    uint32_t max_hours;  ///< 工时上界（含）
+} dbproto_employee_range_hours_req_t;
+
 /**
  * @brief 阻塞式发送函数，确保完整发送所有数据
  * @param fd 文件描述符（套接字）
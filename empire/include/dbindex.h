@@ -0,0 +1,199 @@
+#ifndef DBINDEX_H
+#define DBINDEX_H
+
+#include <stdbool.h>  // For bool
+#include <stddef.h>   // For size_t
+#include <stdint.h>   // For uint32_t, uint64_t
+
+#include "dbmap.h"  // 包含映射的数据库 dbmap_t
+
+/**
+ * @brief 索引文件头部的魔数
+ */
+#define DBINDEX_MAGIC 0x49445846  // "IDXF" in ASCII
+
+/**
+ * @brief 索引文件格式版本号
+ */
+#define DBINDEX_VERSION 1
+
+/**
+ * @brief B+ 树节点最多容纳的键数（插入时临时达到此值后分裂）
+ */
+#define DBINDEX_BTREE_ORDER 64
+
+/**
+ * @brief 名字哈希表的最小容量，容量始终是 2 的幂
+ */
+#define DBINDEX_MIN_BUCKETS 64
+
+/**
+ * @brief 索引文件 <db>.idx 的头部，使用本机字节序（与映射的数据库文件一致）。
+ *        其后依次是 nbuckets 个 dbindex_bucket_t 和 nkeys 个升序的 B+ 树键。
+ */
+struct dbindex_file_hdr_t {
+    uint32_t magic;     ///< 魔数，标识索引文件
+    uint16_t version;   ///< 索引文件格式版本
+    uint16_t reserved;  ///< 保留，写 0
+    uint64_t stamp;     ///< 保存时数据库的戳，加载时必须与当前数据库一致
+    uint64_t nkeys;     ///< 索引的记录数
+    uint64_t nbuckets;  ///< 名字哈希表容量
+} __attribute__((__packed__));
+
+/**
+ * @brief 哈希表槽位的特殊取值：从未使用 / 条目已删除
+ */
+#define DBINDEX_EMPTY UINT32_MAX
+#define DBINDEX_TOMBSTONE (UINT32_MAX - 1)
+
+/**
+ * @brief 名字哈希表的一个槽位。slot 为员工记录下标，
+ *        hash 缓存名字的哈希值，探测时不必访问记录本身。
+ */
+typedef struct {
+    uint32_t slot;  ///< 记录下标，或 DBINDEX_EMPTY / DBINDEX_TOMBSTONE
+    uint32_t hash;  ///< 名字的 FNV-1a 哈希
+} dbindex_bucket_t;
+
+/**
+ * @brief hours 上的 B+ 树节点。键为 (hours << 32 | slot)，
+ *        因此重复的 hours 也有唯一的键，并按记录下标排序。
+ *        叶子节点通过 next 串成链表，范围扫描只需一次下降。
+ */
+typedef struct dbindex_node {
+    uint16_t n;                                        ///< 键数
+    bool leaf;                                         ///< 是否为叶子
+    uint64_t keys[DBINDEX_BTREE_ORDER];                ///< 有序的键
+    struct dbindex_node *next;                         ///< 下一个叶子
+    struct dbindex_node *child[DBINDEX_BTREE_ORDER + 1];  ///< 内部节点的子节点
+} dbindex_node_t;
+
+/**
+ * @brief 员工表的二级索引：name 上的开放寻址哈希表（线性探测）
+ *        和 hours 上的 B+ 树。索引只覆盖 [0, count) 中未删除的记录，
+ *        由修改记录的代码在持有写锁时增量维护。
+ */
+typedef struct {
+    dbindex_bucket_t *buckets;  ///< 名字哈希表
+    size_t nbuckets;            ///< 哈希表容量（2 的幂）
+    size_t used;                ///< 有效条目数
+    size_t filled;              ///< 有效条目加墓碑数，决定何时重新哈希
+    dbindex_node_t *root;       ///< hours B+ 树的根
+    size_t nkeys;               ///< B+ 树中的键数
+    size_t height;              ///< B+ 树的高度，只有根叶子时为 1
+    dbindex_node_t *spare;      ///< 预先分配的空闲节点链表（经 next 串联）
+    size_t nspare;              ///< 空闲节点数
+} dbindex_t;
+
+/**
+ * @brief 查询结果：匹配记录的下标数组。
+ */
+typedef struct {
+    uint32_t *slots;  ///< 记录下标
+    size_t len;       ///< 结果数
+    size_t cap;       ///< 数组容量
+} dbindex_result_t;
+
+/**
+ * @brief 从数据库重建全部索引，替换 idx 中原有的内容。墓碑被跳过。
+ * @param idx 索引
+ * @param map 映射的数据库
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int dbindex_build(dbindex_t *idx, const dbmap_t *map);
+
+/**
+ * @brief 从 <db>.idx 加载索引。文件中记录的戳和记录数必须与当前数据库
+ *        一致，否则说明数据库在索引保存之后被修改过，返回 STATUS_ERROR，
+ *        调用者应改用 dbindex_build 重建。
+ * @param idx 索引，成功时其原有内容被替换
+ * @param db_path 数据库文件路径
+ * @param stamp 当前数据库的戳（同步检查点之后 WAL 已落盘的 LSN）
+ * @param count 当前槽位数
+ * @param live 当前有效记录数
+ * @return 成功时返回 STATUS_SUCCESS，文件缺失、过期或损坏时返回 STATUS_ERROR。
+ */
+int dbindex_load(dbindex_t *idx, const char *db_path, uint64_t stamp,
+                 size_t count, size_t live);
+
+/**
+ * @brief 把索引原子地写入 <db>.idx（先写临时文件再 rename）。
+ *        只应在同步检查点之后调用，此时数据库文件与 stamp 对应。
+ * @param idx 索引
+ * @param db_path 数据库文件路径
+ * @param stamp 当前数据库的戳
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbindex_save(const dbindex_t *idx, const char *db_path, uint64_t stamp);
+
+/**
+ * @brief 预先分配再插入 n 条记录所需的内存。之后的 n 次 dbindex_insert
+ *        （中间没有其他插入）不会失败，用于无法回滚的修改。
+ * @param idx 索引
+ * @param n 即将插入的记录数
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int dbindex_reserve(dbindex_t *idx, size_t n);
+
+/**
+ * @brief 把 slot 处的记录加入索引。
+ * @param idx 索引
+ * @param map 映射的数据库，slot 处的记录必须已经写入
+ * @param slot 记录下标
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR
+ * （此时索引不变）。
+ */
+int dbindex_insert(dbindex_t *idx, const dbmap_t *map, uint32_t slot);
+
+/**
+ * @brief 把 slot 处的记录从索引中删除，必须在记录被覆盖或删除之前调用。
+ * @param idx 索引
+ * @param map 映射的数据库
+ * @param slot 记录下标
+ */
+void dbindex_remove(dbindex_t *idx, const dbmap_t *map, uint32_t slot);
+
+/**
+ * @brief 按名字精确查找，期望 O(1)。结果按记录下标升序追加到 out。
+ * @param idx 索引
+ * @param map 映射的数据库
+ * @param name 要查找的名字
+ * @param out 查询结果
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int dbindex_find_name(const dbindex_t *idx, const dbmap_t *map,
+                      const char *name, dbindex_result_t *out);
+
+/**
+ * @brief 查找 hours 在 [lo, hi] 内的记录，O(log n + k)。
+ *        结果按 hours、再按记录下标升序追加到 out。
+ * @param idx 索引
+ * @param lo 下界（含）
+ * @param hi 上界（含）
+ * @param out 查询结果
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int dbindex_range_hours(const dbindex_t *idx, uint32_t lo, uint32_t hi,
+                        dbindex_result_t *out);
+
+/**
+ * @brief 释放查询结果。
+ * @param out 查询结果
+ */
+void dbindex_result_free(dbindex_result_t *out);
+
+/**
+ * @brief 释放索引占用的内存，idx 恢复为空索引。
+ * @param idx 索引
+ */
+void dbindex_free(dbindex_t *idx);
+
+/**
+ * @brief 用于 GCC cleanup 属性的内联函数：释放索引
+ * @param idx 指向索引的指针
+ */
+static inline void _cleanup_dbindex_(dbindex_t *idx) {
+    dbindex_free(idx);
+}
+
+#endif
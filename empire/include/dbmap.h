@@ -0,0 +1,372 @@
+#ifndef DBMAP_H
+#define DBMAP_H
+
+#include <limits.h>   // For PATH_MAX
+#include <stdbool.h>  // For bool
+#include <stddef.h>   // For size_t
+#include <stdint.h>   // For uint32_t, uint64_t
+
+#include "parse.h"   // 包含 dbheader_t, employee_t 结构体
+#include "record.h"  // 包含紧凑记录的编解码
+
+/**
+ * @brief 记录堆在数据库文件中的起始偏移
+ */
+#define DBMAP_HEAP_START sizeof(struct dbheader_t)
+
+/**
+ * @brief 内存中槽位表的初始容量，之后按倍数增长
+ */
+#define DBMAP_MIN_CAPACITY 64
+
+/**
+ * @brief 新建数据库文件的大小，记录堆用完时文件按倍数增长
+ */
+#define DBMAP_MIN_FILE (64 * 1024)
+
+/**
+ * @brief 数据库最多能容纳的记录数。dbheader_t.count 是 64 位的，
+ *        限制来自 WAL、索引和协议中 32 位的槽位下标（索引保留了最大的两个值）
+ */
+#define DBMAP_MAX_RECORDS (UINT32_MAX - 1)
+
+/**
+ * @brief 记录堆中的垃圾（被覆盖的旧版本与墓碑）至少有这么多字节，
+ *        并且不少于有效记录的字节数时触发压缩
+ */
+#define DBMAP_COMPACT_GARBAGE (1024 * 1024)
+
+/**
+ * @brief dbmap_prepare 预留的记录堆空间：一条新记录加一个回滚用的墓碑
+ */
+#define DBMAP_PREPARE_BYTES (DBREC_MAX_SIZE + DBREC_TOMBSTONE_MAX_SIZE)
+
+/**
+ * @brief 记录堆按这个大小分段计算 CRC32C，保存在校验和文件 <db>.crc 中
+ */
+#define DBMAP_SUM_SPAN (64 * 1024)
+
+/**
+ * @brief 校验和文件头部的魔数
+ */
+#define DBMAP_SUM_MAGIC 0x53435243  // "CRCS" in ASCII
+
+/**
+ * @brief 校验和文件格式版本号
+ */
+#define DBMAP_SUM_VERSION 1
+
+/**
+ * @brief 校验和文件 <db>.crc 的头部，使用本机字节序。其后是 nspans 个
+ *        uint32_t 的段校验和（第 i 段覆盖记录堆中从 DBMAP_HEAP_START +
+ *        i * DBMAP_SUM_SPAN 开始、不超过 heap_end 的字节），最后是前面
+ *        所有字节的 CRC32C。dev 与 ino 标识它描述的数据库文件：压缩、
+ *        恢复和复制都用 rename 换上新文件，旧的校验和文件随之失效。
+ */
+struct dbmap_sum_hdr_t {
+    uint32_t magic;     ///< 魔数，标识校验和文件
+    uint16_t version;   ///< 校验和文件格式版本
+    uint16_t reserved;  ///< 保留，写 0
+    uint64_t dev;       ///< 数据库文件所在的设备
+    uint64_t ino;       ///< 数据库文件的 inode
+    uint64_t heap_end;  ///< 校验和覆盖的记录堆末尾
+    uint64_t nspans;    ///< 段数
+} __attribute__((__packed__));
+
+/**
+ * @brief 内存映射的数据库文件。
+ *        文件布局为 dbheader_t 后跟只追加的记录堆，记录使用 record.h 中的
+ *        紧凑编码，每条记录带有自己的槽位下标；整个文件以 MAP_SHARED 映射。
+ *        写入一个槽位总是在 heap_end 处追加新版本，删除追加一个墓碑，
+ *        磁盘上 heap_end 之前的字节从不被原地修改。内存中的槽位表 offs
+ *        记录每个槽位最新版本的偏移，打开时顺序扫描记录堆重建。
+ *        磁盘头部的 count 与 heap_end 只在检查点时更新（见 dbmap_sync），
+ *        两次检查点之间的修改由 WAL 保证持久性；hdr 是内存中的实时头部。
+ *        对任意一致的 (count, heap_end)，每个槽位在堆中的最新版本都反映
+ *        它的状态：count 之后的槽位的最新版本总是墓碑（或者没有记录），
+ *        因此截断记录数时要为被截掉的有效记录追加墓碑。
+ *        槽位下标就是员工 id。删除不移动其他记录，只把槽位标记为墓碑，
+ *        并记入内存中的位图；新记录优先复用下标最小的空闲槽位。末尾的
+ *        墓碑会立即截掉，因此 [0, count) 的最后一个槽位总是有效记录。
+ *        旧版本和墓碑占用的空间由 dbmap_compact 重写文件时回收。
+ *        记录堆每 DBMAP_SUM_SPAN 字节一段的 CRC32C 随追加增量更新，
+ *        检查点时写入 <db>.crc，打开时校验；每个有效记录的 CRC32C
+ *        另外保存在内存中，dbmap_view 每次读取都会校验。
+ */
+typedef struct {
+    int fd;                       ///< 数据库文件描述符
+    char path[PATH_MAX];          ///< 数据库文件路径，压缩时原子替换
+    char *base;                   ///< 映射的起始地址
+    size_t map_size;              ///< 映射（也是文件）的大小
+    struct dbheader_t *disk_hdr;  ///< 映射中的头部，即磁盘上的头部
+    struct dbheader_t hdr;  ///< 实时头部，count 为已使用的槽位数，
+                            ///< heap_end 为下一条记录的写入位置
+    uint64_t *offs;     ///< 槽位表：每个槽位最新记录的偏移，0 表示墓碑
+    size_t capacity;    ///< 槽位表与墓碑位图覆盖的槽位数
+    uint64_t *dead;     ///< 墓碑位图，覆盖 [0, capacity)，打开时扫描重建
+    size_t ndead;       ///< [0, count) 中的墓碑数
+    size_t dead_hint;   ///< 位图中可能有置位的最小字下标，加速空闲槽位查找
+    size_t live_bytes;  ///< 有效记录编码后的总字节数
+    bool heap_sorted;   ///< 记录堆中的有效记录按槽位严格递增（没有垃圾时）
+    size_t heap_last;   ///< 最后追加的有效记录的槽位，用于维护 heap_sorted
+    uint32_t *crcs;     ///< 每个有效槽位最新记录的 CRC32C，覆盖 capacity
+    uint32_t *sums;     ///< 记录堆各段到 heap_end 为止的 CRC32C
+    size_t nsums;       ///< sums 覆盖的段数，足够覆盖整个映射
+} dbmap_t;
+
+/**
+ * @brief 在新建的空文件上初始化映射的数据库。
+ * @param fd 新建数据库文件的文件描述符，成功后归 map 所有
+ * @param path 数据库文件路径
+ * @param mapOut 输出参数，返回映射的数据库
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_create(int fd, const char *path, dbmap_t **mapOut);
+
+/**
+ * @brief 映射现有的数据库文件，顺序扫描磁盘头部 heap_end 之前的记录堆，
+ *        重建槽位表和墓碑位图。记录堆先按 <db>.crc 逐段校验，任何一段
+ *        不符都报告该段的偏移并拒绝打开；校验和文件缺失或不属于这个
+ *        数据库文件时（例如刚从镜像恢复）只打印警告，按现有内容重新计算。
+ *        旧版（网络字节序、紧凑布局）文件会先连同其 WAL 一起转换；
+ *        16 位记录数与定长槽位的映射格式文件会被改写为变长记录格式，
+ *        其 WAL 按槽位记录，转换后照常重放。转换都写临时文件再原子替换。
+ * @param fd 数据库文件的文件描述符，成功后归 map 所有
+ * @param path 数据库文件路径（转换和压缩时用于原子替换）
+ * @param mapOut 输出参数，返回映射的数据库
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_open(int fd, const char *path, dbmap_t **mapOut);
+
+/**
+ * @brief 为写入 slot 预留槽位表和 DBMAP_PREPARE_BYTES 字节的记录堆空间。
+ *        之后对该槽位的一次 dbmap_put，以及随后的一次 dbmap_kill 或截掉
+ *        一条有效记录的 dbmap_truncate 都不会失败，用于无法回滚的修改。
+ *        记录堆扩展时映射可能移动，之前取得的 dbrec_t 视图随之失效。
+ * @param map 映射的数据库
+ * @param slot 即将写入的槽位下标
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_prepare(dbmap_t *map, size_t slot);
+
+/**
+ * @brief 批量版本的 dbmap_prepare：预留 slots 个槽位的槽位表，以及
+ *        records 倍 DBMAP_PREPARE_BYTES 字节的记录堆空间。之后对槽位
+ *        [0, slots) 的共 records 次写入或删除，以及撤销它们的同样次数的
+ *        写入或删除都不会失败。映射可能移动，之前取得的视图随之失效。
+ * @param map 映射的数据库
+ * @param slots 需要的槽位数
+ * @param records 即将写入或删除的记录数
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_reserve(dbmap_t *map, size_t slots, size_t records);
+
+/**
+ * @brief 有效记录数。
+ * @param map 映射的数据库
+ * @return [0, count) 中未被删除的记录数。
+ */
+static inline size_t dbmap_live(const dbmap_t *map) {
+    return map->hdr.count - map->ndead;
+}
+
+/**
+ * @brief 判断记录堆是否恰好是按槽位顺序排列的全部有效记录，即没有旧版本
+ *        和墓碑（例如压缩或新建之后只有追加）。此时 [DBMAP_HEAP_START,
+ *        heap_end) 就是 V3 完整列表的记录数据，任意一段连续槽位中的有效
+ *        记录在文件中也是连续的。heap_end 之前的字节从不被原地修改，
+ *        压缩也只会原子地替换文件，所以通过 dup 出的文件描述符可以在
+ *        释放锁之后继续读取这些字节，得到的是调用时刻的快照。
+ * @param map 映射的数据库
+ * @return 满足条件时返回 true。
+ */
+bool dbmap_heap_is_list(const dbmap_t *map);
+
+/**
+ * @brief 解码视图对应的记录在数据库文件中的偏移。
+ * @param map 映射的数据库
+ * @param rec dbmap_view 返回的解码视图
+ * @return 记录的文件偏移。
+ */
+static inline uint64_t dbmap_offset_of(const dbmap_t *map,
+                                       const dbrec_t *rec) {
+    return (uint64_t)(rec->raw - map->base);
+}
+
+/**
+ * @brief 判断槽位中是否是有效记录，即 id 是否存在。
+ * @param map 映射的数据库
+ * @param slot 槽位下标
+ * @return 有效时返回 true。
+ */
+bool dbmap_is_live(const dbmap_t *map, size_t slot);
+
+/**
+ * @brief 取得有效记录的解码视图，字符串直接指向映射，不拷贝。
+ *        视图在下一次修改数据库之前有效。记录与写入（或打开时校验）时的
+ *        CRC32C 不符时记录错误日志（含偏移）并返回 false。
+ * @param map 映射的数据库
+ * @param slot 槽位下标
+ * @param rec 输出参数，返回解码视图
+ * @return 有效记录返回 true，墓碑、越界或损坏返回 false。
+ */
+bool dbmap_view(const dbmap_t *map, size_t slot, dbrec_t *rec);
+
+/**
+ * @brief 与 dbmap_view 相同，但不校验 CRC32C。只用于调用者在同一次
+ *        持有读锁期间已经用 dbmap_view 检查过的记录，避免重复计算。
+ * @param map 映射的数据库
+ * @param slot 槽位下标
+ * @param rec 输出参数，返回解码视图
+ * @return 有效记录返回 true，墓碑或越界返回 false。
+ */
+bool dbmap_peek(const dbmap_t *map, size_t slot, dbrec_t *rec);
+
+/**
+ * @brief 把槽位中的记录展开为定长的员工记录，墓碑展开为全零记录。
+ * @param map 映射的数据库
+ * @param slot 槽位下标
+ * @param out 输出参数，返回员工记录（hours 为主机字节序）
+ */
+void dbmap_get(const dbmap_t *map, size_t slot, struct employee_t *out);
+
+/**
+ * @brief 下一条新记录应使用的槽位：下标最小的墓碑，没有墓碑时为 count。
+ * @param map 映射的数据库
+ * @return 槽位下标。
+ */
+size_t dbmap_next_slot(dbmap_t *map);
+
+/**
+ * @brief 把一条记录写入指定槽位（可以是墓碑或更新已有记录），记录数不足
+ *        slot + 1 时增加到 slot + 1。新版本追加到记录堆末尾，旧版本成为垃圾。
+ *        WAL 重放使用它按槽位幂等地重做 ADD 记录。
+ * @param map 映射的数据库
+ * @param slot 槽位下标
+ * @param employee 员工记录（hours 为主机字节序）
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_put(dbmap_t *map, size_t slot, const struct employee_t *employee);
+
+/**
+ * @brief 把槽位标记为墓碑，与之前的状态无关（WAL 重放使用）。
+ *        有效记录会在记录堆中追加一个墓碑。不改变记录数。
+ * @param map 映射的数据库
+ * @param slot 槽位下标
+ * @return 成功时返回 STATUS_SUCCESS，扩展失败时返回 STATUS_ERROR。
+ */
+int dbmap_mark_deleted(dbmap_t *map, size_t slot);
+
+/**
+ * @brief 删除一条有效记录：标记为墓碑，若它位于末尾则连同之前的墓碑一起截掉。
+ * @param map 映射的数据库
+ * @param slot 槽位下标，必须是有效记录
+ * @return 成功时返回 STATUS_SUCCESS，槽位无效时返回 STATUS_ERROR。
+ */
+int dbmap_kill(dbmap_t *map, size_t slot);
+
+/**
+ * @brief 计算把记录数截断为 count 之后还需截掉末尾墓碑时的记录数。
+ * @param map 映射的数据库
+ * @param count 截断后的记录数，不大于当前记录数
+ * @return 末尾不是墓碑的记录数。
+ */
+size_t dbmap_trim_count(const dbmap_t *map, size_t count);
+
+/**
+ * @brief 把一条记录追加到末尾。
+ * @param map 映射的数据库
+ * @param employee 员工记录（hours 为主机字节序）
+ * @return 成功时返回 STATUS_SUCCESS，已满或扩展失败时返回 STATUS_ERROR。
+ */
+int dbmap_append(dbmap_t *map, const struct employee_t *employee);
+
+/**
+ * @brief 把记录数截断为 count，被截掉的有效记录在记录堆中追加墓碑。
+ * @param map 映射的数据库
+ * @param count 新的记录数，不大于当前记录数
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_truncate(dbmap_t *map, size_t count);
+
+/**
+ * @brief 直接设置记录数（WAL 重放使用）。增大时扫描新纳入的槽位中的墓碑。
+ * @param map 映射的数据库
+ * @param count 新的记录数
+ * @return 成功时返回 STATUS_SUCCESS，扩展失败时返回 STATUS_ERROR。
+ */
+int dbmap_set_count(dbmap_t *map, size_t count);
+
+/**
+ * @brief 判断是否值得做一次压缩：记录堆中的垃圾足够多，且不少于有效数据。
+ * @param map 映射的数据库
+ * @return 需要压缩时返回 true。
+ */
+bool dbmap_should_compact(const dbmap_t *map);
+
+/**
+ * @brief 压缩：按槽位顺序把有效记录写入 <db>.tmp，刷盘后原子地替换
+ *        数据库文件，并切换到新文件的映射。员工 id 保持不变，垃圾和
+ *        墓碑全部丢弃，文件大小随之缩小。有效记录无法通过校验时放弃压缩。
+ *        新文件的头部直接记录当前状态，
+ *        因此调用者必须保证没有检查点子进程在运行，且所有修改都已在
+ *        WAL 中落盘；WAL 的记录按槽位幂等，之后照常重放。
+ * @param map 映射的数据库
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR（此时继续
+ * 使用原来的文件）。
+ */
+int dbmap_compact(dbmap_t *map);
+
+/**
+ * @brief 检查点：先把映射中的数据页刷到磁盘，再原子地替换 <db>.crc，
+ *        最后把 count 与 hdr.heap_end 写入磁盘头部并刷盘。校验和文件覆盖的
+ *        范围因此总是不小于磁盘头部的 heap_end。只使用系统调用，可以
+ *        安全地在 fork 出的子进程中调用，此时 hdr.heap_end 和段校验和
+ *        都是 fork 时刻的值。
+ * @param map 映射的数据库
+ * @param count 写入磁盘头部的记录数，对应的 WAL 记录必须已经落盘
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_sync(dbmap_t *map, uint64_t count);
+
+/**
+ * @brief 把 map->hdr 对应的状态写成一个完整的数据库文件镜像：头部之后是
+ *        [DBMAP_HEAP_START, hdr.heap_end) 的记录堆，镜像大小恰好为
+ *        hdr.heap_end，可以直接作为数据库文件打开，不需要 WAL。
+ *        只读取映射，只使用系统调用，供 fork 出的快照子进程调用，
+ *        此时 hdr 是 fork 时刻的值，父进程之后的修改不影响镜像。
+ * @param map 映射的数据库
+ * @param fd 输出文件，从当前位置开始写入
+ * @param crcOut 输出参数，返回整个镜像的 CRC32C
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbmap_write_image(const dbmap_t *map, int fd, uint32_t *crcOut);
+
+/**
+ * @brief 取得 dbmap_write_image 写出的镜像头部：map->hdr，filesize 为
+ *        hdr.heap_end。镜像的其余部分就是数据库文件中
+ *        [DBMAP_HEAP_START, hdr.heap_end) 的字节，它们之后不会被修改，
+ *        调用者可以直接从文件发送。
+ * @param map 映射的数据库
+ * @param hdrOut 输出参数，返回镜像头部（主机字节序，与数据库文件相同）
+ */
+void dbmap_image_hdr(const dbmap_t *map, struct dbheader_t *hdrOut);
+
+/**
+ * @brief 解除映射、关闭文件并释放资源。
+ * @param map 映射的数据库，可以为 NULL
+ */
+void dbmap_close(dbmap_t *map);
+
+/**
+ * @brief 用于 GCC cleanup 属性的内联函数：关闭映射的数据库
+ * @param p_map 指向 dbmap_t 指针的指针
+ */
+static inline void _cleanup_dbmap_(dbmap_t **p_map) {
+    if (*p_map != NULL) {
+        dbmap_close(*p_map);
+        *p_map = NULL;
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef DBPACK_H
+#define DBPACK_H
+
+#include <stddef.h>  // For size_t
+#include <stdint.h>  // For uint_t types
+
+#include "dbmap.h"  // 包含映射的数据库 dbmap_t
+
+/**
+ * @brief 打包镜像文件的魔数 "EMPK"
+ */
+#define DBPACK_MAGIC 0x454d504bu
+
+/**
+ * @brief 打包镜像的格式版本
+ */
+#define DBPACK_VERSION 1
+
+/**
+ * @brief 每个数据块覆盖的镜像字节数（最后一块可以更短）。
+ *        块内的匹配距离因此总能用 16 位表示。
+ */
+#define DBPACK_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @brief 压缩 n 字节时输出的最大长度（不可压缩的数据略有膨胀）
+ */
+#define DBPACK_BOUND(n) ((n) + (n) / 255 + 16)
+
+/**
+ * @brief 数据块的存储方式
+ */
+typedef enum {
+    DBPACK_RAW = 0,  ///< 原样存储（压缩后不更小）
+    DBPACK_LZ = 1,   ///< LZ4 块格式压缩
+} dbpack_codec_e;
+
+/**
+ * @brief 打包镜像的文件头部（主机字节序）
+ */
+typedef struct {
+    uint32_t magic;       ///< DBPACK_MAGIC
+    uint16_t version;     ///< DBPACK_VERSION
+    uint16_t reserved;    ///< 保留，写 0
+    uint32_t block_size;  ///< DBPACK_BLOCK_SIZE
+    uint32_t reserved2;   ///< 保留，写 0
+    uint64_t raw_size;    ///< 解包后的镜像大小
+} __attribute__((__packed__)) dbpack_hdr_t;
+
+/**
+ * @brief 块索引的一项（主机字节序）
+ */
+typedef struct {
+    uint64_t offset;  ///< 块数据在打包文件中的偏移
+    uint32_t stored;  ///< 块数据在文件中的字节数
+    uint32_t raw;     ///< 解包后的字节数
+    uint32_t crc;     ///< 块数据（文件中的字节）的 CRC32C
+    uint32_t codec;   ///< 存储方式，见 dbpack_codec_e
+} __attribute__((__packed__)) dbpack_index_t;
+
+/**
+ * @brief 打包镜像的文件尾部，位于文件的最后（主机字节序）
+ */
+typedef struct {
+    uint64_t index_offset;  ///< 块索引在文件中的偏移
+    uint64_t nblocks;       ///< 块数
+    uint32_t index_crc;     ///< 整个块索引的 CRC32C
+    uint32_t image_crc;     ///< 解包后整个镜像的 CRC32C
+    uint32_t reserved;      ///< 保留，写 0
+    uint32_t magic;         ///< DBPACK_MAGIC，用于识别被截断的文件
+} __attribute__((__packed__)) dbpack_footer_t;
+
+/**
+ * @brief 用 LZ4 块格式压缩一段数据：贪心匹配，4096 项的哈希表，
+ *        最后 5 个字节总是字面量。不申请内存。
+ * @param src 输入
+ * @param len 输入长度，不超过 DBPACK_BLOCK_SIZE
+ * @param dst 输出缓冲区，至少 DBPACK_BOUND(len) 字节
+ * @return 压缩后的长度。
+ */
+size_t dbpack_compress(const char *src, size_t len, char *dst);
+
+/**
+ * @brief 解压 LZ4 块格式的数据，检查所有长度与距离，
+ *        损坏的数据不会造成越界访问。
+ * @param src 压缩数据
+ * @param len 压缩数据长度
+ * @param dst 输出缓冲区
+ * @param raw 期望的解压长度，也是 dst 的容量
+ * @return 成功时返回 STATUS_SUCCESS，数据损坏时返回 STATUS_ERROR。
+ */
+int dbpack_decompress(const char *src, size_t len, char *dst, size_t raw);
+
+/**
+ * @brief 把 map->hdr 对应的镜像（内容同 dbmap_write_image）写成打包格式：
+ *        头部、逐块压缩的数据块、块索引和尾部。每块各自带 CRC32C，
+ *        损坏只影响所在的块，并能被精确定位。
+ *        只使用系统调用（工作内存来自匿名映射），供快照子进程调用。
+ * @param map 映射的数据库
+ * @param fd 输出文件，从当前位置开始写入
+ * @param crcOut 输出参数，返回解包后整个镜像的 CRC32C
+ * @param packedOut 输出参数，返回打包文件的大小，可以为 NULL
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbpack_write_image(const dbmap_t *map, int fd, uint32_t *crcOut,
+                       uint64_t *packedOut);
+
+/**
+ * @brief 从打包镜像恢复数据库文件：逐块读取、校验并解压到 <db>.tmp，
+ *        整个镜像的校验和也匹配时落盘并原子地替换 db_path。
+ *        只读取压缩后的字节。损坏时报告出错的块，数据库文件保持不变。
+ * @param pack_path 打包镜像路径（例如 <db>.snap）
+ * @param db_path 要恢复的数据库文件路径
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbpack_restore(const char *pack_path, const char *db_path);
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef FILE_H
 #define FILE_H
 
+#include <stddef.h>  // For size_t
+
 /**
  * @brief 创建一个新的数据库文件。
  *        如果文件已存在则返回错误。
@@ -16,4 +18,30 @@ int create_db_file(char *filename);
  */
 int open_db_file(char *filename);
 
+/**
+ * @brief 对文件所在目录执行 fsync，保证 rename/unlink/create 持久化。
+ * @param path 文件路径
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int fsync_parent_dir(const char *path);
+
+/**
+ * @brief 完整写入缓冲区，处理短写和 EINTR。
+ * @param fd 文件描述符
+ * @param buf 数据缓冲区
+ * @param len 要写入的字节数
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int write_all(int fd, const void *buf, size_t len);
+
+/**
+ * @brief 完整读取 len 字节，处理短读和 EINTR。
+ * @param fd 文件描述符
+ * @param buf 接收数据的缓冲区
+ * @param len 要读取的字节数
+ * @return 成功时返回 STATUS_SUCCESS，错误或提前遇到文件结尾时返回
+ * STATUS_ERROR。
+ */
+int read_all(int fd, void *buf, size_t len);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>  // For size_t
+#include <stdint.h>  // For uint64_t
+
+/**
+ * @brief 每个二进制数量级内的子桶数的对数。每个数量级分为 64 个等宽子桶，
+ *        记录值的相对误差不超过 1/64（约两位有效数字）
+ */
+#define HIST_SUB_BITS 6
+
+/**
+ * @brief 桶的总数：小于 128 的值每个值一个桶，之后每个数量级 64 个桶，
+ *        覆盖到 2^39（以纳秒计约 9 分钟），更大的值记入最后一个桶
+ */
+#define HIST_BUCKETS ((40 - HIST_SUB_BITS) << HIST_SUB_BITS)
+
+/**
+ * @brief 对数-线性分桶的延迟直方图（HDR 直方图的简化版）。
+ *        记录是 O(1) 的，内存大小固定，多个线程各自记录后再合并。
+ */
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];  ///< 每个桶的计数
+    uint64_t total;                 ///< 记录的值的个数
+    uint64_t min;                   ///< 最小值
+    uint64_t max;                   ///< 最大值
+    double sum;                     ///< 所有值之和，用于求平均值
+} hist_t;
+
+/**
+ * @brief 把直方图清零。
+ * @param h 直方图
+ */
+void hist_init(hist_t *h);
+
+/**
+ * @brief 记录一个值。
+ * @param h 直方图
+ * @param value 值（例如以纳秒计的延迟）
+ */
+void hist_record(hist_t *h, uint64_t value);
+
+/**
+ * @brief 把 src 的计数累加到 dst。
+ * @param dst 目标直方图
+ * @param src 源直方图
+ */
+void hist_merge(hist_t *dst, const hist_t *src);
+
+/**
+ * @brief 计算百分位数。
+ * @param h 直方图
+ * @param percentile 百分位，0 到 100
+ * @return 该百分位所在桶的上界（不超过最大值），没有记录时返回 0。
+ */
+uint64_t hist_percentile(const hist_t *h, double percentile);
+
+/**
+ * @brief 计算平均值。
+ * @param h 直方图
+ * @return 平均值，没有记录时返回 0。
+ */
+double hist_mean(const hist_t *h);
+
+#endif
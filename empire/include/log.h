@@ -0,0 +1,62 @@
+#ifndef LOG_H
+#define LOG_H
+
+/**
+ * @brief 日志环形缓冲区的槽位数，必须是 2 的幂
+ */
+#define LOG_RING_SLOTS 4096
+
+/**
+ * @brief 一条日志的最大长度（含换行），更长的消息被截断
+ */
+#define LOG_LINE_MAX 256
+
+/**
+ * @brief 日志级别，低于当前级别的消息在格式化之前就被丢弃
+ */
+typedef enum {
+    LOG_DEBUG = 0,  ///< 每个请求、每个连接的细节
+    LOG_INFO = 1,   ///< 启动、关闭、快照与复制等事件
+    LOG_WARN = 2,   ///< 客户端错误等不影响服务器的问题
+    LOG_ERROR = 3,  ///< 服务器自身的错误
+} log_level_e;
+
+/**
+ * @brief 当前的日志级别，默认为 LOG_INFO
+ */
+extern log_level_e log_level;
+
+/**
+ * @brief 启动后台写日志线程。之后的日志由调用线程格式化进环形缓冲区，
+ *        由后台线程批量写到 stdout（LOG_WARN 及以上写到 stderr），
+ *        事件循环不再因为写终端或文件而阻塞。缓冲区满时丢弃新消息并计数。
+ *        启动之前（以及客户端程序中）日志直接同步写出。
+ *        写日志线程屏蔽所有信号。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int log_start(void);
+
+/**
+ * @brief 写出缓冲区中剩余的日志并停止后台线程，之后的日志恢复同步写出。
+ *        必须在所有写日志的线程退出之后调用。
+ */
+void log_stop(void);
+
+/**
+ * @brief 写一条日志，末尾自动加换行。请使用下面的宏，它们先检查级别。
+ * @param level 日志级别
+ * @param fmt printf 格式的消息
+ */
+void log_write(log_level_e level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#define log_at(level, ...)                                         \
+    do {                                                           \
+        if ((level) >= log_level) log_write((level), __VA_ARGS__); \
+    } while (0)
+#define log_debug(...) log_at(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...) log_at(LOG_INFO, __VA_ARGS__)
+#define log_warn(...) log_at(LOG_WARN, __VA_ARGS__)
+#define log_error(...) log_at(LOG_ERROR, __VA_ARGS__)
+
+#endif
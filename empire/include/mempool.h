@@ -0,0 +1,99 @@
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include <stddef.h>  // For size_t
+
+/**
+ * @brief 对象池中一次向系统申请的内存块大小（对象很大时至少容纳一个对象）
+ */
+#define SLAB_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @brief 请求内存池的初始容量，之后按需要增长到单条请求用过的最大值
+ */
+#define ARENA_MIN_SIZE (16 * 1024)
+
+/**
+ * @brief 定长对象池。
+ *        对象从 SLAB_BLOCK_SIZE 大小的内存块中切分，释放的对象挂到空闲链表
+ *        上供下次分配复用，内存块直到 slab_destroy 才归还系统，因此稳定
+ *        状态下分配与释放都只是链表操作。不加锁，只能由一个线程使用。
+ */
+typedef struct {
+    size_t size;         ///< 对象大小（按 16 字节对齐）
+    size_t per_block;    ///< 每个内存块中的对象数
+    void *free;          ///< 空闲对象链表，链接指针存放在对象本身的开头
+    void *blocks;        ///< 已申请的内存块链表，用于 slab_destroy
+    size_t nblocks;      ///< 已申请的内存块数
+    size_t in_use;       ///< 已分配未释放的对象数
+} slab_t;
+
+/**
+ * @brief 初始化对象池，不申请内存。
+ * @param slab 对象池
+ * @param size 对象大小
+ */
+void slab_init(slab_t *slab, size_t size);
+
+/**
+ * @brief 分配一个对象，内容未初始化。空闲链表为空时申请一个新内存块。
+ * @param slab 对象池
+ * @return 对象指针，内存不足时返回 NULL。
+ */
+void *slab_alloc(slab_t *slab);
+
+/**
+ * @brief 把对象归还到空闲链表。
+ * @param slab 对象池
+ * @param obj 由 slab_alloc 分配的对象，可以为 NULL
+ */
+void slab_free(slab_t *slab, void *obj);
+
+/**
+ * @brief 释放对象池的所有内存块，之前分配的对象全部失效。
+ * @param slab 对象池
+ */
+void slab_destroy(slab_t *slab);
+
+/**
+ * @brief 单条请求使用的线性（bump）内存池。
+ *        分配只移动偏移，不单独释放；处理完一条消息后 arena_reset 一次性
+ *        回收。容量不够时临时向系统申请溢出块，reset 时把主块扩大到这次
+ *        用过的总量，之后同样大小的请求不再申请内存。不加锁。
+ */
+typedef struct {
+    char *base;       ///< 主块
+    size_t cap;       ///< 主块容量
+    size_t used;      ///< 主块已用字节数
+    void *overflow;   ///< 主块放不下时申请的溢出块链表
+    size_t spilled;   ///< 溢出块中分配的总字节数
+} arena_t;
+
+/**
+ * @brief 初始化请求内存池，申请 ARENA_MIN_SIZE 字节的主块。
+ * @param arena 请求内存池
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int arena_init(arena_t *arena);
+
+/**
+ * @brief 分配 size 字节（按 16 字节对齐），内容未初始化。
+ * @param arena 请求内存池
+ * @param size 字节数
+ * @return 内存指针，内存不足时返回 NULL。
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * @brief 回收本次请求分配的所有内存，释放溢出块并按需扩大主块。
+ * @param arena 请求内存池
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * @brief 释放请求内存池的全部内存。
+ * @param arena 请求内存池
+ */
+void arena_destroy(arena_t *arena);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef OUTQ_H
+#define OUTQ_H
+
+#include <stddef.h>  // For size_t
+#include <stdint.h>  // For uint64_t
+
+#include "mempool.h"  // 包含 slab_t
+
+/**
+ * @brief 输出队列第一个数据块的容量，后续数据块按倍数增长
+ */
+#define OUTQ_MIN_CHUNK 4096
+/**
+ * @brief 单个数据块的最大容量（大于此值的单次追加除外）
+ */
+#define OUTQ_MAX_CHUNK (256 * 1024)
+/**
+ * @brief 一次 writev 最多聚合的数据块数量
+ */
+#define OUTQ_MAX_IOV 64
+
+/**
+ * @brief 输出队列中的一个数据块。文件块没有数据区，而是引用文件中的
+ *        一段字节，发送时用 sendfile 直接从页缓存写到套接字。
+ */
+typedef struct outq_chunk {
+    struct outq_chunk *next;  ///< 下一个数据块
+    size_t off;               ///< 已发送到的位置
+    size_t len;               ///< 已写入的数据长度（文件块为字节段长度）
+    size_t cap;               ///< 数据区容量，文件块为 0
+    int fd;                   ///< 文件块的文件描述符，内存块为 -1
+    uint64_t file_off;        ///< 文件块的字节段在文件中的起始偏移
+    char data[];              ///< 数据区
+} outq_chunk_t;
+
+/**
+ * @brief 输出队列对象池中每个对象的大小：容量为 OUTQ_MIN_CHUNK 的数据块
+ */
+#define OUTQ_POOL_OBJ_SIZE (sizeof(outq_chunk_t) + OUTQ_MIN_CHUNK)
+
+/**
+ * @brief 可增长的非阻塞输出队列。
+ *        响应被追加到数据块链表尾部，可写时用 writev 一次发送多个数据块。
+ *        appended/sent 是自连接建立以来的绝对字节偏移，调用者可以据此
+ *        只发送到某个偏移为止（例如等待 WAL 落盘的确认之前）。
+ *        设置了 pool 时，最小容量的数据块（绝大多数小响应只用一个）取自
+ *        对象池，发送完后归还，稳定状态下小响应不再调用 malloc。
+ */
+typedef struct {
+    outq_chunk_t *head;  ///< 第一个未发送完的数据块
+    outq_chunk_t *tail;  ///< 最后一个数据块
+    uint64_t appended;   ///< 累计追加的字节数
+    uint64_t sent;       ///< 累计发送的字节数
+    slab_t *pool;  ///< OUTQ_MIN_CHUNK 数据块的对象池，NULL 时直接 malloc
+} outq_t;
+
+/**
+ * @brief 获取队列中尚未发送的字节数。
+ * @param q 输出队列
+ * @return 待发送字节数。
+ */
+static inline size_t outq_pending(const outq_t *q) {
+    return (size_t)(q->appended - q->sent);
+}
+
+/**
+ * @brief 在队列尾部预留至少 min 字节的连续空间，供调用者直接写入。
+ *        写入后必须调用 outq_commit 确认实际使用的字节数。
+ * @param q 输出队列
+ * @param min 需要的最小连续空间
+ * @param avail 输出参数，返回实际可用的连续空间
+ * @return 可写入位置的指针，内存不足时返回 NULL。
+ */
+void *outq_reserve(outq_t *q, size_t min, size_t *avail);
+
+/**
+ * @brief 确认 outq_reserve 预留的空间中实际写入的字节数。
+ * @param q 输出队列
+ * @param used 写入的字节数，不超过 outq_reserve 返回的 avail
+ */
+void outq_commit(outq_t *q, size_t used);
+
+/**
+ * @brief 把数据拷贝追加到队列尾部。
+ * @param q 输出队列
+ * @param buf 数据
+ * @param len 数据长度
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int outq_append(outq_t *q, const void *buf, size_t len);
+
+/**
+ * @brief 在队列尾部追加文件中的一段字节，发送时不经过用户态拷贝。
+ *        调用者必须保证这段字节在发送完之前不被修改。
+ * @param q 输出队列
+ * @param fd 文件描述符，无论成功与否都归队列所有，发送完或清空时关闭
+ * @param off 字节段在文件中的起始偏移
+ * @param len 字节段长度
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int outq_append_file(outq_t *q, int fd, uint64_t off, size_t len);
+
+/**
+ * @brief 用 writev 把队列中的数据写到非阻塞套接字，直到写完、遇到 EAGAIN，
+ *        或者达到绝对偏移 limit。文件块用 sendfile 发送。已发送完的数据块
+ *        会被释放。
+ * @param q 输出队列
+ * @param fd 套接字
+ * @param limit 最多发送到的绝对偏移，传 UINT64_MAX 表示不限制
+ * @return 成功（包括 EAGAIN）时返回 STATUS_SUCCESS，连接错误时返回
+ * STATUS_ERROR。
+ */
+int outq_flush(outq_t *q, int fd, uint64_t limit);
+
+/**
+ * @brief 丢弃队列中所有数据并释放内存。
+ * @param q 输出队列
+ */
+void outq_clear(outq_t *q);
+
+#endif
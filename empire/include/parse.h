@@ -1,6 +1,7 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+#include <stddef.h>  // For size_t
 #include <stdint.h>  // For uint_t types
 
 /**
@@ -9,55 +10,89 @@
 #define HEADER_MAGIC 0x4c4c4144  // "LLAD" in ASCII
 
 /**
- * @brief 数据库文件头部结构体。
- *        所有字段在文件读写时需要进行字节序转换。
- *        `__attribute__((__packed__))`
- * 确保结构体没有填充字节，但可能导致对齐问题和性能下降。
+ * @brief 旧版数据库文件格式：网络字节序、紧凑布局，每次写回整个文件。
+ *        头部为 dbheader_v1_t。打开时会自动升级为 DB_VERSION_VARLEN。
  */
-struct dbheader_t {
-    uint32_t magic;    ///< 魔数，标识数据库文件
-    uint16_t version;  ///< 数据库版本
-    uint16_t count;    ///< 数据库中员工记录的数量
+#define DB_VERSION_LEGACY 100
+
+/**
+ * @brief 第一版内存映射格式：本机字节序，头部为 dbheader_v1_t，
+ *        记录数只有 16 位。打开时会自动升级为 DB_VERSION_VARLEN。
+ */
+#define DB_VERSION_MMAP16 101
+
+/**
+ * @brief 定长槽位的内存映射格式：本机字节序，头部为 dbheader_t 中
+ *        heap_end 之前的部分，之后是 count 个定长的 employee_t 槽位。
+ *        打开时会自动升级为 DB_VERSION_VARLEN。
+ */
+#define DB_VERSION_FIXED 102
+
+/**
+ * @brief 变长记录的内存映射格式：本机字节序，头部之后是只追加的
+ *        紧凑记录堆（见 dbmap.h 与 record.h）
+ */
+#define DB_VERSION_VARLEN 103
+
+/**
+ * @brief 旧版（DB_VERSION_LEGACY 与 DB_VERSION_MMAP16）文件的头部结构体，
+ *        只在读取和升级旧文件时使用。
+ *        `__attribute__((__packed__))` 确保结构体没有填充字节。
+ */
+struct dbheader_v1_t {
+    uint32_t magic;     ///< 魔数，标识数据库文件
+    uint16_t version;   ///< 数据库版本
+    uint16_t count;     ///< 员工记录的数量
     uint32_t filesize;  ///< 整个数据库文件的大小，包括头部和所有员工记录
 } __attribute__((__packed__));
 
+/**
+ * @brief 数据库文件头部结构体，也是内存中使用的头部。
+ *        映射格式中直接使用本机字节序；count、filesize 与 heap_end 位于
+ *        8 字节对齐的偏移处，检查点可以原子地更新它们。
+ *        `__attribute__((__packed__))` 确保结构体没有填充字节。
+ */
+struct dbheader_t {
+    uint32_t magic;     ///< 魔数，标识数据库文件
+    uint16_t version;   ///< 数据库版本
+    uint16_t reserved;  ///< 保留，写 0
+    uint64_t count;  ///< 数据库中员工记录的数量（映射格式中为已使用的槽位数，
+                     ///< 含已删除的槽位）
+    uint64_t filesize;  ///< 整个数据库文件的大小，包括头部和所有员工记录
+    uint64_t heap_end;  ///< 记录堆的末尾偏移，之后的字节不属于数据库
+} __attribute__((__packed__));
+
 /**
  * @brief 员工信息结构体。
  *        `__attribute__((__packed__))` 确保结构体没有填充字节。
+ *        员工 id 即记录所在的槽位下标，在记录被删除之前保持不变。
  */
 struct employee_t {
-    char name[256];     ///< 员工姓名，以 null 结尾
+    char name[256];     ///< 员工姓名，以 null 结尾；为空表示槽位已删除
     char address[256];  ///< 员工地址，以 null 结尾
     uint32_t hours;     ///< 员工工作小时数
 } __attribute__((__packed__));
 
 /**
- * @brief 创建并初始化数据库文件头部。
- * @param fd 数据库文件的文件描述符。
- * @param headerOut 指向 dbheader_t 指针的指针，用于返回新创建的头部。
- * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ * @brief 判断槽位中的记录是否已被删除（墓碑）。
+ *        parse_employee 不接受空名字，因此有效记录的名字总是非空的；
+ *        删除只需清零名字的第一个字节，单字节写入不会被撕裂。
+ * @param employee 员工记录
+ * @return 已删除时返回 1，否则返回 0。
  */
-int create_db_header(struct dbheader_t **headerOut);
+static inline int employee_is_deleted(const struct employee_t *employee) {
+    return employee->name[0] == '\0';
+}
 
 /**
- * @brief 验证数据库文件的头部信息。
+ * @brief 验证旧版数据库文件的头部信息（磁盘上为 dbheader_v1_t）。
  * @param fd 数据库文件的文件描述符。
- * @param headerOut 指向 dbheader_t 指针的指针，用于返回读取和验证后的头部。
+ * @param headerOut 指向 dbheader_t 指针的指针，用于返回读取和验证后的头部
+ *                  （已转换为主机字节序）。
  * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
  */
 int validate_db_header(int fd, struct dbheader_t **headerOut);
 
-/**
- * @brief 将内存中的数据库头部和员工数据写入文件。
- *        此函数负责字节序转换和文件截断。
- * @param fd 数据库文件的文件描述符。
- * @param dbhdr 指向数据库头部的指针（只读）。
- * @param employees 指向员工数组的指针（只读）。
- * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
- */
-int output_file(int fd, const struct dbheader_t *dbhdr,
-                const struct employee_t *employees);
-
 /**
  * @brief 从数据库文件中读取所有员工记录到内存。
  * @param fd 数据库文件的文件描述符。
@@ -70,32 +105,57 @@ int read_employees(int fd, struct dbheader_t *dbhdr,
                    struct employee_t **employeesOut);
 
 /**
- * @brief 向内存中的员工数组添加一个新员工。
- *        此函数会重新分配内存以容纳新员工，并解析 `addstring`。
- * @param dbhdr 指向数据库头部的指针（会修改其 count 字段）。
- * @param employees 指向 struct employee_t 指针的指针（可能会改变内存地址）。
- * @param addstring 格式为 "Name-Address-Hours" 的员工信息字符串。
+ * @brief 解析 "Name-Address-Hours" 格式的字符串，填充一条员工记录。
+ *        单遍扫描，不复制输入也不申请内存，可以在多个线程中同时调用。
+ *        名字与地址中的 '-' 和 '\' 前面加一个 '\' 转义；字段不能为空，
+ *        也不能超过 255 字节；小时数只允许十进制数字。
+ *        不修改内存中的员工数组。
+ * @param addstring 员工信息字符串，不必以 '\0' 结尾。
+ * @param len 最多读取的字节数，遇到 '\0' 提前结束。
+ * @param employeeOut 输出参数，解析得到的员工记录（hours 为主机字节序）。
  * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
  */
-int add_employee(struct dbheader_t *dbhdr, struct employee_t **employees,
-                 const char *addstring);
+int parse_employee_n(const char *addstring, size_t len,
+                     struct employee_t *employeeOut);
 
 /**
- * @brief 从内存中的员工数组中删除最后一个员工。
- *        此函数会重新分配内存以缩小数组。
+ * @brief 解析以 '\0' 结尾的 "Name-Address-Hours" 字符串，
+ *        规则与 parse_employee_n 相同。
+ * @param addstring 以 '\0' 结尾的员工信息字符串。
+ * @param employeeOut 输出参数，解析得到的员工记录（hours 为主机字节序）。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int parse_employee(const char *addstring, struct employee_t *employeeOut);
+
+/**
+ * @brief 从二进制添加请求（dbproto_employee_add_req_v2_t 及之后的字段）
+ *        中取出员工记录，只检查长度，不做字符串解析。
+ * @param body 指向请求体。
+ * @param len 请求体的总字节数。
+ * @param employeeOut 输出参数，员工记录（hours 为主机字节序）。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int parse_employee_fields(const void *body, size_t len,
+                          struct employee_t *employeeOut);
+
+/**
+ * @brief 将一条已解析的员工记录追加到内存中的员工数组末尾。
+ *        WAL 重放时直接使用此函数，无需再次解析字符串。
  * @param dbhdr 指向数据库头部的指针（会修改其 count 字段）。
  * @param employees 指向 struct employee_t 指针的指针（可能会改变内存地址）。
+ * @param employee 要追加的员工记录（hours 为主机字节序）。
  * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
  */
-int remove_employee(struct dbheader_t *dbhdr, struct employee_t **employees);
+int append_employee(struct dbheader_t *dbhdr, struct employee_t **employees,
+                    const struct employee_t *employee);
 
 /**
- * @brief 列出内存中的所有员工信息到标准输出。
- * @param dbhdr 指向数据库头部的指针（只读）。
- * @param employees 指向员工数组的指针（只读）。
+ * @brief 从内存中的员工数组中删除最后一个员工。
+ *        数组不随之缩小，之后的追加直接复用空出的位置。
+ * @param dbhdr 指向数据库头部的指针（会修改其 count 字段）。
+ * @param employees 指向 struct employee_t 指针的指针（可能会改变内存地址）。
  * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
  */
-int list_employees(const struct dbheader_t *dbhdr,
-                   const struct employee_t *employees);
+int remove_employee(struct dbheader_t *dbhdr, struct employee_t **employees);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <signal.h>  // For sig_atomic_t
+
+#include "srvpoll.h"  // 包含 dbctx_t, clientstate_t
+
+/**
+ * @brief 一次 epoll_wait 最多取回的事件数量
+ */
+#define REACTOR_MAX_EVENTS 256
+
+/**
+ * @brief 监听队列长度
+ */
+#define REACTOR_BACKLOG SOMAXCONN
+
+/**
+ * @brief 事件循环线程数的上限
+ */
+#define REACTOR_MAX_THREADS 256
+
+/**
+ * @brief 运行基于 epoll 边沿触发的服务器事件循环，直到 *stop 被置位。
+ *        clientstate_t 指针保存在 epoll_event.data.ptr 中，每次唤醒的代价
+ *        只与就绪的连接数有关；连接数只受进程文件描述符上限约束。
+ *        每轮事件处理完后做一次 WAL 组提交，并按需启动后台检查点。
+ *        nthreads > 1 时每个线程运行一个独立的事件循环，各自用 SO_REUSEPORT
+ *        监听同一端口；连接一经接受就只由该线程处理，线程间只共享 db。
+ *        调用线程运行 0 号事件循环并负责接收 SIGINT/SIGCHLD。
+ * @param port 服务器监听端口
+ * @param nthreads 事件循环线程数，1 到 REACTOR_MAX_THREADS
+ * @param db 服务器数据上下文（FSM 可能修改它，须已用 dbctx_init 初始化）
+ * @param stop 退出标志，由信号处理函数设置
+ * @return 正常退出时返回 STATUS_SUCCESS，初始化失败时返回 STATUS_ERROR。
+ */
+int reactor_run(unsigned short port, int nthreads, dbctx_t *db,
+                volatile sig_atomic_t *stop);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>  // For size_t
+#include <stdint.h>  // For uint32_t, uint64_t
+
+#include "parse.h"  // 包含 employee_t 结构体
+
+/**
+ * @brief 一条紧凑记录编码后的最大长度：槽位和 hours 的变长整数各 5 字节，
+ *        名字和地址各为 2 字节长度加最多 255 字节内容
+ */
+#define DBREC_MAX_SIZE (5 + 2 + 255 + 2 + 255 + 5)
+
+/**
+ * @brief 一个墓碑编码后的最大长度：槽位的变长整数加三个 0 字节
+ */
+#define DBREC_TOMBSTONE_MAX_SIZE (5 + 3)
+
+/**
+ * @brief 紧凑记录的解码视图，字符串指向编码数据本身，不以 '\0' 结尾。
+ *        编码格式（数据库文件与 V3 协议的列表响应共用）依次为：
+ *        varint 槽位、varint 名字长度、名字、varint 地址长度、地址、
+ *        varint hours。varint 为 LEB128：每字节低 7 位是数据，最高位
+ *        表示后面还有字节，与字节序无关。名字长度为 0 的记录是墓碑。
+ */
+typedef struct {
+    uint32_t slot;        ///< 槽位下标，即员工 id
+    const char *name;     ///< 名字
+    size_t name_len;      ///< 名字长度，为 0 表示墓碑
+    const char *address;  ///< 地址
+    size_t address_len;   ///< 地址长度
+    uint32_t hours;       ///< 员工工作小时数
+    const char *raw;      ///< 编码数据的起始位置
+    size_t size;          ///< 编码后的总字节数
+} dbrec_t;
+
+/**
+ * @brief 把一条员工记录编码为紧凑格式。
+ * @param dst 目标缓冲区，至少 DBREC_MAX_SIZE 字节
+ * @param slot 槽位下标
+ * @param employee 员工记录（hours 为主机字节序），名字为空时编码为墓碑
+ * @return 编码后的字节数。
+ */
+size_t dbrec_encode(char *dst, uint32_t slot,
+                    const struct employee_t *employee);
+
+/**
+ * @brief 编码一个墓碑记录。
+ * @param dst 目标缓冲区，至少 DBREC_MAX_SIZE 字节
+ * @param slot 被删除的槽位下标
+ * @return 编码后的字节数。
+ */
+size_t dbrec_encode_tombstone(char *dst, uint32_t slot);
+
+/**
+ * @brief 从 src 解码一条记录，不拷贝字符串。
+ * @param src 编码数据
+ * @param len src 中可用的字节数
+ * @param out 输出参数，返回解码视图
+ * @return 记录的字节数；数据不完整或格式错误时返回 0。
+ *         len 不小于 DBREC_MAX_SIZE 时返回 0 只可能是格式错误。
+ */
+size_t dbrec_decode(const char *src, size_t len, dbrec_t *out);
+
+/**
+ * @brief 把解码视图展开为定长的员工记录（旧版协议使用）。
+ * @param rec 解码视图
+ * @param out 输出参数，未使用的字节填 0（hours 为主机字节序）
+ */
+void dbrec_to_employee(const dbrec_t *rec, struct employee_t *out);
+
+#endif
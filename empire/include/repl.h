@@ -0,0 +1,208 @@
+#ifndef REPL_H
+#define REPL_H
+
+#include <pthread.h>  // For pthread_t, pthread_mutex_t, pthread_rwlock_t
+#include <stdbool.h>  // For bool
+#include <stddef.h>   // For size_t
+#include <stdint.h>   // For uint_t types
+#include <sys/types.h>  // For ssize_t
+
+#include "dbindex.h"  // 包含二级索引 dbindex_t
+#include "dbmap.h"    // 包含映射的数据库 dbmap_t
+
+/**
+ * @brief 主库的复制积压缓冲区大小：副本最多可以落后这么多字节的日志
+ */
+#define REPL_BACKLOG_SIZE (16 * 1024 * 1024)
+
+/**
+ * @brief 一条 MSG_REPL_WAL 消息最多携带的日志字节数
+ */
+#define REPL_CHUNK (64 * 1024)
+
+/**
+ * @brief 复制状态（主机字节序），字段含义见 dbproto_repl_stats_resp_t
+ */
+typedef struct {
+    uint32_t role;         ///< 见 dbproto_repl_role_e
+    uint32_t links;        ///< 主库：已连接的副本数；副本：与主库连接时为 1
+    uint64_t lsn;          ///< 主库：已落盘的最大 LSN；副本：已应用的最大 LSN
+    uint64_t primary_lsn;  ///< 主库最近一次通告的已落盘 LSN
+    uint64_t lag_lsn;      ///< 落后的 LSN 数
+    uint64_t lag_ms;       ///< 已经落后了多少毫秒，追上时为 0
+} repl_stats_t;
+
+struct repl_log;
+
+/**
+ * @brief 主库上一个副本的订阅：它在日志流中的发送位置与确认进度。
+ *        由订阅连接所在的事件循环线程读取日志，确认进度由 log 的锁保护。
+ */
+typedef struct repl_sub {
+    struct repl_log *log;   ///< 所属的复制日志
+    uint64_t off;           ///< 下一个要发送的字节在日志流中的偏移
+    uint64_t ack_lsn;       ///< 副本确认已应用的最大 LSN
+    uint64_t behind_since;  ///< 开始落后的时刻（单调时钟毫秒），0 表示已追上
+    struct repl_sub *prev;  ///< 所有订阅组成的双向链表
+    struct repl_sub *next;
+} repl_sub_t;
+
+/**
+ * @brief 主库的复制日志：最近落盘的 WAL 记录组成的环形积压缓冲区。
+ *        WAL 每次组提交之后（见 wal_set_commit_hook）把落盘的记录原样
+ *        追加到缓冲区，并写 notify_fd 唤醒所有事件循环，由各自向本线程的
+ *        副本推送。日志流用自启动以来的绝对字节偏移定位，缓冲区只保留最后
+ *        REPL_BACKLOG_SIZE 字节；没有订阅时不拷贝记录，也不申请缓冲区。
+ *        所有接口都是线程安全的。
+ */
+typedef struct repl_log {
+    char *ring;           ///< 环形缓冲区，第一个订阅出现时申请
+    uint64_t start;       ///< 缓冲区中最老的字节在日志流中的偏移
+    uint64_t end;         ///< 日志流的末尾偏移
+    uint64_t end_lsn;     ///< 日志流中最后一条记录的 LSN
+    repl_sub_t *subs;     ///< 所有订阅
+    size_t nsubs;         ///< 订阅数
+    int notify_fd;        ///< 有新记录时写入的 eventfd，从不读取
+    pthread_mutex_t lock; ///< 保护以上状态
+} repl_log_t;
+
+/**
+ * @brief 初始化复制日志并创建 notify_fd。
+ * @param log 复制日志
+ * @param lsn 此刻已经落盘的最大 LSN
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int repl_log_init(repl_log_t *log, uint64_t lsn);
+
+/**
+ * @brief 释放复制日志，所有订阅必须已经取消。
+ * @param log 复制日志
+ */
+void repl_log_destroy(repl_log_t *log);
+
+/**
+ * @brief 追加一批落盘的记录，签名与 wal_commit_fn 相同。
+ * @param arg 指向 repl_log_t
+ * @param data 编码后的记录
+ * @param len 记录的总字节数
+ * @param last_lsn 最后一条记录的 LSN
+ */
+void repl_log_append(void *arg, const char *data, size_t len,
+                     uint64_t last_lsn);
+
+/**
+ * @brief 订阅日志流的末尾。调用者必须保证此刻 WAL 中没有未提交的记录，
+ *        并且在订阅之前没有新的修改，使日志流从 lsn 之后的第一条记录开始。
+ * @param log 复制日志
+ * @param sub 要登记的订阅
+ * @param lsn 副本已有的最大 LSN（它收到的镜像对应的 LSN）
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int repl_log_subscribe(repl_log_t *log, repl_sub_t *sub, uint64_t lsn);
+
+/**
+ * @brief 取消订阅。
+ * @param sub 已登记的订阅
+ */
+void repl_log_unsubscribe(repl_sub_t *sub);
+
+/**
+ * @brief 查询订阅尚未发送的字节数。
+ * @param sub 订阅
+ * @return 待发送的字节数；订阅已经落后到缓冲区之外时返回 -1。
+ */
+ssize_t repl_log_pending(repl_sub_t *sub);
+
+/**
+ * @brief 从订阅的发送位置拷贝最多 max 字节并推进发送位置。
+ * @param sub 订阅
+ * @param dst 目标缓冲区
+ * @param max 最多拷贝的字节数
+ * @param lsnOut 输出参数，返回此刻主库已落盘的最大 LSN
+ * @return 拷贝的字节数；订阅已经落后到缓冲区之外时返回 -1。
+ */
+ssize_t repl_log_read(repl_sub_t *sub, char *dst, size_t max,
+                      uint64_t *lsnOut);
+
+/**
+ * @brief 记录副本确认已应用的 LSN。
+ * @param sub 订阅
+ * @param lsn 副本已应用的最大 LSN
+ */
+void repl_log_ack(repl_sub_t *sub, uint64_t lsn);
+
+/**
+ * @brief 汇总主库的复制状态，落后程度取最慢的副本。
+ * @param log 复制日志
+ * @param out 输出参数
+ */
+void repl_log_stats(repl_log_t *log, repl_stats_t *out);
+
+/**
+ * @brief 副本一侧的复制状态。
+ *        启动时 repl_replica_sync 从主库下载数据库镜像，之后由后台线程
+ *        阻塞地读取日志流，持有写锁把记录重做到映射的数据库与索引上，
+ *        再回复确认。副本不写自己的 WAL：重启时重新从主库同步。
+ *        连接断开或副本落后太多时停止复制，副本继续以只读方式提供旧数据，
+ *        需要重启副本以重新同步。
+ */
+typedef struct {
+    int fd;             ///< 到主库的连接，-1 表示没有
+    bool started;       ///< 复制线程是否已经启动
+    pthread_t thread;   ///< 复制线程
+    dbmap_t *map;       ///< 副本的映射数据库
+    dbindex_t *index;   ///< 副本的二级索引
+    pthread_rwlock_t *db_lock;  ///< 保护 map 与 index 的读写锁
+    bool stopping;              ///< 正在关闭（__atomic 读写），断开不算错误
+    pthread_mutex_t lock;       ///< 保护以下状态
+    bool connected;             ///< 复制是否仍在进行
+    uint64_t applied_lsn;       ///< 已应用的最大 LSN
+    uint64_t primary_lsn;       ///< 主库最近一次通告的已落盘 LSN
+    uint64_t behind_since;  ///< 开始落后的时刻（单调时钟毫秒），0 表示已追上
+} repl_replica_t;
+
+/**
+ * @brief 连接主库并订阅日志流，把收到的数据库镜像写成 db_path
+ *        （先写临时文件，落盘后原子地替换）。成功后 rep->fd 是到主库的
+ *        连接，日志流紧随其后。
+ * @param rep 副本状态，其余字段在这里初始化
+ * @param primary 主库地址，格式为 "<IPv4 地址>:<端口>"
+ * @param db_path 副本的数据库文件路径
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int repl_replica_sync(repl_replica_t *rep, const char *primary,
+                      const char *db_path);
+
+/**
+ * @brief 启动复制线程。线程屏蔽所有信号，不会打断事件循环的信号处理。
+ * @param rep 已经完成 repl_replica_sync 的副本状态
+ * @param map 由同步得到的文件打开的映射数据库
+ * @param index 覆盖 map 的二级索引
+ * @param db_lock 保护 map 与 index 的读写锁
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int repl_replica_start(repl_replica_t *rep, dbmap_t *map, dbindex_t *index,
+                       pthread_rwlock_t *db_lock);
+
+/**
+ * @brief 断开与主库的连接，等待复制线程退出并释放资源。可以重复调用。
+ * @param rep 副本状态
+ */
+void repl_replica_stop(repl_replica_t *rep);
+
+/**
+ * @brief 汇总副本的复制状态。
+ * @param rep 副本状态
+ * @param out 输出参数
+ */
+void repl_replica_stats(repl_replica_t *rep, repl_stats_t *out);
+
+/**
+ * @brief 用于 GCC cleanup 属性的内联函数：停止复制
+ * @param rep 指向副本状态
+ */
+static inline void _cleanup_repl_replica_(repl_replica_t *rep) {
+    repl_replica_stop(rep);
+}
+
+#endif
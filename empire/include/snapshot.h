@@ -0,0 +1,85 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <limits.h>     // For PATH_MAX
+#include <pthread.h>    // For pthread_mutex_t
+#include <stdint.h>     // For uint_t types
+#include <sys/types.h>  // For pid_t
+
+#include "dbmap.h"  // 包含映射的数据库 dbmap_t
+
+/**
+ * @brief 快照镜像文件名的后缀：<db>.snap
+ */
+#define SNAPSHOT_SUFFIX ".snap"
+
+/**
+ * @brief 快照校验和文件名的后缀：<db>.snap.sum
+ */
+#define SNAPSHOT_SUM_SUFFIX ".snap.sum"
+
+/**
+ * @brief 一次快照的描述：镜像对应的时刻与大小。
+ */
+typedef struct {
+    uint64_t lsn;    ///< 镜像包含的最大 LSN，之后的修改不在镜像中
+    uint64_t count;  ///< 镜像中的槽位数（含已删除的槽位）
+    uint64_t bytes;  ///< 解包后镜像的大小
+} snapshot_info_t;
+
+/**
+ * @brief 在线快照（热备份）的运行时状态。
+ *        快照由 fork 出的子进程写出：子进程继承 fork 时刻的槽位数与
+ *        记录堆末尾，而记录堆在 heap_end 之前的字节从不被原地修改，
+ *        压缩也只会原子地替换文件，所以子进程直接从映射中写出的就是
+ *        一致的时间点镜像，父进程的事件循环不必等待。
+ *        镜像先写入 <db>.snap.tmp，落盘后改名为 <db>.snap，最后写出
+ *        <db>.snap.sum；.sum 与镜像匹配时快照才算完整。
+ *        镜像是打包格式（见 dbpack.h）：逐块压缩、每块带 CRC32C，
+ *        .sum 记录的是解包后镜像的校验和与大小，用 dbserver -x 恢复。
+ *        同一时刻最多只有一个快照子进程。所有接口都是线程安全的。
+ */
+typedef struct {
+    char path[PATH_MAX];      ///< 镜像路径：<db>.snap
+    char tmp_path[PATH_MAX];  ///< 写入中的镜像路径：<db>.snap.tmp
+    char sum_path[PATH_MAX];  ///< 校验和路径：<db>.snap.sum
+    char sum_tmp_path[PATH_MAX];  ///< 写入中的校验和路径：<db>.snap.sum.tmp
+    pid_t pid;              ///< 快照子进程 PID，-1 表示没有
+    snapshot_info_t info;   ///< 正在进行（或最近一次）的快照
+    pthread_mutex_t lock;   ///< 保护以上状态
+} snapshot_t;
+
+/**
+ * @brief 初始化快照状态，不创建任何文件。
+ * @param snap 快照状态
+ * @param db_path 数据库文件路径
+ * @return 成功时返回 STATUS_SUCCESS，路径过长时返回 STATUS_ERROR。
+ */
+int snapshot_init(snapshot_t *snap, const char *db_path);
+
+/**
+ * @brief 启动一次快照。调用者必须持有数据上下文的读锁（或写锁），
+ *        并且已经提交了 WAL，使 lsn 之前的修改都已落盘、之后没有修改。
+ *        已有快照在进行时不启动新的快照，返回正在进行的快照。
+ * @param snap 快照状态
+ * @param map 映射的数据库，镜像对应它此刻的状态
+ * @param lsn 此刻已经落盘的最大 LSN
+ * @param infoOut 输出参数，返回启动的（或正在进行的）快照，可以为 NULL
+ * @return 成功时返回 STATUS_SUCCESS，fork 失败时返回 STATUS_ERROR。
+ */
+int snapshot_start(snapshot_t *snap, const dbmap_t *map, uint64_t lsn,
+                   snapshot_info_t *infoOut);
+
+/**
+ * @brief 非阻塞地回收已结束的快照子进程并报告结果。
+ * @param snap 快照状态
+ */
+void snapshot_poll(snapshot_t *snap);
+
+/**
+ * @brief 等待正在进行的快照结束并释放资源。
+ * @param snap 快照状态
+ */
+void snapshot_destroy(snapshot_t *snap);
+
+#endif
@@ -3,23 +3,118 @@
 
 #include <arpa/inet.h>   // 用于 inet_ntoa, inet_pton
 #include <netinet/in.h>  // 用于 sockaddr_in, htons, htonl
-#include <poll.h>        // 用于 poll, pollfd
+#include <pthread.h>     // 用于 pthread_rwlock_t
+#include <stdbool.h>     // 用于 bool
 #include <string.h>      // 用于 memset
 #include <sys/socket.h>  // 用于 socket, accept, send, recv
 #include <unistd.h>      // 用于 close, ssize_t
 
-#include "common.h"  // 包含通用宏和协议结构
-#include "parse.h"   // 包含数据库解析相关结构
+#include "common.h"    // 包含通用宏和协议结构
+#include "dbindex.h"   // 包含二级索引 dbindex_t
+#include "dbmap.h"     // 包含映射的数据库 dbmap_t
+#include "mempool.h"   // 包含对象池 slab_t 与请求内存池 arena_t
+#include "outq.h"      // 包含非阻塞输出队列 outq_t
+#include "parse.h"     // 包含数据库解析相关结构
+#include "repl.h"      // 包含主从复制 repl_log_t, repl_replica_t
+#include "snapshot.h"  // 包含在线快照 snapshot_t
+#include "stats.h"     // 包含服务器统计 stats_t
+#include "timer.h"     // 包含连接超时用的 timer_node_t
+#include "wal.h"       // 包含预写日志 wal_t
 
-/**
- * @brief 服务器支持的最大客户端连接数
- */
-#define MAX_CLIENTS 256
 /**
  * @brief 服务器监听的默认端口号
  */
 #define SERVER_PORT 3333
 
+/**
+ * @brief 输出队列高水位：待发送数据超过此值时暂停处理该客户端的请求
+ */
+#define CLIENT_OUTQ_HIGH_WATER (1024 * 1024)
+/**
+ * @brief 输出队列低水位：因高水位暂停的客户端，待发送数据降到此值以下才恢复
+ */
+#define CLIENT_OUTQ_LOW_WATER (256 * 1024)
+/**
+ * @brief 完整列表的记录数据至少有这么多字节时直接从数据库文件 sendfile，
+ *        更小的列表拷贝到输出队列反而更省系统调用
+ */
+#define CLIENT_SENDFILE_MIN (64 * 1024)
+/**
+ * @brief 连接内存中复用的索引查询结果数组超过这么多项时，用完即释放
+ */
+#define CLIENT_RESULT_KEEP 4096
+/**
+ * @brief hold_from 的取值，表示输出队列中没有等待 WAL 落盘的数据
+ */
+#define CLIENT_NO_HOLD UINT64_MAX
+/**
+ * @brief 默认超时（毫秒）：连接后必须在握手超时内完成 Hello；
+ *        一条消息开始接收后必须在请求超时内收完，待发送的响应
+ *        在请求超时内没有任何进展也会断开；其余时间没有活动超过
+ *        空闲超时的连接被关闭
+ */
+#define CLIENT_HANDSHAKE_TIMEOUT_MS 5000
+#define CLIENT_REQUEST_TIMEOUT_MS 30000
+#define CLIENT_IDLE_TIMEOUT_MS (300 * 1000)
+
+/**
+ * @brief 连接的超时设置（毫秒），0 表示不限
+ */
+typedef struct {
+    uint32_t handshake_ms;  ///< 连接到完成 Hello
+    uint32_t request_ms;    ///< 接收一条消息，或发送有进展的间隔
+    uint32_t idle_ms;       ///< 没有未完成的请求时的最长静默
+} client_timeouts_t;
+
+/**
+ * @brief 服务器的数据上下文：映射的数据库、二级索引与预写日志。
+ *        多个事件循环线程共享同一个上下文：LIST 和索引查询等只读请求持有
+ *        读锁并发执行，ADD/UPDATE/DEL 持有写锁，同一时刻只有一个写者修改
+ *        映射、更新索引并写入 WAL，因此日志顺序与映射中的修改顺序一致。
+ *        写锁同时保护压缩，压缩期间映射会切换到新文件。
+ *        主库把落盘的 WAL 记录追加到复制日志，推送给订阅的副本；
+ *        副本（replica 非 NULL）由复制线程持有写锁重做主库的记录，
+ *        拒绝所有修改请求。
+ */
+typedef struct {
+    dbmap_t *map;  ///< 映射的数据库，扩展时 map->base 可能改变地址
+    dbindex_t *index;       ///< name 与 hours 上的二级索引，与映射同步修改
+    wal_t *wal;             ///< 预写日志，所有修改在确认前先写入日志
+    pthread_rwlock_t lock;  ///< 保护 map 与 index 的读写锁
+    snapshot_t snapshot;    ///< 在线快照，由 MSG_SNAPSHOT_REQ 或 SIGUSR1 触发
+    repl_log_t repl;        ///< 复制日志，副本通过 MSG_REPL_SYNC_REQ 订阅
+    repl_replica_t *replica;  ///< 副本的复制状态，主库为 NULL
+    stats_t stats;  ///< 服务器统计，由 reactor_run 按事件循环数初始化
+    client_timeouts_t timeouts;  ///< 连接超时，dbctx_init 设为默认值
+} dbctx_t;
+
+/**
+ * @brief 初始化服务器数据上下文。读写锁偏向写者，
+ *        避免读多写少的负载下修改请求被持续的 LIST 饿死。
+ *        WAL 的提交回调设置为追加复制日志。
+ * @param db 要初始化的数据上下文
+ * @param map 映射的数据库
+ * @param wal 预写日志
+ * @param index 覆盖映射中全部记录的二级索引
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbctx_init(dbctx_t *db, dbmap_t *map, wal_t *wal, dbindex_t *index);
+
+/**
+ * @brief 销毁服务器数据上下文的锁与复制日志，不释放数据本身。
+ * @param db 数据上下文
+ */
+void dbctx_destroy(dbctx_t *db);
+
+/**
+ * @brief 启动一次在线快照：持有读锁提交 WAL，使此刻所有修改都已落盘，
+ *        然后 fork 子进程写出镜像。只在提交与 fork 期间阻塞写者。
+ * @param db 数据上下文
+ * @param infoOut 输出参数，返回启动的（或正在进行的）快照，可以为 NULL
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int dbctx_snapshot(dbctx_t *db, snapshot_info_t *infoOut);
+
 /**
  * @brief 客户端连接的有限状态机 (FSM) 状态
  */
@@ -34,55 +129,140 @@ typedef enum {
 } client_state_e;
 
 /**
- * @brief 存储每个客户端连接的状态信息
+ * @brief 服务器端的分页游标：一个尚未发送完的分页列表请求。
+ *        每次只生成一块，输出队列超过高水位时暂停，随背压一起恢复。
+ */
+typedef struct {
+    bool active;     ///< 是否有尚未发送完的分页列表
+    uint64_t next;   ///< 下一块从这个槽位开始扫描
+    uint64_t left;   ///< 还能发送的记录数，UINT64_MAX 表示不限
+    uint32_t chunk;  ///< 每块最多的记录数
+} list_cursor_t;
+
+/**
+ * @brief 一个事件循环的连接内存：连接状态、接收缓冲区和输出队列的小数据块
+ *        都从对象池分配并在关闭时归还；单条请求需要的临时内存（批量操作、
+ *        索引查询结果）来自请求内存池，每处理完一条消息就整体回收。
+ *        接收缓冲区只在连接有未处理的数据时才挂上，空闲连接只占用
+ *        clientstate_t 本身。只由所属的事件循环线程使用，不加锁。
  */
 typedef struct {
-    int fd;  ///< 客户端的套接字文件描述符，-1 表示空闲
+    slab_t clients;   ///< clientstate_t 的对象池
+    slab_t buffers;   ///< CLIENT_BUFFER_SIZE 字节接收缓冲区的对象池
+    slab_t chunks;    ///< 输出队列最小数据块的对象池
+    arena_t arena;    ///< 单条请求的临时内存
+    dbindex_result_t result;  ///< 索引查询结果，清空后复用其数组
+    stats_shard_t *stats;     ///< 所属事件循环的统计分片
+} client_pool_t;
+
+/**
+ * @brief 初始化连接内存。
+ * @param pool 连接内存
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int client_pool_init(client_pool_t *pool);
+
+/**
+ * @brief 释放连接内存，从中分配的连接必须已经全部释放。
+ * @param pool 连接内存
+ */
+void client_pool_destroy(client_pool_t *pool);
+
+/**
+ * @brief 存储每个客户端连接的状态信息。
+ *        每个连接从所属事件循环的 client_pool_t 分配，由事件循环通过链表
+ *        管理，连接数不再有固定上限。
+ */
+typedef struct clientstate {
+    int fd;  ///< 客户端的套接字文件描述符，-1 表示已关闭
     client_state_e state;             ///< 客户端的当前状态
-    char buffer[CLIENT_BUFFER_SIZE];  ///< 用于接收客户端数据的缓冲区
+    uint16_t proto;  ///< 协商的协议版本，Hello 之前为 PROTO_VER_V1
+    char *buffer;  ///< 接收缓冲区（CLIENT_BUFFER_SIZE 字节），空闲时为 NULL
     size_t buffer_pos;  ///< 当前缓冲区已接收数据的末尾位置
     size_t msg_expected_len;  ///< 当前正在接收的消息，其预期的总长度 (头部 +
                               ///< 消息体)
+    outq_t outq;  ///< 待发送的响应，套接字可写时用 writev 发送
+    uint64_t hold_from;  ///< 第一条等待 WAL 落盘的响应在 outq 中的绝对偏移，
+                         ///< 此后的数据暂不发送；CLIENT_NO_HOLD 表示没有
+    uint64_t wait_lsn;  ///< 被扣留的响应依赖的最大 LSN，落盘后才能发送
+    bool rx_pending;  ///< 缓冲区满时暂停读取，套接字中可能还有未读数据
+    bool tx_blocked;  ///< 输出队列超过高水位，请求处理已暂停
+    list_cursor_t cursor;  ///< 正在流式发送的分页列表，之后的请求排在其后
+    struct clientstate *prev;  ///< 事件循环中所有连接的双向链表
+    struct clientstate *next;
+    struct clientstate *pend_next;  ///< 等待 WAL 组提交的连接链表
+    bool in_pending;                ///< 是否已在等待组提交的链表中
+    client_pool_t *pool;  ///< 所属事件循环的连接内存
+    repl_sub_t *repl;  ///< 副本连接在复制日志中的订阅，普通连接为 NULL
+    struct clientstate *repl_prev;  ///< 事件循环中副本连接的双向链表
+    struct clientstate *repl_next;
+    bool in_replicas;  ///< 是否已在副本连接的链表中
+    timer_node_t timer;  ///< 事件循环时间轮中的超时定时器
+    uint64_t created_ms;  ///< 接受连接的时刻（单调时钟毫秒）
+    uint64_t active_ms;   ///< 最近一次套接字事件的时刻
+    uint64_t req_start_ms;  ///< 当前未收完的消息开始接收的时刻，0 表示没有
 } clientstate_t;
 
 /**
- * @brief 初始化所有客户端状态槽位
- * @param clientStates 客户端状态数组
- * @param max_clients 数组的最大大小
+ * @brief 为一个新接受的连接分配并初始化客户端状态。
+ * @param pool 所属事件循环的连接内存
+ * @param fd 客户端套接字（应已设置为非阻塞）
+ * @return 新的客户端状态，内存不足时返回 NULL。
  */
-void init_clients(clientstate_t *clientStates, int max_clients);
+clientstate_t *client_create(client_pool_t *pool, int fd);
 
 /**
- * @brief 查找一个空闲的客户端状态槽位
- * @param clientStates 客户端状态数组
- * @param max_clients 数组的最大大小
- * @return 空闲槽位的索引，或 STATUS_ERROR (-1) 如果没有空闲槽位。
+ * @brief 释放客户端状态。如果连接尚未关闭，会先关闭它。
+ * @param client 要释放的客户端状态
  */
-int find_free_slot(clientstate_t *clientStates, int max_clients);
+void client_destroy(clientstate_t *client);
 
 /**
- * @brief 根据文件描述符查找对应的客户端状态槽位
- * @param clientStates 客户端状态数组
- * @param max_clients 数组的最大大小
- * @param fd 要查找的文件描述符
- * @return 槽位的索引，或 STATUS_ERROR (-1) 如果未找到。
+ * @brief 处理单个客户端连接的有限状态机逻辑（可读事件）。
+ *        在边沿触发模式下持续读取套接字直到 EAGAIN，并处理所有完整的消息。
+ *        响应进入输出队列；修改类请求的响应及其后的响应会被扣留，
+ *        直到对应的 WAL 记录落盘。
+ * @param db 服务器数据上下文，FSM 可能会修改它（例如添加/删除员工）
+ * @param client 指向当前要处理的客户端状态
  */
-int find_slot_by_fd(clientstate_t *clientStates, int max_clients, const int fd);
+void handle_client_fsm(dbctx_t *db, clientstate_t *client);
 
 /**
- * @brief 处理单个客户端连接的有限状态机逻辑。
- *        根据客户端的当前状态和接收到的消息进行处理和响应。
- * @param dbhdr 指向数据库头部，用于操作数据
- * @param employees 指向员工数组的指针，FSM 可能会修改它（例如添加/删除员工）
+ * @brief 处理可写事件：发送输出队列中的数据，
+ *        队列降到低水位以下时恢复因背压而暂停的请求处理。
+ * @param db 服务器数据上下文
  * @param client 指向当前要处理的客户端状态
  */
-void handle_client_fsm(struct dbheader_t *dbhdr, struct employee_t **employees,
-                       clientstate_t *client);
+void handle_client_writable(dbctx_t *db, clientstate_t *client);
+
+/**
+ * @brief WAL 组提交之后放行被扣留的响应并尝试立即发送；
+ *        若发送后队列降到低水位以下，继续处理因背压暂停的请求
+ *        （这可能产生新的被扣留响应）。
+ * @param db 服务器数据上下文
+ * @param client 指向客户端状态，其 wait_lsn 必须已经落盘
+ */
+void resume_client_fsm(dbctx_t *db, clientstate_t *client);
+
+/**
+ * @brief 把复制日志中尚未发送的记录推送给副本连接，每条 MSG_REPL_WAL
+ *        最多携带 REPL_CHUNK 字节。输出队列达到高水位时停止，等可写事件
+ *        再继续；副本落后到积压缓冲区之外时回复 MSG_ERROR 并断开。
+ * @param client 指向副本连接的客户端状态
+ */
+void feed_replica_client(clientstate_t *client);
+
+/**
+ * @brief 连接超时：尽力回复 MSG_ERROR 后关闭连接。
+ * @param client 指向超时的客户端状态
+ * @param reason 超时原因，写入日志
+ */
+void expire_client(clientstate_t *client, const char *reason);
 
 /**
  * @brief 封装关闭客户端连接的逻辑。
+ *        只关闭套接字并重置状态，内存由事件循环在处理完事件后释放。
  * @param client 指向要关闭的客户端状态
- * @param nfds_ptr 指向 poll 描述符数量的指针（在 poll_loop 内部使用）
  */
 void close_client_connection(clientstate_t *client);
 
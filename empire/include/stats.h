@@ -0,0 +1,130 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <pthread.h>  // For pthread_mutex_t
+#include <stdint.h>   // For uint_t types
+
+#include "common.h"     // 包含消息类型 MSG_MAX
+#include "histogram.h"  // 包含延迟直方图 hist_t
+
+/**
+ * @brief 一个事件循环的统计分片，只由所属的事件循环线程写入。
+ *        计数器用 stats_add 原子地累加，查询时不必停下事件循环；
+ *        直方图较大，由 lock 保护，事件循环每处理一条消息加锁一次，
+ *        锁几乎总是无竞争的。
+ */
+typedef struct {
+    pthread_mutex_t lock;    ///< 保护以下直方图
+    hist_t ops[MSG_MAX];     ///< 每种请求的处理时间（纳秒）
+    hist_t loop;             ///< 每轮事件循环的处理时间（纳秒，不含等待）
+    uint64_t conns_accepted;  ///< 接受的连接数
+    uint64_t conns_closed;    ///< 关闭并释放的连接数
+    uint64_t bytes_in;        ///< 从套接字读取的字节数
+    uint64_t bytes_out;       ///< 写到套接字的字节数
+    uint64_t errors;          ///< 回复 MSG_ERROR 的次数
+    uint64_t events;          ///< 处理的就绪事件数
+    uint64_t events_max;      ///< 一轮中最多的就绪事件数
+    uint64_t commits;         ///< 有连接等待时做的组提交次数
+    uint64_t commit_waiters;  ///< 组提交累计放行的连接数
+    uint64_t commit_waiters_max;  ///< 一次组提交最多放行的连接数
+} stats_shard_t;
+
+/**
+ * @brief 服务器统计：每个事件循环一个分片，查询时汇总。
+ */
+typedef struct {
+    stats_shard_t *shards;  ///< 分片数组
+    int nshards;            ///< 分片数（事件循环线程数）
+    uint64_t start_ns;      ///< 开始统计的时刻（单调时钟纳秒）
+} stats_t;
+
+/**
+ * @brief 汇总后的统计（主机字节序），字段含义见 dbproto_stats_resp_t
+ */
+typedef struct {
+    uint64_t uptime_ms;
+    uint64_t conns_open;
+    uint64_t conns_accepted;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t errors;
+    uint64_t events;
+    uint64_t events_max;
+    uint64_t commits;
+    uint64_t commit_waiters;
+    uint64_t commit_waiters_max;
+    hist_t loop;  ///< 合并后的每轮处理时间
+} stats_totals_t;
+
+/**
+ * @brief 分配并清零 nshards 个分片。
+ * @param stats 服务器统计
+ * @param nshards 分片数
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+int stats_init(stats_t *stats, int nshards);
+
+/**
+ * @brief 释放所有分片。
+ * @param stats 服务器统计
+ */
+void stats_destroy(stats_t *stats);
+
+/**
+ * @brief 获取单调时钟的纳秒数，用于计时。
+ * @return 当前时刻。
+ */
+uint64_t stats_now_ns(void);
+
+/**
+ * @brief 原子地累加一个计数器（relaxed 内存序）。
+ * @param counter 计数器
+ * @param value 增量
+ */
+static inline void stats_add(uint64_t *counter, uint64_t value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 把计数器提升到 value（只由分片的所属线程调用）。
+ * @param counter 计数器
+ * @param value 新的候选最大值
+ */
+static inline void stats_max(uint64_t *counter, uint64_t value) {
+    if (value > __atomic_load_n(counter, __ATOMIC_RELAXED)) {
+        __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 记录一次请求的处理时间。
+ * @param shard 当前事件循环的分片
+ * @param type 请求的消息类型，必须小于 MSG_MAX
+ * @param ns 处理时间（纳秒）
+ */
+void stats_record_op(stats_shard_t *shard, uint32_t type, uint64_t ns);
+
+/**
+ * @brief 记录一轮事件循环。
+ * @param shard 当前事件循环的分片
+ * @param events 本轮的就绪事件数
+ * @param ns 本轮的处理时间（纳秒）
+ */
+void stats_record_loop(stats_shard_t *shard, uint64_t events, uint64_t ns);
+
+/**
+ * @brief 汇总所有分片的计数器与每轮处理时间。
+ * @param stats 服务器统计
+ * @param out 输出参数
+ */
+void stats_totals(stats_t *stats, stats_totals_t *out);
+
+/**
+ * @brief 合并所有分片中一种请求的处理时间。
+ * @param stats 服务器统计
+ * @param type 请求的消息类型，必须小于 MSG_MAX
+ * @param out 输出参数，合并后的直方图
+ */
+void stats_merge_op(stats_t *stats, uint32_t type, hist_t *out);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdbool.h>  // For bool
+#include <stddef.h>   // For size_t, NULL
+#include <stdint.h>   // For uint_t types
+
+/**
+ * @brief 时间轮的层数
+ */
+#define TIMER_LEVELS 4
+/**
+ * @brief 每层的槽位数（一个 64 位位图），必须是 2 的幂
+ */
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+/**
+ * @brief 时间轮能直接表示的最远到期时间（毫秒），约 4.6 小时。
+ *        更远的定时器先放在最高层的最远槽位，到时再按真实到期时间重新放入。
+ */
+#define TIMER_RANGE ((uint64_t)1 << (TIMER_LEVELS * TIMER_SLOT_BITS))
+
+/**
+ * @brief 定时器节点，嵌入到拥有它的对象中（例如 clientstate_t），
+ *        不单独分配内存。
+ */
+typedef struct timer_node {
+    struct timer_node *next;    ///< 同一槽位中的下一个节点
+    struct timer_node **pprev;  ///< 指向前一个节点的 next，NULL 表示未加入
+    uint64_t expires;           ///< 到期时刻（单调时钟毫秒）
+    uint8_t level;              ///< 所在的层
+    uint8_t slot;               ///< 所在的槽位
+} timer_node_t;
+
+/**
+ * @brief 分层时间轮，每毫秒一格。第 L 层的每个槽位覆盖 64^L 毫秒，
+ *        加入与删除都是 O(1)；高层槽位在低层转完一圈时整体下放到低层，
+ *        每个定时器至多下放 TIMER_LEVELS - 1 次，因此到期处理是均摊 O(1)。
+ *        每层用位图记录非空槽位，查找下一个到期时刻不必逐格扫描。
+ *        不加锁，只能由一个线程使用。
+ */
+typedef struct {
+    uint64_t now;  ///< 已处理到的时刻（单调时钟毫秒）
+    uint64_t occupied[TIMER_LEVELS];  ///< 每层非空槽位的位图
+    timer_node_t *slots[TIMER_LEVELS][TIMER_SLOTS];  ///< 每个槽位的节点链表
+    size_t count;  ///< 已加入的定时器数
+} timer_wheel_t;
+
+/**
+ * @brief 到期回调。调用前节点已从时间轮中移除，回调可以重新加入它，
+ *        也可以释放拥有它的对象。
+ * @param node 到期的定时器
+ * @param arg timer_wheel_advance 的 arg
+ */
+typedef void (*timer_fn_t)(timer_node_t *node, void *arg);
+
+/**
+ * @brief 获取单调时钟的毫秒数，时间轮使用的时间单位。
+ * @return 当前时刻。
+ */
+uint64_t timer_now_ms(void);
+
+/**
+ * @brief 初始化空的时间轮。
+ * @param tw 时间轮
+ * @param now 当前时刻（毫秒）
+ */
+void timer_wheel_init(timer_wheel_t *tw, uint64_t now);
+
+/**
+ * @brief 初始化定时器节点（未加入任何时间轮）。
+ * @param node 定时器
+ */
+static inline void timer_node_init(timer_node_t *node) {
+    node->next = NULL;
+    node->pprev = NULL;
+    node->expires = 0;
+}
+
+/**
+ * @brief 判断定时器是否已加入时间轮。
+ * @param node 定时器
+ * @return 已加入时返回 true。
+ */
+static inline bool timer_pending(const timer_node_t *node) {
+    return node->pprev != NULL;
+}
+
+/**
+ * @brief 加入或改期一个定时器。已经过去的时刻在下一次推进时到期。
+ * @param tw 时间轮
+ * @param node 定时器，可以已经在时间轮中
+ * @param expires 到期时刻（毫秒）
+ */
+void timer_wheel_add(timer_wheel_t *tw, timer_node_t *node, uint64_t expires);
+
+/**
+ * @brief 移除一个定时器，未加入时什么也不做。
+ * @param tw 时间轮
+ * @param node 定时器
+ */
+void timer_wheel_del(timer_wheel_t *tw, timer_node_t *node);
+
+/**
+ * @brief 下一次需要推进时间轮的时刻：最早的到期槽位，或者更早的、
+ *        需要把高层槽位下放的时刻。
+ * @param tw 时间轮
+ * @return 时刻（毫秒），没有定时器时返回 UINT64_MAX。
+ */
+uint64_t timer_wheel_next(const timer_wheel_t *tw);
+
+/**
+ * @brief 把时间轮推进到 now，对每个到期的定时器调用 fn。
+ *        中间没有任何槽位需要处理的时间段被直接跳过。
+ * @param tw 时间轮
+ * @param now 当前时刻（毫秒）
+ * @param fn 到期回调
+ * @param arg 传给回调的参数
+ */
+void timer_wheel_advance(timer_wheel_t *tw, uint64_t now, timer_fn_t fn,
+                         void *arg);
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <limits.h>     // For PATH_MAX
+#include <pthread.h>    // For pthread_mutex_t
+#include <stdbool.h>    // For bool
+#include <stdint.h>     // For uint_t types
+#include <stdlib.h>     // For free
+#include <sys/types.h>  // For pid_t, size_t
+
+#include "dbindex.h"  // 包含二级索引 dbindex_t
+#include "dbmap.h"    // 包含映射的数据库 dbmap_t
+#include "parse.h"  // 包含 dbheader_t, employee_t 结构体
+
+/**
+ * @brief WAL 段文件头部的魔数，用于标识日志文件。
+ */
+#define WAL_MAGIC 0x57414C47  // "WALG" in ASCII
+
+/**
+ * @brief WAL 文件格式版本号
+ */
+#define WAL_VERSION 2
+
+/**
+ * @brief 旧版（逻辑记录）WAL 格式版本号，只在升级旧版数据库文件时重放
+ */
+#define WAL_VERSION_LEGACY 1
+
+/**
+ * @brief 单条 WAL 记录负载的最大长度，用于在重放时识别损坏的长度字段
+ */
+#define WAL_MAX_PAYLOAD (64 * 1024)
+
+/**
+ * @brief 当前日志段超过此大小时触发后台检查点
+ */
+#define WAL_CHECKPOINT_BYTES (4 * 1024 * 1024)
+
+/**
+ * @brief WAL 记录类型
+ */
+typedef enum {
+    WAL_REC_ADD = 1,   ///< 写入一个槽位，负载为 struct wal_add_t
+    WAL_REC_DEL = 2,   ///< 截断记录数，负载为 struct wal_del_t
+    WAL_REC_CKPT = 3,  ///< 旧版检查点完成标记，负载为快照文件的 CRC32C
+    WAL_REC_FREE = 4,  ///< 把一个槽位标记为墓碑，负载为 struct wal_free_t
+    WAL_REC_BATCH = 5,  ///< 原子的一批 ADD/FREE，负载为若干子记录
+} wal_rec_type_e;
+
+/**
+ * @brief ADD 记录的负载：把员工写入 slot 槽位（新增、复用墓碑或更新已有记录），
+ *        记录数不足 slot + 1 时增加到 slot + 1。
+ *        记录的是物理位置，重复重放结果不变。所有字段使用网络字节序。
+ *        （旧版格式中 ADD 的负载只有 struct employee_t，DEL 没有负载。）
+ */
+struct wal_add_t {
+    uint32_t slot;               ///< 槽位下标
+    struct employee_t employee;  ///< 员工记录
+} __attribute__((__packed__));
+
+/**
+ * @brief DEL 记录的负载：删除后的记录数，使用网络字节序。
+ */
+struct wal_del_t {
+    uint32_t count;  ///< 删除后的记录数
+} __attribute__((__packed__));
+
+/**
+ * @brief FREE 记录的负载：把 slot 标记为墓碑，并把记录数设为 count
+ *        （删除末尾的记录时会连同之前的墓碑一起截掉）。使用网络字节序。
+ */
+struct wal_free_t {
+    uint32_t slot;   ///< 被删除的槽位
+    uint32_t count;  ///< 删除后的记录数
+} __attribute__((__packed__));
+
+/**
+ * @brief BATCH 记录中每个子记录的头部，后跟 len 字节的 ADD 或 FREE 负载。
+ *        整批共用外层记录的校验和，撕裂时整批被丢弃。使用网络字节序。
+ */
+struct wal_sub_hdr_t {
+    uint16_t type;  ///< 子记录类型，WAL_REC_ADD 或 WAL_REC_FREE
+    uint16_t len;   ///< 子记录负载长度
+} __attribute__((__packed__));
+
+/**
+ * @brief BATCH 记录中 ADD 与 FREE 子记录编码后的长度
+ */
+#define WAL_BATCH_ADD_SIZE \
+    (sizeof(struct wal_sub_hdr_t) + sizeof(struct wal_add_t))
+#define WAL_BATCH_FREE_SIZE \
+    (sizeof(struct wal_sub_hdr_t) + sizeof(struct wal_free_t))
+
+/**
+ * @brief WAL 段文件头部，位于每个日志段的开头。
+ *        所有字段在文件读写时需要进行字节序转换。
+ */
+struct wal_file_hdr_t {
+    uint32_t magic;     ///< 魔数，标识 WAL 文件
+    uint16_t version;   ///< WAL 格式版本
+    uint16_t reserved;  ///< 保留，写 0
+    uint64_t base_lsn;  ///< 本段第一条记录的 LSN
+} __attribute__((__packed__));
+
+/**
+ * @brief WAL 记录头部，后跟 len 字节负载。
+ *        crc 覆盖 crc 字段之后的头部字段以及全部负载，用于识别撕裂写入。
+ */
+struct wal_rec_hdr_t {
+    uint32_t crc;       ///< CRC32C 校验和
+    uint32_t len;       ///< 负载长度，单位字节
+    uint64_t lsn;       ///< 日志序列号，单调递增
+    uint16_t type;      ///< 记录类型，见 wal_rec_type_e
+    uint16_t reserved;  ///< 保留，写 0
+} __attribute__((__packed__));
+
+/**
+ * @brief 组提交落盘之后的回调，收到这次写入日志段的全部记录。
+ *        调用时持有 commit_lock，回调之间按 LSN 顺序串行执行，不能再调用
+ *        wal_commit。
+ * @param arg wal_set_commit_hook 传入的参数
+ * @param data 编码后的记录（头部 + 负载），与日志段中的字节相同
+ * @param len 记录的总字节数
+ * @param last_lsn 最后一条记录的 LSN
+ */
+typedef void (*wal_commit_fn)(void *arg, const char *data, size_t len,
+                              uint64_t last_lsn);
+
+/**
+ * @brief 预写日志 (WAL) 的运行时状态。
+ *        记录先追加到内存中的组提交缓冲区，wal_commit 时一次 write 加一次
+ *        fdatasync 落盘。检查点时当前段被改名为 <db>.wal.old，由子进程把
+ *        映射的数据页刷盘并更新磁盘头部的记录数与记录堆末尾，然后删除 .old。
+ *        记录是按槽位的、幂等的，数据页可以在任意时刻被内核写回（模糊
+ *        检查点）：数据库文件的记录堆只追加，磁盘头部之外的字节在恢复时
+ *        被忽略，重放只需从最老的日志段开始依次重做，修改不必等待日志落盘。
+ *        除 wal_open/wal_checkpoint_sync/wal_close 外，所有接口都是线程安全的：
+ *        lock 保护内存状态，commit_lock 保证同一时刻只有一个线程在写盘，
+ *        写盘期间其他线程仍可继续追加记录，它们会由下一次提交一并落盘。
+ */
+typedef struct {
+    int fd;                     ///< 当前日志段的文件描述符
+    char path[PATH_MAX];        ///< 当前日志段路径：<db>.wal
+    char old_path[PATH_MAX];    ///< 检查点中的日志段路径：<db>.wal.old
+    dbmap_t *map;               ///< 日志所保护的映射数据库
+    uint64_t next_lsn;          ///< 下一条记录将使用的 LSN
+    uint64_t synced_lsn;        ///< 已经 fdatasync 落盘的最大 LSN
+    char *buf;                  ///< 组提交缓冲区，存放尚未写入的记录
+    size_t buf_len;             ///< 缓冲区中已使用的字节数
+    size_t buf_cap;             ///< 缓冲区容量
+    char *flush_buf;            ///< 正在写盘的缓冲区，提交时与 buf 交换
+    size_t flush_cap;           ///< flush_buf 的容量
+    size_t seg_bytes;           ///< 当前日志段在磁盘上的大小
+    pid_t ckpt_pid;             ///< 后台检查点子进程 PID，-1 表示没有
+    bool ckpt_disabled;         ///< 后台检查点失败后停止重试，直到下次同步检查点
+    wal_commit_fn on_commit;    ///< 每次组提交落盘之后的回调，可以为 NULL
+    void *on_commit_arg;        ///< on_commit 的参数
+    pthread_mutex_t lock;         ///< 保护以上内存状态
+    pthread_mutex_t commit_lock;  ///< 串行化写盘与日志段轮换
+} wal_t;
+
+/**
+ * @brief 打开数据库对应的 WAL，并把日志重放到映射的数据库上。
+ *        如有记录被重放，会立即执行一次同步检查点，把日志合并回数据库文件。
+ *        旧版格式的日志段是升级留下的（内容已合并进数据库文件），直接丢弃。
+ * @param db_path 数据库文件路径，日志文件为 <db_path>.wal
+ * @param newdb 是否为新建数据库；为 true 时丢弃残留的旧日志
+ * @param map 映射的数据库，重放时会修改它
+ * @param walOut 输出参数，返回打开的 WAL
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_open(const char *db_path, bool newdb, dbmap_t *map, wal_t **walOut);
+
+/**
+ * @brief 把旧版数据库文件的旧版 WAL 重放到内存中的员工数组上，
+ *        供 dbmap_open 在升级文件格式之前调用。不修改任何文件。
+ * @param db_path 旧版数据库文件路径
+ * @param dbhdr 指向数据库头部（重放时会修改 count）
+ * @param employees 指向员工数组指针（重放时可能改变内存地址）
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_replay_legacy(const char *db_path, struct dbheader_t *dbhdr,
+                      struct employee_t **employees);
+
+/**
+ * @brief 把一段连续的编码记录（例如从主库收到的日志流）重做到映射的
+ *        数据库上，并同步维护二级索引。末尾不完整的记录不处理，由调用者
+ *        保留到收到后续字节之后再次调用。调用者必须持有数据库的写锁。
+ * @param map 映射的数据库
+ * @param index 二级索引，可以为 NULL
+ * @param data 编码后的记录（头部 + 负载）
+ * @param len data 的字节数
+ * @param usedOut 输出参数，返回已经重做的完整记录的总字节数
+ * @param lsnOut 输出参数，有记录被重做时返回最后一条的 LSN，否则不变
+ * @return 成功时返回 STATUS_SUCCESS；记录损坏或重做失败时返回
+ * STATUS_ERROR，此时 usedOut 之前的记录已经生效。
+ */
+int wal_apply_stream(dbmap_t *map, dbindex_t *index, const char *data,
+                     size_t len, size_t *usedOut, uint64_t *lsnOut);
+
+/**
+ * @brief 设置组提交落盘之后的回调（见 wal_commit_fn）。
+ *        必须在其他线程开始使用 WAL 之前设置或清除。
+ * @param wal WAL 状态
+ * @param fn 回调，NULL 表示清除
+ * @param arg 回调的参数
+ */
+void wal_set_commit_hook(wal_t *wal, wal_commit_fn fn, void *arg);
+
+/**
+ * @brief 记录一次写入槽位的操作（仅写入组提交缓冲区，尚未落盘）。
+ * @param wal WAL 状态
+ * @param slot 写入的槽位
+ * @param employee 员工记录（hours 为主机字节序）
+ * @param lsnOut 输出参数，返回该记录的 LSN
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_log_add(wal_t *wal, uint32_t slot, const struct employee_t *employee,
+                uint64_t *lsnOut);
+
+/**
+ * @brief 记录一次截断记录数的操作（仅写入组提交缓冲区，尚未落盘）。
+ * @param wal WAL 状态
+ * @param count 删除后的记录数
+ * @param lsnOut 输出参数，返回该记录的 LSN
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_log_del(wal_t *wal, uint32_t count, uint64_t *lsnOut);
+
+/**
+ * @brief 记录一次删除槽位的操作（仅写入组提交缓冲区，尚未落盘）。
+ * @param wal WAL 状态
+ * @param slot 被删除的槽位
+ * @param count 删除后的记录数
+ * @param lsnOut 输出参数，返回该记录的 LSN
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_log_free(wal_t *wal, uint32_t slot, uint32_t count, uint64_t *lsnOut);
+
+/**
+ * @brief 把一个 ADD 子记录编码到 BATCH 负载中。
+ * @param dst 目标缓冲区，至少 WAL_BATCH_ADD_SIZE 字节
+ * @param slot 写入的槽位
+ * @param employee 员工记录（hours 为主机字节序）
+ * @return 编码后的字节数。
+ */
+size_t wal_batch_add(char *dst, uint32_t slot,
+                     const struct employee_t *employee);
+
+/**
+ * @brief 把一个 FREE 子记录编码到 BATCH 负载中。
+ * @param dst 目标缓冲区，至少 WAL_BATCH_FREE_SIZE 字节
+ * @param slot 被删除的槽位
+ * @param count 删除后的记录数
+ * @return 编码后的字节数。
+ */
+size_t wal_batch_free(char *dst, uint32_t slot, uint32_t count);
+
+/**
+ * @brief 把一批子记录作为一条 BATCH 记录写入组提交缓冲区（尚未落盘）。
+ * @param wal WAL 状态
+ * @param payload 由 wal_batch_add / wal_batch_free 编码的子记录
+ * @param len 负载长度，不超过 WAL_MAX_PAYLOAD
+ * @param lsnOut 输出参数，返回该记录的 LSN
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_log_batch(wal_t *wal, const char *payload, uint32_t len,
+                  uint64_t *lsnOut);
+
+/**
+ * @brief 判断组提交缓冲区中是否有尚未落盘的记录。
+ * @param wal WAL 状态
+ * @return 有未提交记录时返回 true。
+ */
+bool wal_has_pending(wal_t *wal);
+
+/**
+ * @brief 组提交：把缓冲区中的所有记录一次写入日志段并 fdatasync。
+ *        成功后 synced_lsn 推进到最后一条记录。若另一个线程正在提交，
+ *        会先等它完成，返回时调用前追加的所有记录都已落盘。
+ * @param wal WAL 状态
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_commit(wal_t *wal);
+
+/**
+ * @brief 获取已经落盘的最大 LSN。
+ * @param wal WAL 状态
+ * @return 已落盘的最大 LSN。
+ */
+uint64_t wal_synced_lsn(wal_t *wal);
+
+/**
+ * @brief 判断当前日志段是否已经大到需要做后台检查点。
+ * @param wal WAL 状态
+ * @return 需要检查点时返回 true。
+ */
+bool wal_should_checkpoint(wal_t *wal);
+
+/**
+ * @brief 启动后台检查点：先提交缓冲区中的记录，再轮换日志段并 fork
+ *        子进程刷盘。调用者必须保证期间映射的数据库不被修改。
+ * @param wal WAL 状态
+ * @return 成功启动（或已有检查点在进行）时返回 STATUS_SUCCESS，错误时返回
+ * STATUS_ERROR。
+ */
+int wal_checkpoint_start(wal_t *wal);
+
+/**
+ * @brief 判断是否有后台检查点子进程在运行。
+ * @param wal WAL 状态
+ * @return 有检查点在进行时返回 true。
+ */
+bool wal_checkpoint_running(wal_t *wal);
+
+/**
+ * @brief 非阻塞地回收后台检查点子进程并报告结果，应在事件循环中周期调用。
+ * @param wal WAL 状态
+ */
+void wal_checkpoint_poll(wal_t *wal);
+
+/**
+ * @brief 同步检查点：等待后台检查点结束，把映射的数据库刷盘并写入当前
+ *        记录数，然后清空所有日志段。用于启动恢复之后和关闭服务器时，
+ *        调用时不能有其他线程在使用 WAL。
+ * @param wal WAL 状态
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_checkpoint_sync(wal_t *wal);
+
+/**
+ * @brief 关闭 WAL 并释放资源。不会提交缓冲区中的记录。
+ * @param wal WAL 状态，可以为 NULL
+ */
+void wal_close(wal_t *wal);
+
+/**
+ * @brief 用于 GCC cleanup 属性的内联函数：关闭 WAL
+ * @param p_wal 指向 wal_t 指针的指针
+ */
+static inline void _cleanup_wal_(wal_t **p_wal) {
+    if (*p_wal != NULL) {
+        wal_close(*p_wal);
+        *p_wal = NULL;
+    }
+}
+
+#endif
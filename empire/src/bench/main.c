@@ -0,0 +1,742 @@
+#include <arpa/inet.h>    // For inet_pton, htonl
+#include <endian.h>       // For htobe64, be64toh
+#include <errno.h>        // For errno, EAGAIN, EINTR
+#include <fcntl.h>        // For fcntl, O_NONBLOCK
+#include <getopt.h>       // For getopt
+#include <netinet/in.h>   // For struct sockaddr_in
+#include <netinet/tcp.h>  // For TCP_NODELAY
+#include <pthread.h>      // For pthread_create, pthread_join
+#include <stdbool.h>      // For bool
+#include <stdio.h>        // For printf, fprintf, snprintf
+#include <stdlib.h>       // For calloc, free, strtod, rand_r
+#include <string.h>       // For memset, memcpy, strtok_r
+#include <sys/epoll.h>    // For epoll_*
+#include <sys/socket.h>   // For socket, connect, send, recv
+#include <time.h>         // For clock_gettime
+#include <unistd.h>       // For close
+
+#include "../../include/common.h"     // 包含协议结构和网络读写函数
+#include "../../include/histogram.h"  // 包含延迟直方图
+
+/**
+ * @brief 每个连接最多同时在途的请求数（流水线深度的上限）
+ */
+#define BENCH_MAX_DEPTH 64
+
+/**
+ * @brief 每个连接的接收缓冲区大小
+ */
+#define BENCH_IN_BUF (64 * 1024)
+
+/**
+ * @brief 每个连接的发送缓冲区大小：能放下 BENCH_MAX_DEPTH 个最大的请求
+ */
+#define BENCH_OUT_BUF \
+    (BENCH_MAX_DEPTH *  \
+     (sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_add_req_t)))
+
+/**
+ * @brief 测试时间结束后等待在途请求完成的最长时间（纳秒）
+ */
+#define BENCH_DRAIN_NS (2 * 1000000000ull)
+
+/**
+ * @brief 一次 epoll_wait 最多返回的事件数
+ */
+#define BENCH_MAX_EVENTS 64
+
+/**
+ * @brief 压测使用的操作类型
+ */
+typedef enum {
+    OP_HELLO,  ///< 断开后重新连接并握手
+    OP_ADD,    ///< 添加员工
+    OP_LIST,   ///< 分页列出前 list_limit 条员工
+    OP_DEL,    ///< 按名字删除本连接之前添加的员工
+    OP_COUNT   ///< 操作类型数
+} bench_op_e;
+
+/**
+ * @brief 操作名，用于 -m 参数与报告
+ */
+static const char *op_names[OP_COUNT] = {"hello", "add", "list", "del"};
+
+/**
+ * @brief 压测配置
+ */
+typedef struct {
+    struct sockaddr_in addr;  ///< 服务器地址
+    int conns;                ///< 连接总数
+    int threads;              ///< 线程数，连接平均分给各线程
+    double duration;          ///< 测试时间（秒）
+    unsigned mix[OP_COUNT];   ///< 各操作的权重
+    unsigned mix_total;       ///< 权重之和
+    double rate;              ///< 开环模式的总请求速率（每秒），0 表示闭环
+    int depth;                ///< 闭环模式下每个连接在途的请求数
+    uint64_t list_limit;      ///< LIST 返回的最大记录数
+} bench_cfg_t;
+
+/**
+ * @brief 一个在途请求
+ */
+typedef struct {
+    bench_op_e op;      ///< 操作类型
+    uint64_t start_ns;  ///< 开始时间：闭环为发送时间，开环为计划发送时间
+} inflight_t;
+
+/**
+ * @brief 一个压测连接的状态
+ */
+typedef struct {
+    int fd;                                ///< 套接字，-1 表示未连接
+    uint32_t id;                           ///< 连接编号，用于生成名字
+    uint64_t add_seq;                      ///< 已发送的 ADD 数
+    uint64_t del_seq;                      ///< 已发送的 DEL 数
+    inflight_t ring[BENCH_MAX_DEPTH];      ///< 在途请求，按发送顺序
+    unsigned head;                         ///< 最早的在途请求
+    unsigned count;                        ///< 在途请求数
+    bool reconnect;                        ///< HELLO 等待在途请求完成
+    uint64_t hello_ns;                     ///< HELLO 的开始时间
+    char out[BENCH_OUT_BUF];               ///< 待发送的请求
+    size_t out_len;                        ///< 发送缓冲区中的字节数
+    size_t out_off;                        ///< 已发送到的位置
+    bool want_out;                         ///< 是否在等待可写事件
+    char in[BENCH_IN_BUF];                 ///< 收到的响应
+    size_t in_len;                         ///< 接收缓冲区中的字节数
+    uint64_t skip;                         ///< 列表块中尚未跳过的记录字节数
+    bool list_last;                        ///< 正在跳过的是最后一块
+    uint64_t next_ns;                      ///< 开环模式下次计划发送的时间
+} bench_conn_t;
+
+/**
+ * @brief 一个压测线程：用 epoll 驱动自己的一组连接，统计只在本线程内更新
+ */
+typedef struct {
+    const bench_cfg_t *cfg;     ///< 压测配置
+    bench_conn_t *conns;        ///< 本线程的连接
+    int nconns;                 ///< 连接数
+    int epfd;                   ///< epoll 实例
+    unsigned seed;              ///< 选择操作的随机数种子
+    uint64_t interval_ns;       ///< 开环模式下每个连接的请求间隔
+    hist_t hist[OP_COUNT];      ///< 每种操作的延迟直方图（纳秒）
+    uint64_t errors[OP_COUNT];  ///< 每种操作的失败数
+    uint64_t elapsed_ns;        ///< 从开始到最后一个请求完成的时间
+    int status;                 ///< 线程结果：STATUS_SUCCESS 或 STATUS_ERROR
+    pthread_t tid;              ///< 线程 ID
+} bench_thread_t;
+
+/**
+ * @brief 单调时钟的当前时间（纳秒）。
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief 建立连接并完成 Hello 握手（阻塞），然后把套接字设为非阻塞。
+ * @param t 压测线程。
+ * @param c 连接，成功后 c->fd 为新的套接字并已加入 epoll。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int conn_open(bench_thread_t *t, bench_conn_t *c) {
+    int fd __attribute__((cleanup(_cleanup_fd_))) =
+        socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        perror("socket");
+        return STATUS_ERROR;
+    }
+    if (connect(fd, (const struct sockaddr *)&t->cfg->addr,
+                sizeof(t->cfg->addr)) == -1) {
+        perror("connect");
+        return STATUS_ERROR;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // Hello 请求与响应总是使用 V1 头部
+    char buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_hello_resp)];
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_hello_req *hello_req =
+        (dbproto_hello_req *)(buf + sizeof(dbproto_hdr_t));
+    dbproto_hdr_pack(hdr, PROTO_VER_V1, MSG_HELLO_REQ,
+                     sizeof(dbproto_hello_req));
+    hello_req->proto = htons(PROTO_VER);
+    if (send_full(fd, buf, sizeof(dbproto_hdr_t) + sizeof(dbproto_hello_req)) ==
+            STATUS_ERROR ||
+        read_full(fd, buf, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
+        fprintf(stderr, "Error: Hello handshake failed\n");
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(hdr, PROTO_VER_V1);
+    if (hdr->type != MSG_HELLO_RESP ||
+        hdr->len != sizeof(dbproto_hello_resp) ||
+        read_full(fd, buf + sizeof(dbproto_hdr_t), hdr->len) == STATUS_ERROR) {
+        fprintf(stderr, "Error: Server rejected the hello request\n");
+        return STATUS_ERROR;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        perror("fcntl O_NONBLOCK");
+        return STATUS_ERROR;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+    if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl add");
+        return STATUS_ERROR;
+    }
+
+    c->fd = fd;
+    fd = -1;  // 所有权转交给连接
+    c->out_len = c->out_off = 0;
+    c->want_out = false;
+    c->in_len = 0;
+    c->skip = 0;
+    c->list_last = false;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 关闭连接，所有在途请求记为失败。
+ */
+static void conn_close(bench_thread_t *t, bench_conn_t *c) {
+    if (c->fd != -1) {
+        close(c->fd);  // 关闭时自动从 epoll 中移除
+        c->fd = -1;
+    }
+    for (; c->count > 0; c->count--) {
+        t->errors[c->ring[c->head].op]++;
+        c->head = (c->head + 1) % BENCH_MAX_DEPTH;
+    }
+}
+
+/**
+ * @brief 执行 HELLO 操作：重新连接并握手，记录从计划开始到握手完成的时间。
+ * @return 成功时返回 STATUS_SUCCESS，无法重新连接时返回 STATUS_ERROR。
+ */
+static int conn_reconnect(bench_thread_t *t, bench_conn_t *c) {
+    conn_close(t, c);
+    c->reconnect = false;
+    if (conn_open(t, c) != STATUS_SUCCESS) {
+        t->errors[OP_HELLO]++;
+        return STATUS_ERROR;
+    }
+    hist_record(&t->hist[OP_HELLO], now_ns() - c->hello_ns);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 根据权重随机选择一个操作；没有可删除的记录时 DEL 改为 ADD。
+ */
+static bench_op_e pick_op(bench_thread_t *t, const bench_conn_t *c) {
+    unsigned r = (unsigned)rand_r(&t->seed) % t->cfg->mix_total;
+    bench_op_e op = OP_HELLO;
+    while (r >= t->cfg->mix[op]) {
+        r -= t->cfg->mix[op];
+        op++;
+    }
+    if (op == OP_DEL && c->del_seq >= c->add_seq) op = OP_ADD;
+    return op;
+}
+
+/**
+ * @brief 把一个请求编码到发送缓冲区并记入在途队列。HELLO 不发送请求，
+ *        只是停止在该连接上发出新请求，等在途请求完成后重新连接。
+ * @param t 压测线程。
+ * @param c 连接，必须已连接且没有等待中的 HELLO。
+ * @param start 请求的开始时间。
+ * @return 成功时返回 STATUS_SUCCESS，重新连接失败时返回 STATUS_ERROR。
+ */
+static int conn_issue(bench_thread_t *t, bench_conn_t *c, uint64_t start) {
+    bench_op_e op = pick_op(t, c);
+    if (op == OP_HELLO) {
+        c->reconnect = true;
+        c->hello_ns = start;
+        return c->count == 0 ? conn_reconnect(t, c) : STATUS_SUCCESS;
+    }
+
+    // 发送缓冲区按在途请求数计算，已发送完的部分先移走
+    if (c->out_off == c->out_len) c->out_len = c->out_off = 0;
+    char *buf = c->out + c->out_len;
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    char *body = buf + sizeof(dbproto_hdr_t);
+    size_t body_len;
+    if (op == OP_ADD) {
+        dbproto_employee_add_req_t *add_req =
+            (dbproto_employee_add_req_t *)body;
+        memset(add_req, 0, sizeof(*add_req));
+        snprintf(add_req->data, sizeof(add_req->data),
+                 "b%u_%lu-%lu Bench Street-%lu", c->id,
+                 (unsigned long)c->add_seq, (unsigned long)c->add_seq,
+                 (unsigned long)(c->add_seq % 160));
+        c->add_seq++;
+        dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_ADD_REQ,
+                         sizeof(*add_req));
+        body_len = sizeof(*add_req);
+    } else if (op == OP_DEL) {
+        dbproto_employee_del_by_name_req_t *del_req =
+            (dbproto_employee_del_by_name_req_t *)body;
+        memset(del_req, 0, sizeof(*del_req));
+        snprintf(del_req->name, sizeof(del_req->name), "b%u_%lu", c->id,
+                 (unsigned long)c->del_seq);
+        c->del_seq++;
+        dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_DEL_BY_NAME_REQ,
+                         sizeof(*del_req));
+        body_len = sizeof(*del_req);
+    } else {
+        dbproto_employee_list_page_req_t page_req = {
+            .cursor = htobe64(0),
+            .limit = htobe64(t->cfg->list_limit),
+            .chunk = htonl(0),
+        };
+        memcpy(body, &page_req, sizeof(page_req));
+        dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_LIST_PAGE_REQ,
+                         sizeof(page_req));
+        body_len = sizeof(page_req);
+    }
+    c->out_len += sizeof(dbproto_hdr_t) + body_len;
+
+    inflight_t *slot = &c->ring[(c->head + c->count) % BENCH_MAX_DEPTH];
+    slot->op = op;
+    slot->start_ns = start;
+    c->count++;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 以非阻塞方式发送缓冲区，发送不完时等待可写事件。
+ * @return 成功时返回 STATUS_SUCCESS，连接出错时返回 STATUS_ERROR。
+ */
+static int conn_flush(bench_thread_t *t, bench_conn_t *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+                         MSG_NOSIGNAL);
+        if (n > 0) {
+            c->out_off += (size_t)n;
+            continue;
+        }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        perror("send");
+        return STATUS_ERROR;
+    }
+    bool want_out = c->out_off < c->out_len;
+    if (want_out != c->want_out) {
+        struct epoll_event ev = {
+            .events = EPOLLIN | (want_out ? EPOLLOUT : 0), .data.ptr = c};
+        if (epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1) {
+            perror("epoll_ctl mod");
+            return STATUS_ERROR;
+        }
+        c->want_out = want_out;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 最早的在途请求已经完成：记录延迟或失败。
+ */
+static void conn_complete(bench_thread_t *t, bench_conn_t *c, bool ok) {
+    inflight_t *req = &c->ring[c->head];
+    if (ok) {
+        hist_record(&t->hist[req->op], now_ns() - req->start_ns);
+    } else {
+        t->errors[req->op]++;
+    }
+    c->head = (c->head + 1) % BENCH_MAX_DEPTH;
+    c->count--;
+}
+
+/**
+ * @brief 解析接收缓冲区中的完整响应。列表的每一块只解析定长部分，
+ *        之后的记录直接跳过，最后一块跳过之后请求才算完成。
+ * @return 成功时返回 STATUS_SUCCESS，收到错误或无法识别的响应时返回
+ * STATUS_ERROR（服务器在 MSG_ERROR 之后会关闭连接）。
+ */
+static int conn_parse(bench_thread_t *t, bench_conn_t *c) {
+    size_t pos = 0;
+    for (;;) {
+        if (c->skip > 0) {
+            size_t n = c->in_len - pos;
+            if (n > c->skip) n = (size_t)c->skip;
+            pos += n;
+            c->skip -= n;
+            if (c->skip > 0) break;
+            if (c->list_last) conn_complete(t, c, true);
+            continue;
+        }
+        if (c->in_len - pos < sizeof(dbproto_hdr_t)) break;
+        dbproto_hdr_t hdr;
+        memcpy(&hdr, c->in + pos, sizeof(hdr));
+        dbproto_hdr_unpack(&hdr, PROTO_VER);
+        if (hdr.len > BENCH_IN_BUF - sizeof(hdr) || c->count == 0) {
+            fprintf(stderr, "Error: Unexpected response (type %u, len %u)\n",
+                    hdr.type, hdr.len);
+            return STATUS_ERROR;
+        }
+        if (c->in_len - pos < sizeof(hdr) + hdr.len) break;
+        const char *body = c->in + pos + sizeof(hdr);
+        pos += sizeof(hdr) + hdr.len;
+
+        if (hdr.type == MSG_ERROR) return STATUS_ERROR;
+        if (hdr.type == MSG_EMPLOYEE_LIST_CHUNK &&
+            hdr.len == sizeof(dbproto_employee_list_chunk_t)) {
+            dbproto_employee_list_chunk_t chunk;
+            memcpy(&chunk, body, sizeof(chunk));
+            c->skip = be64toh(chunk.bytes);
+            c->list_last = ntohl(chunk.last) != 0;
+            if (c->skip == 0 && c->list_last) conn_complete(t, c, true);
+        } else if ((hdr.type == MSG_EMPLOYEE_ADD_RESP ||
+                    hdr.type == MSG_EMPLOYEE_DEL_BY_NAME_RESP) &&
+                   hdr.len >= sizeof(int)) {
+            int status;
+            memcpy(&status, body, sizeof(status));
+            conn_complete(t, c, (int)ntohl(status) == STATUS_SUCCESS);
+        } else {
+            fprintf(stderr, "Error: Unexpected response (type %u, len %u)\n",
+                    hdr.type, hdr.len);
+            return STATUS_ERROR;
+        }
+    }
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 读取并解析响应，直到套接字读空。
+ * @return 成功时返回 STATUS_SUCCESS，连接断开或出错时返回 STATUS_ERROR。
+ */
+static int conn_read(bench_thread_t *t, bench_conn_t *c) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, BENCH_IN_BUF - c->in_len, 0);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            if (conn_parse(t, c) != STATUS_SUCCESS) return STATUS_ERROR;
+            continue;
+        }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n == 0) fprintf(stderr, "Error: Server closed connection\n");
+        if (n == -1) perror("recv");
+        return STATUS_ERROR;
+    }
+    // 等待中的 HELLO 在所有在途请求完成之后执行
+    if (c->reconnect && c->count == 0) return conn_reconnect(t, c);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 连接出错后的处理：在途请求记为失败，然后重新连接。
+ * @return 重新连接成功时返回 STATUS_SUCCESS，否则返回 STATUS_ERROR。
+ */
+static int conn_recover(bench_thread_t *t, bench_conn_t *c) {
+    conn_close(t, c);
+    c->reconnect = false;
+    return conn_open(t, c);
+}
+
+/**
+ * @brief 压测线程主循环。闭环模式下每个连接保持 depth 个请求在途；
+ *        开环模式下按固定间隔计划请求，延迟从计划时间算起，因此服务器
+ *        变慢造成的排队也计入延迟（避免协调遗漏）。
+ */
+static void *bench_thread(void *arg) {
+    bench_thread_t *t = arg;
+    const bench_cfg_t *cfg = t->cfg;
+    struct epoll_event events[BENCH_MAX_EVENTS];
+
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(cfg->duration * 1e9);
+    for (int i = 0; i < t->nconns; i++) {
+        // 开环模式下各连接的第一次请求错开，避免同时到达
+        t->conns[i].next_ns = start + t->interval_ns * i / t->nconns;
+    }
+
+    t->status = STATUS_SUCCESS;
+    for (;;) {
+        uint64_t now = now_ns();
+        bool running = now < end;
+        unsigned inflight = 0;
+        for (int i = 0; i < t->nconns; i++) {
+            bench_conn_t *c = &t->conns[i];
+            int rc = STATUS_SUCCESS;
+            if (running && cfg->rate > 0) {
+                while (rc == STATUS_SUCCESS && c->next_ns <= now &&
+                       !c->reconnect && c->count < BENCH_MAX_DEPTH) {
+                    rc = conn_issue(t, c, c->next_ns);
+                    c->next_ns += t->interval_ns;
+                }
+            } else if (running) {
+                while (rc == STATUS_SUCCESS && !c->reconnect &&
+                       c->count < (unsigned)cfg->depth) {
+                    rc = conn_issue(t, c, now);
+                }
+            }
+            if (rc == STATUS_SUCCESS && c->out_off < c->out_len) {
+                rc = conn_flush(t, c);
+            }
+            if (rc != STATUS_SUCCESS && conn_recover(t, c) != STATUS_SUCCESS) {
+                t->status = STATUS_ERROR;
+                return NULL;
+            }
+            inflight += c->count;
+        }
+        if (!running && (inflight == 0 || now >= end + BENCH_DRAIN_NS)) {
+            t->elapsed_ns = now - start;
+            break;
+        }
+
+        int timeout_ms = cfg->rate > 0 ? 1 : 10;
+        int n = epoll_wait(t->epfd, events, BENCH_MAX_EVENTS, timeout_ms);
+        if (n == -1 && errno != EINTR) {
+            perror("epoll_wait");
+            t->status = STATUS_ERROR;
+            return NULL;
+        }
+        for (int i = 0; i < n; i++) {
+            bench_conn_t *c = events[i].data.ptr;
+            if (c->fd == -1) continue;
+            int rc = STATUS_SUCCESS;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                rc = conn_read(t, c);
+            }
+            if (rc == STATUS_SUCCESS && (events[i].events & EPOLLOUT)) {
+                rc = conn_flush(t, c);
+            }
+            if (rc != STATUS_SUCCESS && conn_recover(t, c) != STATUS_SUCCESS) {
+                t->status = STATUS_ERROR;
+                return NULL;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 解析 "add=70,list=10,del=20,hello=0" 形式的操作权重。
+ * @param arg 命令行参数。
+ * @param cfg 压测配置，成功时更新 mix 与 mix_total。
+ * @return 成功时返回 STATUS_SUCCESS，格式错误时返回 STATUS_ERROR。
+ */
+static int parse_mix(const char *arg, bench_cfg_t *cfg) {
+    char copy[256];
+    if (strlen(arg) >= sizeof(copy)) return STATUS_ERROR;
+    strcpy(copy, arg);
+
+    unsigned mix[OP_COUNT] = {0};
+    unsigned total = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(copy, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(tok, '=');
+        if (eq == NULL) return STATUS_ERROR;
+        *eq = '\0';
+        char *end = NULL;
+        unsigned long weight = strtoul(eq + 1, &end, 10);
+        if (end == eq + 1 || *end != '\0' || weight > 1000000) {
+            return STATUS_ERROR;
+        }
+        int op = 0;
+        while (op < OP_COUNT && strcmp(tok, op_names[op]) != 0) op++;
+        if (op == OP_COUNT) return STATUS_ERROR;
+        mix[op] = (unsigned)weight;
+    }
+    for (int op = 0; op < OP_COUNT; op++) total += mix[op];
+    if (total == 0) return STATUS_ERROR;
+    memcpy(cfg->mix, mix, sizeof(mix));
+    cfg->mix_total = total;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 打印一行延迟统计（微秒）。
+ */
+static void print_row(const char *name, const hist_t *h, uint64_t errors) {
+    printf("%-6s %10lu %8lu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+           (unsigned long)h->total, (unsigned long)errors,
+           hist_mean(h) / 1e3, hist_percentile(h, 50) / 1e3,
+           hist_percentile(h, 90) / 1e3, hist_percentile(h, 99) / 1e3,
+           hist_percentile(h, 99.9) / 1e3, (h->total ? h->max : 0) / 1e3);
+}
+
+/**
+ * @brief 压测程序主函数。
+ *        打开 -c 个连接（分给 -t 个线程），按 -m 给出的权重发送请求，
+ *        运行 -d 秒后报告吞吐量与延迟分布。给出 -r 时为开环模式（固定的
+ *        总请求速率），否则为闭环模式（每个连接保持 -q 个请求在途）。
+ * @param argc 命令行参数数量
+ * @param argv 命令行参数数组
+ * @return 成功时返回 STATUS_SUCCESS (0)，错误时返回 STATUS_ERROR (-1)。
+ */
+int main(int argc, char *argv[]) {
+    bench_cfg_t cfg = {
+        .conns = 16,
+        .threads = 1,
+        .duration = 10,
+        .mix = {[OP_ADD] = 70, [OP_LIST] = 10, [OP_DEL] = 20},
+        .mix_total = 100,
+        .depth = 1,
+        .list_limit = 100,
+    };
+    char *hostarg = NULL;
+    unsigned short port = 0;
+
+    int c;
+    // 解析命令行参数：-h (主机), -p (端口), -c (连接数), -t (线程数),
+    // -d (秒数), -m (操作权重), -r (开环速率), -q (闭环深度), -L (LIST 条数)
+    while ((c = getopt(argc, argv, "h:p:c:t:d:m:r:q:L:")) != -1) {
+        switch (c) {
+            case 'h': hostarg = optarg; break;
+            case 'p': port = (unsigned short)atoi(optarg); break;
+            case 'c': cfg.conns = atoi(optarg); break;
+            case 't': cfg.threads = atoi(optarg); break;
+            case 'd': cfg.duration = strtod(optarg, NULL); break;
+            case 'r': cfg.rate = strtod(optarg, NULL); break;
+            case 'q': cfg.depth = atoi(optarg); break;
+            case 'L': cfg.list_limit = strtoull(optarg, NULL, 10); break;
+            case 'm':
+                if (parse_mix(optarg, &cfg) != STATUS_SUCCESS) {
+                    fprintf(stderr,
+                            "Error: -m expects weights like "
+                            "'add=70,list=10,del=20,hello=0', got '%s'\n",
+                            optarg);
+                    return STATUS_ERROR;
+                }
+                break;
+            default: return STATUS_ERROR;
+        }
+    }
+
+    if (hostarg == NULL || port == 0) {
+        fprintf(stderr, "Usage: %s -h <host> -p <port> [-c conns] [-t threads] "
+                        "[-d seconds] [-m mix] [-r rate | -q depth] "
+                        "[-L list limit]\n",
+                argv[0]);
+        return STATUS_ERROR;
+    }
+    if (cfg.conns < 1 || cfg.threads < 1 || cfg.duration <= 0 ||
+        cfg.rate < 0 || cfg.depth < 1 || cfg.depth > BENCH_MAX_DEPTH) {
+        fprintf(stderr,
+                "Error: Need -c >= 1, -t >= 1, -d > 0, -r >= 0 and "
+                "1 <= -q <= %d.\n",
+                BENCH_MAX_DEPTH);
+        return STATUS_ERROR;
+    }
+    if (cfg.threads > cfg.conns) cfg.threads = cfg.conns;
+    cfg.addr.sin_family = AF_INET;
+    cfg.addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, hostarg, &cfg.addr.sin_addr) != 1) {
+        fprintf(stderr, "Error: Invalid host address '%s'.\n", hostarg);
+        return STATUS_ERROR;
+    }
+
+    bench_thread_t *threads __attribute__((cleanup(_cleanup_ptr_))) =
+        calloc(cfg.threads, sizeof(bench_thread_t));
+    bench_conn_t *conns __attribute__((cleanup(_cleanup_ptr_))) =
+        calloc(cfg.conns, sizeof(bench_conn_t));
+    if (threads == NULL || conns == NULL) {
+        perror("calloc for benchmark state");
+        return STATUS_ERROR;
+    }
+
+    // 建立全部连接之后再开始计时
+    int status = STATUS_SUCCESS;
+    int next = 0;
+    for (int i = 0; i < cfg.threads; i++) {
+        bench_thread_t *t = &threads[i];
+        t->cfg = &cfg;
+        t->conns = &conns[next];
+        t->nconns = cfg.conns / cfg.threads + (i < cfg.conns % cfg.threads);
+        t->seed = 0x9e3779b9u * (unsigned)(i + 1);
+        t->epfd = -1;
+        if (cfg.rate > 0) {
+            t->interval_ns = (uint64_t)(1e9 * cfg.conns / cfg.rate);
+        }
+        for (int op = 0; op < OP_COUNT; op++) hist_init(&t->hist[op]);
+        for (int j = 0; j < t->nconns; j++) {
+            t->conns[j].fd = -1;
+            t->conns[j].id = (uint32_t)(next + j);
+        }
+        next += t->nconns;
+
+        t->epfd = epoll_create1(0);
+        if (t->epfd == -1) {
+            perror("epoll_create1");
+            status = STATUS_ERROR;
+            break;
+        }
+        for (int j = 0; j < t->nconns && status == STATUS_SUCCESS; j++) {
+            status = conn_open(t, &t->conns[j]);
+        }
+        if (status != STATUS_SUCCESS) break;
+    }
+
+    if (status == STATUS_SUCCESS) {
+        if (cfg.rate > 0) {
+            printf("Running %.1f s, %d connections, %d threads, open loop at "
+                   "%.0f req/s\n",
+                   cfg.duration, cfg.conns, cfg.threads, cfg.rate);
+        } else {
+            printf("Running %.1f s, %d connections, %d threads, closed loop "
+                   "with %d in flight per connection\n",
+                   cfg.duration, cfg.conns, cfg.threads, cfg.depth);
+        }
+        int started = 0;
+        for (; started < cfg.threads; started++) {
+            if (pthread_create(&threads[started].tid, NULL, bench_thread,
+                               &threads[started]) != 0) {
+                perror("pthread_create");
+                status = STATUS_ERROR;
+                break;
+            }
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i].tid, NULL);
+            if (threads[i].status != STATUS_SUCCESS) status = STATUS_ERROR;
+        }
+    }
+
+    // 合并各线程的统计并报告
+    hist_t *total __attribute__((cleanup(_cleanup_ptr_))) =
+        calloc(OP_COUNT + 1, sizeof(hist_t));
+    if (total != NULL && status == STATUS_SUCCESS) {
+        uint64_t errors[OP_COUNT + 1] = {0};
+        uint64_t elapsed = 0;
+        for (int op = 0; op <= OP_COUNT; op++) hist_init(&total[op]);
+        for (int i = 0; i < cfg.threads; i++) {
+            for (int op = 0; op < OP_COUNT; op++) {
+                hist_merge(&total[op], &threads[i].hist[op]);
+                hist_merge(&total[OP_COUNT], &threads[i].hist[op]);
+                errors[op] += threads[i].errors[op];
+                errors[OP_COUNT] += threads[i].errors[op];
+            }
+            if (threads[i].elapsed_ns > elapsed) {
+                elapsed = threads[i].elapsed_ns;
+            }
+        }
+
+        printf("Completed %lu requests (%lu errors) in %.2f s: %.0f req/s\n",
+               (unsigned long)total[OP_COUNT].total,
+               (unsigned long)errors[OP_COUNT], elapsed / 1e9,
+               elapsed ? total[OP_COUNT].total / (elapsed / 1e9) : 0);
+        printf("%-6s %10s %8s %9s %9s %9s %9s %9s %9s  (latency in us)\n",
+               "op", "count", "errors", "mean", "p50", "p90", "p99", "p99.9",
+               "max");
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (cfg.mix[op] == 0) continue;
+            print_row(op_names[op], &total[op], errors[op]);
+        }
+        print_row("all", &total[OP_COUNT], errors[OP_COUNT]);
+    }
+
+    for (int i = 0; i < cfg.threads; i++) {
+        for (int j = 0; j < threads[i].nconns; j++) {
+            if (threads[i].conns[j].fd != -1) close(threads[i].conns[j].fd);
+        }
+        if (threads[i].epfd != -1) close(threads[i].epfd);
+    }
+    return status;
+}
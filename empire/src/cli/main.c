@@ -1,12 +1,13 @@
 #include <arpa/inet.h>
-#include <errno.h>  // For errno
+#include <endian.h>  // For be64toh
+#include <errno.h>   // For errno
 #include <fcntl.h>
 #include <getopt.h>  // For getopt
 #include <netinet/in.h>
 #include <stdbool.h>  // For bool, true, false
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>  // For memset, strlen, strncpy
+#include <string.h>  // For memset, memmove, strlen, strncpy
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -14,6 +15,7 @@
 
 #include "../../include/common.h"  // 包含通用宏、协议结构和网络读写函数
 #include "../../include/parse.h"  // 包含 struct employee_t 定义
+#include "../../include/record.h"  // 包含紧凑记录的解码
 
 /**
  * @brief 客户端发送 Hello 请求并接收响应，进行协议协商。
@@ -34,8 +36,8 @@ int send_hello(int fd) {
     hello_req->proto = PROTO_VER;  // 客户端协议版本
 
     // 将头部和请求体字段转换为网络字节序
-    hdr->type = htonl(hdr->type);
-    hdr->len = htons(hdr->len);
+    // Hello 请求总是使用 V1 头部
+    dbproto_hdr_pack(hdr, PROTO_VER_V1, hdr->type, hdr->len);
     hello_req->proto = htons(hello_req->proto);
 
     // 发送完整的 Hello 请求消息
@@ -52,8 +54,7 @@ int send_hello(int fd) {
     }
 
     // 将接收到的头部字段转换回主机字节序
-    hdr->type = ntohl(hdr->type);
-    hdr->len = ntohs(hdr->len);
+    dbproto_hdr_unpack(hdr, PROTO_VER_V1);
 
     // 根据响应类型进行处理
     if (hdr->type == MSG_ERROR) {
@@ -95,43 +96,52 @@ int send_hello(int fd) {
     }
 }
 
+/**
+ * @brief 把员工记录编码为二进制添加请求的消息体：
+ *        dbproto_employee_add_req_v2_t 之后是名字与地址，不含 '\0'。
+ * @param employee 员工记录（hours 为主机字节序）。
+ * @param out 输出缓冲区，至少 MAX_EMPLOYEE_ADD_DATA 字节。
+ * @return 编码后的字节数。
+ */
+static size_t pack_employee_fields(const struct employee_t *employee,
+                                   char *out) {
+    size_t name_len = strnlen(employee->name, sizeof(employee->name) - 1);
+    size_t address_len =
+        strnlen(employee->address, sizeof(employee->address) - 1);
+    dbproto_employee_add_req_v2_t req = {
+        .hours = htonl(employee->hours),
+        .name_len = htons((uint16_t)name_len),
+        .address_len = htons((uint16_t)address_len),
+    };
+    memcpy(out, &req, sizeof(req));
+    memcpy(out + sizeof(req), employee->name, name_len);
+    memcpy(out + sizeof(req) + name_len, employee->address, address_len);
+    return sizeof(req) + name_len + address_len;
+}
+
 /**
  * @brief 客户端发送添加员工请求并接收响应。
+ *        添加字符串在本地解析，以二进制请求发送拆分好的字段。
  * @param fd 服务器的套接字文件描述符。
- * @param addstring 格式为 "Name-Address-Hours" 的员工信息字符串。
+ * @param addstring 格式为 "Name-Address-Hours" 的员工信息字符串，
+ *        名字与地址中的 '-' 和 '\' 前面加一个 '\' 转义。
  * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
  */
 int send_add_employee_req(int fd, const char *addstring) {
     char buf[CLIENT_BUFFER_SIZE] = {0};
     dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
-    dbproto_employee_add_req_t *add_req =
-        (dbproto_employee_add_req_t *)(buf + sizeof(dbproto_hdr_t));
 
-    // 检查添加字符串长度是否超出协议限制
-    size_t addstring_len = strlen(addstring);
-    if (addstring_len >= MAX_EMPLOYEE_ADD_DATA) {
-        fprintf(stderr,
-                "Error: Employee add string too long (%zu bytes), max is %d.\n",
-                addstring_len, MAX_EMPLOYEE_ADD_DATA - 1);
+    struct employee_t employee;
+    if (parse_employee(addstring, &employee) != STATUS_SUCCESS) {
         return STATUS_ERROR;
     }
 
-    // 构造添加员工请求头部
-    hdr->type = MSG_EMPLOYEE_ADD_REQ;
-    hdr->len = sizeof(dbproto_employee_add_req_t);  // 消息体长度
-
-    // 拷贝员工信息字符串到请求体，并确保空终止
-    strncpy(add_req->data, addstring, MAX_EMPLOYEE_ADD_DATA - 1);
-    add_req->data[MAX_EMPLOYEE_ADD_DATA - 1] = '\0';
-
-    // 转换为网络字节序
-    hdr->type = htonl(hdr->type);
-    hdr->len = htons(hdr->len);
+    // 构造二进制添加员工请求并转换为网络字节序
+    size_t len = pack_employee_fields(&employee, buf + sizeof(dbproto_hdr_t));
+    dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_ADD_V2_REQ, (uint32_t)len);
 
     // 发送完整的添加员工请求消息
-    if (send_full(fd, buf,
-                  sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_add_req_t)) ==
-        STATUS_ERROR) {
+    if (send_full(fd, buf, sizeof(dbproto_hdr_t) + len) == STATUS_ERROR) {
         perror("send_full add employee request");
         return STATUS_ERROR;
     }
@@ -142,8 +152,7 @@ int send_add_employee_req(int fd, const char *addstring) {
         return STATUS_ERROR;
     }
     // 转换回主机字节序
-    hdr->type = ntohl(hdr->type);
-    hdr->len = ntohs(hdr->len);
+    dbproto_hdr_unpack(hdr, PROTO_VER);
 
     // 根据响应类型处理
     if (hdr->type == MSG_ERROR) {
@@ -182,92 +191,318 @@ int send_add_employee_req(int fd, const char *addstring) {
 }
 
 /**
- * @brief 客户端发送列出所有员工的请求，并接收和显示服务器响应的员工列表。
+ * @brief 接收列表中紧凑记录的缓冲区大小，必须不小于 DBREC_MAX_SIZE
+ */
+#define LIST_CHUNK_SIZE (64 * 1024)
+
+/**
+ * @brief 接收 bytes 字节的紧凑记录并逐条显示。记录按块接收，跨块的
+ *        半条记录移到缓冲区开头，与下一块拼接后再解码。
  * @param fd 服务器的套接字文件描述符。
+ * @param chunk 接收缓冲区，LIST_CHUNK_SIZE 字节。
+ * @param bytes 记录数据的总字节数。
+ * @param what 请求的描述，用于错误信息。
+ * @param shown 输出参数，累加显示的记录数。
  * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
  */
-int send_list_employee_req(int fd) {
-    char buf[CLIENT_BUFFER_SIZE] = {0};
-    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
-
-    // 构造列出员工请求头部
-    hdr->type = MSG_EMPLOYEE_LIST_REQ;
-    hdr->len = 0;  // 列表请求没有消息体
-
-    // 转换为网络字节序
-    hdr->type = htonl(hdr->type);
-    hdr->len = htons(hdr->len);
+static int recv_records(int fd, char *chunk, uint64_t bytes, const char *what,
+                        uint64_t *shown) {
+    uint64_t left = bytes;
+    size_t have = 0;  // 缓冲区中尚未解码的字节数
+    while (left > 0 || have > 0) {
+        size_t want = LIST_CHUNK_SIZE - have;
+        if (want > left) want = (size_t)left;
+        if (want > 0 && read_full(fd, chunk + have, want) == STATUS_ERROR) {
+            perror("read_full employee data");
+            return STATUS_ERROR;
+        }
+        have += want;
+        left -= want;
 
-    // 发送完整的列出员工请求消息
-    if (send_full(fd, buf, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
-        perror("send_full list employee request");
-        return STATUS_ERROR;
+        size_t pos = 0;
+        dbrec_t rec;
+        size_t n;
+        while ((n = dbrec_decode(chunk + pos, have - pos, &rec)) > 0) {
+            printf("Employee id %u:\n", rec.slot);
+            printf("\tName: %.*s\n", (int)rec.name_len, rec.name);
+            printf("\tAddress: %.*s\n", (int)rec.address_len, rec.address);
+            printf("\tHours: %u\n", rec.hours);
+            pos += n;
+            (*shown)++;
+        }
+        // 剩余的字节不足一条记录：还有数据可读时留到下一块，否则是格式错误
+        if (have - pos >= DBREC_MAX_SIZE || (left == 0 && pos < have)) {
+            fprintf(stderr, "Error: Malformed record in %s response\n", what);
+            return STATUS_ERROR;
+        }
+        memmove(chunk, chunk + pos, have - pos);
+        have -= pos;
     }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 接收员工列表形式的响应（数量 + 字节数 + 紧凑记录）并显示。
+ *        按名字、按工时范围的查询使用这一格式，只包含有效记录，
+ *        每条记录带有自己的 id。
+ * @param fd 服务器的套接字文件描述符。
+ * @param resp_type 期望的响应消息类型。
+ * @param what 请求的描述，用于错误信息。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int recv_employee_list(int fd, dbproto_type_e resp_type,
+                              const char *what) {
+    char buf[CLIENT_BUFFER_SIZE] = {0};
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
 
     // 接收服务器响应头部
     if (read_full(fd, buf, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
-        perror("read_full list employee response header");
+        fprintf(stderr, "read_full %s response header failed\n", what);
         return STATUS_ERROR;
     }
     // 转换回主机字节序
-    hdr->type = ntohl(hdr->type);
-    hdr->len = ntohs(hdr->len);
+    dbproto_hdr_unpack(hdr, PROTO_VER);
 
     // 根据响应类型处理
     if (hdr->type == MSG_ERROR) {
-        printf("Server returned an error for list employees.\n");
+        printf("Server returned an error for %s.\n", what);
         return STATUS_ERROR;
-    } else if (hdr->type == MSG_EMPLOYEE_LIST_RESP) {
-        // 验证响应体长度
-        if (hdr->len != sizeof(dbproto_employee_list_resp_t)) {
-            fprintf(stderr,
-                    "Error: List employee response length mismatch. Expected "
-                    "%zu, got %u.\n",
-                    sizeof(dbproto_employee_list_resp_t), hdr->len);
+    } else if (hdr->type != resp_type) {
+        fprintf(stderr, "Unexpected message type for %s response: %d\n", what,
+                hdr->type);
+        return STATUS_ERROR;
+    }
+
+    // 验证响应体长度
+    if (hdr->len != sizeof(dbproto_employee_list_resp_v3_t)) {
+        fprintf(stderr,
+                "Error: %s response length mismatch. Expected %zu, got "
+                "%u.\n",
+                what, sizeof(dbproto_employee_list_resp_v3_t), hdr->len);
+        return STATUS_ERROR;
+    }
+    // 接收响应体（包含记录数和记录数据的字节数）
+    dbproto_employee_list_resp_v3_t *list_resp =
+        (dbproto_employee_list_resp_v3_t *)(buf + sizeof(dbproto_hdr_t));
+    if (read_full(fd, list_resp, sizeof(dbproto_employee_list_resp_v3_t)) ==
+        STATUS_ERROR) {
+        fprintf(stderr, "read_full %s response payload failed\n", what);
+        return STATUS_ERROR;
+    }
+    uint64_t count = be64toh(list_resp->count);
+    uint64_t bytes = be64toh(list_resp->bytes);
+
+    printf("--- Employee List (%lu records) ---\n", (unsigned long)count);
+    if (count == 0) printf("No employees to list.\n");
+
+    char *chunk __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(LIST_CHUNK_SIZE);
+    if (chunk == NULL) {
+        perror("malloc for employee list");
+        return STATUS_ERROR;
+    }
+    uint64_t shown = 0;
+    if (recv_records(fd, chunk, bytes, what, &shown) == STATUS_ERROR) {
+        return STATUS_ERROR;
+    }
+    if (shown != count) {
+        fprintf(stderr,
+                "Error: %s response announced %lu records, got %lu\n", what,
+                (unsigned long)count, (unsigned long)shown);
+        return STATUS_ERROR;
+    }
+    printf("----------------------------------\n\n");
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 客户端发送分页列出员工的请求，服务器以若干块流式返回，
+ *        每块到达后立即显示，不需要先把整个列表读入内存。
+ *        因 limit 提前结束时显示续传令牌，用 -c 传回即可继续列出。
+ * @param fd 服务器的套接字文件描述符。
+ * @param cursor 续传令牌，0 表示从头开始。
+ * @param limit 最多列出的记录数，0 表示不限。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_list_employee_req(int fd, uint64_t cursor, uint64_t limit) {
+    char buf[sizeof(dbproto_hdr_t) +
+             sizeof(dbproto_employee_list_chunk_t)] = {0};
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_employee_list_page_req_t *page_req =
+        (dbproto_employee_list_page_req_t *)(buf + sizeof(dbproto_hdr_t));
+
+    // 构造分页列表请求，块大小使用服务器默认值
+    dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_LIST_PAGE_REQ,
+                     sizeof(dbproto_employee_list_page_req_t));
+    page_req->cursor = htobe64(cursor);
+    page_req->limit = htobe64(limit);
+    page_req->chunk = htonl(0);
+
+    if (send_full(fd, buf,
+                  sizeof(dbproto_hdr_t) +
+                      sizeof(dbproto_employee_list_page_req_t)) ==
+        STATUS_ERROR) {
+        perror("send_full list employee request");
+        return STATUS_ERROR;
+    }
+
+    char *chunk __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(LIST_CHUNK_SIZE);
+    if (chunk == NULL) {
+        perror("malloc for employee list");
+        return STATUS_ERROR;
+    }
+
+    printf("--- Employee List ---\n");
+    uint64_t shown = 0;
+    uint64_t next = DBPROTO_CURSOR_END;
+    bool last = false;
+    while (!last) {
+        if (read_full(fd, buf, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
+            fprintf(stderr, "read_full list employees chunk header failed\n");
             return STATUS_ERROR;
         }
-        // 接收响应体（包含员工总数）
-        dbproto_employee_list_resp_t *list_resp =
-            (dbproto_employee_list_resp_t *)(buf + sizeof(dbproto_hdr_t));
-        if (read_full(fd, list_resp, sizeof(dbproto_employee_list_resp_t)) ==
-            STATUS_ERROR) {
-            perror("read_full list employee response payload");
+        dbproto_hdr_unpack(hdr, PROTO_VER);
+        if (hdr->type == MSG_ERROR) {
+            printf("Server returned an error for list employees.\n");
+            return STATUS_ERROR;
+        } else if (hdr->type != MSG_EMPLOYEE_LIST_CHUNK ||
+                   hdr->len != sizeof(dbproto_employee_list_chunk_t)) {
+            fprintf(stderr,
+                    "Unexpected list employees response: type %d, len %u\n",
+                    hdr->type, hdr->len);
             return STATUS_ERROR;
         }
-        // 转换员工总数
-        list_resp->count = ntohs(list_resp->count);
 
-        printf("--- Employee List (%hu records) ---\n", list_resp->count);
-        if (list_resp->count == 0) {
-            printf("No employees to list.\n");
-        } else {
-            // 循环接收每个员工的数据结构
-            for (uint16_t i = 0; i < list_resp->count; ++i) {
-                struct employee_t
-                    employee_data;  // 声明一个临时 employee_t 结构体来接收
-                if (read_full(fd, &employee_data, sizeof(struct employee_t)) ==
-                    STATUS_ERROR) {
-                    perror("read_full employee data");
-                    return STATUS_ERROR;
-                }
-                // 转换员工数据中的字段（例如 hours）
-                employee_data.hours = ntohl(employee_data.hours);
+        dbproto_employee_list_chunk_t *chunk_resp =
+            (dbproto_employee_list_chunk_t *)(buf + sizeof(dbproto_hdr_t));
+        if (read_full(fd, chunk_resp, sizeof(*chunk_resp)) == STATUS_ERROR) {
+            fprintf(stderr, "read_full list employees chunk failed\n");
+            return STATUS_ERROR;
+        }
+        uint64_t count = be64toh(chunk_resp->count);
+        next = be64toh(chunk_resp->next);
+        last = ntohl(chunk_resp->last) != 0;
 
-                printf("Employee #%d:\n", i + 1);
-                printf("\tName: %s\n", employee_data.name);
-                printf("\tAddress: %s\n", employee_data.address);
-                printf("\tHours: %u\n", employee_data.hours);
-            }
+        uint64_t before = shown;
+        if (recv_records(fd, chunk, be64toh(chunk_resp->bytes),
+                         "list employees", &shown) == STATUS_ERROR) {
+            return STATUS_ERROR;
+        }
+        if (shown - before != count) {
+            fprintf(stderr,
+                    "Error: list employees chunk announced %lu records, got "
+                    "%lu\n",
+                    (unsigned long)count, (unsigned long)(shown - before));
+            return STATUS_ERROR;
         }
-        printf("----------------------------------\n\n");
-        return STATUS_SUCCESS;
+        fflush(stdout);  // 每块到达后立即输出
+    }
 
-    } else {
-        fprintf(stderr,
-                "Unexpected message type for list employee response: %d\n",
-                hdr->type);
+    if (shown == 0) printf("No employees to list.\n");
+    printf("--- %lu records ---\n", (unsigned long)shown);
+    if (next != DBPROTO_CURSOR_END) {
+        printf("More records remain, continue with -c %lu\n",
+               (unsigned long)next);
+    }
+    printf("\n");
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 客户端发送按名字查找的请求，并显示所有同名的员工。
+ * @param fd 服务器的套接字文件描述符。
+ * @param name 要查找的名字。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_get_by_name_req(int fd, const char *name) {
+    char buf[sizeof(dbproto_hdr_t) +
+             sizeof(dbproto_employee_get_by_name_req_t)] = {0};
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_employee_get_by_name_req_t *name_req =
+        (dbproto_employee_get_by_name_req_t *)(buf + sizeof(dbproto_hdr_t));
+
+    // 检查名字长度是否超出协议限制
+    size_t name_len = strlen(name);
+    if (name_len >= sizeof(name_req->name)) {
+        fprintf(stderr, "Error: Name too long (%zu bytes), max is %zu.\n",
+                name_len, sizeof(name_req->name) - 1);
+        return STATUS_ERROR;
+    }
+
+    // 构造请求头部和请求体
+    hdr->type = MSG_EMPLOYEE_GET_BY_NAME_REQ;
+    hdr->len = sizeof(dbproto_employee_get_by_name_req_t);
+    memcpy(name_req->name, name, name_len + 1);
+
+    // 转换为网络字节序
+    dbproto_hdr_pack(hdr, PROTO_VER, hdr->type, hdr->len);
+
+    if (send_full(fd, buf, sizeof(buf)) == STATUS_ERROR) {
+        perror("send_full get by name request");
         return STATUS_ERROR;
     }
+    return recv_employee_list(fd, MSG_EMPLOYEE_GET_BY_NAME_RESP,
+                              "get employee by name");
+}
+
+/**
+ * @brief 客户端发送按工时范围查找的请求，并按工时升序显示匹配的员工。
+ * @param fd 服务器的套接字文件描述符。
+ * @param min_hours 工时下界（含）。
+ * @param max_hours 工时上界（含）。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_range_hours_req(int fd, uint32_t min_hours, uint32_t max_hours) {
+    char buf[sizeof(dbproto_hdr_t) +
+             sizeof(dbproto_employee_range_hours_req_t)] = {0};
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_employee_range_hours_req_t *range_req =
+        (dbproto_employee_range_hours_req_t *)(buf + sizeof(dbproto_hdr_t));
+
+    // 构造请求头部和请求体
+    hdr->type = MSG_EMPLOYEE_RANGE_HOURS_REQ;
+    hdr->len = sizeof(dbproto_employee_range_hours_req_t);
+    range_req->min_hours = min_hours;
+    range_req->max_hours = max_hours;
+
+    // 转换为网络字节序
+    dbproto_hdr_pack(hdr, PROTO_VER, hdr->type, hdr->len);
+    range_req->min_hours = htonl(range_req->min_hours);
+    range_req->max_hours = htonl(range_req->max_hours);
+
+    if (send_full(fd, buf, sizeof(buf)) == STATUS_ERROR) {
+        perror("send_full range hours request");
+        return STATUS_ERROR;
+    }
+    return recv_employee_list(fd, MSG_EMPLOYEE_RANGE_HOURS_RESP,
+                              "range hours");
+}
+
+/**
+ * @brief 解析 "<min>-<max>" 形式的工时范围。
+ * @param arg 命令行参数。
+ * @param min_hours 输出参数，工时下界。
+ * @param max_hours 输出参数，工时上界。
+ * @return 成功时返回 STATUS_SUCCESS，格式错误时返回 STATUS_ERROR。
+ */
+static int parse_hours_range(const char *arg, uint32_t *min_hours,
+                             uint32_t *max_hours) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long lo = strtoul(arg, &end, 10);
+    if (end == arg || *end != '-' || errno != 0 || lo > UINT32_MAX) {
+        return STATUS_ERROR;
+    }
+    const char *hi_str = end + 1;
+    unsigned long hi = strtoul(hi_str, &end, 10);
+    if (end == hi_str || *end != '\0' || errno != 0 || hi > UINT32_MAX ||
+        lo > hi) {
+        return STATUS_ERROR;
+    }
+    *min_hours = (uint32_t)lo;
+    *max_hours = (uint32_t)hi;
+    return STATUS_SUCCESS;
 }
 
 /**
@@ -284,8 +519,7 @@ int send_remove_employee_req(int fd) {
     hdr->len = 0;  // 删除请求（删除最后一个）没有消息体
 
     // 转换为网络字节序
-    hdr->type = htonl(hdr->type);
-    hdr->len = htons(hdr->len);
+    dbproto_hdr_pack(hdr, PROTO_VER, hdr->type, hdr->len);
 
     // 发送完整的删除员工请求消息
     if (send_full(fd, buf, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
@@ -299,8 +533,7 @@ int send_remove_employee_req(int fd) {
         return STATUS_ERROR;
     }
     // 转换回主机字节序
-    hdr->type = ntohl(hdr->type);
-    hdr->len = ntohs(hdr->len);
+    dbproto_hdr_unpack(hdr, PROTO_VER);
 
     // 根据响应类型处理
     if (hdr->type == MSG_ERROR) {
@@ -340,6 +573,620 @@ int send_remove_employee_req(int fd) {
     }
 }
 
+/**
+ * @brief 接收只包含状态字段的响应（更新、按 id 删除共用）。
+ * @param fd 服务器的套接字文件描述符。
+ * @param resp_type 期望的响应消息类型。
+ * @param what 请求的描述，用于输出信息。
+ * @return 服务器报告成功时返回 STATUS_SUCCESS，否则返回 STATUS_ERROR。
+ */
+static int recv_status_resp(int fd, dbproto_type_e resp_type,
+                            const char *what) {
+    char buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_del_resp_t)];
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_employee_del_resp_t *resp =
+        (dbproto_employee_del_resp_t *)(buf + sizeof(dbproto_hdr_t));
+
+    if (read_full(fd, hdr, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
+        fprintf(stderr, "read_full %s response header failed\n", what);
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(hdr, PROTO_VER);
+
+    if (hdr->type == MSG_ERROR) {
+        printf("Server returned an error for %s.\n", what);
+        return STATUS_ERROR;
+    } else if (hdr->type != resp_type ||
+               hdr->len != sizeof(dbproto_employee_del_resp_t)) {
+        fprintf(stderr, "Unexpected %s response: type %d, len %u\n", what,
+                hdr->type, hdr->len);
+        return STATUS_ERROR;
+    }
+    if (read_full(fd, resp, sizeof(dbproto_employee_del_resp_t)) ==
+        STATUS_ERROR) {
+        fprintf(stderr, "read_full %s response payload failed\n", what);
+        return STATUS_ERROR;
+    }
+    resp->status = ntohl(resp->status);
+    if (resp->status != STATUS_SUCCESS) {
+        fprintf(stderr, "Failed to %s on server (status: %d).\n", what,
+                resp->status);
+        return STATUS_ERROR;
+    }
+    printf("%s succeeded.\n", what);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 客户端发送按 id 更新员工的请求，并接收响应。
+ * @param fd 服务器的套接字文件描述符。
+ * @param id 员工 id（LIST 中显示的 id）。
+ * @param data 格式为 "Name-Address-Hours" 的新内容。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_update_employee_req(int fd, uint32_t id, const char *data) {
+    char buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_update_req_t)] = {
+        0};
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_employee_update_req_t *update_req =
+        (dbproto_employee_update_req_t *)(buf + sizeof(dbproto_hdr_t));
+
+    if (strlen(data) >= MAX_EMPLOYEE_ADD_DATA) {
+        fprintf(stderr,
+                "Error: Employee update string too long, max is %d bytes.\n",
+                MAX_EMPLOYEE_ADD_DATA - 1);
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_UPDATE_REQ,
+                     sizeof(dbproto_employee_update_req_t));
+    update_req->id = htonl(id);
+    strncpy(update_req->data, data, MAX_EMPLOYEE_ADD_DATA - 1);
+
+    if (send_full(fd, buf, sizeof(buf)) == STATUS_ERROR) {
+        perror("send_full update employee request");
+        return STATUS_ERROR;
+    }
+    return recv_status_resp(fd, MSG_EMPLOYEE_UPDATE_RESP, "update employee");
+}
+
+/**
+ * @brief 客户端发送按 id 删除员工的请求，并接收响应。
+ * @param fd 服务器的套接字文件描述符。
+ * @param id 员工 id（LIST 中显示的 id）。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_del_by_id_req(int fd, uint32_t id) {
+    char buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_del_by_id_req_t)] =
+        {0};
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_employee_del_by_id_req_t *del_req =
+        (dbproto_employee_del_by_id_req_t *)(buf + sizeof(dbproto_hdr_t));
+
+    dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_DEL_BY_ID_REQ,
+                     sizeof(dbproto_employee_del_by_id_req_t));
+    del_req->id = htonl(id);
+
+    if (send_full(fd, buf, sizeof(buf)) == STATUS_ERROR) {
+        perror("send_full delete by id request");
+        return STATUS_ERROR;
+    }
+    return recv_status_resp(fd, MSG_EMPLOYEE_DEL_BY_ID_RESP, "delete employee");
+}
+
+/**
+ * @brief 客户端发送按名字删除员工的请求，并显示删除的数量。
+ * @param fd 服务器的套接字文件描述符。
+ * @param name 要删除的名字，所有同名的员工都会被删除。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_del_by_name_req(int fd, const char *name) {
+    char buf[sizeof(dbproto_hdr_t) +
+             sizeof(dbproto_employee_del_by_name_req_t)] = {0};
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    dbproto_employee_del_by_name_req_t *name_req =
+        (dbproto_employee_del_by_name_req_t *)(buf + sizeof(dbproto_hdr_t));
+
+    if (strlen(name) >= sizeof(name_req->name)) {
+        fprintf(stderr, "Error: Name too long, max is %zu bytes.\n",
+                sizeof(name_req->name) - 1);
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_pack(hdr, PROTO_VER, MSG_EMPLOYEE_DEL_BY_NAME_REQ,
+                     sizeof(dbproto_employee_del_by_name_req_t));
+    strncpy(name_req->name, name, sizeof(name_req->name) - 1);
+
+    if (send_full(fd, buf, sizeof(buf)) == STATUS_ERROR) {
+        perror("send_full delete by name request");
+        return STATUS_ERROR;
+    }
+
+    char resp_buf[sizeof(dbproto_hdr_t) +
+                  sizeof(dbproto_employee_del_by_name_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_employee_del_by_name_resp_t *del_resp =
+        (dbproto_employee_del_by_name_resp_t *)(resp_buf +
+                                                sizeof(dbproto_hdr_t));
+    if (read_full(fd, resp_hdr, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
+        perror("read_full delete by name response header");
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(resp_hdr, PROTO_VER);
+
+    if (resp_hdr->type == MSG_ERROR) {
+        printf("Server returned an error for delete by name.\n");
+        return STATUS_ERROR;
+    } else if (resp_hdr->type != MSG_EMPLOYEE_DEL_BY_NAME_RESP ||
+               resp_hdr->len != sizeof(dbproto_employee_del_by_name_resp_t)) {
+        fprintf(stderr, "Unexpected delete by name response: type %d, len %u\n",
+                resp_hdr->type, resp_hdr->len);
+        return STATUS_ERROR;
+    }
+    if (read_full(fd, del_resp, sizeof(dbproto_employee_del_by_name_resp_t)) ==
+        STATUS_ERROR) {
+        perror("read_full delete by name response payload");
+        return STATUS_ERROR;
+    }
+    del_resp->status = ntohl(del_resp->status);
+    del_resp->count = ntohl(del_resp->count);
+    printf("Deleted %u employees named '%s'.\n", del_resp->count, name);
+    if (del_resp->status != STATUS_SUCCESS) {
+        fprintf(stderr, "Failed to delete all employees named '%s'.\n", name);
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 客户端请求服务器做一次在线快照，并显示快照对应的时刻。
+ *        服务器在后台写出镜像，<db>.snap.sum 出现时快照才算完整。
+ * @param fd 服务器的套接字文件描述符。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_snapshot_req(int fd) {
+    dbproto_hdr_t hdr;
+    dbproto_hdr_pack(&hdr, PROTO_VER, MSG_SNAPSHOT_REQ,
+                     sizeof(dbproto_snapshot_req_t));
+    if (send_full(fd, &hdr, sizeof(hdr)) == STATUS_ERROR) {
+        perror("send_full snapshot request");
+        return STATUS_ERROR;
+    }
+
+    if (read_full(fd, &hdr, sizeof(hdr)) == STATUS_ERROR) {
+        perror("read_full snapshot response header");
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(&hdr, PROTO_VER);
+    if (hdr.type == MSG_ERROR) {
+        printf("Server returned an error for snapshot.\n");
+        return STATUS_ERROR;
+    } else if (hdr.type != MSG_SNAPSHOT_RESP ||
+               hdr.len != sizeof(dbproto_snapshot_resp_t)) {
+        fprintf(stderr, "Unexpected snapshot response: type %d, len %u\n",
+                hdr.type, hdr.len);
+        return STATUS_ERROR;
+    }
+    dbproto_snapshot_resp_t resp;
+    if (read_full(fd, &resp, sizeof(resp)) == STATUS_ERROR) {
+        perror("read_full snapshot response payload");
+        return STATUS_ERROR;
+    }
+    if ((int)ntohl(resp.status) != STATUS_SUCCESS) {
+        fprintf(stderr, "Failed to start snapshot on server.\n");
+        return STATUS_ERROR;
+    }
+    printf("Snapshot in progress: LSN %lu, %lu slots, %lu bytes.\n",
+           (unsigned long)be64toh(resp.lsn), (unsigned long)be64toh(resp.count),
+           (unsigned long)be64toh(resp.bytes));
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 客户端查询服务器的复制状态：角色、已落盘或已应用的 LSN，
+ *        以及（最慢的）副本落后主库的程度。
+ * @param fd 服务器的套接字文件描述符。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_repl_stats_req(int fd) {
+    dbproto_hdr_t hdr;
+    dbproto_hdr_pack(&hdr, PROTO_VER, MSG_REPL_STATS_REQ,
+                     sizeof(dbproto_repl_stats_req_t));
+    if (send_full(fd, &hdr, sizeof(hdr)) == STATUS_ERROR) {
+        perror("send_full replication stats request");
+        return STATUS_ERROR;
+    }
+
+    if (read_full(fd, &hdr, sizeof(hdr)) == STATUS_ERROR) {
+        perror("read_full replication stats response header");
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(&hdr, PROTO_VER);
+    if (hdr.type == MSG_ERROR) {
+        printf("Server returned an error for replication stats.\n");
+        return STATUS_ERROR;
+    } else if (hdr.type != MSG_REPL_STATS_RESP ||
+               hdr.len != sizeof(dbproto_repl_stats_resp_t)) {
+        fprintf(stderr,
+                "Unexpected replication stats response: type %d, len %u\n",
+                hdr.type, hdr.len);
+        return STATUS_ERROR;
+    }
+    dbproto_repl_stats_resp_t resp;
+    if (read_full(fd, &resp, sizeof(resp)) == STATUS_ERROR) {
+        perror("read_full replication stats response payload");
+        return STATUS_ERROR;
+    }
+    if (ntohl(resp.role) == REPL_ROLE_PRIMARY) {
+        printf("Role: primary, %u replica(s) connected, durable LSN %lu\n",
+               ntohl(resp.links), (unsigned long)be64toh(resp.lsn));
+        printf("Slowest replica: %lu LSN behind, for %lu ms\n",
+               (unsigned long)be64toh(resp.lag_lsn),
+               (unsigned long)be64toh(resp.lag_ms));
+    } else {
+        printf("Role: replica (%s), applied LSN %lu, primary LSN %lu\n",
+               ntohl(resp.links) ? "streaming" : "disconnected",
+               (unsigned long)be64toh(resp.lsn),
+               (unsigned long)be64toh(resp.primary_lsn));
+        printf("Lag: %lu LSN, for %lu ms\n",
+               (unsigned long)be64toh(resp.lag_lsn),
+               (unsigned long)be64toh(resp.lag_ms));
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 请求类型的简短名称，用于打印服务器统计。
+ * @param type 消息类型。
+ * @return 名称，未知类型返回 "?"。
+ */
+static const char *msg_type_name(uint32_t type) {
+    static const char *const names[MSG_MAX] = {
+        [MSG_HELLO_REQ] = "hello",
+        [MSG_EMPLOYEE_LIST_REQ] = "list",
+        [MSG_EMPLOYEE_ADD_REQ] = "add",
+        [MSG_EMPLOYEE_DEL_REQ] = "remove",
+        [MSG_EMPLOYEE_GET_BY_NAME_REQ] = "get_by_name",
+        [MSG_EMPLOYEE_RANGE_HOURS_REQ] = "range_hours",
+        [MSG_EMPLOYEE_UPDATE_REQ] = "update",
+        [MSG_EMPLOYEE_DEL_BY_ID_REQ] = "del_by_id",
+        [MSG_EMPLOYEE_DEL_BY_NAME_REQ] = "del_by_name",
+        [MSG_EMPLOYEE_LIST_PAGE_REQ] = "list_page",
+        [MSG_BATCH_REQ] = "batch",
+        [MSG_EMPLOYEE_ADD_V2_REQ] = "add_v2",
+        [MSG_SNAPSHOT_REQ] = "snapshot",
+        [MSG_REPL_SYNC_REQ] = "repl_sync",
+        [MSG_REPL_ACK] = "repl_ack",
+        [MSG_REPL_STATS_REQ] = "repl_stats",
+        [MSG_STATS_REQ] = "stats",
+    };
+    return type < MSG_MAX && names[type] != NULL ? names[type] : "?";
+}
+
+/**
+ * @brief 客户端查询服务器统计：连接、流量、事件循环与组提交的计数，
+ *        以及每种请求的处理时间分布。
+ * @param fd 服务器的套接字文件描述符。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int send_stats_req(int fd) {
+    dbproto_hdr_t hdr;
+    dbproto_hdr_pack(&hdr, PROTO_VER, MSG_STATS_REQ,
+                     sizeof(dbproto_stats_req_t));
+    if (send_full(fd, &hdr, sizeof(hdr)) == STATUS_ERROR) {
+        perror("send_full stats request");
+        return STATUS_ERROR;
+    }
+
+    if (read_full(fd, &hdr, sizeof(hdr)) == STATUS_ERROR) {
+        perror("read_full stats response header");
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(&hdr, PROTO_VER);
+    if (hdr.type == MSG_ERROR) {
+        printf("Server returned an error for stats.\n");
+        return STATUS_ERROR;
+    } else if (hdr.type != MSG_STATS_RESP ||
+               hdr.len < sizeof(dbproto_stats_resp_t) ||
+               hdr.len > sizeof(dbproto_stats_resp_t) +
+                             MSG_MAX * sizeof(dbproto_stats_op_t)) {
+        fprintf(stderr, "Unexpected stats response: type %d, len %u\n",
+                hdr.type, hdr.len);
+        return STATUS_ERROR;
+    }
+    dbproto_stats_resp_t resp;
+    dbproto_stats_op_t ops[MSG_MAX];
+    if (read_full(fd, &resp, sizeof(resp)) == STATUS_ERROR ||
+        read_full(fd, ops, hdr.len - sizeof(resp)) == STATUS_ERROR) {
+        perror("read_full stats response payload");
+        return STATUS_ERROR;
+    }
+    uint32_t ntypes = ntohl(resp.ntypes);
+    if (sizeof(resp) + ntypes * sizeof(dbproto_stats_op_t) != hdr.len) {
+        fprintf(stderr, "Stats response has %u types but len %u\n", ntypes,
+                hdr.len);
+        return STATUS_ERROR;
+    }
+
+    uint64_t commits = be64toh(resp.commits);
+    printf("Uptime: %lu ms, %u reactor(s)\n",
+           (unsigned long)be64toh(resp.uptime_ms), ntohl(resp.reactors));
+    printf("Connections: %lu open, %lu accepted; %lu errors\n",
+           (unsigned long)be64toh(resp.conns_open),
+           (unsigned long)be64toh(resp.conns_accepted),
+           (unsigned long)be64toh(resp.errors));
+    printf("Traffic: %lu bytes in, %lu bytes out\n",
+           (unsigned long)be64toh(resp.bytes_in),
+           (unsigned long)be64toh(resp.bytes_out));
+    printf("Event loop: %lu iterations, mean %lu ns, p99 %lu ns, max %lu ns; "
+           "%lu events (max %lu per iteration)\n",
+           (unsigned long)be64toh(resp.loop_iters),
+           (unsigned long)be64toh(resp.loop_mean_ns),
+           (unsigned long)be64toh(resp.loop_p99_ns),
+           (unsigned long)be64toh(resp.loop_max_ns),
+           (unsigned long)be64toh(resp.events),
+           (unsigned long)be64toh(resp.events_max));
+    printf("Group commit: %lu commits, %.2f waiters per commit (max %lu)\n",
+           (unsigned long)commits,
+           commits ? (double)be64toh(resp.commit_waiters) / commits : 0.0,
+           (unsigned long)be64toh(resp.commit_waiters_max));
+    printf("%-12s %10s %10s %10s %10s %10s %10s %10s\n", "request", "count",
+           "mean_us", "p50_us", "p90_us", "p99_us", "p99.9_us", "max_us");
+    for (uint32_t i = 0; i < ntypes; i++) {
+        dbproto_stats_op_t *op = &ops[i];
+        printf("%-12s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+               msg_type_name(ntohl(op->type)),
+               (unsigned long)be64toh(op->count),
+               be64toh(op->mean_ns) / 1e3, be64toh(op->p50_ns) / 1e3,
+               be64toh(op->p90_ns) / 1e3, be64toh(op->p99_ns) / 1e3,
+               be64toh(op->p999_ns) / 1e3, be64toh(op->max_ns) / 1e3);
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 解析员工 id。
+ * @param arg 命令行参数。
+ * @param id 输出参数，员工 id。
+ * @return 成功时返回 STATUS_SUCCESS，格式错误时返回 STATUS_ERROR。
+ */
+static int parse_id(const char *arg, uint32_t *id) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long val = strtoul(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno != 0 || val > UINT32_MAX) {
+        return STATUS_ERROR;
+    }
+    *id = (uint32_t)val;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 批量导入时同时在途的批量请求数（流水线深度）
+ */
+#define BATCH_WINDOW 32
+
+/**
+ * @brief 用于 GCC cleanup 属性的内联函数：关闭文件
+ * @param p_fp 指向 FILE 指针的指针
+ */
+static inline void _cleanup_file_(FILE **p_fp) {
+    if (*p_fp != NULL) {
+        fclose(*p_fp);
+        *p_fp = NULL;
+    }
+}
+
+/**
+ * @brief 正在构造或等待响应的一个批量请求。
+ */
+typedef struct {
+    char buf[CLIENT_BUFFER_SIZE];          ///< 完整的请求消息
+    size_t len;                            ///< 请求消息的长度
+    uint32_t count;                        ///< 操作数
+    size_t lines[DBPROTO_BATCH_MAX_OPS];  ///< 每个操作来自的行号
+} batch_frame_t;
+
+/**
+ * @brief 把 CSV 的一行 "name,address,hours" 解析为员工记录，
+ *        去掉行尾的换行符。名字与地址中不能有 ','，可以有 '-'。
+ * @param line CSV 行，会被修改。
+ * @param employeeOut 输出参数，员工记录（hours 为主机字节序）。
+ * @return 成功时返回 1，空行返回 0，格式错误时返回 -1。
+ */
+static int csv_to_employee(char *line, struct employee_t *employeeOut) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0') return 0;
+
+    char *address = strchr(line, ',');
+    if (address == NULL) return -1;
+    *address++ = '\0';
+    char *hours = strchr(address, ',');
+    if (hours == NULL) return -1;
+    *hours++ = '\0';
+
+    size_t name_len = strlen(line);
+    size_t address_len = strlen(address);
+    if (name_len == 0 || name_len >= sizeof(employeeOut->name) ||
+        address_len == 0 || address_len >= sizeof(employeeOut->address) ||
+        hours[0] == '\0' || hours[strspn(hours, "0123456789")] != '\0') {
+        return -1;
+    }
+    errno = 0;
+    unsigned long value = strtoul(hours, NULL, 10);
+    if (errno == ERANGE || value > UINT32_MAX) return -1;
+
+    memset(employeeOut, 0, sizeof(*employeeOut));
+    memcpy(employeeOut->name, line, name_len);
+    memcpy(employeeOut->address, address, address_len);
+    employeeOut->hours = (uint32_t)value;
+    return 1;
+}
+
+/**
+ * @brief 接收一个批量操作响应。
+ * @param fd 服务器的套接字文件描述符。
+ * @param frame 对应的批量请求，用于把失败的操作对应到行号。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int recv_batch_resp(int fd, const batch_frame_t *frame) {
+    char buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_batch_resp_t)];
+    dbproto_hdr_t *hdr = (dbproto_hdr_t *)buf;
+    if (read_full(fd, buf, sizeof(dbproto_hdr_t)) == STATUS_ERROR) {
+        perror("read_full batch response header");
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(hdr, PROTO_VER);
+    if (hdr->type == MSG_ERROR) {
+        printf("Server returned an error for batch.\n");
+        return STATUS_ERROR;
+    } else if (hdr->type != MSG_BATCH_RESP ||
+               hdr->len != sizeof(dbproto_batch_resp_t)) {
+        fprintf(stderr, "Unexpected batch response: type %d, len %u\n",
+                hdr->type, hdr->len);
+        return STATUS_ERROR;
+    }
+
+    dbproto_batch_resp_t *batch_resp =
+        (dbproto_batch_resp_t *)(buf + sizeof(dbproto_hdr_t));
+    if (read_full(fd, batch_resp, sizeof(*batch_resp)) == STATUS_ERROR) {
+        perror("read_full batch response");
+        return STATUS_ERROR;
+    }
+    if ((int)ntohl(batch_resp->status) != STATUS_SUCCESS) {
+        uint32_t failed = ntohl(batch_resp->failed);
+        if (failed < frame->count) {
+            fprintf(stderr, "Batch rejected at line %zu, nothing from lines "
+                            "%zu-%zu was added.\n",
+                    frame->lines[failed], frame->lines[0],
+                    frame->lines[frame->count - 1]);
+        } else {
+            fprintf(stderr, "Batch for lines %zu-%zu failed on the server.\n",
+                    frame->lines[0], frame->lines[frame->count - 1]);
+        }
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 从 CSV 文件批量导入员工。每行为 "name,address,hours"，空行被跳过。
+ *        每 DBPROTO_BATCH_MAX_OPS 行（或请求放满时）组成一个原子的批量请求，
+ *        最多 BATCH_WINDOW 个请求同时在途，不必等待每个请求的往返。
+ *        某个批量失败后不再发送新的请求，已经在途的请求照常完成。
+ * @param fd 服务器的套接字文件描述符。
+ * @param path CSV 文件路径。
+ * @return 全部导入成功时返回 STATUS_SUCCESS，否则返回 STATUS_ERROR。
+ */
+int send_batch_file(int fd, const char *path) {
+    FILE *fp __attribute__((cleanup(_cleanup_file_))) = fopen(path, "r");
+    if (fp == NULL) {
+        perror("fopen batch file");
+        return STATUS_ERROR;
+    }
+    batch_frame_t *frames __attribute__((cleanup(_cleanup_ptr_))) =
+        calloc(BATCH_WINDOW, sizeof(batch_frame_t));
+    if (frames == NULL) {
+        perror("calloc for batch frames");
+        return STATUS_ERROR;
+    }
+
+    char line[MAX_EMPLOYEE_ADD_DATA + 2];
+    struct employee_t employee;
+    size_t lineno = 0;
+    size_t sent = 0;   // 已发送的请求数，frames[sent % BATCH_WINDOW] 正在构造
+    size_t acked = 0;  // 已收到响应的请求数
+    uint64_t added = 0;
+    bool eof = false;
+    int status = STATUS_SUCCESS;
+
+    while (!eof || acked < sent) {
+        // 构造并发送下一个请求，直到窗口已满
+        while (!eof && status == STATUS_SUCCESS &&
+               sent - acked < BATCH_WINDOW) {
+            batch_frame_t *frame = &frames[sent % BATCH_WINDOW];
+            frame->len = sizeof(dbproto_hdr_t) + sizeof(dbproto_batch_req_t);
+            frame->count = 0;
+            while (frame->count < DBPROTO_BATCH_MAX_OPS) {
+                // 当前请求放不下最长的一行时先发送
+                if (frame->len + sizeof(dbproto_batch_op_t) +
+                        MAX_EMPLOYEE_ADD_DATA >
+                    sizeof(frame->buf)) {
+                    break;
+                }
+                if (fgets(line, sizeof(line), fp) == NULL) {
+                    eof = true;
+                    break;
+                }
+                lineno++;
+                int parsed = csv_to_employee(line, &employee);
+                if (parsed == 0) continue;
+                if (parsed < 0) {
+                    fprintf(stderr,
+                            "Error: Line %zu is not 'name,address,hours'.\n",
+                            lineno);
+                    status = STATUS_ERROR;
+                    eof = true;
+                    break;
+                }
+                char *arg =
+                    frame->buf + frame->len + sizeof(dbproto_batch_op_t);
+                size_t len = pack_employee_fields(&employee, arg);
+                dbproto_batch_op_t op_hdr = {.op = BATCH_OP_ADD_V2,
+                                             .len = htons((uint16_t)len)};
+                memcpy(frame->buf + frame->len, &op_hdr, sizeof(op_hdr));
+                frame->len += sizeof(op_hdr) + len;
+                frame->lines[frame->count++] = lineno;
+            }
+            if (frame->count == 0 || status != STATUS_SUCCESS) break;
+
+            dbproto_hdr_pack((dbproto_hdr_t *)frame->buf, PROTO_VER,
+                             MSG_BATCH_REQ,
+                             (uint32_t)(frame->len - sizeof(dbproto_hdr_t)));
+            dbproto_batch_req_t req = {.count = htonl(frame->count)};
+            memcpy(frame->buf + sizeof(dbproto_hdr_t), &req, sizeof(req));
+            if (send_full(fd, frame->buf, frame->len) == STATUS_ERROR) {
+                perror("send_full batch request");
+                return STATUS_ERROR;
+            }
+            sent++;
+        }
+        if (acked == sent) break;
+
+        // 按发送顺序接收最早的一个响应
+        const batch_frame_t *frame = &frames[acked % BATCH_WINDOW];
+        if (recv_batch_resp(fd, frame) == STATUS_SUCCESS) {
+            added += frame->count;
+        } else {
+            status = STATUS_ERROR;
+            eof = true;  // 不再发送新的请求
+        }
+        acked++;
+    }
+    if (ferror(fp)) {
+        perror("read batch file");
+        status = STATUS_ERROR;
+    }
+    printf("Added %lu employees from '%s' in %zu batches.\n",
+           (unsigned long)added, path, acked);
+    return status;
+}
+
+/**
+ * @brief 解析非负整数形式的续传令牌或记录数。
+ * @param arg 命令行参数。
+ * @param val 输出参数，解析结果。
+ * @return 成功时返回 STATUS_SUCCESS，格式错误时返回 STATUS_ERROR。
+ */
+static int parse_u64(const char *arg, uint64_t *val) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno != 0 || arg[0] == '-') {
+        return STATUS_ERROR;
+    }
+    *val = (uint64_t)v;
+    return STATUS_SUCCESS;
+}
+
 /**
  * @brief 客户端程序主函数。
  *        解析命令行参数，连接服务器，并根据参数执行指定操作。
@@ -354,12 +1201,29 @@ int main(int argc, char *argv[]) {
     char *portarg = NULL, *hostarg = NULL;
     unsigned short port = 0;
     bool list_flag = false;    // 标志：是否执行列出员工操作
+    bool page_flag = false;    // 标志：是否给出了 -c 或 -m
+    uint64_t cursor = 0;       // 列出员工的续传令牌
+    uint64_t limit = 0;        // 列出员工的最大记录数，0 表示不限
     bool remove_flag = false;  // 标志：是否执行删除员工操作
+    char *namearg = NULL;      // 按名字查找的名字
+    char *rangearg = NULL;     // 按工时范围查找的 "<min>-<max>"
+    uint32_t min_hours = 0, max_hours = 0;
+    char *updatearg = NULL;    // 按 id 更新的 id，新内容由 -a 给出
+    char *delidarg = NULL;     // 按 id 删除的 id
+    char *delnamearg = NULL;   // 按名字删除的名字
+    char *batcharg = NULL;     // 批量导入的 CSV 文件
+    bool snap_flag = false;    // 标志：是否请求在线快照
+    bool repl_flag = false;    // 标志：是否查询复制状态
+    bool stats_flag = false;   // 标志：是否查询服务器统计
+    uint32_t id = 0;
 
     int c;
     // 解析命令行参数：支持 -p (端口), -h (主机), -a (添加), -l (列出), -r
-    // (删除)
-    while ((c = getopt(argc, argv, "p:h:a:lr")) != -1) {
+    // (删除), -n (按名字查找), -w (按工时范围查找), -u (按 id 更新),
+    // -d (按 id 删除), -D (按名字删除), -c/-m (列出的续传令牌/最大记录数),
+    // -b (从 CSV 文件批量导入), -S (在线快照), -L (复制状态),
+    // -s (服务器统计)
+    while ((c = getopt(argc, argv, "p:h:a:lrn:w:u:d:D:c:m:b:SLs")) != -1) {
         switch (c) {
             case 'a':  // 添加员工
                 addarg = optarg;
@@ -374,9 +1238,62 @@ int main(int argc, char *argv[]) {
             case 'l':  // 列出员工
                 list_flag = true;
                 break;
+            case 'c':  // 列出员工的续传令牌
+            case 'm':  // 列出员工的最大记录数
+                if (parse_u64(optarg, c == 'c' ? &cursor : &limit) !=
+                    STATUS_SUCCESS) {
+                    fprintf(stderr, "Error: -%c expects a number, got '%s'\n",
+                            c, optarg);
+                    return STATUS_ERROR;
+                }
+                page_flag = true;
+                break;
             case 'r':  // 删除员工
                 remove_flag = true;
                 break;
+            case 'n':  // 按名字查找
+                namearg = optarg;
+                break;
+            case 'w':  // 按工时范围查找
+                rangearg = optarg;
+                if (parse_hours_range(rangearg, &min_hours, &max_hours) !=
+                    STATUS_SUCCESS) {
+                    fprintf(stderr,
+                            "Error: -w expects a range '<min>-<max>', got "
+                            "'%s'\n",
+                            rangearg);
+                    return STATUS_ERROR;
+                }
+                break;
+            case 'u':  // 按 id 更新
+            case 'd':  // 按 id 删除
+                if (parse_id(optarg, &id) != STATUS_SUCCESS) {
+                    fprintf(stderr, "Error: -%c expects an employee id, got "
+                                    "'%s'\n",
+                            c, optarg);
+                    return STATUS_ERROR;
+                }
+                if (c == 'u') {
+                    updatearg = optarg;
+                } else {
+                    delidarg = optarg;
+                }
+                break;
+            case 'D':  // 按名字删除
+                delnamearg = optarg;
+                break;
+            case 'b':  // 从 CSV 文件批量导入
+                batcharg = optarg;
+                break;
+            case 'S':  // 在线快照
+                snap_flag = true;
+                break;
+            case 'L':  // 复制状态
+                repl_flag = true;
+                break;
+            case 's':  // 服务器统计
+                stats_flag = true;
+                break;
             case '?':  // 未知选项
                 fprintf(stderr, "Error: Unknown option '-%c'\n", optopt);
                 return STATUS_ERROR;
@@ -384,16 +1301,30 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // 检查客户端操作的有效性：只能执行一个操作
-    int action_count = (addarg != NULL) + list_flag + remove_flag;
+    // 检查客户端操作的有效性：只能执行一个操作（-u 与 -a 一起构成更新）
+    if (updatearg != NULL && addarg == NULL) {
+        fprintf(stderr, "Error: -u requires the new data with -a.\n");
+        return STATUS_ERROR;
+    }
+    if (page_flag && !list_flag) {
+        fprintf(stderr, "Error: -c and -m can only be used with -l.\n");
+        return STATUS_ERROR;
+    }
+    int action_count = (addarg != NULL) + list_flag + remove_flag +
+                       (namearg != NULL) + (rangearg != NULL) +
+                       (delidarg != NULL) + (delnamearg != NULL) +
+                       (batcharg != NULL) + snap_flag + repl_flag +
+                       stats_flag;
     if (action_count > 1) {
         fprintf(stderr,
-                "Error: Client can only perform one action at a time (-a, -l, "
-                "or -r).\n");
+                "Error: Client can only perform one action at a time (-a, -u "
+                "-a, -l, -r, -n, -w, -d, -D, -b, -S, -L, or -s).\n");
         return STATUS_ERROR;
     }
     if (action_count == 0) {
-        fprintf(stderr, "Error: No action specified (-a, -l, or -r).\n");
+        fprintf(stderr,
+                "Error: No action specified (-a, -u -a, -l, -r, -n, -w, -d, "
+                "-D, -b, -S, -L, or -s).\n");
         return STATUS_ERROR;
     }
 
@@ -438,18 +1369,54 @@ int main(int argc, char *argv[]) {
     if (send_hello(fd) != STATUS_SUCCESS) { return STATUS_ERROR; }
 
     // 根据命令行参数执行相应的操作
-    if (addarg) {
+    if (updatearg) {
+        if (send_update_employee_req(fd, id, addarg) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (addarg) {
         if (send_add_employee_req(fd, addarg) != STATUS_SUCCESS) {
             return STATUS_ERROR;
         }
     } else if (list_flag) {
-        if (send_list_employee_req(fd) != STATUS_SUCCESS) {
+        if (send_list_employee_req(fd, cursor, limit) != STATUS_SUCCESS) {
             return STATUS_ERROR;
         }
     } else if (remove_flag) {
         if (send_remove_employee_req(fd) != STATUS_SUCCESS) {
             return STATUS_ERROR;
         }
+    } else if (namearg) {
+        if (send_get_by_name_req(fd, namearg) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (rangearg) {
+        if (send_range_hours_req(fd, min_hours, max_hours) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (delidarg) {
+        if (send_del_by_id_req(fd, id) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (delnamearg) {
+        if (send_del_by_name_req(fd, delnamearg) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (batcharg) {
+        if (send_batch_file(fd, batcharg) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (snap_flag) {
+        if (send_snapshot_req(fd) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (repl_flag) {
+        if (send_repl_stats_req(fd) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    } else if (stats_flag) {
+        if (send_stats_req(fd) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
     }
 
     printf("Client operations finished.\n");
@@ -0,0 +1,76 @@
+#include "../../include/checksum.h"  // 包含 crc32c 声明
+
+#include <stddef.h>  // For size_t
+#include <stdint.h>  // For uint32_t
+
+/**
+ * @brief CRC32C 的反射多项式 (Castagnoli)
+ */
+#define CRC32C_POLY 0x82F63B78u
+
+// 按字节查表法使用的 256 项查找表，在程序启动时生成
+static uint32_t crc32c_table[256];
+
+/**
+ * @brief 计算 CRC32C 校验和（查表法，每次处理一个字节），不支持
+ *        CRC32 指令的 CPU 使用。参数与返回值同 crc32c，但不做取反。
+ */
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len) {
+    while (len--) { crc = crc32c_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8); }
+    return crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief 用 SSE4.2 的 CRC32 指令计算（多项式正是 Castagnoli），
+ *        每条指令处理 8 字节，比查表快一个数量级。不做取反。
+ */
+__attribute__((target("sse4.2"))) static uint32_t crc32c_hw(
+    uint32_t crc, const unsigned char *p, size_t len) {
+    uint64_t c = crc;
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+        len--;
+    }
+    for (; len >= 8; len -= 8, p += 8) {
+        uint64_t word;
+        __builtin_memcpy(&word, p, sizeof(word));
+        c = __builtin_ia32_crc32di(c, word);
+    }
+    while (len--) c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+    return (uint32_t)c;
+}
+#endif
+
+// 启动时按 CPU 选择的实现
+static uint32_t (*crc32c_impl)(uint32_t, const unsigned char *,
+                               size_t) = crc32c_sw;
+
+/**
+ * @brief 生成 CRC32C 查找表，CPU 支持 SSE4.2 时改用 CRC32 指令。
+ *        使用 GCC constructor 属性，在 main 之前执行，避免运行时的竞态。
+ */
+__attribute__((constructor)) static void crc32c_init_table(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        crc32c_table[i] = crc;
+    }
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) crc32c_impl = crc32c_hw;
+#endif
+}
+
+/**
+ * @brief 计算 CRC32C 校验和。
+ * @param crc 初始校验值，首次计算传 0
+ * @param buf 数据缓冲区
+ * @param len 数据长度，单位字节
+ * @return 累加后的 CRC32C 值
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    return ~crc32c_impl(~crc, (const unsigned char *)buf, len);
+}
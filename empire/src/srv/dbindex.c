@@ -0,0 +1,627 @@
+#include "../../include/dbindex.h"  // 包含 dbindex_t 声明
+
+#include <fcntl.h>   // For open, O_RDONLY, O_WRONLY, O_CREAT
+#include <limits.h>  // For PATH_MAX
+#include <stdio.h>   // For perror, fprintf, snprintf
+#include <stdlib.h>  // For malloc, realloc, free, qsort
+#include <string.h>  // For memcpy, memmove, memset, memcmp, strnlen
+#include <unistd.h>  // For close, fsync
+
+#include "../../include/common.h"  // 包含 STATUS_SUCCESS 等宏
+#include "../../include/file.h"  // 包含 fsync_parent_dir, write_all, read_all
+
+/**
+ * @brief 员工名字字段的长度
+ */
+#define NAME_LEN sizeof(((struct employee_t *)0)->name)
+
+/**
+ * @brief 计算名字的 FNV-1a 哈希。
+ */
+static uint32_t name_hash(const char *name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief 向查询结果追加一个记录下标，按倍数扩容。
+ */
+static int result_push(dbindex_result_t *out, uint32_t slot) {
+    if (out->len == out->cap) {
+        size_t cap = out->cap ? out->cap * 2 : 16;
+        uint32_t *slots = realloc(out->slots, cap * sizeof(uint32_t));
+        if (slots == NULL) {
+            perror("realloc for index result");
+            return STATUS_ERROR;
+        }
+        out->slots = slots;
+        out->cap = cap;
+    }
+    out->slots[out->len++] = slot;
+    return STATUS_SUCCESS;
+}
+
+/* ---------------- name 上的开放寻址哈希表 ---------------- */
+
+/**
+ * @brief 容纳 n 个条目所需的哈希表容量，负载因子不超过 1/2。
+ */
+static size_t names_capacity_for(size_t n) {
+    size_t cap = DBINDEX_MIN_BUCKETS;
+    while (cap < n * 2) cap *= 2;
+    return cap;
+}
+
+/**
+ * @brief 把哈希表重建为 nbuckets 个槽位，同时清除所有墓碑。
+ */
+static int names_rehash(dbindex_t *idx, size_t nbuckets) {
+    dbindex_bucket_t *buckets = malloc(nbuckets * sizeof(dbindex_bucket_t));
+    if (buckets == NULL) {
+        perror("malloc for name index");
+        return STATUS_ERROR;
+    }
+    for (size_t i = 0; i < nbuckets; i++) buckets[i].slot = DBINDEX_EMPTY;
+
+    size_t mask = nbuckets - 1;
+    for (size_t i = 0; i < idx->nbuckets; i++) {
+        dbindex_bucket_t b = idx->buckets[i];
+        if (b.slot == DBINDEX_EMPTY || b.slot == DBINDEX_TOMBSTONE) continue;
+        size_t j = b.hash & mask;
+        while (buckets[j].slot != DBINDEX_EMPTY) j = (j + 1) & mask;
+        buckets[j] = b;
+    }
+    free(idx->buckets);
+    idx->buckets = buckets;
+    idx->nbuckets = nbuckets;
+    idx->filled = idx->used;
+    return STATUS_SUCCESS;
+}
+
+static int names_insert(dbindex_t *idx, uint32_t slot, uint32_t hash) {
+    if ((idx->filled + 1) * 2 > idx->nbuckets &&
+        names_rehash(idx, names_capacity_for(idx->used + 1)) !=
+            STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+
+    // 复用探测路径上的第一个墓碑；查找会越过墓碑，因此同名条目仍能找到
+    size_t mask = idx->nbuckets - 1;
+    size_t i = hash & mask;
+    while (idx->buckets[i].slot != DBINDEX_EMPTY &&
+           idx->buckets[i].slot != DBINDEX_TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (idx->buckets[i].slot == DBINDEX_EMPTY) idx->filled++;
+    idx->buckets[i].slot = slot;
+    idx->buckets[i].hash = hash;
+    idx->used++;
+    return STATUS_SUCCESS;
+}
+
+static void names_remove(dbindex_t *idx, uint32_t slot, uint32_t hash) {
+    if (idx->nbuckets == 0) return;
+    size_t mask = idx->nbuckets - 1;
+    for (size_t i = hash & mask; idx->buckets[i].slot != DBINDEX_EMPTY;
+         i = (i + 1) & mask) {
+        if (idx->buckets[i].slot == slot) {
+            idx->buckets[i].slot = DBINDEX_TOMBSTONE;
+            idx->used--;
+            return;
+        }
+    }
+}
+
+/* ---------------- hours 上的 B+ 树 ---------------- */
+
+/**
+ * @brief 确保空闲链表中至少有 n 个节点。插入前按最坏情况（每层都分裂
+ *        再加一个新根）预留，插入过程本身不会因内存不足而中途失败。
+ */
+static int reserve_nodes(dbindex_t *idx, size_t n) {
+    while (idx->nspare < n) {
+        dbindex_node_t *node = malloc(sizeof(dbindex_node_t));
+        if (node == NULL) {
+            perror("malloc for index node");
+            return STATUS_ERROR;
+        }
+        node->next = idx->spare;
+        idx->spare = node;
+        idx->nspare++;
+    }
+    return STATUS_SUCCESS;
+}
+
+static dbindex_node_t *node_take(dbindex_t *idx, bool leaf) {
+    dbindex_node_t *node = idx->spare;
+    idx->spare = node->next;
+    idx->nspare--;
+    memset(node, 0, sizeof(*node));
+    node->leaf = leaf;
+    return node;
+}
+
+static void free_tree(dbindex_node_t *node) {
+    if (node == NULL) return;
+    if (!node->leaf) {
+        for (size_t i = 0; i <= node->n; i++) free_tree(node->child[i]);
+    }
+    free(node);
+}
+
+/**
+ * @brief 第一个不小于 key 的位置。
+ */
+static size_t lower_bound(const uint64_t *keys, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief 第一个大于 key 的位置，即内部节点中应下降的子节点下标。
+ */
+static size_t upper_bound(const uint64_t *keys, size_t n, uint64_t key) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (keys[mid] <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief 把 key 插入以 node 为根的子树。节点满时分裂，
+ *        通过 up_key/up_node 把新的右兄弟交给父节点。
+ */
+static void node_insert(dbindex_t *idx, dbindex_node_t *node, uint64_t key,
+                        uint64_t *up_key, dbindex_node_t **up_node) {
+    *up_node = NULL;
+    if (node->leaf) {
+        size_t pos = lower_bound(node->keys, node->n, key);
+        memmove(&node->keys[pos + 1], &node->keys[pos],
+                (node->n - pos) * sizeof(uint64_t));
+        node->keys[pos] = key;
+        node->n++;
+        if (node->n < DBINDEX_BTREE_ORDER) return;
+
+        dbindex_node_t *right = node_take(idx, true);
+        size_t mid = node->n / 2;
+        right->n = node->n - mid;
+        memcpy(right->keys, &node->keys[mid], right->n * sizeof(uint64_t));
+        node->n = mid;
+        right->next = node->next;
+        node->next = right;
+        *up_key = right->keys[0];
+        *up_node = right;
+        return;
+    }
+
+    size_t i = upper_bound(node->keys, node->n, key);
+    uint64_t child_key;
+    dbindex_node_t *child_right;
+    node_insert(idx, node->child[i], key, &child_key, &child_right);
+    if (child_right == NULL) return;
+
+    memmove(&node->keys[i + 1], &node->keys[i],
+            (node->n - i) * sizeof(uint64_t));
+    memmove(&node->child[i + 2], &node->child[i + 1],
+            (node->n - i) * sizeof(dbindex_node_t *));
+    node->keys[i] = child_key;
+    node->child[i + 1] = child_right;
+    node->n++;
+    if (node->n < DBINDEX_BTREE_ORDER) return;
+
+    // 内部节点分裂：中间的键上移，不保留在任何一侧
+    dbindex_node_t *right = node_take(idx, false);
+    size_t mid = node->n / 2;
+    *up_key = node->keys[mid];
+    right->n = node->n - mid - 1;
+    memcpy(right->keys, &node->keys[mid + 1], right->n * sizeof(uint64_t));
+    memcpy(right->child, &node->child[mid + 1],
+           (right->n + 1) * sizeof(dbindex_node_t *));
+    node->n = mid;
+    *up_node = right;
+}
+
+static int tree_insert(dbindex_t *idx, uint64_t key) {
+    if (reserve_nodes(idx, idx->height + 1) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    if (idx->root == NULL) {
+        idx->root = node_take(idx, true);
+        idx->height = 1;
+    }
+
+    uint64_t up_key;
+    dbindex_node_t *right;
+    node_insert(idx, idx->root, key, &up_key, &right);
+    if (right != NULL) {
+        dbindex_node_t *root = node_take(idx, false);
+        root->n = 1;
+        root->keys[0] = up_key;
+        root->child[0] = idx->root;
+        root->child[1] = right;
+        idx->root = root;
+        idx->height++;
+    }
+    idx->nkeys++;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 从叶子中删除 key。节点不合并：分隔键仍然是正确的上下界，
+ *        空叶子留在链表中，范围扫描会跳过它们；重建索引时自然消失。
+ */
+static void tree_remove(dbindex_t *idx, uint64_t key) {
+    dbindex_node_t *node = idx->root;
+    if (node == NULL) return;
+    while (!node->leaf) node = node->child[upper_bound(node->keys, node->n, key)];
+
+    size_t pos = lower_bound(node->keys, node->n, key);
+    if (pos == node->n || node->keys[pos] != key) return;
+    memmove(&node->keys[pos], &node->keys[pos + 1],
+            (node->n - pos - 1) * sizeof(uint64_t));
+    node->n--;
+    idx->nkeys--;
+}
+
+/**
+ * @brief 自底向上从升序的键构建 B+ 树，替换 idx 中原有的树。
+ *        节点只填到 3/4，给之后的插入留出空间。
+ */
+static int bulk_load(dbindex_t *idx, const uint64_t *keys, size_t n) {
+    const size_t fill = DBINDEX_BTREE_ORDER * 3 / 4;
+    size_t count = n ? (n + fill - 1) / fill : 1;  // 叶子数，空树也有一个叶子
+
+    // 先算出所有层的节点总数并一次预留，构建过程不会失败
+    size_t total = 0;
+    size_t height = 0;
+    for (size_t c = count;; c = (c + fill) / (fill + 1)) {
+        total += c;
+        height++;
+        if (c == 1) break;
+    }
+    if (reserve_nodes(idx, total) != STATUS_SUCCESS) return STATUS_ERROR;
+
+    dbindex_node_t **level __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(count * sizeof(dbindex_node_t *));
+    uint64_t *lows __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(count * sizeof(uint64_t));
+    if (level == NULL || lows == NULL) {
+        perror("malloc for index bulk load");
+        return STATUS_ERROR;
+    }
+
+    // 叶子层：按顺序切分并串成链表
+    dbindex_node_t *prev = NULL;
+    for (size_t l = 0; l < count; l++) {
+        dbindex_node_t *leaf = node_take(idx, true);
+        size_t start = l * fill;
+        size_t m = n - start < fill ? n - start : fill;
+        memcpy(leaf->keys, keys + start, m * sizeof(uint64_t));
+        leaf->n = (uint16_t)m;
+        lows[l] = m ? keys[start] : 0;
+        if (prev) prev->next = leaf;
+        prev = leaf;
+        level[l] = leaf;
+    }
+
+    // 逐层向上：每个父节点的分隔键是除第一个子节点外各子树的最小键
+    while (count > 1) {
+        size_t parents = (count + fill) / (fill + 1);
+        for (size_t p = 0; p < parents; p++) {
+            dbindex_node_t *node = node_take(idx, false);
+            size_t first = p * (fill + 1);
+            size_t m = count - first < fill + 1 ? count - first : fill + 1;
+            for (size_t j = 0; j < m; j++) {
+                node->child[j] = level[first + j];
+                if (j > 0) node->keys[j - 1] = lows[first + j];
+            }
+            node->n = (uint16_t)(m - 1);
+            lows[p] = lows[first];
+            level[p] = node;
+        }
+        count = parents;
+    }
+
+    free_tree(idx->root);
+    idx->root = level[0];
+    idx->height = height;
+    idx->nkeys = n;
+    return STATUS_SUCCESS;
+}
+
+static uint64_t hours_key(const dbrec_t *rec) {
+    return ((uint64_t)rec->hours << 32) | rec->slot;
+}
+
+/* ---------------- 对外接口 ---------------- */
+
+/**
+ * @brief 从数据库重建索引：排序后批量构建 B+ 树，逐条插入哈希表。
+ *        已删除的槽位不进入索引。
+ */
+int dbindex_build(dbindex_t *idx, const dbmap_t *map) {
+    size_t count = map->hdr.count;
+    dbindex_t fresh = {0};
+    uint64_t *keys __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc((count ? count : 1) * sizeof(uint64_t));
+    if (keys == NULL) {
+        perror("malloc for index keys");
+        return STATUS_ERROR;
+    }
+    size_t live = 0;
+    dbrec_t rec;
+    for (size_t i = 0; i < count; i++) {
+        if (dbmap_view(map, i, &rec)) keys[live++] = hours_key(&rec);
+    }
+    qsort(keys, live, sizeof(uint64_t), cmp_u64);
+
+    int status = bulk_load(&fresh, keys, live);
+    if (status == STATUS_SUCCESS) {
+        status = names_rehash(&fresh, names_capacity_for(live));
+    }
+    for (size_t i = 0; status == STATUS_SUCCESS && i < count; i++) {
+        if (!dbmap_view(map, i, &rec)) continue;
+        status = names_insert(&fresh, i, name_hash(rec.name, rec.name_len));
+    }
+    if (status != STATUS_SUCCESS) {
+        dbindex_free(&fresh);
+        return STATUS_ERROR;
+    }
+
+    dbindex_free(idx);
+    *idx = fresh;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 加载索引文件：哈希表按原样读入，B+ 树从有序的键批量构建，
+ *        不需要访问任何员工记录。
+ */
+int dbindex_load(dbindex_t *idx, const char *db_path, uint64_t stamp,
+                 size_t count, size_t live) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s.idx", db_path) >= (int)sizeof(path)) {
+        return STATUS_ERROR;
+    }
+    int fd __attribute__((cleanup(_cleanup_fd_))) = open(path, O_RDONLY);
+    if (fd == -1) return STATUS_ERROR;
+
+    struct dbindex_file_hdr_t fhdr;
+    if (read_all(fd, &fhdr, sizeof(fhdr)) != STATUS_SUCCESS ||
+        fhdr.magic != DBINDEX_MAGIC || fhdr.version != DBINDEX_VERSION ||
+        fhdr.stamp != stamp || fhdr.nkeys != live ||
+        fhdr.nbuckets < names_capacity_for(live) ||
+        (fhdr.nbuckets & (fhdr.nbuckets - 1)) != 0) {
+        return STATUS_ERROR;
+    }
+
+    dbindex_t fresh = {0};
+    fresh.nbuckets = fhdr.nbuckets;
+    fresh.buckets = malloc(fresh.nbuckets * sizeof(dbindex_bucket_t));
+    uint64_t *keys __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc((live ? live : 1) * sizeof(uint64_t));
+    int status = STATUS_ERROR;
+    if (fresh.buckets == NULL || keys == NULL) {
+        perror("malloc for index load");
+    } else if (read_all(fd, fresh.buckets,
+                        fresh.nbuckets * sizeof(dbindex_bucket_t)) ==
+                   STATUS_SUCCESS &&
+               read_all(fd, keys, live * sizeof(uint64_t)) ==
+                   STATUS_SUCCESS) {
+        status = STATUS_SUCCESS;
+    }
+
+    // 校验内容，损坏的索引文件不能被当作有效索引使用
+    for (size_t i = 0; status == STATUS_SUCCESS && i < fresh.nbuckets; i++) {
+        uint32_t slot = fresh.buckets[i].slot;
+        if (slot == DBINDEX_EMPTY) continue;
+        fresh.filled++;
+        if (slot == DBINDEX_TOMBSTONE) continue;
+        fresh.used++;
+        if (slot >= count) status = STATUS_ERROR;
+    }
+    if (fresh.used != live) status = STATUS_ERROR;
+    for (size_t i = 0; status == STATUS_SUCCESS && i < live; i++) {
+        if ((keys[i] & UINT32_MAX) >= count ||
+            (i > 0 && keys[i] <= keys[i - 1])) {
+            status = STATUS_ERROR;
+        }
+    }
+    if (status == STATUS_SUCCESS) status = bulk_load(&fresh, keys, live);
+    if (status != STATUS_SUCCESS) {
+        dbindex_free(&fresh);
+        return STATUS_ERROR;
+    }
+
+    dbindex_free(idx);
+    *idx = fresh;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 写出索引文件：头部、哈希表原样、再按叶子链表顺序写出有序的键。
+ */
+int dbindex_save(const dbindex_t *idx, const char *db_path, uint64_t stamp) {
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s.idx", db_path) >= (int)sizeof(path) ||
+        snprintf(tmp_path, sizeof(tmp_path), "%s.idx.tmp", db_path) >=
+            (int)sizeof(tmp_path)) {
+        fprintf(stderr, "Error: Database path too long for index: '%s'\n",
+                db_path);
+        return STATUS_ERROR;
+    }
+
+    int fd __attribute__((cleanup(_cleanup_fd_))) =
+        open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("open index file");
+        return STATUS_ERROR;
+    }
+
+    struct dbindex_file_hdr_t fhdr = {0};
+    fhdr.magic = DBINDEX_MAGIC;
+    fhdr.version = DBINDEX_VERSION;
+    fhdr.stamp = stamp;
+    fhdr.nkeys = idx->nkeys;
+    fhdr.nbuckets = idx->nbuckets;
+    if (write_all(fd, &fhdr, sizeof(fhdr)) != STATUS_SUCCESS ||
+        write_all(fd, idx->buckets,
+                  idx->nbuckets * sizeof(dbindex_bucket_t)) != STATUS_SUCCESS) {
+        perror("write index file");
+        return STATUS_ERROR;
+    }
+
+    const dbindex_node_t *node = idx->root;
+    while (node != NULL && !node->leaf) node = node->child[0];
+    for (; node != NULL; node = node->next) {
+        if (write_all(fd, node->keys, node->n * sizeof(uint64_t)) !=
+            STATUS_SUCCESS) {
+            perror("write index file");
+            return STATUS_ERROR;
+        }
+    }
+
+    if (fsync(fd) == -1 || rename(tmp_path, path) == -1 ||
+        fsync_parent_dir(path) != STATUS_SUCCESS) {
+        perror("commit index file");
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 每次插入最多用掉 height + 1 个节点且树高最多增加 1，
+ *        哈希表只在填充率超过 1/2 时重建，提前满足这两点即可。
+ */
+int dbindex_reserve(dbindex_t *idx, size_t n) {
+    if ((idx->filled + n) * 2 > idx->nbuckets &&
+        names_rehash(idx, names_capacity_for(idx->used + n)) !=
+            STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    return reserve_nodes(idx, n * (idx->height + n));
+}
+
+/**
+ * @brief 加入一条记录。先插入 B+ 树（预留节点后不会失败），
+ *        哈希表插入失败时再把键删掉，保证两个索引一致。
+ */
+int dbindex_insert(dbindex_t *idx, const dbmap_t *map, uint32_t slot) {
+    dbrec_t rec;
+    if (!dbmap_view(map, slot, &rec)) return STATUS_ERROR;
+    uint64_t key = hours_key(&rec);
+    if (tree_insert(idx, key) != STATUS_SUCCESS) return STATUS_ERROR;
+    if (names_insert(idx, slot, name_hash(rec.name, rec.name_len)) !=
+        STATUS_SUCCESS) {
+        tree_remove(idx, key);
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 删除一条记录。
+ */
+void dbindex_remove(dbindex_t *idx, const dbmap_t *map, uint32_t slot) {
+    dbrec_t rec;
+    if (!dbmap_view(map, slot, &rec)) return;
+    tree_remove(idx, hours_key(&rec));
+    names_remove(idx, slot, name_hash(rec.name, rec.name_len));
+}
+
+/**
+ * @brief 沿探测序列收集同名记录，遇到空槽位结束。
+ *        记录中的名字不以 '\0' 结尾，先比较长度再比较内容。
+ */
+int dbindex_find_name(const dbindex_t *idx, const dbmap_t *map,
+                      const char *name, dbindex_result_t *out) {
+    if (idx->nbuckets == 0) return STATUS_SUCCESS;
+
+    size_t len = strnlen(name, NAME_LEN);
+    uint32_t hash = name_hash(name, len);
+    size_t mask = idx->nbuckets - 1;
+    size_t start = out->len;
+    for (size_t i = hash & mask; idx->buckets[i].slot != DBINDEX_EMPTY;
+         i = (i + 1) & mask) {
+        const dbindex_bucket_t *b = &idx->buckets[i];
+        if (b->slot == DBINDEX_TOMBSTONE || b->hash != hash) continue;
+        dbrec_t rec;
+        if (!dbmap_view(map, b->slot, &rec) || rec.name_len != len ||
+            memcmp(rec.name, name, len) != 0) {
+            continue;
+        }
+        if (result_push(out, b->slot) != STATUS_SUCCESS) return STATUS_ERROR;
+    }
+    qsort(out->slots + start, out->len - start, sizeof(uint32_t), cmp_u32);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 下降到第一个可能包含 lo 的叶子，再沿叶子链表扫描到 hi 为止。
+ */
+int dbindex_range_hours(const dbindex_t *idx, uint32_t lo, uint32_t hi,
+                        dbindex_result_t *out) {
+    const dbindex_node_t *node = idx->root;
+    if (node == NULL || lo > hi) return STATUS_SUCCESS;
+
+    uint64_t lo_key = (uint64_t)lo << 32;
+    while (!node->leaf) {
+        node = node->child[upper_bound(node->keys, node->n, lo_key)];
+    }
+    for (size_t pos = lower_bound(node->keys, node->n, lo_key); node != NULL;
+         node = node->next, pos = 0) {
+        for (; pos < node->n; pos++) {
+            if ((node->keys[pos] >> 32) > hi) return STATUS_SUCCESS;
+            if (result_push(out, (uint32_t)node->keys[pos]) != STATUS_SUCCESS) {
+                return STATUS_ERROR;
+            }
+        }
+    }
+    return STATUS_SUCCESS;
+}
+
+void dbindex_result_free(dbindex_result_t *out) {
+    free(out->slots);
+    out->slots = NULL;
+    out->len = out->cap = 0;
+}
+
+void dbindex_free(dbindex_t *idx) {
+    free_tree(idx->root);
+    while (idx->spare != NULL) {
+        dbindex_node_t *next = idx->spare->next;
+        free(idx->spare);
+        idx->spare = next;
+    }
+    free(idx->buckets);
+    memset(idx, 0, sizeof(*idx));
+}
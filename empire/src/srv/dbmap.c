@@ -0,0 +1,1072 @@
+#define _GNU_SOURCE  // For mremap, MREMAP_MAYMOVE
+
+#include "../../include/dbmap.h"  // 包含 dbmap_t 声明
+
+#include <arpa/inet.h>  // For ntohl, ntohs
+#include <fcntl.h>      // For open, O_RDWR, O_CREAT, O_TRUNC
+#include <limits.h>     // For PATH_MAX
+#include <stddef.h>     // For offsetof
+#include <stdio.h>      // For perror, fprintf, snprintf, rename
+#include <stdlib.h>     // For calloc, realloc, free
+#include <string.h>     // For memcpy, memset
+#include <sys/mman.h>   // For mmap, mremap, msync, munmap
+#include <sys/stat.h>   // For fstat
+#include <unistd.h>     // For ftruncate, pread, close
+
+#include "../../include/checksum.h"  // 包含 crc32c
+#include "../../include/common.h"    // 包含 STATUS_SUCCESS 等宏
+#include "../../include/file.h"      // 包含 fsync_parent_dir, write_all
+#include "../../include/log.h"       // 包含 log_info, log_warn
+#include "../../include/wal.h"     // 包含 wal_replay_legacy
+
+/**
+ * @brief 记录堆的起始偏移
+ */
+#define HEAP_START DBMAP_HEAP_START
+
+/**
+ * @brief 写出镜像时每次计算校验和并写入的字节数
+ */
+#define IMAGE_CHUNK (1024 * 1024)
+
+/**
+ * @brief 定长槽位格式（DB_VERSION_FIXED）的头部大小
+ */
+#define FIXED_HEADER_SIZE offsetof(struct dbheader_t, heap_end)
+
+/**
+ * @brief 容纳 bytes 字节所需的文件大小：从 DBMAP_MIN_FILE 起按倍数增长。
+ */
+static size_t file_size_for(size_t bytes) {
+    size_t size = DBMAP_MIN_FILE;
+    while (size < bytes) size *= 2;
+    return size;
+}
+
+/**
+ * @brief 墓碑位图覆盖 capacity 个槽位所需的字数。
+ */
+static size_t bitmap_words(size_t capacity) {
+    return (capacity + 63) / 64;
+}
+
+static bool dead_test(const dbmap_t *map, size_t slot) {
+    return (map->dead[slot / 64] >> (slot % 64)) & 1;
+}
+
+static void dead_set(dbmap_t *map, size_t slot) {
+    map->dead[slot / 64] |= 1ULL << (slot % 64);
+    if (slot / 64 < map->dead_hint) map->dead_hint = slot / 64;
+}
+
+static void dead_clear(dbmap_t *map, size_t slot) {
+    map->dead[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+/**
+ * @brief 记录堆 [HEAP_START, end) 分成的段数。
+ */
+static size_t span_count(uint64_t end) {
+    if (end <= HEAP_START) return 0;
+    return (size_t)((end - HEAP_START - 1) / DBMAP_SUM_SPAN) + 1;
+}
+
+/**
+ * @brief 扩展段校验和数组，使其覆盖 size 字节的映射。记录堆不会超出映射，
+ *        因此之后的追加不需要再分配内存。
+ */
+static int sums_reserve(dbmap_t *map, size_t size) {
+    size_t n = span_count(size);
+    if (n <= map->nsums) return STATUS_SUCCESS;
+    uint32_t *sums = realloc(map->sums, n * sizeof(uint32_t));
+    if (sums == NULL) {
+        perror("realloc for heap checksums");
+        return STATUS_ERROR;
+    }
+    memset(sums + map->nsums, 0, (n - map->nsums) * sizeof(uint32_t));
+    map->sums = sums;
+    map->nsums = n;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把写在 off 处的 len 字节累加进所在各段的校验和。
+ */
+static void sums_add(dbmap_t *map, uint64_t off, const char *data,
+                     size_t len) {
+    while (len > 0) {
+        size_t span = (size_t)((off - HEAP_START) / DBMAP_SUM_SPAN);
+        size_t room = DBMAP_SUM_SPAN - (off - HEAP_START) % DBMAP_SUM_SPAN;
+        size_t n = len < room ? len : room;
+        map->sums[span] = crc32c(map->sums[span], data, n);
+        off += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief 从头计算 base 中记录堆 [HEAP_START, end) 各段的校验和。
+ */
+static void sums_compute(uint32_t *sums, const char *base, uint64_t end) {
+    for (uint64_t off = HEAP_START; off < end; off += DBMAP_SUM_SPAN) {
+        size_t len = end - off < DBMAP_SUM_SPAN ? (size_t)(end - off)
+                                                : DBMAP_SUM_SPAN;
+        sums[(off - HEAP_START) / DBMAP_SUM_SPAN] = crc32c(0, base + off, len);
+    }
+}
+
+/**
+ * @brief 校验和文件的路径 <db>.crc，tmp 为真时是 <db>.crc.tmp。
+ */
+static int sums_path(char *out, const char *db_path, bool tmp) {
+    if (snprintf(out, PATH_MAX, "%s.crc%s", db_path, tmp ? ".tmp" : "") >=
+        PATH_MAX) {
+        fprintf(stderr, "Error: Database path too long for checksums: '%s'\n",
+                db_path);
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把 [HEAP_START, heap_end) 的段校验和写入 <db>.crc.tmp，刷盘后
+ *        原子地替换 <db>.crc。只使用系统调用，可以在检查点子进程中调用。
+ */
+static int sums_save(const dbmap_t *map, uint64_t heap_end) {
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+    if (sums_path(path, map->path, false) != STATUS_SUCCESS ||
+        sums_path(tmp_path, map->path, true) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    struct stat st;
+    if (fstat(map->fd, &st) == -1) return STATUS_ERROR;
+
+    struct dbmap_sum_hdr_t shdr = {0};
+    shdr.magic = DBMAP_SUM_MAGIC;
+    shdr.version = DBMAP_SUM_VERSION;
+    shdr.dev = (uint64_t)st.st_dev;
+    shdr.ino = (uint64_t)st.st_ino;
+    shdr.heap_end = heap_end;
+    shdr.nspans = span_count(heap_end);
+    size_t table = shdr.nspans * sizeof(uint32_t);
+    uint32_t crc = crc32c(crc32c(0, &shdr, sizeof(shdr)), map->sums, table);
+
+    int fd __attribute__((cleanup(_cleanup_fd_))) =
+        open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1 || write_all(fd, &shdr, sizeof(shdr)) != STATUS_SUCCESS ||
+        write_all(fd, map->sums, table) != STATUS_SUCCESS ||
+        write_all(fd, &crc, sizeof(crc)) != STATUS_SUCCESS ||
+        fsync(fd) == -1 || rename(tmp_path, path) == -1 ||
+        fsync_parent_dir(path) != STATUS_SUCCESS) {
+        if (fd != -1) unlink(tmp_path);
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 读取属于当前数据库文件的 <db>.crc。
+ * @param shdrOut 输出参数，返回校验和文件头部
+ * @param sumsOut 输出参数，返回段校验和数组，由调用者释放
+ * @return 文件存在、完整且属于 map 时返回 STATUS_SUCCESS。
+ */
+static int sums_load(const dbmap_t *map, struct dbmap_sum_hdr_t *shdrOut,
+                     uint32_t **sumsOut) {
+    char path[PATH_MAX];
+    if (sums_path(path, map->path, false) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    int fd __attribute__((cleanup(_cleanup_fd_))) =
+        open(path, O_RDONLY | O_CLOEXEC);
+    struct stat db_st;
+    struct stat st;
+    struct dbmap_sum_hdr_t shdr;
+    if (fd == -1 || fstat(map->fd, &db_st) == -1 || fstat(fd, &st) == -1 ||
+        read_all(fd, &shdr, sizeof(shdr)) != STATUS_SUCCESS ||
+        shdr.magic != DBMAP_SUM_MAGIC || shdr.version != DBMAP_SUM_VERSION ||
+        shdr.dev != (uint64_t)db_st.st_dev ||
+        shdr.ino != (uint64_t)db_st.st_ino ||
+        shdr.nspans != span_count(shdr.heap_end) ||
+        (uint64_t)st.st_size !=
+            sizeof(shdr) + (shdr.nspans + 1) * sizeof(uint32_t)) {
+        return STATUS_ERROR;
+    }
+
+    size_t table = shdr.nspans * sizeof(uint32_t);
+    uint32_t *sums __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(table + sizeof(uint32_t));
+    if (sums == NULL ||
+        read_all(fd, sums, table + sizeof(uint32_t)) != STATUS_SUCCESS ||
+        crc32c(crc32c(0, &shdr, sizeof(shdr)), sums, table) !=
+            sums[shdr.nspans]) {
+        return STATUS_ERROR;
+    }
+    *shdrOut = shdr;
+    *sumsOut = sums;
+    sums = NULL;  // 清除 cleanup 宏的作用
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 计算记录堆的段校验和，并与 <db>.crc 比较。检查点先写校验和文件
+ *        再更新头部，所以它覆盖的范围可能超过头部的 heap_end，多出的字节
+ *        已经刷盘，一样可以校验。
+ */
+static int verify_heap(dbmap_t *map) {
+    uint64_t heap_end = map->hdr.heap_end;
+    sums_compute(map->sums, map->base, heap_end);
+
+    struct dbmap_sum_hdr_t shdr;
+    uint32_t *disk __attribute__((cleanup(_cleanup_ptr_))) = NULL;
+    if (sums_load(map, &shdr, &disk) != STATUS_SUCCESS) {
+        log_warn("No heap checksums for '%s', computing them from the "
+                 "current contents",
+                 map->path);
+        return STATUS_SUCCESS;
+    }
+    if (shdr.heap_end > map->map_size) {
+        fprintf(stderr,
+                "Error: Corrupted database. Heap checksums cover %lu bytes "
+                "but the file has only %zu\n",
+                (unsigned long)shdr.heap_end, map->map_size);
+        return STATUS_ERROR;
+    }
+    for (size_t i = 0; i < shdr.nspans; i++) {
+        uint64_t start = HEAP_START + (uint64_t)i * DBMAP_SUM_SPAN;
+        uint64_t end = start + DBMAP_SUM_SPAN;
+        uint64_t disk_end = end < shdr.heap_end ? end : shdr.heap_end;
+        uint64_t mem_end = end < heap_end ? end : heap_end;
+        // 只有和头部的 heap_end 不一致的那一段需要单独计算
+        uint32_t crc = disk_end == mem_end
+                           ? map->sums[i]
+                           : crc32c(0, map->base + start, disk_end - start);
+        if (crc != disk[i]) {
+            fprintf(stderr,
+                    "Error: Corrupted database. Heap span %zu at offset %lu "
+                    "fails its checksum\n",
+                    i, (unsigned long)start);
+            return STATUS_ERROR;
+        }
+    }
+    if (shdr.heap_end < heap_end) {
+        log_warn("Heap checksums of '%s' end at offset %lu, bytes up to %lu "
+                 "were not verified",
+                 map->path, (unsigned long)shdr.heap_end,
+                 (unsigned long)heap_end);
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 解码偏移 off 处的记录。记录堆中 heap_end 之前的记录都是完整的。
+ * @return 记录的字节数，格式错误时返回 0。
+ */
+static size_t record_at(const dbmap_t *map, uint64_t off, dbrec_t *rec) {
+    return dbrec_decode(map->base + off, map->hdr.heap_end - off, rec);
+}
+
+/**
+ * @brief 按倍数扩展槽位表和墓碑位图，使其至少覆盖 n 个槽位。
+ *        只涉及内存，与文件大小无关。
+ */
+static int slots_reserve(dbmap_t *map, size_t n) {
+    if (n <= map->capacity) return STATUS_SUCCESS;
+    if (n > DBMAP_MAX_RECORDS) {
+        fprintf(stderr, "Error: Database is full (%lu records)\n",
+                (unsigned long)DBMAP_MAX_RECORDS);
+        return STATUS_ERROR;
+    }
+
+    size_t capacity = map->capacity ? map->capacity : DBMAP_MIN_CAPACITY;
+    while (capacity < n) capacity *= 2;
+    if (capacity > DBMAP_MAX_RECORDS) capacity = DBMAP_MAX_RECORDS;
+
+    uint64_t *offs = realloc(map->offs, capacity * sizeof(uint64_t));
+    if (offs == NULL) {
+        perror("realloc for slot table");
+        return STATUS_ERROR;
+    }
+    memset(offs + map->capacity, 0,
+           (capacity - map->capacity) * sizeof(uint64_t));
+    map->offs = offs;
+
+    uint32_t *crcs = realloc(map->crcs, capacity * sizeof(uint32_t));
+    if (crcs == NULL) {
+        perror("realloc for record checksums");
+        return STATUS_ERROR;
+    }
+    map->crcs = crcs;
+
+    size_t words = bitmap_words(capacity);
+    size_t old_words = bitmap_words(map->capacity);
+    if (words > old_words) {
+        uint64_t *dead = realloc(map->dead, words * sizeof(uint64_t));
+        if (dead == NULL) {
+            perror("realloc for dead slot bitmap");
+            return STATUS_ERROR;  // 槽位表变大不影响正确性
+        }
+        memset(dead + old_words, 0, (words - old_words) * sizeof(uint64_t));
+        map->dead = dead;
+    }
+    map->capacity = capacity;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 让 map 中的指针指向新的映射地址。
+ */
+static void attach_mapping(dbmap_t *map, char *base, size_t size) {
+    map->base = base;
+    map->map_size = size;
+    map->disk_hdr = (struct dbheader_t *)base;
+    map->hdr.filesize = size;
+}
+
+/**
+ * @brief 确保记录堆末尾至少还有 bytes 字节，按倍数扩展文件和映射，
+ *        摊销 ftruncate/mremap 的开销。
+ */
+static int heap_reserve(dbmap_t *map, size_t bytes) {
+    size_t need = map->hdr.heap_end + bytes;
+    if (need <= map->map_size) return STATUS_SUCCESS;
+
+    size_t size = map->map_size;
+    while (size < need) size *= 2;
+    if (sums_reserve(map, size) != STATUS_SUCCESS) return STATUS_ERROR;
+    if (ftruncate(map->fd, (off_t)size) == -1) {
+        perror("ftruncate to grow database file");
+        return STATUS_ERROR;
+    }
+    void *base = mremap(map->base, map->map_size, size, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED) {
+        perror("mremap database file");
+        return STATUS_ERROR;  // 文件变大但旧映射仍然有效
+    }
+    attach_mapping(map, base, size);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把编码好的记录追加到记录堆末尾。
+ * @param offOut 输出参数，返回记录的偏移
+ */
+static int heap_append(dbmap_t *map, const char *rec, size_t len,
+                       uint64_t *offOut) {
+    if (heap_reserve(map, len) != STATUS_SUCCESS) return STATUS_ERROR;
+    memcpy(map->base + map->hdr.heap_end, rec, len);
+    sums_add(map, map->hdr.heap_end, rec, len);
+    *offOut = map->hdr.heap_end;
+    map->hdr.heap_end += len;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 为一条有效记录追加墓碑，并把槽位表中的偏移清零。
+ *        空间必须已经预留，因此不会失败。
+ */
+static void bury(dbmap_t *map, size_t slot) {
+    dbrec_t old;
+    map->live_bytes -= record_at(map, map->offs[slot], &old);
+    char rec[DBREC_TOMBSTONE_MAX_SIZE];
+    size_t len = dbrec_encode_tombstone(rec, (uint32_t)slot);
+    memcpy(map->base + map->hdr.heap_end, rec, len);
+    sums_add(map, map->hdr.heap_end, rec, len);
+    map->hdr.heap_end += len;
+    map->offs[slot] = 0;
+}
+
+/**
+ * @brief 把 [hdr.count, count) 纳入记录数。这些槽位的最新版本都是墓碑，
+ *        直接记入位图。
+ */
+static void extend_count(dbmap_t *map, size_t count) {
+    for (size_t slot = map->hdr.count; slot < count; slot++) {
+        if (!dead_test(map, slot)) {
+            dead_set(map, slot);
+            map->ndead++;
+        }
+    }
+    map->hdr.count = count;
+}
+
+/**
+ * @brief 以 MAP_SHARED 方式映射整个文件，创建 dbmap_t。
+ *        失败时 fd 仍归调用者所有。
+ * @param fd 数据库文件描述符
+ * @param path 数据库文件路径
+ * @param size 文件大小
+ * @param mapOut 输出参数，返回映射的数据库
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int map_file(int fd, const char *path, size_t size, dbmap_t **mapOut) {
+    dbmap_t *map __attribute__((cleanup(_cleanup_dbmap_))) =
+        calloc(1, sizeof(dbmap_t));
+    if (map == NULL) {
+        perror("calloc for dbmap");
+        return STATUS_ERROR;
+    }
+    map->fd = -1;
+    if (snprintf(map->path, sizeof(map->path), "%s", path) >=
+        (int)sizeof(map->path)) {
+        fprintf(stderr, "Error: Database path too long: '%s'\n", path);
+        return STATUS_ERROR;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap database file");
+        return STATUS_ERROR;
+    }
+    map->hdr = *(struct dbheader_t *)base;
+    attach_mapping(map, base, size);
+    if (slots_reserve(map, DBMAP_MIN_CAPACITY) != STATUS_SUCCESS ||
+        sums_reserve(map, size) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    map->heap_sorted = true;
+    map->fd = fd;
+    *mapOut = map;
+    map = NULL;  // 清除 cleanup 宏的作用
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把空文件初始化为空的映射数据库，并让头部落盘。
+ */
+int dbmap_create(int fd, const char *path, dbmap_t **mapOut) {
+    size_t size = DBMAP_MIN_FILE;
+    if (ftruncate(fd, (off_t)size) == -1) {
+        perror("ftruncate new database file");
+        return STATUS_ERROR;
+    }
+
+    dbmap_t *map = NULL;
+    if (map_file(fd, path, size, &map) != STATUS_SUCCESS) return STATUS_ERROR;
+    map->hdr.magic = HEADER_MAGIC;
+    map->hdr.version = DB_VERSION_VARLEN;
+    map->hdr.reserved = 0;
+    map->hdr.count = 0;
+    map->hdr.filesize = size;
+    map->hdr.heap_end = HEAP_START;
+    *map->disk_hdr = map->hdr;
+    if (dbmap_sync(map, 0) != STATUS_SUCCESS) {
+        perror("sync new database file");
+        map->fd = -1;  // 失败时 fd 仍归调用者所有
+        dbmap_close(map);
+        return STATUS_ERROR;
+    }
+
+    *mapOut = map;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把旧文件中的记录写成当前格式的 <db>.tmp，再原子地替换原文件。
+ * @param fd 旧数据库文件描述符，成功后被关闭
+ * @param path 数据库文件路径
+ * @param employees 旧文件中的记录（本机字节序），名字为空的是墓碑
+ * @param count 记录数
+ * @param mapOut 输出参数，返回映射的新文件
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int write_upgraded(int fd, const char *path,
+                          const struct employee_t *employees, size_t count,
+                          dbmap_t **mapOut) {
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+        (int)sizeof(tmp_path)) {
+        fprintf(stderr, "Error: Database path too long: '%s'\n", path);
+        return STATUS_ERROR;
+    }
+    int tmp_fd __attribute__((cleanup(_cleanup_fd_))) =
+        open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tmp_fd == -1) {
+        perror("open upgraded database file");
+        return STATUS_ERROR;
+    }
+
+    // 使用最终路径：<db>.crc 记录的是新文件的 inode，改名之前崩溃时
+    // 不会被当作旧文件的校验和
+    dbmap_t *map __attribute__((cleanup(_cleanup_dbmap_))) = NULL;
+    if (dbmap_create(tmp_fd, path, &map) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    tmp_fd = -1;  // 已归 map 所有
+    for (size_t slot = 0; slot < count; slot++) {
+        if (employee_is_deleted(&employees[slot])) continue;
+        if (dbmap_put(map, slot, &employees[slot]) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+    }
+    if (dbmap_set_count(map, count) != STATUS_SUCCESS ||
+        dbmap_sync(map, map->hdr.count) != STATUS_SUCCESS) {
+        perror("sync upgraded database file");
+        return STATUS_ERROR;
+    }
+    if (rename(tmp_path, path) == -1 ||
+        fsync_parent_dir(path) != STATUS_SUCCESS) {
+        perror("rename upgraded database file");
+        return STATUS_ERROR;
+    }
+    printf("Upgraded '%s' to database format %d (%lu records)\n", path,
+           DB_VERSION_VARLEN, (unsigned long)map->hdr.count);
+
+    close(fd);
+    *mapOut = map;
+    map = NULL;  // 清除 cleanup 宏的作用
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把旧版文件（及其旧版 WAL）读入内存，再写成当前格式。
+ *        只在第一次打开旧版文件时执行一次。
+ * @param fd 旧版数据库文件描述符，成功后被关闭
+ * @param path 数据库文件路径
+ * @param mapOut 输出参数，返回映射的新文件
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int upgrade_legacy(int fd, const char *path, dbmap_t **mapOut) {
+    struct dbheader_t *old_hdr __attribute__((cleanup(_cleanup_ptr_))) = NULL;
+    struct employee_t *old_employees
+        __attribute__((cleanup(_cleanup_ptr_))) = NULL;
+    if (validate_db_header(fd, &old_hdr) != STATUS_SUCCESS ||
+        read_employees(fd, old_hdr, &old_employees) != STATUS_SUCCESS ||
+        wal_replay_legacy(path, old_hdr, &old_employees) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    return write_upgraded(fd, path, old_employees, old_hdr->count, mapOut);
+}
+
+/**
+ * @brief 把定长槽位的映射格式文件（16 位或 64 位记录数）改写为当前格式。
+ *        只复制磁盘头部计数的槽位；WAL 按槽位下标记录修改，与文件布局
+ *        无关，升级之后由 wal_open 照常重放。
+ * @param fd 旧文件描述符，成功后被关闭
+ * @param path 数据库文件路径
+ * @param hdr_size 旧文件头部的大小，槽位紧随其后
+ * @param count 旧文件头部中的记录数
+ * @param mapOut 输出参数，返回映射的新文件
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int upgrade_fixed(int fd, const char *path, size_t hdr_size,
+                         uint64_t count, dbmap_t **mapOut) {
+    struct stat dbstat = {0};
+    if (fstat(fd, &dbstat) == -1) {
+        perror("Error getting file stats");
+        return STATUS_ERROR;
+    }
+    size_t size = (size_t)dbstat.st_size;
+    if (count > DBMAP_MAX_RECORDS ||
+        size < hdr_size + count * sizeof(struct employee_t)) {
+        fprintf(stderr,
+                "Error: Corrupted database. File size %ld does not fit %lu "
+                "records\n",
+                dbstat.st_size, (unsigned long)count);
+        return STATUS_ERROR;
+    }
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap database file for upgrade");
+        return STATUS_ERROR;
+    }
+    const struct employee_t *employees =
+        (const struct employee_t *)((char *)base + hdr_size);
+    int status = write_upgraded(fd, path, employees, count, mapOut);
+    munmap(base, size);
+    return status;
+}
+
+/**
+ * @brief 顺序扫描记录堆，每个槽位以最后出现的版本为准，重建槽位表、
+ *        有效字节数和墓碑位图。count 之后的槽位的最新版本都是墓碑，跳过。
+ */
+static int load_heap(dbmap_t *map) {
+    size_t count = map->hdr.count;
+    if (slots_reserve(map, count) != STATUS_SUCCESS) return STATUS_ERROR;
+
+    uint64_t pos = HEAP_START;
+    while (pos < map->hdr.heap_end) {
+        dbrec_t rec;
+        size_t len = record_at(map, pos, &rec);
+        if (len == 0) {
+            fprintf(stderr,
+                    "Error: Corrupted database. Bad record at offset %lu\n",
+                    (unsigned long)pos);
+            return STATUS_ERROR;
+        }
+        if (pos > HEAP_START && rec.slot <= map->heap_last) {
+            map->heap_sorted = false;
+        }
+        map->heap_last = rec.slot;
+        if (rec.slot < count) {
+            if (map->offs[rec.slot] != 0) {
+                dbrec_t old;
+                map->live_bytes -= record_at(map, map->offs[rec.slot], &old);
+            }
+            map->offs[rec.slot] = rec.name_len > 0 ? pos : 0;
+            if (rec.name_len > 0) {
+                map->live_bytes += len;
+                map->crcs[rec.slot] = crc32c(0, rec.raw, len);
+            }
+        }
+        pos += len;
+    }
+
+    for (size_t slot = 0; slot < count; slot++) {
+        if (map->offs[slot] == 0) {
+            dead_set(map, slot);
+            map->ndead++;
+        }
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 映射现有的数据库文件并扫描记录堆。只有打开时读取一遍记录，
+ *        之后的访问都通过槽位表直接定位。
+ */
+int dbmap_open(int fd, const char *path, dbmap_t **mapOut) {
+    // 先按旧版头部读取，旧版头部比当前头部短，可以识别任何版本
+    struct dbheader_v1_t old;
+    if (pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old)) {
+        if (ntohl(old.magic) == HEADER_MAGIC &&
+            ntohs(old.version) == DB_VERSION_LEGACY) {
+            return upgrade_legacy(fd, path, mapOut);
+        }
+        if (old.magic == HEADER_MAGIC && old.version == DB_VERSION_MMAP16) {
+            return upgrade_fixed(fd, path, sizeof(old), old.count, mapOut);
+        }
+    }
+
+    struct dbheader_t raw;
+    ssize_t n = pread(fd, &raw, sizeof(raw), 0);
+    if (n >= (ssize_t)FIXED_HEADER_SIZE && raw.magic == HEADER_MAGIC &&
+        raw.version == DB_VERSION_FIXED) {
+        return upgrade_fixed(fd, path, FIXED_HEADER_SIZE, raw.count, mapOut);
+    }
+    if (n != (ssize_t)sizeof(raw)) {
+        if (n == -1) {
+            perror("Error reading database header");
+        } else {
+            fprintf(stderr,
+                    "Error: Incomplete database header read. Expected %zu "
+                    "bytes, got %zd.\n",
+                    sizeof(raw), n);
+        }
+        return STATUS_ERROR;
+    }
+
+    if (raw.magic != HEADER_MAGIC) {
+        fprintf(stderr,
+                "Error: Improper header magic. Expected 0x%X, got 0x%X\n",
+                HEADER_MAGIC, raw.magic);
+        return STATUS_ERROR;
+    }
+    if (raw.version != DB_VERSION_VARLEN) {
+        fprintf(stderr,
+                "Error: Improper header version. Expected %d, got %hu\n",
+                DB_VERSION_VARLEN, raw.version);
+        return STATUS_ERROR;
+    }
+
+    // 头部的 filesize 只在检查点时更新，之后的扩展以实际文件大小为准
+    struct stat dbstat = {0};
+    if (fstat(fd, &dbstat) == -1) {
+        perror("Error getting file stats");
+        return STATUS_ERROR;
+    }
+    size_t size = (size_t)dbstat.st_size;
+    if (raw.count > DBMAP_MAX_RECORDS || raw.heap_end < HEAP_START ||
+        raw.heap_end > size) {
+        fprintf(stderr,
+                "Error: Corrupted database. File size %ld does not fit a "
+                "record heap ending at %lu\n",
+                dbstat.st_size, (unsigned long)raw.heap_end);
+        return STATUS_ERROR;
+    }
+
+    dbmap_t *map __attribute__((cleanup(_cleanup_dbmap_))) = NULL;
+    if (map_file(fd, path, size, &map) != STATUS_SUCCESS) return STATUS_ERROR;
+    if (verify_heap(map) != STATUS_SUCCESS ||
+        load_heap(map) != STATUS_SUCCESS) {
+        map->fd = -1;  // 失败时 fd 仍归调用者所有
+        return STATUS_ERROR;
+    }
+    *mapOut = map;
+    map = NULL;  // 清除 cleanup 宏的作用
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 预留槽位表和记录堆空间。
+ */
+int dbmap_prepare(dbmap_t *map, size_t slot) {
+    return dbmap_reserve(map, slot + 1, 1);
+}
+
+/**
+ * @brief 为一批写入预留槽位表和记录堆空间。
+ */
+int dbmap_reserve(dbmap_t *map, size_t slots, size_t records) {
+    if (slots_reserve(map, slots) != STATUS_SUCCESS) return STATUS_ERROR;
+    return heap_reserve(map, records * DBMAP_PREPARE_BYTES);
+}
+
+/**
+ * @brief 判断槽位是否是有效记录。
+ */
+/**
+ * @brief 垃圾为 0 时记录堆中只有有效记录，再按槽位有序即与完整列表一致。
+ */
+bool dbmap_heap_is_list(const dbmap_t *map) {
+    return map->heap_sorted &&
+           map->hdr.heap_end - HEAP_START == map->live_bytes;
+}
+
+bool dbmap_is_live(const dbmap_t *map, size_t slot) {
+    return slot < map->hdr.count && !dead_test(map, slot);
+}
+
+/**
+ * @brief 通过槽位表定位并解码记录，再用写入时的校验和检查映射中的字节。
+ */
+bool dbmap_view(const dbmap_t *map, size_t slot, dbrec_t *rec) {
+    if (slot >= map->hdr.count || map->offs[slot] == 0) return false;
+    uint64_t off = map->offs[slot];
+    if (record_at(map, off, rec) == 0 ||
+        crc32c(0, rec->raw, rec->size) != map->crcs[slot]) {
+        log_error("Corrupted database: record %zu at offset %lu fails its "
+                  "checksum",
+                  slot, (unsigned long)off);
+        return false;
+    }
+    return true;
+}
+
+bool dbmap_peek(const dbmap_t *map, size_t slot, dbrec_t *rec) {
+    if (slot >= map->hdr.count || map->offs[slot] == 0) return false;
+    return record_at(map, map->offs[slot], rec) != 0;
+}
+
+/**
+ * @brief 展开为定长记录，墓碑得到全零记录。
+ */
+void dbmap_get(const dbmap_t *map, size_t slot, struct employee_t *out) {
+    dbrec_t rec;
+    if (dbmap_view(map, slot, &rec)) {
+        dbrec_to_employee(&rec, out);
+    } else {
+        memset(out, 0, sizeof(*out));
+    }
+}
+
+/**
+ * @brief 从 dead_hint 开始查找下标最小的墓碑。
+ */
+size_t dbmap_next_slot(dbmap_t *map) {
+    if (map->ndead == 0) return map->hdr.count;
+    size_t words = bitmap_words(map->hdr.count);
+    for (size_t w = map->dead_hint; w < words; w++) {
+        if (map->dead[w] != 0) {
+            map->dead_hint = w;
+            return w * 64 + (size_t)__builtin_ctzll(map->dead[w]);
+        }
+    }
+    return map->hdr.count;  // ndead 与位图不一致时退回追加
+}
+
+/**
+ * @brief 追加新版本并更新槽位表，必要时把记录数增加到 slot + 1。
+ */
+int dbmap_put(dbmap_t *map, size_t slot, const struct employee_t *employee) {
+    if (employee_is_deleted(employee)) {
+        // 重放可能写入墓碑：等价于标记删除并纳入记录数
+        if (dbmap_mark_deleted(map, slot) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        if (slot >= map->hdr.count) extend_count(map, slot + 1);
+        return STATUS_SUCCESS;
+    }
+
+    if (slots_reserve(map, slot + 1) != STATUS_SUCCESS) return STATUS_ERROR;
+    char rec[DBREC_MAX_SIZE];
+    size_t len = dbrec_encode(rec, (uint32_t)slot, employee);
+    uint64_t off;
+    if (heap_append(map, rec, len, &off) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    if (map->offs[slot] != 0) {
+        dbrec_t old;
+        map->live_bytes -= record_at(map, map->offs[slot], &old);
+    }
+    map->offs[slot] = off;
+    map->crcs[slot] = crc32c(0, rec, len);
+    map->live_bytes += len;
+    if (off > HEAP_START && slot <= map->heap_last) map->heap_sorted = false;
+    map->heap_last = slot;
+
+    if (slot < map->hdr.count) {
+        if (dead_test(map, slot)) {
+            dead_clear(map, slot);
+            map->ndead--;
+        }
+    } else {
+        // 重放时中间可能跳过一些槽位，它们随之作为墓碑进入 [0, count)
+        extend_count(map, slot);
+        map->hdr.count = slot + 1;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 有效记录追加墓碑，并把槽位记入墓碑位图。
+ */
+int dbmap_mark_deleted(dbmap_t *map, size_t slot) {
+    if (slots_reserve(map, slot + 1) != STATUS_SUCCESS) return STATUS_ERROR;
+    if (map->offs[slot] != 0) {
+        if (heap_reserve(map, DBREC_TOMBSTONE_MAX_SIZE) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        bury(map, slot);
+    }
+    if (slot < map->hdr.count && !dead_test(map, slot)) {
+        dead_set(map, slot);
+        map->ndead++;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 删除一条有效记录，保持末尾的槽位是有效记录。
+ */
+int dbmap_kill(dbmap_t *map, size_t slot) {
+    if (!dbmap_is_live(map, slot)) {
+        fprintf(stderr, "Error: No employee with id %zu\n", slot);
+        return STATUS_ERROR;
+    }
+    if (dbmap_mark_deleted(map, slot) != STATUS_SUCCESS) return STATUS_ERROR;
+    return dbmap_truncate(map, dbmap_trim_count(map, map->hdr.count));
+}
+
+/**
+ * @brief 越过末尾的墓碑。
+ */
+size_t dbmap_trim_count(const dbmap_t *map, size_t count) {
+    while (count > 0 && dead_test(map, count - 1)) count--;
+    return count;
+}
+
+/**
+ * @brief 追加一条记录。
+ */
+int dbmap_append(dbmap_t *map, const struct employee_t *employee) {
+    return dbmap_put(map, map->hdr.count, employee);
+}
+
+/**
+ * @brief 截断记录数。先为所有被截掉的有效记录预留墓碑的空间，
+ *        之后不会中途失败。
+ */
+int dbmap_truncate(dbmap_t *map, size_t count) {
+    if (count > map->hdr.count) {
+        fprintf(stderr, "Error: Cannot truncate %lu records to %zu\n",
+                (unsigned long)map->hdr.count, count);
+        return STATUS_ERROR;
+    }
+    size_t cut = 0;
+    for (size_t slot = count; slot < map->hdr.count; slot++) {
+        if (map->offs[slot] != 0) cut++;
+    }
+    if (heap_reserve(map, cut * DBREC_TOMBSTONE_MAX_SIZE) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    for (size_t slot = count; slot < map->hdr.count; slot++) {
+        if (map->offs[slot] != 0) bury(map, slot);
+        if (dead_test(map, slot)) {
+            dead_clear(map, slot);
+            map->ndead--;
+        }
+    }
+    map->hdr.count = count;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 设置记录数，增大时新纳入的槽位都是墓碑。
+ */
+int dbmap_set_count(dbmap_t *map, size_t count) {
+    if (count <= map->hdr.count) return dbmap_truncate(map, count);
+    if (slots_reserve(map, count) != STATUS_SUCCESS) return STATUS_ERROR;
+    extend_count(map, count);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 垃圾足够多，且至少占记录堆的一半时值得压缩。
+ */
+bool dbmap_should_compact(const dbmap_t *map) {
+    size_t garbage = map->hdr.heap_end - HEAP_START - map->live_bytes;
+    return garbage >= DBMAP_COMPACT_GARBAGE && garbage >= map->live_bytes;
+}
+
+/**
+ * @brief 压缩：把有效记录按槽位顺序写入新文件，刷盘后原子替换。
+ *        新文件的头部直接记录当前的记录数与堆末尾，替换之前崩溃
+ *        只会留下一个无用的 <db>.tmp。
+ */
+int dbmap_compact(dbmap_t *map) {
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", map->path) >=
+        (int)sizeof(tmp_path)) {
+        fprintf(stderr, "Error: Database path too long: '%s'\n", map->path);
+        return STATUS_ERROR;
+    }
+    int tmp_fd __attribute__((cleanup(_cleanup_fd_))) =
+        open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tmp_fd == -1) {
+        perror("open compacted database file");
+        return STATUS_ERROR;
+    }
+    size_t size = file_size_for(HEAP_START + map->live_bytes);
+    if (ftruncate(tmp_fd, (off_t)size) == -1) {
+        perror("ftruncate compacted database file");
+        unlink(tmp_path);
+        return STATUS_ERROR;
+    }
+    uint64_t *offs __attribute__((cleanup(_cleanup_ptr_))) =
+        calloc(map->capacity, sizeof(uint64_t));
+    uint32_t *sums __attribute__((cleanup(_cleanup_ptr_))) =
+        calloc(span_count(size), sizeof(uint32_t));
+    if (offs == NULL || sums == NULL) {
+        perror("calloc for compacted slot table");
+        unlink(tmp_path);
+        return STATUS_ERROR;
+    }
+    char *base =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, tmp_fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap compacted database file");
+        unlink(tmp_path);
+        return STATUS_ERROR;
+    }
+
+    uint64_t pos = HEAP_START;
+    for (size_t slot = 0; slot < map->hdr.count; slot++) {
+        dbrec_t rec;
+        if (!dbmap_is_live(map, slot)) continue;
+        if (!dbmap_view(map, slot, &rec)) {
+            // 损坏的记录不能被悄悄丢掉，保留原文件
+            fprintf(stderr, "Error: Compaction aborted, record %zu is "
+                            "corrupted\n",
+                    slot);
+            munmap(base, size);
+            unlink(tmp_path);
+            return STATUS_ERROR;
+        }
+        memcpy(base + pos, rec.raw, rec.size);
+        offs[slot] = pos;
+        pos += rec.size;
+    }
+    struct dbheader_t hdr = map->hdr;
+    hdr.filesize = size;
+    hdr.heap_end = pos;
+    memcpy(base, &hdr, sizeof(hdr));
+    sums_compute(sums, base, pos);
+
+    if (msync(base, size, MS_SYNC) == -1 ||
+        rename(tmp_path, map->path) == -1 ||
+        fsync_parent_dir(map->path) != STATUS_SUCCESS) {
+        perror("replace database file with compacted copy");
+        munmap(base, size);
+        unlink(tmp_path);
+        return STATUS_ERROR;
+    }
+
+    size_t before = map->map_size;
+    munmap(map->base, map->map_size);
+    close(map->fd);
+    map->fd = tmp_fd;
+    tmp_fd = -1;  // 已归 map 所有
+    map->hdr = hdr;
+    attach_mapping(map, base, size);
+    free(map->offs);
+    map->offs = offs;
+    offs = NULL;  // 清除 cleanup 宏的作用
+    free(map->sums);
+    map->sums = sums;
+    map->nsums = span_count(size);
+    sums = NULL;  // 清除 cleanup 宏的作用
+    // 新文件的 inode 不同，旧的 <db>.crc 已经失效；这里失败时下次检查点
+    // 会再写，在那之前重启只会跳过校验
+    if (sums_save(map, pos) != STATUS_SUCCESS) {
+        perror("write checksums of compacted database");
+    }
+    map->heap_sorted = true;  // 按槽位顺序重写，没有垃圾
+    map->heap_last = hdr.count > 0 ? hdr.count - 1 : 0;
+    log_info("Compacted '%s': %zu -> %zu bytes", map->path, before, size);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 两次 msync：数据页先落盘，之后写入的校验和与头部才能指向它们。
+ */
+int dbmap_sync(dbmap_t *map, uint64_t count) {
+    if (msync(map->base, map->map_size, MS_SYNC) == -1) return STATUS_ERROR;
+    if (sums_save(map, map->hdr.heap_end) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    map->disk_hdr->count = count;
+    map->disk_hdr->filesize = map->map_size;
+    map->disk_hdr->heap_end = map->hdr.heap_end;
+    if (msync(map->base, sizeof(struct dbheader_t), MS_SYNC) == -1) {
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 分块计算校验和并写出，校验和在写入之前计算，数据页仍在缓存中。
+ */
+int dbmap_write_image(const dbmap_t *map, int fd, uint32_t *crcOut) {
+    struct dbheader_t hdr;
+    dbmap_image_hdr(map, &hdr);
+    uint32_t crc = crc32c(0, &hdr, sizeof(hdr));
+    if (write_all(fd, &hdr, sizeof(hdr)) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    for (uint64_t off = HEAP_START; off < hdr.heap_end;) {
+        size_t len = hdr.heap_end - off < IMAGE_CHUNK
+                         ? (size_t)(hdr.heap_end - off)
+                         : IMAGE_CHUNK;
+        crc = crc32c(crc, map->base + off, len);
+        if (write_all(fd, map->base + off, len) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        off += len;
+    }
+    *crcOut = crc;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 镜像截止到记录堆末尾，没有预留的空间。
+ */
+void dbmap_image_hdr(const dbmap_t *map, struct dbheader_t *hdrOut) {
+    *hdrOut = map->hdr;
+    hdrOut->filesize = map->hdr.heap_end;
+}
+
+/**
+ * @brief 解除映射并关闭文件。
+ */
+void dbmap_close(dbmap_t *map) {
+    if (map == NULL) return;
+    if (map->base != NULL) munmap(map->base, map->map_size);
+    if (map->fd != -1) close(map->fd);
+    free(map->offs);
+    free(map->dead);
+    free(map->crcs);
+    free(map->sums);
+    free(map);
+}
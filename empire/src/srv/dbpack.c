@@ -0,0 +1,431 @@
+#include "../../include/dbpack.h"  // 包含打包镜像格式的声明
+
+#include <fcntl.h>     // For open, O_RDONLY, O_WRONLY, O_CREAT
+#include <limits.h>    // For PATH_MAX
+#include <stdio.h>     // For perror, fprintf, printf, snprintf, rename
+#include <stdlib.h>    // For malloc, free
+#include <string.h>    // For memcpy, memset
+#include <sys/mman.h>  // For mmap, munmap
+#include <sys/stat.h>  // For fstat
+#include <unistd.h>    // For lseek, fsync, unlink
+
+#include "../../include/checksum.h"  // 包含 crc32c
+#include "../../include/common.h"    // 包含 STATUS_SUCCESS 等宏
+#include "../../include/file.h"  // 包含 write_all, read_all, fsync_parent_dir
+
+/**
+ * @brief LZ4 块格式的常量：最短匹配、最后必须是字面量的字节数，
+ *        以及末尾多少字节之内不再开始新的匹配
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MF_LIMIT 12
+
+/**
+ * @brief 压缩用哈希表的位数（4096 项，每项是块内的 16 位偏移）
+ */
+#define LZ_HASH_BITS 12
+
+/* ---------------- LZ4 块格式 ---------------- */
+
+/**
+ * @brief 读取 4 个字节（不要求对齐）。
+ */
+static uint32_t read32(const char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief 4 字节序列的哈希（Knuth 乘法哈希）。
+ */
+static unsigned lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * @brief 写出超过 15 的长度的剩余部分：若干个 255 加一个小于 255 的字节。
+ */
+static char *lz_put_len(char *op, size_t len) {
+    while (len >= 255) {
+        *op++ = (char)255;
+        len -= 255;
+    }
+    *op++ = (char)len;
+    return op;
+}
+
+/**
+ * @brief 写出一个序列：标记字节、字面量长度、字面量，以及（mlen 非 0 时）
+ *        2 字节小端距离和匹配长度。最后一个序列只有字面量。
+ */
+static char *lz_emit(char *op, const char *lit, size_t nlit, size_t dist,
+                     size_t mlen) {
+    char *token = op++;
+    unsigned t = nlit >= 15 ? 15 : (unsigned)nlit;
+    if (nlit >= 15) op = lz_put_len(op, nlit - 15);
+    memcpy(op, lit, nlit);
+    op += nlit;
+    if (mlen == 0) {
+        *token = (char)(t << 4);
+        return op;
+    }
+    *op++ = (char)(dist & 0xFF);
+    *op++ = (char)(dist >> 8);
+    size_t m = mlen - LZ_MIN_MATCH;
+    unsigned tm = m >= 15 ? 15 : (unsigned)m;
+    if (m >= 15) op = lz_put_len(op, m - 15);
+    *token = (char)((t << 4) | tm);
+    return op;
+}
+
+/**
+ * @brief 贪心压缩：哈希表记录每个 4 字节序列最近出现的位置，
+ *        命中且内容相同时尽量向后延长匹配。
+ */
+size_t dbpack_compress(const char *src, size_t len, char *dst) {
+    uint16_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));  // 0 也是合法位置，命中后总会比较内容
+    const char *ip = src, *anchor = src, *end = src + len;
+    char *op = dst;
+
+    if (len > LZ_MF_LIMIT) {
+        const char *limit = end - LZ_MF_LIMIT;
+        const char *match_end = end - LZ_LAST_LITERALS;
+        ip++;
+        while (ip < limit) {
+            unsigned h = lz_hash(read32(ip));
+            const char *ref = src + table[h];
+            table[h] = (uint16_t)(ip - src);
+            if (ref >= ip || read32(ref) != read32(ip)) {
+                ip++;
+                continue;
+            }
+            const char *mp = ip + LZ_MIN_MATCH, *rp = ref + LZ_MIN_MATCH;
+            while (mp < match_end && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+            op = lz_emit(op, anchor, (size_t)(ip - anchor), (size_t)(ip - ref),
+                         (size_t)(mp - ip));
+            ip = anchor = mp;
+        }
+    }
+    op = lz_emit(op, anchor, (size_t)(end - anchor), 0, 0);
+    return (size_t)(op - dst);
+}
+
+/**
+ * @brief 读取超过 15 的长度的剩余部分，累加到 *len。
+ * @return 成功时返回 STATUS_SUCCESS，输入提前结束时返回 STATUS_ERROR。
+ */
+static int lz_get_len(const unsigned char **ip, const unsigned char *iend,
+                      size_t *len) {
+    unsigned char b;
+    do {
+        if (*ip >= iend) return STATUS_ERROR;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 逐个序列解码，每一步都检查输入和输出的剩余空间与匹配距离。
+ */
+int dbpack_decompress(const char *src, size_t len, char *dst, size_t raw) {
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + len;
+    char *op = dst, *oend = dst + raw;
+
+    for (;;) {
+        if (ip >= iend) return STATUS_ERROR;
+        unsigned token = *ip++;
+        size_t nlit = token >> 4;
+        if (nlit == 15 && lz_get_len(&ip, iend, &nlit) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        if (nlit > (size_t)(iend - ip) || nlit > (size_t)(oend - op)) {
+            return STATUS_ERROR;
+        }
+        memcpy(op, ip, nlit);
+        op += nlit;
+        ip += nlit;
+        if (ip == iend) break;  // 最后一个序列只有字面量
+
+        if (iend - ip < 2) return STATUS_ERROR;
+        size_t dist = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        size_t mlen = token & 15;
+        if (mlen == 15 && lz_get_len(&ip, iend, &mlen) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        mlen += LZ_MIN_MATCH;
+        if (dist == 0 || dist > (size_t)(op - dst) ||
+            mlen > (size_t)(oend - op)) {
+            return STATUS_ERROR;
+        }
+        const char *ref = op - dist;
+        if (dist >= mlen) {
+            memcpy(op, ref, mlen);
+            op += mlen;
+        } else {
+            while (mlen--) *op++ = *ref++;  // 重叠的匹配逐字节复制
+        }
+    }
+    return op == oend ? STATUS_SUCCESS : STATUS_ERROR;
+}
+
+/* ---------------- 打包与恢复 ---------------- */
+
+/**
+ * @brief 逐块压缩镜像。第一块的开头是镜像头部而不是磁盘头部，
+ *        先拼到工作缓冲区中；其余块直接从映射读取。
+ *        不可压缩的块原样存储。块索引在全部数据块之后写出。
+ */
+int dbpack_write_image(const dbmap_t *map, int fd, uint32_t *crcOut,
+                       uint64_t *packedOut) {
+    struct dbheader_t hdr;
+    dbmap_image_hdr(map, &hdr);
+    uint64_t raw_size = hdr.heap_end;
+    uint64_t nblocks = (raw_size + DBPACK_BLOCK_SIZE - 1) / DBPACK_BLOCK_SIZE;
+
+    // 工作内存：第一块、压缩输出和块索引，来自匿名映射而不是 malloc
+    size_t out_cap = DBPACK_BOUND(DBPACK_BLOCK_SIZE);
+    size_t index_len = nblocks * sizeof(dbpack_index_t);
+    size_t work = DBPACK_BLOCK_SIZE + out_cap + index_len;
+    char *mem = mmap(NULL, work, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return STATUS_ERROR;
+    char *first = mem;
+    char *out = mem + DBPACK_BLOCK_SIZE;
+    dbpack_index_t *index = (dbpack_index_t *)(out + out_cap);
+
+    int status = STATUS_ERROR;
+    dbpack_hdr_t phdr = {
+        .magic = DBPACK_MAGIC,
+        .version = DBPACK_VERSION,
+        .block_size = DBPACK_BLOCK_SIZE,
+        .raw_size = raw_size,
+    };
+    uint64_t pos = sizeof(phdr);
+    uint32_t image_crc = 0;
+    if (write_all(fd, &phdr, sizeof(phdr)) != STATUS_SUCCESS) goto out;
+
+    for (uint64_t b = 0; b < nblocks; b++) {
+        uint64_t start = b * DBPACK_BLOCK_SIZE;
+        size_t raw = raw_size - start < DBPACK_BLOCK_SIZE
+                         ? (size_t)(raw_size - start)
+                         : DBPACK_BLOCK_SIZE;
+        const char *src = map->base + start;
+        if (b == 0) {
+            memcpy(first, &hdr, sizeof(hdr));
+            memcpy(first + sizeof(hdr), map->base + sizeof(hdr),
+                   raw - sizeof(hdr));
+            src = first;
+        }
+        image_crc = crc32c(image_crc, src, raw);
+
+        const char *data = out;
+        size_t stored = dbpack_compress(src, raw, out);
+        uint32_t codec = DBPACK_LZ;
+        if (stored >= raw) {
+            data = src;
+            stored = raw;
+            codec = DBPACK_RAW;
+        }
+        index[b] = (dbpack_index_t){
+            .offset = pos,
+            .stored = (uint32_t)stored,
+            .raw = (uint32_t)raw,
+            .crc = crc32c(0, data, stored),
+            .codec = codec,
+        };
+        if (write_all(fd, data, stored) != STATUS_SUCCESS) goto out;
+        pos += stored;
+    }
+
+    dbpack_footer_t footer = {
+        .index_offset = pos,
+        .nblocks = nblocks,
+        .index_crc = crc32c(0, index, index_len),
+        .image_crc = image_crc,
+        .magic = DBPACK_MAGIC,
+    };
+    if (write_all(fd, index, index_len) != STATUS_SUCCESS ||
+        write_all(fd, &footer, sizeof(footer)) != STATUS_SUCCESS) {
+        goto out;
+    }
+    *crcOut = image_crc;
+    if (packedOut != NULL) *packedOut = pos + index_len + sizeof(footer);
+    status = STATUS_SUCCESS;
+out:
+    munmap(mem, work);
+    return status;
+}
+
+/**
+ * @brief 读取并校验打包镜像的头部、尾部与块索引。
+ * @param fd 打包镜像
+ * @param pack_path 打包镜像路径，用于报错
+ * @param hdr 输出参数，返回头部
+ * @param footer 输出参数，返回尾部
+ * @return 块索引（调用者 free），格式错误或损坏时返回 NULL。
+ */
+static dbpack_index_t *read_index(int fd, const char *pack_path,
+                                  dbpack_hdr_t *hdr, dbpack_footer_t *footer) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        return NULL;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+    if (size < sizeof(*hdr) + sizeof(*footer) ||
+        read_all(fd, hdr, sizeof(*hdr)) != STATUS_SUCCESS ||
+        lseek(fd, (off_t)(size - sizeof(*footer)), SEEK_SET) == -1 ||
+        read_all(fd, footer, sizeof(*footer)) != STATUS_SUCCESS ||
+        hdr->magic != DBPACK_MAGIC || footer->magic != DBPACK_MAGIC) {
+        fprintf(stderr, "Error: '%s' is not a packed database image\n",
+                pack_path);
+        return NULL;
+    }
+    uint64_t nblocks =
+        (hdr->raw_size + DBPACK_BLOCK_SIZE - 1) / DBPACK_BLOCK_SIZE;
+    if (hdr->version != DBPACK_VERSION ||
+        hdr->block_size != DBPACK_BLOCK_SIZE ||
+        hdr->raw_size < sizeof(struct dbheader_t) ||
+        footer->nblocks != nblocks ||
+        footer->index_offset < sizeof(*hdr) ||
+        footer->index_offset + nblocks * sizeof(dbpack_index_t) +
+                sizeof(*footer) != size) {
+        fprintf(stderr, "Error: Packed image '%s' has a bad header or footer\n",
+                pack_path);
+        return NULL;
+    }
+
+    size_t index_len = nblocks * sizeof(dbpack_index_t);
+    dbpack_index_t *index = malloc(index_len);
+    if (index == NULL) {
+        perror("malloc for block index");
+        return NULL;
+    }
+    if (lseek(fd, (off_t)footer->index_offset, SEEK_SET) == -1 ||
+        read_all(fd, index, index_len) != STATUS_SUCCESS ||
+        crc32c(0, index, index_len) != footer->index_crc) {
+        fprintf(stderr, "Error: Block index of '%s' is corrupted\n",
+                pack_path);
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+/**
+ * @brief 把一块读入 in，校验后解压（或原样使用）。
+ * @return 解包后的数据，损坏时返回 NULL。
+ */
+static const char *read_block(int fd, const dbpack_index_t *entry,
+                              uint64_t expect_raw, uint64_t index_offset,
+                              char *in, char *out) {
+    if (entry->raw != expect_raw ||
+        entry->stored > DBPACK_BOUND(DBPACK_BLOCK_SIZE) ||
+        entry->offset < sizeof(dbpack_hdr_t) ||
+        entry->offset + entry->stored > index_offset ||
+        lseek(fd, (off_t)entry->offset, SEEK_SET) == -1 ||
+        read_all(fd, in, entry->stored) != STATUS_SUCCESS ||
+        crc32c(0, in, entry->stored) != entry->crc) {
+        return NULL;
+    }
+    if (entry->codec == DBPACK_RAW) {
+        return entry->stored == entry->raw ? in : NULL;
+    }
+    if (entry->codec != DBPACK_LZ ||
+        dbpack_decompress(in, entry->stored, out, entry->raw) !=
+            STATUS_SUCCESS) {
+        return NULL;
+    }
+    return out;
+}
+
+/**
+ * @brief 逐块恢复到 <db>.tmp，全部校验通过后原子替换。
+ */
+int dbpack_restore(const char *pack_path, const char *db_path) {
+    int in_fd __attribute__((cleanup(_cleanup_fd_))) =
+        open(pack_path, O_RDONLY | O_CLOEXEC);
+    if (in_fd == -1) {
+        perror("open packed image");
+        return STATUS_ERROR;
+    }
+    dbpack_hdr_t hdr;
+    dbpack_footer_t footer;
+    dbpack_index_t *index __attribute__((cleanup(_cleanup_ptr_))) =
+        read_index(in_fd, pack_path, &hdr, &footer);
+    if (index == NULL) return STATUS_ERROR;
+
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", db_path) >=
+        (int)sizeof(tmp_path)) {
+        fprintf(stderr, "Error: Database path too long: '%s'\n", db_path);
+        return STATUS_ERROR;
+    }
+    char *in __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(DBPACK_BOUND(DBPACK_BLOCK_SIZE));
+    char *out __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(DBPACK_BLOCK_SIZE);
+    if (in == NULL || out == NULL) {
+        perror("malloc for restore buffers");
+        return STATUS_ERROR;
+    }
+    int out_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out_fd == -1) {
+        perror("open restore file");
+        return STATUS_ERROR;
+    }
+
+    int status = STATUS_SUCCESS;
+    uint32_t image_crc = 0;
+    uint64_t packed = 0;
+    for (uint64_t b = 0; b < footer.nblocks && status == STATUS_SUCCESS;
+         b++) {
+        uint64_t start = b * DBPACK_BLOCK_SIZE;
+        uint64_t raw = hdr.raw_size - start < DBPACK_BLOCK_SIZE
+                           ? hdr.raw_size - start
+                           : DBPACK_BLOCK_SIZE;
+        const char *data =
+            read_block(in_fd, &index[b], raw, footer.index_offset, in, out);
+        if (data == NULL) {
+            fprintf(stderr,
+                    "Error: Block %lu of '%s' (image bytes %lu-%lu) is "
+                    "corrupted\n",
+                    (unsigned long)b, pack_path, (unsigned long)start,
+                    (unsigned long)(start + raw));
+            status = STATUS_ERROR;
+            break;
+        }
+        image_crc = crc32c(image_crc, data, raw);
+        packed += index[b].stored;
+        status = write_all(out_fd, data, raw);
+    }
+    if (status == STATUS_SUCCESS && image_crc != footer.image_crc) {
+        fprintf(stderr, "Error: Image checksum mismatch in '%s'\n", pack_path);
+        status = STATUS_ERROR;
+    }
+    if (status == STATUS_SUCCESS && fsync(out_fd) == -1) status = STATUS_ERROR;
+    if (close(out_fd) == -1) status = STATUS_ERROR;
+    if (status == STATUS_SUCCESS && (rename(tmp_path, db_path) == -1 ||
+                                     fsync_parent_dir(db_path) !=
+                                         STATUS_SUCCESS)) {
+        perror("rename restored database");
+        status = STATUS_ERROR;
+    }
+    if (status != STATUS_SUCCESS) {
+        unlink(tmp_path);
+        return STATUS_ERROR;
+    }
+    printf("Restored '%s' from '%s': %lu blocks, read %lu of %lu bytes\n",
+           db_path, pack_path, (unsigned long)footer.nblocks,
+           (unsigned long)packed, (unsigned long)hdr.raw_size);
+    return STATUS_SUCCESS;
+}
@@ -1,11 +1,14 @@
 #include "../../include/file.h"  // 包含 file.h 声明
 
-#include <errno.h>      // For errno, ENOENT
-#include <fcntl.h>      // For open, O_RDWR, O_CREAT
+#include <errno.h>      // For errno, ENOENT, EINTR
+#include <fcntl.h>      // For open, O_RDWR, O_CREAT, O_DIRECTORY
+#include <libgen.h>     // For dirname
+#include <limits.h>     // For PATH_MAX
 #include <stdio.h>      // For perror, fprintf
+#include <string.h>     // For strncpy
 #include <sys/stat.h>   // For open, stat
 #include <sys/types.h>  // For open, stat
-#include <unistd.h>     // For open, close
+#include <unistd.h>     // For open, close, read, write, fsync
 
 #include "../../include/common.h"  // 包含 STATUS_ERROR 等宏
 
@@ -53,4 +56,64 @@ int open_db_file(char *filename) {
     }
 
     return fd;
+}
+
+/**
+ * @brief 对文件所在目录执行 fsync，保证 rename/unlink/create 持久化。
+ * @param path 文件路径
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int fsync_parent_dir(const char *path) {
+    char dir_buf[PATH_MAX];
+    strncpy(dir_buf, path, sizeof(dir_buf) - 1);
+    dir_buf[sizeof(dir_buf) - 1] = '\0';
+
+    int dirfd __attribute__((cleanup(_cleanup_fd_))) =
+        open(dirname(dir_buf), O_RDONLY | O_DIRECTORY);
+    if (dirfd == -1) return STATUS_ERROR;
+    return fsync(dirfd) == -1 ? STATUS_ERROR : STATUS_SUCCESS;
+}
+
+/**
+ * @brief 完整写入缓冲区，处理短写和 EINTR。
+ * @param fd 文件描述符
+ * @param buf 数据缓冲区
+ * @param len 要写入的字节数
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int write_all(int fd, const void *buf, size_t len) {
+    const char *ptr = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, ptr, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return STATUS_ERROR;
+        }
+        ptr += n;
+        len -= n;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 完整读取 len 字节，处理短读和 EINTR。
+ * @param fd 文件描述符
+ * @param buf 接收数据的缓冲区
+ * @param len 要读取的字节数
+ * @return 成功时返回 STATUS_SUCCESS，错误或提前遇到文件结尾时返回
+ * STATUS_ERROR。
+ */
+int read_all(int fd, void *buf, size_t len) {
+    char *ptr = (char *)buf;
+    while (len > 0) {
+        ssize_t n = read(fd, ptr, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return STATUS_ERROR;
+        }
+        if (n == 0) return STATUS_ERROR;  // 文件比预期短
+        ptr += n;
+        len -= n;
+    }
+    return STATUS_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "../../include/histogram.h"  // 包含 hist_t 声明
+
+#include <string.h>  // For memset
+
+/**
+ * @brief 每个数量级的子桶数，以及小于它两倍的值直接作为下标的界限
+ */
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_LINEAR (2 * HIST_SUB)
+
+/**
+ * @brief 计算值所在的桶。value >> shift 总是落在 [HIST_SUB, 2 * HIST_SUB)，
+ *        即保留最高的 HIST_SUB_BITS + 1 位。
+ */
+static size_t bucket_of(uint64_t value) {
+    if (value < HIST_LINEAR) return (size_t)value;
+    unsigned msb = 63 - (unsigned)__builtin_clzll(value);
+    unsigned shift = msb - HIST_SUB_BITS;
+    size_t idx =
+        ((size_t)(shift + 1) << HIST_SUB_BITS) + (value >> shift) - HIST_SUB;
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief 计算桶中最大的值。
+ */
+static uint64_t bucket_high(size_t idx) {
+    if (idx < HIST_LINEAR) return idx;
+    unsigned shift = (unsigned)(idx >> HIST_SUB_BITS) - 1;
+    uint64_t top = (idx & (HIST_SUB - 1)) + HIST_SUB;
+    return ((top + 1) << shift) - 1;
+}
+
+void hist_init(hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hist_record(hist_t *h, uint64_t value) {
+    h->counts[bucket_of(value)]++;
+    h->total++;
+    h->sum += (double)value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void hist_merge(hist_t *dst, const hist_t *src) {
+    for (size_t i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const hist_t *h, double percentile) {
+    if (h->total == 0) return 0;
+    // 第 rank 个值（从 1 开始）所在的桶
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->total + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > h->total) rank = h->total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t high = bucket_high(i);
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const hist_t *h) {
+    return h->total ? h->sum / (double)h->total : 0;
+}
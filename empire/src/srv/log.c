@@ -0,0 +1,184 @@
+#include "../../include/log.h"  // 包含 log_write 声明
+
+#include <pthread.h>  // For pthread_create, pthread_mutex_t, pthread_cond_t
+#include <signal.h>   // For sigfillset, pthread_sigmask
+#include <stdarg.h>   // For va_list
+#include <stdbool.h>  // For bool
+#include <stdint.h>   // For uint64_t
+#include <stdio.h>    // For vsnprintf, fwrite, fflush
+#include <stdlib.h>   // For malloc, free
+#include <string.h>   // For memcpy, strerror
+
+#include "../../include/common.h"  // 包含 STATUS_SUCCESS 等宏
+
+/**
+ * @brief 当前的日志级别
+ */
+log_level_e log_level = LOG_INFO;
+
+/**
+ * @brief 环形缓冲区中的一条日志
+ */
+typedef struct {
+    log_level_e level;        ///< 日志级别，决定写到 stdout 还是 stderr
+    size_t len;               ///< 消息长度（含换行）
+    char text[LOG_LINE_MAX];  ///< 格式化后的消息，不以 '\0' 结尾
+} log_slot_t;
+
+/**
+ * @brief 后台写日志的状态。[tail, head) 是尚未写出的日志，写线程在
+ *        锁外读取它们：生产者只写 head 处的槽位，tail 在写出之后才前进，
+ *        所以这些槽位在写出期间不会被覆盖。
+ */
+static struct {
+    log_slot_t *slots;      ///< LOG_RING_SLOTS 个槽位
+    uint64_t head;          ///< 下一条日志写入的位置
+    uint64_t tail;          ///< 下一条要写出的日志
+    uint64_t dropped;       ///< 缓冲区满时丢弃、尚未报告的日志数
+    bool running;           ///< 后台线程是否在运行
+    bool stopping;          ///< 要求后台线程写完后退出
+    pthread_t thread;       ///< 后台写日志线程
+    pthread_mutex_t lock;   ///< 保护以上状态
+    pthread_cond_t cond;    ///< 有新日志或要求退出时通知后台线程
+} logger = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * @brief 写出一条日志。LOG_WARN 及以上写到 stderr。
+ */
+static void log_emit(log_level_e level, const char *text, size_t len) {
+    fwrite(text, 1, len, level >= LOG_WARN ? stderr : stdout);
+}
+
+/**
+ * @brief 写出 [from, to) 的日志并刷新 stdout。
+ */
+static void log_emit_range(uint64_t from, uint64_t to) {
+    for (uint64_t i = from; i != to; i++) {
+        const log_slot_t *slot = &logger.slots[i & (LOG_RING_SLOTS - 1)];
+        log_emit(slot->level, slot->text, slot->len);
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief 后台线程：等待新日志，每次把积累的全部日志一起写出。
+ * @param arg 未使用
+ * @return 总是 NULL。
+ */
+static void *log_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&logger.lock);
+    for (;;) {
+        while (logger.head == logger.tail && logger.dropped == 0 &&
+               !logger.stopping) {
+            pthread_cond_wait(&logger.cond, &logger.lock);
+        }
+        if (logger.head == logger.tail && logger.dropped == 0) break;
+        uint64_t from = logger.tail;
+        uint64_t to = logger.head;
+        uint64_t dropped = logger.dropped;
+        logger.dropped = 0;
+        pthread_mutex_unlock(&logger.lock);
+
+        if (dropped > 0) {
+            fprintf(stderr, "Warning: Log buffer full, dropped %lu messages\n",
+                    (unsigned long)dropped);
+        }
+        log_emit_range(from, to);
+
+        pthread_mutex_lock(&logger.lock);
+        logger.tail = to;
+    }
+    pthread_mutex_unlock(&logger.lock);
+    return NULL;
+}
+
+/**
+ * @brief 申请环形缓冲区，屏蔽所有信号后创建后台线程。
+ */
+int log_start(void) {
+    log_slot_t *slots = malloc(sizeof(log_slot_t) * LOG_RING_SLOTS);
+    if (slots == NULL) {
+        perror("malloc for log buffer");
+        return STATUS_ERROR;
+    }
+    fflush(stdout);  // 之前同步写出的日志排在前面
+
+    pthread_mutex_lock(&logger.lock);
+    logger.slots = slots;
+    logger.head = logger.tail = logger.dropped = 0;
+    logger.stopping = false;
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&logger.thread, NULL, log_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        logger.slots = NULL;
+        pthread_mutex_unlock(&logger.lock);
+        free(slots);
+        fprintf(stderr, "Error: pthread_create: %s\n", strerror(err));
+        return STATUS_ERROR;
+    }
+    logger.running = true;
+    pthread_mutex_unlock(&logger.lock);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 通知后台线程写完退出，再写出它退出之后才到达的日志。
+ */
+void log_stop(void) {
+    pthread_mutex_lock(&logger.lock);
+    if (!logger.running) {
+        pthread_mutex_unlock(&logger.lock);
+        return;
+    }
+    logger.stopping = true;
+    pthread_cond_signal(&logger.cond);
+    pthread_mutex_unlock(&logger.lock);
+    pthread_join(logger.thread, NULL);
+
+    pthread_mutex_lock(&logger.lock);
+    log_emit_range(logger.tail, logger.head);
+    logger.running = false;
+    free(logger.slots);
+    logger.slots = NULL;
+    pthread_mutex_unlock(&logger.lock);
+}
+
+/**
+ * @brief 在调用线程中格式化，然后拷贝进环形缓冲区；后台线程没有运行时
+ *        直接写出。
+ */
+void log_write(log_level_e level, const char *fmt, ...) {
+    char line[LOG_LINE_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    size_t len = (size_t)n < sizeof(line) - 2 ? (size_t)n : sizeof(line) - 2;
+    line[len++] = '\n';
+
+    pthread_mutex_lock(&logger.lock);
+    if (!logger.running) {
+        pthread_mutex_unlock(&logger.lock);
+        log_emit(level, line, len);
+        return;
+    }
+    if (logger.head - logger.tail == LOG_RING_SLOTS) {
+        logger.dropped++;  // 由后台线程报告
+    } else {
+        log_slot_t *slot = &logger.slots[logger.head & (LOG_RING_SLOTS - 1)];
+        slot->level = level;
+        slot->len = len;
+        memcpy(slot->text, line, len);
+        logger.head++;
+        pthread_cond_signal(&logger.cond);
+    }
+    pthread_mutex_unlock(&logger.lock);
+}
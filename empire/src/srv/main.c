@@ -8,12 +8,16 @@
 #include <unistd.h>  // For close, write, read
 
 #include "../../include/common.h"  // 包含通用宏、协议结构和网络读写函数
+#include "../../include/dbindex.h"  // 包含 name/hours 二级索引
+#include "../../include/dbpack.h"   // 包含打包镜像的恢复
+#include "../../include/dbmap.h"  // 包含内存映射的数据库
 #include "../../include/file.h"   // 包含文件操作函数
+#include "../../include/log.h"    // 包含异步日志
 #include "../../include/parse.h"  // 包含数据库解析和员工结构
-#include "../../include/srvpoll.h"  // 包含服务器轮询和客户端状态管理
-
-// 全局客户端状态数组，存储所有连接客户端的信息
-clientstate_t clientStates[MAX_CLIENTS];
+#include "../../include/reactor.h"  // 包含 epoll 事件循环
+#include "../../include/repl.h"     // 包含主从复制的副本一侧
+#include "../../include/srvpoll.h"  // 包含客户端状态管理
+#include "../../include/wal.h"      // 包含预写日志
 
 // 全局退出标志，volatile sig_atomic_t 确保在信号处理函数中安全修改
 static volatile sig_atomic_t server_should_exit = 0;
@@ -30,6 +34,30 @@ static void handle_sigint(int sig) {
     }
 }
 
+/**
+ * @brief 列出数据库中的所有员工信息到标准输出，跳过已删除的槽位。
+ *        名字和地址直接从映射中的紧凑记录打印，不拷贝。
+ * @param map 映射的数据库（只读）
+ */
+static void list_employees(const dbmap_t *map) {
+    if (dbmap_live(map) == 0) {
+        printf("No employees to list.\n");
+        return;
+    }
+
+    printf("\n--- Employee List (%lu slots) ---\n",
+           (unsigned long)map->hdr.count);
+    dbrec_t rec;
+    for (size_t i = 0; i < map->hdr.count; ++i) {
+        if (!dbmap_view(map, i, &rec)) continue;
+        printf("Employee id %zu:\n", i);
+        printf("\tName: %.*s\n", (int)rec.name_len, rec.name);
+        printf("\tAddress: %.*s\n", (int)rec.address_len, rec.address);
+        printf("\tHours: %u\n", rec.hours);
+    }
+    printf("----------------------------------\n\n");
+}
+
 /**
  * @brief 打印服务器程序的命令行用法。
  * @param argv 程序参数数组
@@ -46,177 +74,22 @@ void print_usage(char *argv[]) {
     fprintf(stderr,
             "\t -r - remove the last employee (only for non-server mode)\n");
     fprintf(stderr, "\t -p - (required) port for the server to listen on\n");
+    fprintf(stderr,
+            "\t -t <threads> - number of event loop threads (default 1)\n");
+    fprintf(stderr,
+            "\t -R <ip:port> - run as a read-only replica of that primary "
+            "(replaces the database file with the primary's image)\n");
+    fprintf(stderr,
+            "\t -x <packed image> - restore the database file from a "
+            "snapshot (e.g. <db>.snap) before opening it\n");
+    fprintf(stderr,
+            "\t -i <seconds> - close connections idle this long (default "
+            "%d, 0 disables)\n",
+            CLIENT_IDLE_TIMEOUT_MS / 1000);
+    fprintf(stderr, "\t -v - verbose: log every connection and request\n");
     return;
 }
 
-/**
- * @brief 填充 pollfd 结构体数组，准备调用 poll()。
- *        监听套接字放在 fds[0]，活跃客户端套接字按顺序添加。
- * @param fds pollfd 数组
- * @param listen_fd 监听套接字文件描述符
- * @param clientStates 客户端状态数组
- * @param max_clients 客户端状态数组的最大大小
- * @param current_nfds 指向当前活跃文件描述符数量的指针
- */
-static void fill_pollfds(struct pollfd *fds, int listen_fd,
-                         const clientstate_t *clientStates, int max_clients,
-                         int *current_nfds) {
-    memset(fds, 0, (max_clients + 1) * sizeof(struct pollfd));  // 每次重新填充
-    int nfds_count = 0;
-
-    // 添加监听套接字
-    fds[nfds_count].fd = listen_fd;
-    fds[nfds_count].events = POLLIN;  // 关注可读事件
-    nfds_count++;
-
-    // 添加所有活跃的客户端套接字
-    for (int i = 0; i < max_clients; ++i) {
-        if (clientStates[i].fd != -1) {
-            fds[nfds_count].fd = clientStates[i].fd;
-            fds[nfds_count].events = POLLIN;  // 关注可读事件
-            nfds_count++;
-        }
-    }
-    *current_nfds = nfds_count;
-}
-
-/**
- * @brief 服务器主循环，使用 poll() 进行 I/O 多路复用。
- *        处理新连接、接收客户端消息，并根据 FSM 转发处理。
- * @param port 服务器监听端口
- * @param dbhdr 指向数据库头部
- * @param employees_ptr 指向员工数组的指针（FSM 可能修改它）
- */
-void poll_loop(unsigned short port, struct dbheader_t *dbhdr,
-               struct employee_t **employees_ptr) {
-    // 监听套接字文件描述符，使用 cleanup 宏确保自动关闭
-    int listen_fd __attribute__((cleanup(_cleanup_fd_))) = -1;
-    int conn_fd;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-
-    // pollfd 数组，用于传递给 poll()，大小为 MAX_CLIENTS + 1 (监听套接字)
-    struct pollfd *fds __attribute__((cleanup(_cleanup_ptr_))) =
-        calloc(MAX_CLIENTS + 1, sizeof(struct pollfd));
-    if (fds == NULL) {
-        perror("calloc for pollfds");
-        exit(EXIT_FAILURE);
-    }
-
-    int nfds = 0;  // 活跃文件描述符的数量
-    int opt = 1;   // 用于 setsockopt
-
-    // 初始化所有客户端状态槽位
-    init_clients(clientStates, MAX_CLIENTS);
-
-    // 创建监听套接字
-    if ((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-        perror("socket");
-        exit(EXIT_FAILURE);
-    }
-
-    // 设置套接字选项：允许地址重用，防止 TIME_WAIT 状态导致重启失败
-    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-        perror("setsockopt");
-        exit(EXIT_FAILURE);
-    }
-
-    // 配置服务器地址结构体
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;  // 监听所有可用网络接口
-    server_addr.sin_port = htons(port);        // 端口转换为网络字节序
-
-    // 绑定套接字到指定地址和端口
-    if (bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) ==
-        -1) {
-        perror("bind");
-        exit(EXIT_FAILURE);
-    }
-
-    // 启动监听，将套接字设为被动连接模式
-    if (listen(listen_fd, 10) == -1) {  // 监听队列长度为 10
-        perror("listen");
-        exit(EXIT_FAILURE);
-    }
-    printf("Server listening on port %d\n", port);
-
-    // 服务器主循环：持续监听客户端连接和消息，直到收到退出信号
-    while (!server_should_exit) {
-        // 每次 poll 前都重新填充 fds 数组并计算 nfds
-        fill_pollfds(fds, listen_fd, clientStates, MAX_CLIENTS, &nfds);
-
-        // 调用 poll() 等待 I/O 事件，设置 100ms 超时，以便定期检查退出标志
-        int n_events = poll(fds, nfds, 100);
-        if (n_events == -1) {
-            // 如果 poll 被 SIGINT (中断信号) 中断，errno 会是
-            // EINTR，此时不应退出，而是继续循环
-            if (errno == EINTR) { continue; }
-            perror("poll");  // 其他错误是严重错误，退出
-            exit(EXIT_FAILURE);
-        }
-
-        // 如果 poll 超时（n_events == 0），且收到退出信号，则退出循环
-        if (n_events == 0 && server_should_exit) { break; }
-
-        // 处理监听套接字上的新连接
-        // fds[0] 总是监听套接字
-        if (fds[0].revents & POLLIN) {
-            conn_fd =
-                accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
-            if (conn_fd == -1) {
-                perror("accept");  // accept 错误，但不是致命错误，继续循环
-            } else {
-                printf("New connection from %s:%d\n",
-                       inet_ntoa(client_addr.sin_addr),
-                       ntohs(client_addr.sin_port));
-
-                // 查找一个空闲的客户端状态槽位
-                int freeSlot = find_free_slot(clientStates, MAX_CLIENTS);
-                if (freeSlot == STATUS_ERROR) {  // STATUS_ERROR == -1
-                    printf("Server full: closing new connection (fd %d)\n",
-                           conn_fd);
-                    close(conn_fd);  // 服务器满，关闭新连接
-                } else {
-                    // 初始化新客户端的状态
-                    clientStates[freeSlot].fd = conn_fd;
-                    clientStates[freeSlot].state =
-                        STATE_CONNECTED;  // 初始状态为 CONNECTED，等待 Hello
-                    clientStates[freeSlot].buffer_pos = 0;
-                    clientStates[freeSlot].msg_expected_len = 0;
-                    printf(
-                        "Client fd %d assigned to slot %d. State: CONNECTED\n",
-                        conn_fd, freeSlot);
-                }
-            }
-        }
-
-        // 遍历所有客户端状态，处理它们的事件
-        // 注意：这里的循环顺序遍历 clientStates 数组，然后查找对应的 fds 条目。
-        // 对于大量客户端，更高效的方式是在 fill_pollfds 时，将 fds 索引映射回
-        // clientStates 索引。
-        for (int i = 0; i < MAX_CLIENTS; ++i) {
-            if (clientStates[i].fd != -1) {  // 如果客户端是活跃的
-                for (int j = 1; j < nfds; ++j) {  // 从 fds[1] 开始遍历客户端的
-                                                  // fd (fds[0] 是监听套接字)
-                    if (fds[j].fd ==
-                        clientStates[i].fd) {  // 找到对应的 pollfd 条目
-                        if (fds[j].revents & POLLIN) {  // 如果有可读事件
-                            // 调用客户端 FSM 处理接收到的数据
-                            handle_client_fsm(dbhdr, employees_ptr,
-                                              &clientStates[i]);
-                        }
-                        // 如果有其他事件，例如 POLLOUT，也可以在这里处理
-                        break;  // 找到并处理了该客户端的事件，跳出内层循环
-                    }
-                }
-            }
-        }
-    }
-    printf("Poll loop exited gracefully.\n");
-    // fds 内存和 listen_fd 文件描述符会在这里被 cleanup 宏自动处理
-}
-
 /**
  * @brief 服务器程序主函数。
  *        解析命令行参数，初始化数据库，启动服务器循环或执行单次文件操作。
@@ -225,25 +98,33 @@ void poll_loop(unsigned short port, struct dbheader_t *dbhdr,
  * @return 成功时返回 STATUS_SUCCESS (0)，错误时返回 STATUS_ERROR (-1)。
  */
 int main(int argc, char *argv[]) {
-    // 自动资源清理：文件描述符、数据库头部内存、员工数组内存
+    // 自动资源清理：文件描述符、数据库映射、预写日志、二级索引、复制线程
+    // （按声明的逆序清理，复制线程在映射和索引之前停止）
     int dbfd __attribute__((cleanup(_cleanup_fd_))) = -1;
-    struct dbheader_t *dbhdr __attribute__((cleanup(_cleanup_ptr_))) = NULL;
-    struct employee_t *employees __attribute__((cleanup(_cleanup_ptr_))) = NULL;
+    dbmap_t *map __attribute__((cleanup(_cleanup_dbmap_))) = NULL;
+    wal_t *wal __attribute__((cleanup(_cleanup_wal_))) = NULL;
+    dbindex_t index __attribute__((cleanup(_cleanup_dbindex_))) = {0};
+    repl_replica_t replica __attribute__((cleanup(_cleanup_repl_replica_))) =
+        {.fd = -1};
 
     char *filepath = NULL;
     char *portarg = NULL;
     unsigned short server_port =
         0;  // 服务器监听端口，避免与 PROTO_VER 的 PORT 宏混淆
     char *addstring = NULL;
+    char *primary = NULL;  // 副本模式下主库的地址
+    char *restore = NULL;  // 启动前用来恢复数据库文件的打包镜像
     bool newfile = false;
     int c;
     bool list_employees_flag = false;
     bool remove_employee_flag = false;
+    int nthreads = 1;  // 事件循环线程数
+    long idle_secs = CLIENT_IDLE_TIMEOUT_MS / 1000;  // 空闲超时（秒）
     bool run_server_mode =
         false;  // 标志：区分是执行单次命令行操作还是启动服务器
 
     // 解析命令行参数
-    while ((c = getopt(argc, argv, "nf:p:a:lr")) != -1) {
+    while ((c = getopt(argc, argv, "nf:p:a:lrt:R:x:i:v")) != -1) {
         switch (c) {
             case 'n':  // 创建新数据库文件
                 newfile = true;
@@ -268,6 +149,42 @@ int main(int argc, char *argv[]) {
                         true;  // 如果指定了端口，默认进入服务器模式
                 }
                 break;
+            case 't': {  // 事件循环线程数
+                char *end = NULL;
+                long val = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || val < 1 ||
+                    val > REACTOR_MAX_THREADS) {
+                    fprintf(stderr,
+                            "Error: -t expects a thread count between 1 and "
+                            "%d\n",
+                            REACTOR_MAX_THREADS);
+                    return STATUS_ERROR;
+                }
+                nthreads = (int)val;
+                break;
+            }
+            case 'R':  // 作为副本运行，从主库同步
+                primary = optarg;
+                break;
+            case 'x':  // 从打包镜像恢复数据库文件
+                restore = optarg;
+                break;
+            case 'i': {  // 空闲连接超时
+                char *end = NULL;
+                idle_secs = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || idle_secs < 0 ||
+                    idle_secs > UINT32_MAX / 1000) {
+                    fprintf(stderr,
+                            "Error: -i expects a number of seconds, got "
+                            "'%s'\n",
+                            optarg);
+                    return STATUS_ERROR;
+                }
+                break;
+            }
+            case 'v':  // 输出每个连接和请求的调试日志
+                log_level = LOG_DEBUG;
+                break;
             case '?':  // 未知选项
                 fprintf(stderr, "Error: Unknown option '-%c'\n", optopt);
                 print_usage(argv);
@@ -283,7 +200,38 @@ int main(int argc, char *argv[]) {
         return STATUS_ERROR;
     }
 
-    // 根据 newfile 标志创建或打开数据库文件
+    // 副本先从主库下载镜像替换数据库文件，之后按已有文件打开
+    if (primary != NULL) {
+        if (!run_server_mode || newfile) {
+            fprintf(stderr, "Error: -R requires -p and cannot be used with "
+                            "-n\n");
+            print_usage(argv);
+            return STATUS_ERROR;
+        }
+        if (repl_replica_sync(&replica, primary, filepath) != STATUS_SUCCESS) {
+            fprintf(stderr, "Error: Failed to sync from primary '%s'\n",
+                    primary);
+            return STATUS_ERROR;
+        }
+    }
+
+    // 从快照的打包镜像逐块校验、解压并替换数据库文件
+    if (restore != NULL) {
+        if (newfile || primary != NULL) {
+            fprintf(stderr, "Error: -x cannot be used with -n or -R\n");
+            print_usage(argv);
+            return STATUS_ERROR;
+        }
+        if (dbpack_restore(restore, filepath) != STATUS_SUCCESS) {
+            fprintf(stderr, "Error: Failed to restore '%s' from '%s'\n",
+                    filepath, restore);
+            return STATUS_ERROR;
+        }
+    }
+    // 镜像替换了数据库文件：旧的日志与索引文件都不再对应它
+    bool fresh_image = newfile || primary != NULL || restore != NULL;
+
+    // 根据 newfile 标志创建或打开数据库文件，并映射到内存
     if (newfile) {
         dbfd = create_db_file(filepath);
         if (dbfd == STATUS_ERROR) {
@@ -291,9 +239,8 @@ int main(int argc, char *argv[]) {
                     filepath);
             return STATUS_ERROR;
         }
-        if (create_db_header(&dbhdr) == STATUS_ERROR) {
-            fprintf(stderr,
-                    "Error: Failed to create database header for '%s'\n",
+        if (dbmap_create(dbfd, filepath, &map) == STATUS_ERROR) {
+            fprintf(stderr, "Error: Failed to initialize database file '%s'\n",
                     filepath);
             return STATUS_ERROR;  // dbfd 会被 cleanup 关闭
         }
@@ -304,44 +251,54 @@ int main(int argc, char *argv[]) {
                     filepath);
             return STATUS_ERROR;
         }
-        if (validate_db_header(dbfd, &dbhdr) == STATUS_ERROR) {
-            fprintf(stderr,
-                    "Error: Failed to validate database header for '%s'\n",
+        if (dbmap_open(dbfd, filepath, &map) == STATUS_ERROR) {
+            fprintf(stderr, "Error: Failed to map database file '%s'\n",
                     filepath);
             return STATUS_ERROR;  // dbfd 会被 cleanup 关闭
         }
     }
+    dbfd = -1;  // 文件描述符已归 map 所有
 
-    // 读取所有员工数据到内存
-    if (read_employees(dbfd, dbhdr, &employees) != STATUS_SUCCESS) {
-        fprintf(stderr, "Error: Failed to read employees from '%s'\n",
+    // 打开预写日志，把上次崩溃前未合并的修改重放到映射中；
+    // 副本或恢复出的镜像是完整的时间点状态，旧的日志直接丢弃
+    if (wal_open(filepath, fresh_image, map, &wal) !=
+        STATUS_SUCCESS) {
+        fprintf(stderr, "Error: Failed to open write-ahead log for '%s'\n",
                 filepath);
-        return STATUS_ERROR;  // dbhdr, employees, dbfd 会被 cleanup 关闭/free
+        return STATUS_ERROR;
     }
 
     // 根据是否为服务器模式，执行不同的逻辑
     if (!run_server_mode) {
-        // 非服务器模式：执行单次命令行数据库操作
+        // 非服务器模式：执行单次命令行数据库操作，修改同样先写入 WAL
         if (addstring) {
-            if (add_employee(dbhdr, &employees, addstring) != STATUS_SUCCESS) {
+            struct employee_t employee;
+            uint32_t slot = (uint32_t)dbmap_next_slot(map);  // 优先复用墓碑
+            if (parse_employee(addstring, &employee) != STATUS_SUCCESS ||
+                dbmap_put(map, slot, &employee) != STATUS_SUCCESS ||
+                wal_log_add(wal, slot, &employee, NULL) != STATUS_SUCCESS) {
                 fprintf(stderr, "Error: Failed to add employee.\n");
                 return STATUS_ERROR;
             }
         }
         if (remove_employee_flag) {
-            if (remove_employee(dbhdr, &employees) != STATUS_SUCCESS) {
-                fprintf(stderr, "Error: Failed to remove employee.\n");
+            if (map->hdr.count == 0) {
+                fprintf(stderr, "Error: No employees to remove.\n");
                 return STATUS_ERROR;
             }
-        }
-        if (list_employees_flag) {
-            if (list_employees(dbhdr, employees) != STATUS_SUCCESS) {
-                fprintf(stderr, "Error: Failed to list employees.\n");
+            // 删除最后一个员工，连同它之前的墓碑一起截掉
+            size_t new_count = dbmap_trim_count(map, map->hdr.count - 1);
+            if (wal_log_del(wal, (uint32_t)new_count, NULL) != STATUS_SUCCESS ||
+                dbmap_truncate(map, new_count) != STATUS_SUCCESS) {
+                fprintf(stderr, "Error: Failed to remove employee.\n");
                 return STATUS_ERROR;
             }
+            printf("Removed last employee. New count: %lu\n",
+                   (unsigned long)map->hdr.count);
         }
-        // 非服务器模式下，操作完成后立即写入文件并退出
-        if (output_file(dbfd, dbhdr, employees) != STATUS_SUCCESS) {
+        if (list_employees_flag) list_employees(map);
+        // 非服务器模式下，操作完成后立即刷盘并清空日志后退出
+        if (wal_checkpoint_sync(wal) != STATUS_SUCCESS) {
             fprintf(stderr,
                     "Error: Failed to output file '%s' after operations.\n",
                     filepath);
@@ -363,22 +320,73 @@ int main(int argc, char *argv[]) {
         sa.sa_handler = handle_sigint;  // 指定信号处理函数
         sigaction(SIGINT, &sa, NULL);   // 注册 SIGINT 处理器
 
+        // 上次正常关闭时保存的索引只在数据库此后未被修改时可用，否则重建；
+        // 副本或恢复出的数据库文件刚被替换，总是重建
+        if (fresh_image ||
+            dbindex_load(&index, filepath, wal_synced_lsn(wal), map->hdr.count,
+                         dbmap_live(map)) != STATUS_SUCCESS) {
+            if (dbindex_build(&index, map) != STATUS_SUCCESS) {
+                fprintf(stderr, "Error: Failed to build indexes for '%s'\n",
+                        filepath);
+                return STATUS_ERROR;
+            }
+            printf("Rebuilt indexes for %zu records\n", dbmap_live(map));
+        }
+
         printf("Starting server on port %u...\n", server_port);
-        // 进入服务器主循环
-        poll_loop(server_port, dbhdr,
-                  &employees);  // 传递 employees 指针的指针以便 FSM 可以修改它
+        // 进入服务器主循环，FSM 通过数据上下文修改映射的数据库和索引
+        dbctx_t db;
+        if (dbctx_init(&db, map, wal, &index) != STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        db.timeouts.idle_ms = (uint32_t)idle_secs * 1000;
+        if (primary != NULL) {
+            if (repl_replica_start(&replica, map, &index, &db.lock) !=
+                STATUS_SUCCESS) {
+                dbctx_destroy(&db);
+                return STATUS_ERROR;
+            }
+            db.replica = &replica;
+        }
+        // 事件循环运行期间日志由后台线程写出，避免写终端阻塞事件循环
+        if (log_start() != STATUS_SUCCESS) {
+            repl_replica_stop(&replica);
+            dbctx_destroy(&db);
+            return STATUS_ERROR;
+        }
+        int loop_status =
+            reactor_run(server_port, nthreads, &db, &server_should_exit);
+        repl_replica_stop(&replica);  // 之后不再有线程修改映射
+        log_stop();
+        dbctx_destroy(&db);
+        if (loop_status != STATUS_SUCCESS) {
+            fprintf(stderr, "Error: Failed to start server on port %u\n",
+                    server_port);
+            return STATUS_ERROR;
+        }
 
-        // 服务器退出后，保存内存中的数据到文件
-        if (output_file(dbfd, dbhdr, employees) != STATUS_SUCCESS) {
+        // 服务器退出后，把映射刷盘并清空日志
+        if (wal_checkpoint_sync(wal) != STATUS_SUCCESS) {
             fprintf(
                 stderr,
                 "Error: Failed to output file '%s' after server shutdown.\n",
                 filepath);
             return STATUS_ERROR;
         }
+        // 检查点之后所有修改都已落盘，可以重写文件释放旧版本和墓碑的空间
+        if (dbmap_should_compact(map) &&
+            dbmap_compact(map) != STATUS_SUCCESS) {
+            fprintf(stderr, "Warning: Failed to compact '%s'\n", filepath);
+        }
+        // 检查点之后数据库与 WAL 的 LSN 对应，保存索引供下次启动直接加载
+        if (dbindex_save(&index, filepath, wal_synced_lsn(wal)) !=
+            STATUS_SUCCESS) {
+            fprintf(stderr, "Warning: Failed to save indexes for '%s'\n",
+                    filepath);
+        }
         printf("Server shutdown. Database updated.\n");
     }
 
-    return STATUS_SUCCESS;  // 所有资源 (dbfd, dbhdr, employees) 会在这里被
+    return STATUS_SUCCESS;  // 所有资源 (map, wal, index) 会在这里被
                             // cleanup 宏自动处理
 }
\ No newline at end of file
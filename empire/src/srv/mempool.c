@@ -0,0 +1,176 @@
+#include "../../include/mempool.h"  // 包含 slab_t, arena_t 声明
+
+#include <stdio.h>   // For perror
+#include <stdlib.h>  // For malloc, free
+
+#include "../../include/common.h"  // 包含 STATUS_SUCCESS 等宏
+
+/**
+ * @brief 对象与分配结果的对齐粒度
+ */
+#define MEMPOOL_ALIGN 16
+
+/**
+ * @brief 把 n 向上对齐到 MEMPOOL_ALIGN。
+ */
+static size_t align_up(size_t n) {
+    return (n + MEMPOOL_ALIGN - 1) & ~(size_t)(MEMPOOL_ALIGN - 1);
+}
+
+/**
+ * @brief 内存块与溢出块的头部：链表指针，数据紧随其后
+ */
+typedef struct mempool_block {
+    struct mempool_block *next;  ///< 下一个块
+    char pad[MEMPOOL_ALIGN - sizeof(void *)];  ///< 让数据区保持对齐
+    char data[];                               ///< 数据区
+} mempool_block_t;
+
+/* ---------------- 定长对象池 ---------------- */
+
+/**
+ * @brief 初始化对象池：对象至少能放下空闲链表的指针。
+ */
+void slab_init(slab_t *slab, size_t size) {
+    slab->size = align_up(size < sizeof(void *) ? sizeof(void *) : size);
+    slab->per_block = SLAB_BLOCK_SIZE / slab->size;
+    if (slab->per_block == 0) slab->per_block = 1;
+    slab->free = NULL;
+    slab->blocks = NULL;
+    slab->nblocks = 0;
+    slab->in_use = 0;
+}
+
+/**
+ * @brief 申请一个新内存块，把其中的对象全部挂到空闲链表上。
+ */
+static int slab_grow(slab_t *slab) {
+    mempool_block_t *block =
+        malloc(sizeof(mempool_block_t) + slab->per_block * slab->size);
+    if (block == NULL) {
+        perror("malloc for slab block");
+        return STATUS_ERROR;
+    }
+    block->next = slab->blocks;
+    slab->blocks = block;
+    slab->nblocks++;
+    // 倒序入链，分配时按地址顺序取出
+    for (size_t i = slab->per_block; i-- > 0;) {
+        void **obj = (void **)(block->data + i * slab->size);
+        *obj = slab->free;
+        slab->free = obj;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 从空闲链表头部取出一个对象。
+ */
+void *slab_alloc(slab_t *slab) {
+    if (slab->free == NULL && slab_grow(slab) != STATUS_SUCCESS) return NULL;
+    void **obj = slab->free;
+    slab->free = *obj;
+    slab->in_use++;
+    return obj;
+}
+
+/**
+ * @brief 把对象挂回空闲链表头部，最近释放的对象最先复用（缓存仍热）。
+ */
+void slab_free(slab_t *slab, void *obj) {
+    if (obj == NULL) return;
+    *(void **)obj = slab->free;
+    slab->free = obj;
+    slab->in_use--;
+}
+
+/**
+ * @brief 释放所有内存块。
+ */
+void slab_destroy(slab_t *slab) {
+    mempool_block_t *block = slab->blocks;
+    while (block != NULL) {
+        mempool_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    slab->free = NULL;
+    slab->blocks = NULL;
+    slab->nblocks = 0;
+    slab->in_use = 0;
+}
+
+/* ---------------- 单条请求的线性内存池 ---------------- */
+
+/**
+ * @brief 申请主块。
+ */
+int arena_init(arena_t *arena) {
+    arena->base = malloc(ARENA_MIN_SIZE);
+    if (arena->base == NULL) {
+        perror("malloc for request arena");
+        return STATUS_ERROR;
+    }
+    arena->cap = ARENA_MIN_SIZE;
+    arena->used = 0;
+    arena->overflow = NULL;
+    arena->spilled = 0;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 优先从主块中分配，放不下时单独申请一个溢出块。
+ */
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = align_up(size);
+    if (arena->cap - arena->used >= size) {
+        void *p = arena->base + arena->used;
+        arena->used += size;
+        return p;
+    }
+    mempool_block_t *block = malloc(sizeof(mempool_block_t) + size);
+    if (block == NULL) {
+        perror("malloc for request arena overflow");
+        return NULL;
+    }
+    block->next = arena->overflow;
+    arena->overflow = block;
+    arena->spilled += size;
+    return block->data;
+}
+
+/**
+ * @brief 释放溢出块；发生过溢出时把主块扩大到这次的总用量，
+ *        扩大失败时保留原来的主块。
+ */
+void arena_reset(arena_t *arena) {
+    mempool_block_t *block = arena->overflow;
+    while (block != NULL) {
+        mempool_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->overflow = NULL;
+    if (arena->spilled > 0) {
+        size_t cap = arena->used + arena->spilled;
+        char *base = malloc(cap);
+        if (base != NULL) {
+            free(arena->base);
+            arena->base = base;
+            arena->cap = cap;
+        }
+        arena->spilled = 0;
+    }
+    arena->used = 0;
+}
+
+/**
+ * @brief 释放主块与溢出块。
+ */
+void arena_destroy(arena_t *arena) {
+    arena->spilled = 0;  // 不再扩大主块
+    arena_reset(arena);
+    free(arena->base);
+    arena->base = NULL;
+    arena->cap = 0;
+}
@@ -0,0 +1,203 @@
+#include "../../include/outq.h"  // 包含 outq_t 声明
+
+#include <errno.h>         // For errno, EINTR, EAGAIN
+#include <stdio.h>         // For perror
+#include <stdlib.h>        // For malloc, free
+#include <string.h>        // For memcpy
+#include <sys/sendfile.h>  // For sendfile
+#include <sys/socket.h>    // For sendmsg, MSG_NOSIGNAL
+#include <sys/uio.h>       // For struct iovec
+#include <unistd.h>        // For close
+
+#include "../../include/common.h"  // 包含 STATUS_SUCCESS 等宏
+
+/**
+ * @brief 释放一个数据块，文件块同时关闭其文件描述符。
+ *        最小容量的数据块归还对象池。
+ */
+static void chunk_free(outq_t *q, outq_chunk_t *c) {
+    if (c->fd != -1) close(c->fd);
+    if (q->pool != NULL && c->cap == OUTQ_MIN_CHUNK) {
+        slab_free(q->pool, c);
+    } else {
+        free(c);
+    }
+}
+
+/**
+ * @brief 分配一个容量为 cap 的空数据块并挂到队列尾部。
+ */
+static outq_chunk_t *chunk_push(outq_t *q, size_t cap) {
+    outq_chunk_t *chunk = q->pool != NULL && cap == OUTQ_MIN_CHUNK
+                              ? slab_alloc(q->pool)
+                              : malloc(sizeof(outq_chunk_t) + cap);
+    if (chunk == NULL) {
+        perror("malloc for output chunk");
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->off = 0;
+    chunk->len = 0;
+    chunk->cap = cap;
+    chunk->fd = -1;
+    chunk->file_off = 0;
+    if (q->tail) {
+        q->tail->next = chunk;
+    } else {
+        q->head = chunk;
+    }
+    q->tail = chunk;
+    return chunk;
+}
+
+/**
+ * @brief 在队列尾部预留至少 min 字节的连续空间。
+ *        新数据块的容量随队列增长而翻倍，小响应只占用一个小数据块。
+ *        尾部是文件块时总是分配新的内存块。
+ */
+void *outq_reserve(outq_t *q, size_t min, size_t *avail) {
+    outq_chunk_t *tail = q->tail;
+    if (tail == NULL || tail->fd != -1 || tail->cap - tail->len < min) {
+        size_t cap = tail && tail->cap ? tail->cap * 2 : OUTQ_MIN_CHUNK;
+        if (cap > OUTQ_MAX_CHUNK) cap = OUTQ_MAX_CHUNK;
+        if (cap < min) cap = min;
+        tail = chunk_push(q, cap);
+        if (tail == NULL) return NULL;
+    }
+    if (avail) *avail = tail->cap - tail->len;
+    return tail->data + tail->len;
+}
+
+/**
+ * @brief 确认 outq_reserve 预留空间中实际写入的字节数。
+ */
+void outq_commit(outq_t *q, size_t used) {
+    q->tail->len += used;
+    q->appended += used;
+}
+
+/**
+ * @brief 把数据拷贝追加到队列尾部。
+ */
+int outq_append(outq_t *q, const void *buf, size_t len) {
+    void *dst = outq_reserve(q, len, NULL);
+    if (dst == NULL) return STATUS_ERROR;
+    memcpy(dst, buf, len);
+    outq_commit(q, len);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 追加一个文件块。之后的追加会另起内存块，保持字节顺序。
+ */
+int outq_append_file(outq_t *q, int fd, uint64_t off, size_t len) {
+    outq_chunk_t *chunk = chunk_push(q, 0);
+    if (chunk == NULL) {
+        close(fd);
+        return STATUS_ERROR;
+    }
+    chunk->fd = fd;
+    chunk->file_off = off;
+    chunk->len = len;
+    q->appended += len;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 用 sendfile 发送一个文件块中从 c->off 开始的至多 n 字节。
+ */
+static ssize_t send_file_chunk(int fd, const outq_chunk_t *c, size_t n) {
+    off_t pos = (off_t)(c->file_off + c->off);
+    return sendfile(fd, c->fd, &pos, n);
+}
+
+/**
+ * @brief 用 writev 语义（sendmsg 聚合多个数据块）发送队列中的数据。
+ *        使用 MSG_NOSIGNAL，对端关闭时返回错误而不是触发 SIGPIPE。
+ *        聚合在文件块前停止；文件块位于队首时单独用 sendfile 发送，
+ *        sendfile 没有 MSG_NOSIGNAL，因此服务器忽略 SIGPIPE。
+ */
+int outq_flush(outq_t *q, int fd, uint64_t limit) {
+    while (q->head != NULL && q->sent < limit) {
+        struct iovec iov[OUTQ_MAX_IOV];
+        int iovcnt = 0;
+        uint64_t budget = limit - q->sent;
+        const outq_chunk_t *file = NULL;
+
+        for (outq_chunk_t *c = q->head;
+             c != NULL && iovcnt < OUTQ_MAX_IOV && budget > 0; c = c->next) {
+            size_t n = c->len - c->off;
+            if (n == 0) continue;
+            if (n > budget) n = (size_t)budget;
+            if (c->fd != -1) {
+                if (iovcnt == 0) {
+                    file = c;
+                    budget = n;
+                }
+                break;
+            }
+            iov[iovcnt].iov_base = c->data + c->off;
+            iov[iovcnt].iov_len = n;
+            iovcnt++;
+            budget -= n;
+        }
+        if (iovcnt == 0 && file == NULL) break;
+
+        ssize_t sent;
+        if (file != NULL) {
+            sent = send_file_chunk(fd, file, (size_t)budget);
+        } else {
+            struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iovcnt};
+            sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        }
+        if (sent == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror(file ? "outq_flush sendfile" : "outq_flush sendmsg");
+            return STATUS_ERROR;
+        }
+        if (sent == 0 && file != NULL) {
+            // 文件比预期短：字节段已经不完整，只能断开连接
+            fprintf(stderr, "Error: outq_flush: file chunk truncated\n");
+            return STATUS_ERROR;
+        }
+
+        // 释放已经完全发送的数据块
+        q->sent += (uint64_t)sent;
+        while (sent > 0) {
+            outq_chunk_t *c = q->head;
+            size_t n = c->len - c->off;
+            if ((size_t)sent < n) {
+                c->off += sent;
+                break;
+            }
+            sent -= n;
+            c->off = c->len;
+            if (c == q->tail) break;  // 尾块保留，后续追加可以继续使用
+            q->head = c->next;
+            chunk_free(q, c);
+        }
+    }
+
+    // 全部发送完时释放尾块，空闲连接不占用输出内存
+    if (q->head != NULL && q->head == q->tail &&
+        q->head->off == q->head->len) {
+        chunk_free(q, q->head);
+        q->head = q->tail = NULL;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 丢弃队列中所有数据并释放内存。
+ */
+void outq_clear(outq_t *q) {
+    outq_chunk_t *c = q->head;
+    while (c != NULL) {
+        outq_chunk_t *next = c->next;
+        chunk_free(q, c);
+        c = next;
+    }
+    q->head = q->tail = NULL;
+    q->sent = q->appended;
+}
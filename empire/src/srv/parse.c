@@ -1,47 +1,18 @@
 #include "../../include/parse.h"  // 包含 dbheader_t, employee_t 结构体
 
-#include <arpa/inet.h>  // For htonl, ntohl (网络字节序转换)
-#include <errno.h>      // For errno, ERANGE
-#include <limits.h>     // For LONG_MAX, LONG_MIN, UINT_MAX
+#include <arpa/inet.h>  // For ntohl, ntohs (网络字节序转换)
+#include <stdint.h>     // For UINT32_MAX, SIZE_MAX
 #include <stdio.h>      // For perror, fprintf
-#include <stdlib.h>     // For calloc, free, strtol, strdup
-#include <string.h>     // For memset, strncpy, strtok, strlen
+#include <stdlib.h>     // For calloc, free
+#include <string.h>     // For memset, memcpy, memchr, strnlen
 #include <sys/stat.h>   // For stat, fstat
 #include <sys/types.h>  // For stat, ssize_t
-#include <unistd.h>     // For lseek, read, write, ftruncate
+#include <unistd.h>     // For lseek, read
 
 #include "../../include/common.h"  // 包含 STATUS_SUCCESS 等宏
 
 /**
- * @brief 创建并初始化数据库文件头部。
- *        分配内存并设置魔数、版本号、计数和文件大小。
- * @param fd 数据库文件的文件描述符（未使用，但保留原始签名）。
- * @param headerOut 指向 dbheader_t 指针的指针，用于返回新创建的头部。
- * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
- */
-int create_db_header(struct dbheader_t **headerOut) {
-    // 分配并清零数据库头部内存，使用 cleanup 宏确保自动释放
-    struct dbheader_t *header __attribute__((cleanup(_cleanup_ptr_))) =
-        calloc(1, sizeof(struct dbheader_t));
-    if (header == NULL) {
-        perror("calloc for db header");  // 使用 perror 报告内存分配错误
-        return STATUS_ERROR;
-    }
-
-    // 初始化头部字段
-    header->version = PROTO_VER;                   // 使用协议版本宏
-    header->count = 0;                             // 初始员工数量为 0
-    header->magic = HEADER_MAGIC;                  // 设置魔数
-    header->filesize = sizeof(struct dbheader_t);  // 初始文件大小仅为头部大小
-
-    *headerOut = header;  // 将新创建的头部指针返回
-    header =
-        NULL;  // 清除 cleanup 宏对 header 的作用，因为 ownership 已转移给调用者
-    return STATUS_SUCCESS;
-}
-
-/**
- * @brief 验证数据库文件的头部信息。
+ * @brief 验证旧版数据库文件的头部信息。
  *        读取头部，进行字节序转换，并检查魔数、版本和文件大小是否一致。
  * @param fd 数据库文件的文件描述符。
  * @param headerOut 指向 dbheader_t 指针的指针，用于返回读取和验证后的头部。
@@ -66,25 +37,26 @@ int validate_db_header(int fd, struct dbheader_t **headerOut) {
 
     lseek(fd, 0, SEEK_SET);  // 定位到文件开头
 
-    // 读取数据库头部
-    ssize_t bytes_read = read(fd, header, sizeof(struct dbheader_t));
-    if (bytes_read != sizeof(struct dbheader_t)) {
+    // 读取旧版格式的数据库头部
+    struct dbheader_v1_t raw;
+    ssize_t bytes_read = read(fd, &raw, sizeof(raw));
+    if (bytes_read != sizeof(raw)) {
         if (bytes_read == -1) {
             perror("Error reading database header");
         } else {
             fprintf(stderr,
                     "Error: Incomplete database header read. Expected %zu "
                     "bytes, got %zd.\n",
-                    sizeof(struct dbheader_t), bytes_read);
+                    sizeof(raw), bytes_read);
         }
         return STATUS_ERROR;
     }
 
     // 将头部字段从网络字节序转换回主机字节序
-    header->magic = ntohl(header->magic);
-    header->version = ntohs(header->version);
-    header->count = ntohs(header->count);
-    header->filesize = ntohl(header->filesize);
+    header->magic = ntohl(raw.magic);
+    header->version = ntohs(raw.version);
+    header->count = ntohs(raw.count);
+    header->filesize = ntohl(raw.filesize);
 
     // 验证魔数
     if (header->magic != HEADER_MAGIC) {
@@ -94,11 +66,11 @@ int validate_db_header(int fd, struct dbheader_t **headerOut) {
         return STATUS_ERROR;
     }
 
-    // 验证协议版本
-    if (header->version != PROTO_VER) {
+    // 验证文件格式版本
+    if (header->version != DB_VERSION_LEGACY) {
         fprintf(stderr,
                 "Error: Improper header version. Expected %d, got %hu\n",
-                PROTO_VER, header->version);
+                DB_VERSION_LEGACY, header->version);
         return STATUS_ERROR;
     }
 
@@ -108,13 +80,13 @@ int validate_db_header(int fd, struct dbheader_t **headerOut) {
         perror("Error getting file stats");
         return STATUS_ERROR;
     }
-    // 注意：dbstat.st_size 是 long int，可能与 header->filesize (uint32_t)
+    // 注意：dbstat.st_size 是 long int，可能与 header->filesize (uint64_t)
     // 类型不匹配，进行显式转换
-    if (header->filesize != (uint32_t)dbstat.st_size) {
+    if (header->filesize != (uint64_t)dbstat.st_size) {
         fprintf(stderr,
-                "Error: Corrupted database. Header filesize %u mismatch with "
+                "Error: Corrupted database. Header filesize %lu mismatch with "
                 "actual file size %ld\n",
-                header->filesize, dbstat.st_size);
+                (unsigned long)header->filesize, dbstat.st_size);
         return STATUS_ERROR;
     }
 
@@ -124,74 +96,14 @@ int validate_db_header(int fd, struct dbheader_t **headerOut) {
 }
 
 /**
- * @brief 将内存中的数据库头部和员工数据写入文件。
- *        此函数负责字节序转换和文件截断，确保文件内容与内存状态一致。
- * @param fd 数据库文件的文件描述符。
- * @param dbhdr 指向数据库头部的指针（只读）。
- * @param employees 指向员工数组的指针（只读）。
- * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ * @brief 内存中员工数组的容量：不小于 count 的 2 的幂，至少 16 个。
+ *        容量完全由记录数决定，不需要额外保存，追加时数组按倍数增长。
  */
-int output_file(int fd, const struct dbheader_t *dbhdr,
-                const struct employee_t *employees) {
-    if (fd < 0) {
-        fprintf(stderr,
-                "Error: Got a bad FD (%d) from the user in output_file\n", fd);
-        return STATUS_ERROR;
-    }
-    if (dbhdr == NULL) {
-        fprintf(stderr, "Error: dbhdr is NULL in output_file\n");
-        return STATUS_ERROR;
-    }
-
-    // 创建一个临时的 dbheader_t 副本，用于字节序转换，不修改原始 dbhdr
-    struct dbheader_t temp_dbhdr = *dbhdr;
-    // 计算文件应该有的总大小
-    uint32_t calculated_filesize = sizeof(struct dbheader_t) +
-                                   temp_dbhdr.count * sizeof(struct employee_t);
-
-    // 将头部字段转换为主机字节序
-    temp_dbhdr.version = htons(temp_dbhdr.version);
-    temp_dbhdr.count = htons(temp_dbhdr.count);
-    temp_dbhdr.magic = htonl(temp_dbhdr.magic);
-    temp_dbhdr.filesize = htonl(calculated_filesize);
-
-    lseek(fd, 0, SEEK_SET);  // 定位到文件开头
-
-    // 写入转换后的数据库头部
-    if (write(fd, &temp_dbhdr, sizeof(struct dbheader_t)) !=
-        sizeof(struct dbheader_t)) {
-        perror("Error writing database header");
-        return STATUS_ERROR;
-    }
-
-    // 检查在有员工记录时 employees 指针是否为 NULL
-    if (dbhdr->count > 0 && employees == NULL) {
-        fprintf(
-            stderr,
-            "Error: dbhdr->count > 0 but employees is NULL in output_file\n");
-        return STATUS_ERROR;
-    }
-
-    // 循环写入每个员工记录
-    for (int i = 0; i < dbhdr->count; ++i) {
-        struct employee_t temp_employee = employees[i];  // 创建副本进行转换
-        temp_employee.hours =
-            htonl(temp_employee.hours);  // 转换 hours 字段为网络字节序
-
-        if (write(fd, &temp_employee, sizeof(struct employee_t)) !=
-            sizeof(struct employee_t)) {
-            perror("Error writing employee record");
-            return STATUS_ERROR;
-        }
-    }
-
-    // 截断文件到计算出的实际大小，删除多余数据
-    if (ftruncate(fd, calculated_filesize) == -1) {
-        perror("Error truncating file");
-        return STATUS_ERROR;
-    }
-
-    return STATUS_SUCCESS;
+static size_t employees_capacity(size_t count) {
+    if (count == 0) return 0;
+    size_t capacity = 16;
+    while (capacity < count) capacity *= 2;
+    return capacity;
 }
 
 /**
@@ -215,19 +127,19 @@ int read_employees(int fd, struct dbheader_t *dbhdr,
         return STATUS_ERROR;
     }
 
-    lseek(fd, sizeof(struct dbheader_t),
-          SEEK_SET);  // 定位到文件头部之后，员工数据开始处
+    lseek(fd, sizeof(struct dbheader_v1_t),
+          SEEK_SET);  // 定位到旧版文件头部之后，员工数据开始处
 
-    int count = dbhdr->count;  // 获取员工数量
+    size_t count = dbhdr->count;  // 获取员工数量
 
     if (count == 0) {
         *employeesOut = NULL;  // 没有员工，返回 NULL
         return STATUS_SUCCESS;
     }
 
-    // 分配内存来存储员工数组，使用 cleanup 宏确保自动释放
+    // 按容量分配员工数组，之后的追加不必立即扩展；使用 cleanup 宏确保自动释放
     struct employee_t *employees __attribute__((cleanup(_cleanup_ptr_))) =
-        calloc(count, sizeof(struct employee_t));
+        calloc(employees_capacity(count), sizeof(struct employee_t));
     if (employees == NULL) {
         perror("calloc for employees");  // 报告内存分配错误
         return STATUS_ERROR;
@@ -242,13 +154,13 @@ int read_employees(int fd, struct dbheader_t *dbhdr,
             fprintf(stderr,
                     "Error: Incomplete employee records read. Expected %zu "
                     "bytes, got %zd.\n",
-                    (size_t)count * sizeof(struct employee_t), bytes_read);
+                    count * sizeof(struct employee_t), bytes_read);
         }
         return STATUS_ERROR;
     }
 
     // 转换员工数据中的字段（例如 hours）回主机字节序
-    for (int i = 0; i < count; ++i) {
+    for (size_t i = 0; i < count; ++i) {
         employees[i].hours = ntohl(employees[i].hours);
     }
 
@@ -258,105 +170,158 @@ int read_employees(int fd, struct dbheader_t *dbhdr,
 }
 
 /**
- * @brief 向内存中的员工数组添加一个新员工。
- *        此函数会重新分配内存以容纳新员工，并解析 `addstring`。
- * @param dbhdr 指向数据库头部的指针（会修改其 count 字段）。
- * @param employees_ptr 指向 struct employee_t
- * 指针的指针（可能会改变内存地址）。
- * @param addstring 格式为 "Name-Address-Hours" 的员工信息字符串。
+ * @brief 单遍解析 "Name-Address-Hours" 格式的字符串，填充一条员工记录。
+ *        直接从输入读取、写入输出记录，不复制输入也不申请内存，可重入。
+ *        不修改内存中的员工数组，便于调用者在写入 WAL 之前先完成校验。
+ * @param addstring 员工信息字符串，名字与地址中的 '-' 和 '\' 以 '\' 转义。
+ * @param len 最多读取的字节数，遇到 '\0' 提前结束。
+ * @param employeeOut 输出参数，解析得到的员工记录（hours 为主机字节序）。
  * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
  */
-int add_employee(struct dbheader_t *dbhdr, struct employee_t **employees_ptr,
-                 const char *addstring) {
-    if (dbhdr == NULL || employees_ptr == NULL || addstring == NULL) {
+int parse_employee_n(const char *addstring, size_t len,
+                     struct employee_t *employeeOut) {
+    if (addstring == NULL || employeeOut == NULL) {
         fprintf(stderr,
-                "Error: Invalid arguments to add_employee (NULL pointer).\n");
+                "Error: Invalid arguments to parse_employee (NULL pointer).\n");
         return STATUS_ERROR;
     }
 
-    // 复制 addstring，因为 strtok 会修改它。使用 cleanup 宏确保自动释放
-    char *addstring_copy __attribute__((cleanup(_cleanup_ptr_))) =
-        strdup(addstring);
-    if (addstring_copy == NULL) {
-        perror("strdup addstring");  // 报告内存分配错误
-        return STATUS_ERROR;
+    memset(employeeOut, 0, sizeof(*employeeOut));
+    char *fields[2] = {employeeOut->name, employeeOut->address};
+    size_t field = 0;      // 正在解析的字段：0 名字，1 地址，2 小时数
+    size_t field_len = 0;  // 当前字段已写入的字节数
+    uint64_t hours = 0;
+    size_t i = 0;
+    for (; i < len && addstring[i] != '\0'; i++) {
+        char c = addstring[i];
+        if (field == 2) {
+            // 小时数只允许十进制数字，多余的 '-' 也在这里被拒绝
+            if (c < '0' || c > '9') goto bad_format;
+            hours = hours * 10 + (uint64_t)(c - '0');
+            if (hours > UINT32_MAX) {
+                fprintf(stderr,
+                        "Error: Hours value is out of valid unsigned int "
+                        "range [0, %u].\n",
+                        UINT32_MAX);
+                return STATUS_ERROR;
+            }
+            field_len++;
+            continue;
+        }
+        if (c == '-') {
+            if (field_len == 0) goto bad_format;  // 空字段
+            field++;
+            field_len = 0;
+            continue;
+        }
+        if (c == '\\') {
+            // 转义：下一个字符原样写入字段
+            if (i + 1 >= len || addstring[i + 1] == '\0') goto bad_format;
+            c = addstring[++i];
+        }
+        if (field_len >= sizeof(employeeOut->name) - 1) {
+            fprintf(stderr, "Error: Employee %s is longer than %zu bytes.\n",
+                    field == 0 ? "name" : "address",
+                    sizeof(employeeOut->name) - 1);
+            return STATUS_ERROR;
+        }
+        fields[field][field_len++] = c;
     }
 
-    // 使用 strtok 分割字符串：姓名-地址-小时数
-    char *name = strtok(addstring_copy, "-");
-    char *address = strtok(NULL, "-");
-    char *hours_str = strtok(NULL, "-");
-    char *extra_token = strtok(NULL, "-");  // 检查是否有额外的分隔符
+    if (field != 2 || field_len == 0) goto bad_format;
+    employeeOut->hours = (uint32_t)hours;
+    return STATUS_SUCCESS;
 
-    // 验证字符串格式
-    if (!name || !address || !hours_str || extra_token) {
-        fprintf(stderr,
-                "Error: Invalid addstring format. Expected "
-                "'Name-Address-Hours', got: '%s'\n",
-                addstring);
-        return STATUS_ERROR;
-    }
+bad_format:
+    fprintf(stderr,
+            "Error: Invalid addstring format. Expected "
+            "'Name-Address-Hours', got: '%.*s'\n",
+            (int)strnlen(addstring, len), addstring);
+    return STATUS_ERROR;
+}
 
-    // 尝试重新分配内存以容纳新员工
-    // realloc 可能返回 NULL，此时 *employees_ptr 不会改变
-    struct employee_t *temp_employees =
-        realloc(*employees_ptr, (dbhdr->count + 1) * sizeof(struct employee_t));
-    if (temp_employees == NULL) {
-        perror("realloc for add_employee");  // 报告内存分配错误
+/**
+ * @brief 解析以 '\0' 结尾的 "Name-Address-Hours" 字符串。
+ */
+int parse_employee(const char *addstring, struct employee_t *employeeOut) {
+    return parse_employee_n(addstring, SIZE_MAX, employeeOut);
+}
+
+/**
+ * @brief 从二进制添加请求中取出已拆分的字段，填充一条员工记录。
+ *        只检查长度与 '\0'，不做任何字符串解析。
+ * @param body 指向 dbproto_employee_add_req_v2_t 及之后的字段。
+ * @param len body 的总字节数。
+ * @param employeeOut 输出参数，员工记录（hours 为主机字节序）。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int parse_employee_fields(const void *body, size_t len,
+                          struct employee_t *employeeOut) {
+    dbproto_employee_add_req_v2_t req;
+    if (body == NULL || employeeOut == NULL || len < sizeof(req)) {
         return STATUS_ERROR;
     }
-    *employees_ptr = temp_employees;  // 更新 employees_ptr 指向新内存
-
-    // 获取新员工的索引
-    int new_employee_idx = dbhdr->count;
-
-    // 拷贝 name，并确保空终止
-    strncpy((*employees_ptr)[new_employee_idx].name, name,
-            sizeof((*employees_ptr)[new_employee_idx].name) - 1);
-    (*employees_ptr)[new_employee_idx]
-        .name[sizeof((*employees_ptr)[new_employee_idx].name) - 1] = '\0';
-
-    // 拷贝 address，并确保空终止
-    strncpy((*employees_ptr)[new_employee_idx].address, address,
-            sizeof((*employees_ptr)[new_employee_idx].address) - 1);
-    (*employees_ptr)[new_employee_idx]
-        .address[sizeof((*employees_ptr)[new_employee_idx].address) - 1] = '\0';
-
-    // 转换 hours 字符串为数字
-    char *end_ptr;
-    errno = 0;  // 重置 errno 以检测 strtol 错误
-    long hours_long = strtol(hours_str, &end_ptr, 10);
-
-    // 检查 strtol 转换结果：是否有未解析的字符，是否为空字符串，是否超出 long
-    // 范围
-    if (*end_ptr != '\0' || hours_str == end_ptr ||
-        (errno == ERANGE &&
-         (hours_long == LONG_MAX || hours_long == LONG_MIN))) {
-        fprintf(stderr,
-                "Error: Invalid hours input or value out of range: '%s'.\n",
-                hours_str);
+    memcpy(&req, body, sizeof(req));
+    size_t name_len = ntohs(req.name_len);
+    size_t address_len = ntohs(req.address_len);
+    const char *name = (const char *)body + sizeof(req);
+    const char *address = name + name_len;
+
+    if (len != sizeof(req) + name_len + address_len || name_len == 0 ||
+        address_len == 0 || name_len >= sizeof(employeeOut->name) ||
+        address_len >= sizeof(employeeOut->address) ||
+        memchr(name, '\0', name_len) != NULL ||
+        memchr(address, '\0', address_len) != NULL) {
+        fprintf(stderr, "Error: Invalid binary add request fields.\n");
         return STATUS_ERROR;
     }
 
-    // 检查 hours 的值是否在 unsigned int 范围内（非负且不超过最大值）
-    if (hours_long < 0 || (unsigned long)hours_long > UINT_MAX) {
-        fprintf(stderr,
-                "Error: Hours value %ld is out of valid unsigned int range [0, "
-                "%u].\n",
-                hours_long, UINT_MAX);
+    memset(employeeOut, 0, sizeof(*employeeOut));
+    memcpy(employeeOut->name, name, name_len);
+    memcpy(employeeOut->address, address, address_len);
+    employeeOut->hours = ntohl(req.hours);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 将一条已解析的员工记录追加到内存中的员工数组末尾。
+ * @param dbhdr 指向数据库头部的指针（会修改其 count 字段）。
+ * @param employees_ptr 指向 struct employee_t
+ * 指针的指针（可能会改变内存地址）。
+ * @param employee 要追加的员工记录（hours 为主机字节序）。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int append_employee(struct dbheader_t *dbhdr, struct employee_t **employees_ptr,
+                    const struct employee_t *employee) {
+    if (dbhdr == NULL || employees_ptr == NULL || employee == NULL) {
+        fprintf(
+            stderr,
+            "Error: Invalid arguments to append_employee (NULL pointer).\n");
         return STATUS_ERROR;
     }
-    (*employees_ptr)[new_employee_idx].hours =
-        (uint32_t)hours_long;  // 存储为 uint32_t
 
-    dbhdr->count++;  // 只有当所有数据都验证并准备好后，才增加员工计数
+    // 容量用完时按倍数扩展，逐条追加的总拷贝量是线性的
+    // realloc 可能返回 NULL，此时 *employees_ptr 不会改变
+    size_t capacity = employees_capacity(dbhdr->count + 1);
+    if (*employees_ptr == NULL || capacity > employees_capacity(dbhdr->count)) {
+        struct employee_t *temp_employees =
+            realloc(*employees_ptr, capacity * sizeof(struct employee_t));
+        if (temp_employees == NULL) {
+            perror("realloc for append_employee");  // 报告内存分配错误
+            return STATUS_ERROR;
+        }
+        *employees_ptr = temp_employees;  // 更新 employees_ptr 指向新内存
+    }
+
+    (*employees_ptr)[dbhdr->count] = *employee;
+    dbhdr->count++;  // 只有当数据拷贝完成后，才增加员工计数
 
     return STATUS_SUCCESS;
 }
 
 /**
  * @brief 从内存中的员工数组中删除最后一个员工。
- *        此函数会重新分配内存以缩小数组。
+ *        数组不随之缩小，之后的追加直接复用空出的位置；删空时释放数组。
  * @param dbhdr 指向数据库头部的指针（会修改其 count 字段）。
  * @param employees_ptr 指向 struct employee_t
  * 指针的指针（可能会改变内存地址）。
@@ -379,66 +344,14 @@ int remove_employee(struct dbheader_t *dbhdr,
     }
 
     dbhdr->count--;  // 递减员工计数
-    printf("Removed last employee. New count: %hu\n", dbhdr->count);
+    printf("Removed last employee. New count: %lu\n",
+           (unsigned long)dbhdr->count);
 
-    if (dbhdr->count == 0) {
+    if (dbhdr->count == 0 && *employees_ptr != NULL) {
         // 如果删除后没有员工，则释放整个员工数组内存并清空指针
-        if (*employees_ptr != NULL) {
-            free(*employees_ptr);
-            *employees_ptr = NULL;
-        }
-    } else {
-        // 尝试缩小内存。如果失败，旧内存仍然有效，这是警告而非致命错误
-        struct employee_t *temp_employees =
-            realloc(*employees_ptr, dbhdr->count * sizeof(struct employee_t));
-        if (temp_employees == NULL) {
-            fprintf(
-                stderr,
-                "Warning: Failed to reallocate memory to shrink employee "
-                "array. "
-                "Memory might be underutilized, but existing data is safe.\n");
-            // 如果 realloc 失败，*employees_ptr
-            // 仍然指向旧的有效内存，不会丢失数据。 此时不更新 *employees_ptr。
-        } else {
-            *employees_ptr = temp_employees;  // 更新 employees_ptr 指向新内存
-        }
+        free(*employees_ptr);
+        *employees_ptr = NULL;
     }
 
     return STATUS_SUCCESS;
 }
-
-/**
- * @brief 列出内存中的所有员工信息到标准输出。
- * @param dbhdr 指向数据库头部的指针（只读）。
- * @param employees 指向员工数组的指针（只读）。
- * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR (例如数据不一致)。
- */
-int list_employees(const struct dbheader_t *dbhdr,
-                   const struct employee_t *employees) {
-    if (dbhdr == NULL) {
-        fprintf(stderr, "Error: dbhdr is NULL in list_employees\n");
-        return STATUS_ERROR;
-    }
-    // 检查员工数量与指针一致性
-    if (dbhdr->count > 0 && employees == NULL) {
-        fprintf(stderr,
-                "Error: dbhdr->count > 0 but employees is NULL in "
-                "list_employees\n");
-        return STATUS_ERROR;
-    }
-
-    if (dbhdr->count == 0) {
-        printf("No employees to list.\n");
-        return STATUS_SUCCESS;
-    }
-
-    printf("\n--- Employee List (%hu records) ---\n", dbhdr->count);
-    for (int i = 0; i < dbhdr->count; ++i) {
-        printf("Employee #%d:\n", i + 1);
-        printf("\tName: %s\n", employees[i].name);
-        printf("\tAddress: %s\n", employees[i].address);
-        printf("\tHours: %u\n", employees[i].hours);
-    }
-    printf("----------------------------------\n\n");
-    return STATUS_SUCCESS;
-}
\ No newline at end of file
@@ -0,0 +1,630 @@
+#define _GNU_SOURCE  // For accept4
+
+#include "../../include/reactor.h"  // 包含 reactor_run 声明
+
+#include <arpa/inet.h>     // For inet_ntoa, htons
+#include <errno.h>         // For errno, EINTR, EAGAIN
+#include <pthread.h>       // For pthread_create, pthread_sigmask
+#include <limits.h>        // For INT_MAX
+#include <signal.h>        // For sigaction, sigprocmask
+#include <stddef.h>        // For offsetof
+#include <stdio.h>         // For perror, fprintf
+#include <stdlib.h>        // For exit
+#include <string.h>        // For memset
+#include <sys/epoll.h>     // For epoll_create1, epoll_ctl, epoll_pwait
+#include <sys/eventfd.h>   // For eventfd，关闭时唤醒所有事件循环
+#include <sys/resource.h>  // For getrlimit, setrlimit
+#include <sys/socket.h>    // For socket, accept4, setsockopt
+#include <unistd.h>        // For close
+
+#include "../../include/common.h"  // 包含 STATUS_SUCCESS 等宏
+#include "../../include/log.h"     // 包含 log_info 等日志宏
+#include "../../include/timer.h"   // 包含连接超时的时间轮
+#include "../../include/wal.h"     // 包含 WAL 组提交与检查点
+
+/**
+ * @brief 单个事件循环（每个线程一个）的运行时状态
+ */
+typedef struct reactor {
+    int id;                  ///< 事件循环编号，0 号运行在调用线程中
+    int epfd;                ///< epoll 实例
+    int listen_fd;           ///< 监听套接字，在 epoll 中以 data.ptr == NULL 标识
+    int wake_fd;  ///< 所有事件循环共享的 eventfd，以 data.ptr == 自身标识
+    dbctx_t *db;  ///< 服务器数据上下文，所有事件循环共享
+    volatile sig_atomic_t *stop;  ///< 退出标志
+    const sigset_t *wait_mask;  ///< epoll_pwait 期间的信号屏蔽字，NULL 表示不变
+    clientstate_t *clients;     ///< 本事件循环所有连接组成的双向链表
+    clientstate_t *pending;  ///< 有被扣留的响应、等待 WAL 组提交的连接
+    clientstate_t *replicas;  ///< 订阅了复制日志的副本连接
+    size_t nclients;         ///< 当前连接数
+    client_pool_t pool;      ///< 本事件循环的连接内存，只由本线程使用
+    timer_wheel_t timers;    ///< 本事件循环所有连接的超时定时器
+    uint64_t now_ms;         ///< 本轮事件循环被唤醒的时刻（单调时钟毫秒）
+    pthread_t thread;        ///< 运行该事件循环的线程（0 号除外）
+} reactor_t;
+
+/**
+ * @brief SIGCHLD 信号处理函数。
+ *        不做任何事，只用于在后台检查点或快照子进程退出时打断 epoll_pwait。
+ * @param sig 接收到的信号编号
+ */
+static void handle_sigchld(int sig) {
+    (void)sig;
+}
+
+/**
+ * @brief 收到 SIGUSR1 后置位，由 0 号事件循环启动一次在线快照
+ */
+static volatile sig_atomic_t snapshot_requested = 0;
+
+/**
+ * @brief SIGUSR1 信号处理函数：请求一次在线快照。
+ * @param sig 接收到的信号编号
+ */
+static void handle_sigusr1(int sig) {
+    (void)sig;
+    snapshot_requested = 1;
+}
+
+/**
+ * @brief 把进程的文件描述符软上限提升到硬上限，以容纳大量连接。
+ */
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) == -1) {
+            perror("setrlimit RLIMIT_NOFILE");
+        }
+    }
+}
+
+/**
+ * @brief 创建非阻塞的监听套接字并开始监听。
+ *        多线程模式下每个事件循环各自绑定同一端口（SO_REUSEPORT），
+ *        由内核把新连接分散到各个监听队列，无需在线程间转交连接。
+ * @param port 监听端口
+ * @param reuseport 是否设置 SO_REUSEPORT
+ * @return 成功时返回套接字，错误时返回 STATUS_ERROR。
+ */
+static int create_listen_socket(unsigned short port, bool reuseport) {
+    int listen_fd __attribute__((cleanup(_cleanup_fd_))) =
+        socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        perror("socket");
+        return STATUS_ERROR;
+    }
+
+    // 设置套接字选项：允许地址重用，防止 TIME_WAIT 状态导致重启失败
+    int opt = 1;
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        perror("setsockopt");
+        return STATUS_ERROR;
+    }
+    if (reuseport &&
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        perror("setsockopt SO_REUSEPORT");
+        return STATUS_ERROR;
+    }
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;  // 监听所有可用网络接口
+    server_addr.sin_port = htons(port);        // 端口转换为网络字节序
+
+    if (bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) ==
+        -1) {
+        perror("bind");
+        return STATUS_ERROR;
+    }
+    if (listen(listen_fd, REACTOR_BACKLOG) == -1) {
+        perror("listen");
+        return STATUS_ERROR;
+    }
+
+    int fd = listen_fd;
+    listen_fd = -1;  // 清除 cleanup 宏的作用，所有权转移给调用者
+    return fd;
+}
+
+/**
+ * @brief 计算连接当前适用的超时时刻：握手未完成时从接受连接算起；
+ *        有未收完的消息时从它开始接收算起；有待发送的数据时从最近一次
+ *        套接字事件算起（对端在读取就会有可写事件）；否则是空闲超时。
+ *        等待组提交的连接与副本连接不受超时限制。
+ * @param r 事件循环
+ * @param client 连接
+ * @param reason 输出参数，超时原因
+ * @return 超时时刻（毫秒），不受限制时返回 UINT64_MAX。
+ */
+static uint64_t reactor_deadline(reactor_t *r, clientstate_t *client,
+                                 const char **reason) {
+    const client_timeouts_t *t = &r->db->timeouts;
+    uint64_t from, limit;
+    if (client->in_pending || client->repl != NULL) return UINT64_MAX;
+    if (client->state == STATE_CONNECTED) {
+        *reason = "Handshake timeout";
+        from = client->created_ms;
+        limit = t->handshake_ms;
+    } else if (client->req_start_ms != 0) {
+        *reason = "Request timeout";
+        from = client->req_start_ms;
+        limit = t->request_ms;
+    } else if (outq_pending(&client->outq) > 0 || client->cursor.active) {
+        *reason = "Send timeout";
+        from = client->active_ms;
+        limit = t->request_ms;
+    } else {
+        *reason = "Idle timeout";
+        from = client->active_ms;
+        limit = t->idle_ms;
+    }
+    return limit == 0 ? UINT64_MAX : from + limit;
+}
+
+/**
+ * @brief 按连接当前的状态设置超时定时器。超时时刻推迟时不改动定时器，
+ *        到期时再重新计算，因此活跃的连接不必每个请求都在时间轮中移动。
+ * @param r 事件循环
+ * @param client 未关闭的连接
+ */
+static void reactor_arm(reactor_t *r, clientstate_t *client) {
+    if (client->buffer_pos == 0) {
+        client->req_start_ms = 0;
+    } else if (client->req_start_ms == 0) {
+        client->req_start_ms = r->now_ms;
+    }
+    const char *reason;
+    uint64_t deadline = reactor_deadline(r, client, &reason);
+    if (deadline == UINT64_MAX) return;
+    if (!timer_pending(&client->timer) || deadline < client->timer.expires) {
+        timer_wheel_add(&r->timers, &client->timer, deadline);
+    }
+}
+
+/**
+ * @brief 在处理完一个连接的事件后更新它在事件循环中的位置：
+ *        已关闭的连接被释放（若仍在等待组提交，则推迟到提交之后），
+ *        有被扣留响应的连接加入等待组提交的链表，刚订阅复制日志的连接
+ *        加入副本连接的链表，未关闭的连接重新设置超时。
+ * @param r 事件循环
+ * @param client 刚处理过的连接
+ */
+static void reactor_track(reactor_t *r, clientstate_t *client) {
+    if (client->fd == -1) {
+        timer_wheel_del(&r->timers, &client->timer);
+        if (client->in_replicas) {
+            clientstate_t *prev = client->repl_prev;
+            clientstate_t *next = client->repl_next;
+            if (prev) prev->repl_next = next;
+            if (next) next->repl_prev = prev;
+            if (r->replicas == client) r->replicas = client->repl_next;
+            client->in_replicas = false;
+        }
+        if (client->in_pending) return;  // 由 reactor_commit 负责释放
+        if (client->prev) client->prev->next = client->next;
+        if (client->next) client->next->prev = client->prev;
+        if (r->clients == client) r->clients = client->next;
+        r->nclients--;
+        client_destroy(client);
+        stats_add(&r->pool.stats->conns_closed, 1);
+        return;
+    }
+    if (client->wait_lsn != 0 && !client->in_pending) {
+        client->pend_next = r->pending;
+        r->pending = client;
+        client->in_pending = true;
+    }
+    if (client->repl != NULL && !client->in_replicas) {
+        client->repl_prev = NULL;
+        client->repl_next = r->replicas;
+        if (r->replicas) r->replicas->repl_prev = client;
+        r->replicas = client;
+        client->in_replicas = true;
+    }
+    reactor_arm(r, client);
+}
+
+/**
+ * @brief 超时定时器到期：若期间有活动使超时时刻推迟，重新设置；
+ *        否则断开连接。
+ * @param node 连接的定时器
+ * @param arg 事件循环
+ */
+static void reactor_expire(timer_node_t *node, void *arg) {
+    reactor_t *r = arg;
+    clientstate_t *client =
+        (clientstate_t *)((char *)node - offsetof(clientstate_t, timer));
+    const char *reason = NULL;
+    uint64_t deadline = reactor_deadline(r, client, &reason);
+    if (deadline > r->now_ms) {
+        if (deadline != UINT64_MAX) {
+            timer_wheel_add(&r->timers, node, deadline);
+        }
+        return;
+    }
+    expire_client(client, reason);
+    reactor_track(r, client);
+}
+
+/**
+ * @brief 复制日志有新记录：推送给本事件循环的所有副本连接。
+ * @param r 事件循环
+ */
+static void reactor_feed_replicas(reactor_t *r) {
+    clientstate_t *client = r->replicas;
+    while (client != NULL) {
+        clientstate_t *next = client->repl_next;  // client 可能被释放
+        feed_replica_client(client);
+        reactor_track(r, client);
+        client = next;
+    }
+}
+
+/**
+ * @brief 接受所有排队的新连接，直到 accept 返回 EAGAIN（边沿触发要求）。
+ * @param r 事件循环
+ */
+static void reactor_accept(reactor_t *r) {
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int conn_fd =
+            accept4(r->listen_fd, (struct sockaddr *)&client_addr, &client_len,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (conn_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");  // 例如 EMFILE，下一个新连接到来时重试
+            }
+            return;
+        }
+        log_debug("New connection from %s:%d",
+                  inet_ntoa(client_addr.sin_addr),
+                  ntohs(client_addr.sin_port));
+
+        clientstate_t *client = client_create(&r->pool, conn_fd);
+        if (client == NULL) {
+            close(conn_fd);
+            continue;
+        }
+        // 同时关注可读与可写：边沿触发下 EPOLLOUT 只在发送缓冲区
+        // 重新有空间时通知一次，无需随输出队列状态反复 EPOLL_CTL_MOD
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            .data.ptr = client};
+        if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, conn_fd, &ev) == -1) {
+            perror("epoll_ctl add client");
+            client_destroy(client);
+            continue;
+        }
+
+        client->next = r->clients;
+        if (r->clients) r->clients->prev = client;
+        r->clients = client;
+        r->nclients++;
+        stats_add(&r->pool.stats->conns_accepted, 1);
+        client->created_ms = client->active_ms = r->now_ms;
+        reactor_arm(r, client);
+        log_debug(
+            "Client fd %d registered on reactor %d. State: CONNECTED (%zu "
+            "clients)",
+            conn_fd, r->id, r->nclients);
+    }
+}
+
+/**
+ * @brief WAL 组提交：本轮所有修改只做一次 fdatasync，然后放行等待落盘的响应。
+ *        其他线程的提交可能已经带走了本线程的记录，此时 wal_commit 会等待
+ *        那次写盘完成，因此返回后 synced_lsn 总能覆盖本线程的记录。
+ *        恢复后的连接可能继续产生修改，因此循环直到没有等待提交的连接。
+ * @param r 事件循环
+ */
+static void reactor_commit(reactor_t *r) {
+    while (r->pending != NULL) {
+        if (wal_commit(r->db->wal) != STATUS_SUCCESS) {
+            // 无法保证持久性时不能继续确认任何修改
+            fprintf(stderr, "Fatal: WAL commit failed, shutting down.\n");
+            exit(EXIT_FAILURE);
+        }
+        uint64_t synced_lsn = wal_synced_lsn(r->db->wal);
+        clientstate_t *client = r->pending;
+        r->pending = NULL;
+        uint64_t waiters = 0;
+        while (client != NULL) {
+            clientstate_t *next = client->pend_next;
+            client->pend_next = NULL;
+            client->in_pending = false;
+            if (client->wait_lsn <= synced_lsn) {
+                resume_client_fsm(r->db, client);
+                waiters++;
+            }
+            reactor_track(r, client);
+            client = next;
+        }
+        stats_shard_t *stats = r->pool.stats;
+        stats_add(&stats->commits, 1);
+        stats_add(&stats->commit_waiters, waiters);
+        stats_max(&stats->commit_waiters_max, waiters);
+    }
+}
+
+/**
+ * @brief 回收已完成的快照与后台检查点，日志段过大时启动新的检查点。
+ *        持有读锁保证 fork 时刻的记录数与记录堆末尾不在修改之中。
+ *        没有检查点在进行时，按需压缩数据库文件：压缩持有写锁，
+ *        先提交 WAL，使新文件中的每个修改都已在日志中落盘。
+ * @param db 服务器数据上下文
+ */
+static void reactor_checkpoint(dbctx_t *db) {
+    snapshot_poll(&db->snapshot);
+    wal_checkpoint_poll(db->wal);
+    if (wal_should_checkpoint(db->wal)) {
+        pthread_rwlock_rdlock(&db->lock);
+        wal_checkpoint_start(db->wal);
+        pthread_rwlock_unlock(&db->lock);
+    }
+    pthread_rwlock_rdlock(&db->lock);
+    bool compact = dbmap_should_compact(db->map);
+    pthread_rwlock_unlock(&db->lock);
+    if (compact && !wal_checkpoint_running(db->wal)) {
+        pthread_rwlock_wrlock(&db->lock);
+        if (!wal_checkpoint_running(db->wal) &&
+            dbmap_should_compact(db->map) &&
+            wal_commit(db->wal) == STATUS_SUCCESS) {
+            dbmap_compact(db->map);
+        }
+        pthread_rwlock_unlock(&db->lock);
+    }
+}
+
+/**
+ * @brief 为一个事件循环初始化连接内存，创建监听套接字和 epoll 实例。
+ * @param r 要初始化的事件循环，id/db/stop/wake_fd 已由调用者设置
+ * @param port 监听端口
+ * @param reuseport 是否与其他事件循环共享端口
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int reactor_init(reactor_t *r, unsigned short port, bool reuseport) {
+    r->epfd = -1;
+    r->listen_fd = -1;
+    if (client_pool_init(&r->pool) != STATUS_SUCCESS) return STATUS_ERROR;
+    r->pool.stats = &r->db->stats.shards[r->id];
+    r->now_ms = timer_now_ms();
+    timer_wheel_init(&r->timers, r->now_ms);
+    if ((r->listen_fd = create_listen_socket(port, reuseport)) ==
+        STATUS_ERROR) {
+        r->listen_fd = -1;
+        return STATUS_ERROR;
+    }
+    if ((r->epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        perror("epoll_create1");
+        return STATUS_ERROR;
+    }
+    struct epoll_event listen_ev = {.events = EPOLLIN | EPOLLET,
+                                    .data.ptr = NULL};
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->listen_fd, &listen_ev) == -1) {
+        perror("epoll_ctl add listen");
+        return STATUS_ERROR;
+    }
+    // 水平触发且从不读取：写入一次后所有事件循环都会持续被唤醒直到退出
+    struct epoll_event wake_ev = {.events = EPOLLIN, .data.ptr = r};
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->wake_fd, &wake_ev) == -1) {
+        perror("epoll_ctl add eventfd");
+        return STATUS_ERROR;
+    }
+    // 边沿触发且从不读取：每次追加复制日志都会通知所有事件循环一次
+    struct epoll_event repl_ev = {.events = EPOLLIN | EPOLLET,
+                                  .data.ptr = &r->db->repl};
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->db->repl.notify_fd, &repl_ev) ==
+        -1) {
+        perror("epoll_ctl add replication eventfd");
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 关闭事件循环的所有连接，释放连接内存、监听套接字和 epoll 实例。
+ * @param r 事件循环
+ */
+static void reactor_destroy(reactor_t *r) {
+    while (r->clients != NULL) {
+        clientstate_t *next = r->clients->next;
+        client_destroy(r->clients);
+        r->clients = next;
+    }
+    client_pool_destroy(&r->pool);
+    if (r->epfd != -1) close(r->epfd);
+    if (r->listen_fd != -1) close(r->listen_fd);
+    r->epfd = r->listen_fd = -1;
+}
+
+/**
+ * @brief 事件循环主体，直到 *stop 被置位或 wake_fd 被写入。
+ * @param r 事件循环
+ */
+static void reactor_loop(reactor_t *r) {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    dbctx_t *db = r->db;
+
+    while (!*r->stop) {
+        // 等待到下一个需要推进时间轮的时刻，没有定时器时无限等待
+        int timeout = -1;
+        uint64_t next = timer_wheel_next(&r->timers);
+        if (next != UINT64_MAX) {
+            uint64_t now = timer_now_ms();
+            uint64_t wait = next > now ? next - now : 0;
+            timeout = wait > INT_MAX ? INT_MAX : (int)wait;
+        }
+        int n_events = epoll_pwait(r->epfd, events, REACTOR_MAX_EVENTS,
+                                   timeout, r->wait_mask);
+        if (n_events == -1) {
+            if (errno != EINTR) {
+                perror("epoll_pwait");  // 其他错误是严重错误，退出
+                exit(EXIT_FAILURE);
+            }
+            n_events = 0;  // 被信号打断，继续做后面的周期性工作
+        }
+        uint64_t start_ns = stats_now_ns();  // 只计处理时间，不含等待
+        r->now_ms = timer_now_ms();
+
+        for (int i = 0; i < n_events; ++i) {
+            clientstate_t *client = events[i].data.ptr;
+            if (client == NULL) {
+                reactor_accept(r);
+                continue;
+            }
+            if ((void *)client == (void *)r) continue;  // 关闭通知
+            if ((void *)client == (void *)&db->repl) {  // 复制日志有新记录
+                reactor_feed_replicas(r);
+                continue;
+            }
+            uint32_t ev = events[i].events;
+            client->active_ms = r->now_ms;
+            if (ev & EPOLLOUT) {
+                handle_client_writable(db, client);
+            }
+            if (client->fd != -1 &&
+                (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                handle_client_fsm(db, client);
+            }
+            reactor_track(r, client);
+        }
+
+        // 本轮所有修改一次落盘，然后发送被扣留的响应
+        reactor_commit(r);
+        timer_wheel_advance(&r->timers, r->now_ms, reactor_expire, r);
+        if (r->id == 0 && snapshot_requested) {
+            snapshot_requested = 0;
+            dbctx_snapshot(db, NULL);
+        }
+        reactor_checkpoint(db);
+        stats_record_loop(r->pool.stats, (uint64_t)n_events,
+                          stats_now_ns() - start_ns);
+    }
+}
+
+/**
+ * @brief 工作线程入口：运行一个事件循环。信号已在创建前被屏蔽，
+ *        只有 0 号事件循环所在的线程会在 epoll_pwait 期间接收信号。
+ * @param arg 指向 reactor_t
+ * @return 总是 NULL。
+ */
+static void *reactor_thread(void *arg) {
+    reactor_loop((reactor_t *)arg);
+    return NULL;
+}
+
+/**
+ * @brief 运行基于 epoll 边沿触发的服务器事件循环。
+ * @param port 服务器监听端口
+ * @param nthreads 事件循环线程数
+ * @param db 服务器数据上下文
+ * @param stop 退出标志
+ * @return 正常退出时返回 STATUS_SUCCESS，初始化失败时返回 STATUS_ERROR。
+ */
+int reactor_run(unsigned short port, int nthreads, dbctx_t *db,
+                volatile sig_atomic_t *stop) {
+    if (nthreads < 1 || nthreads > REACTOR_MAX_THREADS) {
+        fprintf(stderr, "Error: Invalid reactor thread count %d\n", nthreads);
+        return STATUS_ERROR;
+    }
+    reactor_t *reactors __attribute__((cleanup(_cleanup_ptr_))) =
+        calloc(nthreads, sizeof(reactor_t));
+    if (reactors == NULL) {
+        perror("calloc for reactors");
+        return STATUS_ERROR;
+    }
+    int wake_fd __attribute__((cleanup(_cleanup_fd_))) =
+        eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd == -1) {
+        perror("eventfd");
+        return STATUS_ERROR;
+    }
+
+    raise_fd_limit();
+    if (stats_init(&db->stats, nthreads) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+
+    int status = STATUS_SUCCESS;
+    int ninit = 0;
+    for (; ninit < nthreads; ++ninit) {
+        reactor_t *r = &reactors[ninit];
+        r->id = ninit;
+        r->db = db;
+        r->stop = stop;
+        r->wake_fd = wake_fd;
+        if (reactor_init(r, port, nthreads > 1) != STATUS_SUCCESS) {
+            reactor_destroy(r);
+            status = STATUS_ERROR;
+            break;
+        }
+    }
+
+    // 平时屏蔽 SIGINT/SIGCHLD/SIGUSR1，只在 0 号事件循环的 epoll_pwait
+    // 期间放开，这样无需轮询超时也不会错过退出信号、快照请求或子进程
+    // 结束；之后创建的工作线程继承屏蔽字，永远不会收到这些信号
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigchld;
+    sa.sa_flags = SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+    sa.sa_handler = handle_sigusr1;
+    sa.sa_flags = 0;
+    sigaction(SIGUSR1, &sa, NULL);
+    // sendfile 没有 MSG_NOSIGNAL，对端关闭时改为返回 EPIPE
+    sa.sa_handler = SIG_IGN;
+    sa.sa_flags = 0;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    sigset_t block_mask, wait_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGINT);
+    sigaddset(&block_mask, SIGCHLD);
+    sigaddset(&block_mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &block_mask, &wait_mask);
+    sigdelset(&wait_mask, SIGINT);
+    sigdelset(&wait_mask, SIGCHLD);
+    sigdelset(&wait_mask, SIGUSR1);
+
+    int nstarted = 1;
+    if (status == STATUS_SUCCESS) {
+        for (; nstarted < nthreads; ++nstarted) {
+            int err = pthread_create(&reactors[nstarted].thread, NULL,
+                                     reactor_thread, &reactors[nstarted]);
+            if (err != 0) {
+                fprintf(stderr, "Error: pthread_create: %s\n", strerror(err));
+                status = STATUS_ERROR;
+                break;
+            }
+        }
+    }
+
+    if (status == STATUS_SUCCESS) {
+        log_info("Server listening on port %d (epoll, %d reactor thread%s)",
+                 port, nthreads, nthreads > 1 ? "s" : "");
+        reactors[0].wait_mask = &wait_mask;
+        reactor_loop(&reactors[0]);
+    }
+
+    // 唤醒并等待所有工作线程退出，然后关闭所有连接并恢复信号屏蔽字
+    *stop = 1;
+    if (eventfd_write(wake_fd, 1) == -1) {
+        perror("eventfd_write");
+    }
+    for (int i = 1; i < nstarted; ++i) {
+        pthread_join(reactors[i].thread, NULL);
+    }
+    for (int i = 0; i < ninit; ++i) {
+        reactor_destroy(&reactors[i]);
+    }
+    pthread_sigmask(SIG_UNBLOCK, &block_mask, NULL);
+    stats_destroy(&db->stats);
+    if (status == STATUS_SUCCESS) {
+        log_info("Event loop exited gracefully.");
+    }
+    return status;
+}
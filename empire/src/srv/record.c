@@ -0,0 +1,111 @@
+#include "../../include/record.h"  // 包含 dbrec_t 声明
+
+#include <string.h>  // For memcpy, memset, strnlen
+
+/**
+ * @brief 员工名字和地址字段的长度
+ */
+#define FIELD_LEN sizeof(((struct employee_t *)0)->name)
+
+/**
+ * @brief 以 LEB128 格式写入一个无符号整数。
+ * @return 写入的字节数。
+ */
+static size_t varint_put(char *dst, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        dst[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    dst[n++] = (char)v;
+    return n;
+}
+
+/**
+ * @brief 读取一个 LEB128 整数，最多 max_len 字节。
+ * @return 读取的字节数；数据不完整或超过 max_len 字节时返回 0。
+ */
+static size_t varint_get(const char *src, size_t len, size_t max_len,
+                         uint64_t *v) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < len && i < max_len; i++) {
+        uint8_t byte = (uint8_t)src[i];
+        result |= (uint64_t)(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            *v = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 写入长度前缀的字符串，长度不超过 FIELD_LEN - 1。
+ */
+static size_t put_string(char *dst, const char *s) {
+    size_t len = strnlen(s, FIELD_LEN - 1);
+    size_t n = varint_put(dst, len);
+    memcpy(dst + n, s, len);
+    return n + len;
+}
+
+/**
+ * @brief 读取长度前缀的字符串。
+ * @return 读取的字节数；数据不完整或长度非法时返回 0。
+ */
+static size_t get_string(const char *src, size_t len, const char **s,
+                         size_t *s_len) {
+    uint64_t n;
+    size_t used = varint_get(src, len, 2, &n);
+    if (used == 0 || n >= FIELD_LEN || len - used < n) return 0;
+    *s = src + used;
+    *s_len = (size_t)n;
+    return used + (size_t)n;
+}
+
+size_t dbrec_encode(char *dst, uint32_t slot,
+                    const struct employee_t *employee) {
+    if (employee->name[0] == '\0') return dbrec_encode_tombstone(dst, slot);
+    size_t n = varint_put(dst, slot);
+    n += put_string(dst + n, employee->name);
+    n += put_string(dst + n, employee->address);
+    n += varint_put(dst + n, employee->hours);
+    return n;
+}
+
+size_t dbrec_encode_tombstone(char *dst, uint32_t slot) {
+    size_t n = varint_put(dst, slot);
+    dst[n++] = 0;  // 名字长度
+    dst[n++] = 0;  // 地址长度
+    dst[n++] = 0;  // hours
+    return n;
+}
+
+size_t dbrec_decode(const char *src, size_t len, dbrec_t *out) {
+    uint64_t v;
+    size_t pos = varint_get(src, len, 5, &v);
+    if (pos == 0 || v > UINT32_MAX) return 0;
+    out->slot = (uint32_t)v;
+
+    size_t n = get_string(src + pos, len - pos, &out->name, &out->name_len);
+    if (n == 0) return 0;
+    pos += n;
+    n = get_string(src + pos, len - pos, &out->address, &out->address_len);
+    if (n == 0) return 0;
+    pos += n;
+    n = varint_get(src + pos, len - pos, 5, &v);
+    if (n == 0 || v > UINT32_MAX) return 0;
+    out->hours = (uint32_t)v;
+    pos += n;
+
+    out->raw = src;
+    out->size = pos;
+    return pos;
+}
+
+void dbrec_to_employee(const dbrec_t *rec, struct employee_t *out) {
+    memset(out, 0, sizeof(*out));
+    memcpy(out->name, rec->name, rec->name_len);
+    memcpy(out->address, rec->address, rec->address_len);
+    out->hours = rec->hours;
+}
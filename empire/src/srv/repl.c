@@ -0,0 +1,555 @@
+#include "../../include/repl.h"  // 包含 repl_log_t, repl_replica_t 声明
+
+#include <arpa/inet.h>     // For inet_pton, htons, ntohs
+#include <endian.h>        // For htobe64, be64toh
+#include <errno.h>         // For errno, EINTR, EAGAIN
+#include <fcntl.h>         // For open, O_WRONLY, O_CREAT, O_TRUNC
+#include <limits.h>        // For PATH_MAX
+#include <netinet/in.h>    // For sockaddr_in
+#include <signal.h>        // For sigfillset, pthread_sigmask
+#include <stdio.h>         // For printf, fprintf, perror, snprintf
+#include <stdlib.h>        // For malloc, free, strtol
+#include <string.h>        // For memcpy, memmove, strrchr
+#include <sys/eventfd.h>   // For eventfd, eventfd_write
+#include <sys/socket.h>    // For socket, connect, recv, shutdown
+#include <time.h>          // For clock_gettime
+#include <unistd.h>        // For close, fsync, unlink
+
+#include "../../include/common.h"  // 包含协议结构与 send_full
+#include "../../include/file.h"    // 包含 fsync_parent_dir, write_all
+#include "../../include/wal.h"     // 包含 wal_apply_stream 与记录格式
+
+/**
+ * @brief 副本接收日志流的缓冲区大小：一条消息的数据加上上一条消息末尾
+ *        残留的不完整记录
+ */
+#define REPL_PENDING_SIZE \
+    (REPL_CHUNK + sizeof(struct wal_rec_hdr_t) + WAL_MAX_PAYLOAD)
+
+/**
+ * @brief 获取单调时钟的毫秒数，用于计算复制延迟。
+ */
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* ---------------- 主库：复制日志 ---------------- */
+
+/**
+ * @brief 初始化复制日志，环形缓冲区等到第一个订阅出现时再申请。
+ */
+int repl_log_init(repl_log_t *log, uint64_t lsn) {
+    memset(log, 0, sizeof(*log));
+    log->end_lsn = lsn;
+    log->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (log->notify_fd == -1) {
+        perror("eventfd for replication");
+        return STATUS_ERROR;
+    }
+    pthread_mutex_init(&log->lock, NULL);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 释放环形缓冲区并关闭 notify_fd。
+ */
+void repl_log_destroy(repl_log_t *log) {
+    free(log->ring);
+    log->ring = NULL;
+    close(log->notify_fd);
+    log->notify_fd = -1;
+    pthread_mutex_destroy(&log->lock);
+}
+
+/**
+ * @brief 把 len 字节写到日志流偏移 off 对应的环形缓冲区位置，必要时回绕。
+ */
+static void ring_put(repl_log_t *log, uint64_t off, const char *data,
+                     size_t len) {
+    size_t pos = (size_t)(off % REPL_BACKLOG_SIZE);
+    size_t room = REPL_BACKLOG_SIZE - pos;
+    size_t first = len < room ? len : room;
+    memcpy(log->ring + pos, data, first);
+    memcpy(log->ring, data + first, len - first);
+}
+
+/**
+ * @brief 从日志流偏移 off 对应的环形缓冲区位置读出 len 字节。
+ */
+static void ring_get(const repl_log_t *log, uint64_t off, char *dst,
+                     size_t len) {
+    size_t pos = (size_t)(off % REPL_BACKLOG_SIZE);
+    size_t room = REPL_BACKLOG_SIZE - pos;
+    size_t first = len < room ? len : room;
+    memcpy(dst, log->ring + pos, first);
+    memcpy(dst + first, log->ring, len - first);
+}
+
+/**
+ * @brief 追加落盘的记录：有订阅时拷贝到环形缓冲区并唤醒事件循环，
+ *        追上的副本从此刻开始计算落后时间；没有订阅时只推进偏移。
+ */
+void repl_log_append(void *arg, const char *data, size_t len,
+                     uint64_t last_lsn) {
+    repl_log_t *log = arg;
+    pthread_mutex_lock(&log->lock);
+    bool notify = log->nsubs > 0;
+    if (notify) {
+        if (len > REPL_BACKLOG_SIZE) {
+            // 只保留最后 REPL_BACKLOG_SIZE 字节，之前的部分直接跳过
+            log->end += len - REPL_BACKLOG_SIZE;
+            data += len - REPL_BACKLOG_SIZE;
+            len = REPL_BACKLOG_SIZE;
+        }
+        ring_put(log, log->end, data, len);
+        log->end += len;
+        if (log->end - log->start > REPL_BACKLOG_SIZE) {
+            log->start = log->end - REPL_BACKLOG_SIZE;
+        }
+        uint64_t now = now_ms();
+        for (repl_sub_t *sub = log->subs; sub != NULL; sub = sub->next) {
+            if (sub->behind_since == 0) sub->behind_since = now;
+        }
+    } else {
+        log->end += len;
+        log->start = log->end;
+    }
+    log->end_lsn = last_lsn;
+    pthread_mutex_unlock(&log->lock);
+
+    // 每个事件循环以边沿触发关注 notify_fd，每次写入都会通知所有事件循环
+    if (notify && eventfd_write(log->notify_fd, 1) == -1 && errno != EAGAIN) {
+        perror("eventfd_write for replication");
+    }
+}
+
+/**
+ * @brief 登记订阅，发送位置为日志流的末尾。
+ */
+int repl_log_subscribe(repl_log_t *log, repl_sub_t *sub, uint64_t lsn) {
+    pthread_mutex_lock(&log->lock);
+    if (log->ring == NULL) {
+        log->ring = malloc(REPL_BACKLOG_SIZE);
+        if (log->ring == NULL) {
+            perror("malloc for replication backlog");
+            pthread_mutex_unlock(&log->lock);
+            return STATUS_ERROR;
+        }
+    }
+    sub->log = log;
+    sub->off = log->end;
+    sub->ack_lsn = lsn;
+    sub->behind_since = 0;
+    sub->prev = NULL;
+    sub->next = log->subs;
+    if (log->subs != NULL) log->subs->prev = sub;
+    log->subs = sub;
+    log->nsubs++;
+    pthread_mutex_unlock(&log->lock);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 从订阅链表中移除。环形缓冲区保留给之后的订阅。
+ */
+void repl_log_unsubscribe(repl_sub_t *sub) {
+    repl_log_t *log = sub->log;
+    pthread_mutex_lock(&log->lock);
+    if (sub->prev != NULL) sub->prev->next = sub->next;
+    if (sub->next != NULL) sub->next->prev = sub->prev;
+    if (log->subs == sub) log->subs = sub->next;
+    log->nsubs--;
+    pthread_mutex_unlock(&log->lock);
+    sub->prev = sub->next = NULL;
+}
+
+/**
+ * @brief 发送位置之后的字节仍在缓冲区中时返回它们的数量。
+ */
+ssize_t repl_log_pending(repl_sub_t *sub) {
+    repl_log_t *log = sub->log;
+    pthread_mutex_lock(&log->lock);
+    ssize_t n = sub->off < log->start ? -1 : (ssize_t)(log->end - sub->off);
+    pthread_mutex_unlock(&log->lock);
+    return n;
+}
+
+/**
+ * @brief 拷贝并推进发送位置。
+ */
+ssize_t repl_log_read(repl_sub_t *sub, char *dst, size_t max,
+                      uint64_t *lsnOut) {
+    repl_log_t *log = sub->log;
+    pthread_mutex_lock(&log->lock);
+    if (sub->off < log->start) {
+        pthread_mutex_unlock(&log->lock);
+        return -1;
+    }
+    size_t n = log->end - sub->off < max ? (size_t)(log->end - sub->off) : max;
+    ring_get(log, sub->off, dst, n);
+    sub->off += n;
+    *lsnOut = log->end_lsn;
+    pthread_mutex_unlock(&log->lock);
+    return (ssize_t)n;
+}
+
+/**
+ * @brief 确认追上日志流末尾时清除落后时间。
+ */
+void repl_log_ack(repl_sub_t *sub, uint64_t lsn) {
+    repl_log_t *log = sub->log;
+    pthread_mutex_lock(&log->lock);
+    if (lsn > sub->ack_lsn) sub->ack_lsn = lsn;
+    if (sub->ack_lsn >= log->end_lsn) sub->behind_since = 0;
+    pthread_mutex_unlock(&log->lock);
+}
+
+/**
+ * @brief 遍历所有订阅，取落后最多的 LSN 数与最长的落后时间。
+ */
+void repl_log_stats(repl_log_t *log, repl_stats_t *out) {
+    uint64_t now = now_ms();
+    memset(out, 0, sizeof(*out));
+    out->role = REPL_ROLE_PRIMARY;
+    pthread_mutex_lock(&log->lock);
+    out->links = (uint32_t)log->nsubs;
+    out->lsn = out->primary_lsn = log->end_lsn;
+    for (repl_sub_t *sub = log->subs; sub != NULL; sub = sub->next) {
+        uint64_t lag = log->end_lsn > sub->ack_lsn ? log->end_lsn - sub->ack_lsn
+                                                   : 0;
+        if (lag > out->lag_lsn) out->lag_lsn = lag;
+        if (sub->behind_since != 0 && now - sub->behind_since > out->lag_ms) {
+            out->lag_ms = now - sub->behind_since;
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+}
+
+/* ---------------- 副本：同步与日志流 ---------------- */
+
+/**
+ * @brief 阻塞地接收恰好 len 字节。与 read_full 不同，不打印错误：
+ *        关闭副本时连接被主动断开，这不是错误。
+ * @return 成功时返回 STATUS_SUCCESS，连接断开或出错时返回 STATUS_ERROR。
+ */
+static int recv_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return STATUS_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 接收一个消息头部并按协议版本转换为主机字节序。
+ */
+static int recv_hdr(int fd, uint16_t proto, dbproto_hdr_t *hdr) {
+    if (recv_all(fd, hdr, sizeof(*hdr)) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    dbproto_hdr_unpack(hdr, proto);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 发送一条消息体不超过 8 字节的消息（Hello、订阅、确认）。
+ */
+static int send_msg(int fd, uint16_t proto, uint32_t type, const void *body,
+                    uint32_t len) {
+    char buf[sizeof(dbproto_hdr_t) + sizeof(uint64_t)];
+    if (len > sizeof(uint64_t)) return STATUS_ERROR;
+    dbproto_hdr_pack((dbproto_hdr_t *)buf, proto, type, len);
+    if (len > 0) memcpy(buf + sizeof(dbproto_hdr_t), body, len);
+    if (send_full(fd, buf, sizeof(dbproto_hdr_t) + len) == STATUS_ERROR) {
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 解析 "<IPv4 地址>:<端口>" 并建立阻塞的 TCP 连接。
+ * @param primary 主库地址
+ * @return 成功时返回套接字，错误时返回 -1。
+ */
+static int connect_primary(const char *primary) {
+    char host[INET_ADDRSTRLEN];
+    const char *colon = strrchr(primary, ':');
+    if (colon == NULL || colon == primary ||
+        (size_t)(colon - primary) >= sizeof(host)) {
+        fprintf(stderr,
+                "Error: Primary address must be <ip>:<port>, got '%s'\n",
+                primary);
+        return -1;
+    }
+    memcpy(host, primary, (size_t)(colon - primary));
+    host[colon - primary] = '\0';
+    char *end = NULL;
+    long port = strtol(colon + 1, &end, 10);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (*(colon + 1) == '\0' || *end != '\0' || port < 1 || port > 65535 ||
+        inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Error: Invalid primary address '%s'\n", primary);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("connect to primary");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 接收 bytes 字节的数据库镜像，写入临时文件并落盘后原子地替换
+ *        数据库文件。
+ * @param fd 到主库的连接
+ * @param db_path 数据库文件路径
+ * @param bytes 镜像字节数
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int receive_image(int fd, const char *db_path, uint64_t bytes) {
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.sync", db_path) >=
+        (int)sizeof(tmp_path)) {
+        fprintf(stderr, "Error: Database path too long: '%s'\n", db_path);
+        return STATUS_ERROR;
+    }
+    char *chunk __attribute__((cleanup(_cleanup_ptr_))) = malloc(REPL_CHUNK);
+    if (chunk == NULL) {
+        perror("malloc for replica sync");
+        return STATUS_ERROR;
+    }
+    int out = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out == -1) {
+        perror("open replica image");
+        return STATUS_ERROR;
+    }
+
+    int status = STATUS_SUCCESS;
+    for (uint64_t left = bytes; left > 0 && status == STATUS_SUCCESS;) {
+        size_t n = left < REPL_CHUNK ? (size_t)left : REPL_CHUNK;
+        if (recv_all(fd, chunk, n) != STATUS_SUCCESS) {
+            fprintf(stderr, "Error: Primary closed the connection during "
+                            "sync\n");
+            status = STATUS_ERROR;
+        } else if (write_all(out, chunk, n) != STATUS_SUCCESS) {
+            perror("write replica image");
+            status = STATUS_ERROR;
+        }
+        left -= n;
+    }
+    if (status == STATUS_SUCCESS && fsync(out) == -1) {
+        perror("fsync replica image");
+        status = STATUS_ERROR;
+    }
+    if (close(out) == -1) status = STATUS_ERROR;
+    if (status == STATUS_SUCCESS &&
+        (rename(tmp_path, db_path) == -1 ||
+         fsync_parent_dir(db_path) != STATUS_SUCCESS)) {
+        perror("replace database file with replica image");
+        status = STATUS_ERROR;
+    }
+    if (status != STATUS_SUCCESS) unlink(tmp_path);
+    return status;
+}
+
+/**
+ * @brief Hello（协商 V3）之后发送订阅请求，接收镜像。
+ */
+int repl_replica_sync(repl_replica_t *rep, const char *primary,
+                      const char *db_path) {
+    memset(rep, 0, sizeof(*rep));
+    rep->fd = -1;
+
+    int fd __attribute__((cleanup(_cleanup_fd_))) = connect_primary(primary);
+    if (fd == -1) return STATUS_ERROR;
+
+    // Hello 请求与响应总是使用 V1 头部
+    dbproto_hdr_t hdr;
+    dbproto_hello_req hello = {.proto = htons(PROTO_VER_V3)};
+    dbproto_hello_resp hello_resp;
+    if (send_msg(fd, PROTO_VER_V1, MSG_HELLO_REQ, &hello, sizeof(hello)) !=
+            STATUS_SUCCESS ||
+        recv_hdr(fd, PROTO_VER_V1, &hdr) != STATUS_SUCCESS ||
+        hdr.type != MSG_HELLO_RESP || hdr.len != sizeof(hello_resp) ||
+        recv_all(fd, &hello_resp, sizeof(hello_resp)) != STATUS_SUCCESS ||
+        ntohs(hello_resp.proto) != PROTO_VER_V3) {
+        fprintf(stderr, "Error: Hello with primary '%s' failed\n", primary);
+        return STATUS_ERROR;
+    }
+
+    dbproto_repl_sync_resp_t resp;
+    if (send_msg(fd, PROTO_VER_V3, MSG_REPL_SYNC_REQ, NULL, 0) !=
+            STATUS_SUCCESS ||
+        recv_hdr(fd, PROTO_VER_V3, &hdr) != STATUS_SUCCESS ||
+        hdr.type != MSG_REPL_SYNC_RESP || hdr.len != sizeof(resp) ||
+        recv_all(fd, &resp, sizeof(resp)) != STATUS_SUCCESS ||
+        (int)ntohl(resp.status) != STATUS_SUCCESS) {
+        fprintf(stderr, "Error: Primary '%s' refused to replicate\n", primary);
+        return STATUS_ERROR;
+    }
+    uint64_t lsn = be64toh(resp.lsn);
+    uint64_t bytes = be64toh(resp.bytes);
+    if (receive_image(fd, db_path, bytes) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    printf("Synced %lu bytes from primary %s at LSN %lu\n",
+           (unsigned long)bytes, primary, (unsigned long)lsn);
+
+    pthread_mutex_init(&rep->lock, NULL);
+    rep->connected = true;
+    rep->applied_lsn = rep->primary_lsn = lsn;
+    rep->fd = fd;
+    fd = -1;  // 清除 cleanup 宏的作用，连接归 rep 所有
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 复制线程：逐条接收日志流，持有写锁重做完整的记录，末尾
+ *        不完整的记录留到下一条消息；每次有记录生效后回复确认。
+ * @param arg 指向 repl_replica_t
+ * @return 总是 NULL。
+ */
+static void *replica_thread(void *arg) {
+    repl_replica_t *rep = arg;
+    char *buf __attribute__((cleanup(_cleanup_ptr_))) =
+        malloc(REPL_PENDING_SIZE);
+    size_t have = 0;
+    const char *reason = "out of memory";
+
+    while (buf != NULL) {
+        dbproto_hdr_t hdr;
+        dbproto_repl_wal_t wal_hdr;
+        if (recv_hdr(rep->fd, PROTO_VER_V3, &hdr) != STATUS_SUCCESS) {
+            reason = "connection to primary lost";
+            break;
+        }
+        if (hdr.type == MSG_ERROR) {
+            reason = "primary dropped the replica, it fell too far behind";
+            break;
+        }
+        if (hdr.type != MSG_REPL_WAL || hdr.len < sizeof(wal_hdr) ||
+            hdr.len - sizeof(wal_hdr) > REPL_CHUNK) {
+            reason = "unexpected message from primary";
+            break;
+        }
+        size_t n = hdr.len - sizeof(wal_hdr);
+        if (recv_all(rep->fd, &wal_hdr, sizeof(wal_hdr)) != STATUS_SUCCESS ||
+            recv_all(rep->fd, buf + have, n) != STATUS_SUCCESS) {
+            reason = "connection to primary lost";
+            break;
+        }
+        have += n;
+
+        uint64_t lsn = 0;
+        size_t used = 0;
+        pthread_rwlock_wrlock(rep->db_lock);
+        int status =
+            wal_apply_stream(rep->map, rep->index, buf, have, &used, &lsn);
+        pthread_rwlock_unlock(rep->db_lock);
+        memmove(buf, buf + used, have - used);
+        have -= used;
+
+        pthread_mutex_lock(&rep->lock);
+        if (lsn != 0) rep->applied_lsn = lsn;
+        rep->primary_lsn = be64toh(wal_hdr.primary_lsn);
+        if (rep->applied_lsn >= rep->primary_lsn) {
+            rep->behind_since = 0;
+        } else if (rep->behind_since == 0) {
+            rep->behind_since = now_ms();
+        }
+        pthread_mutex_unlock(&rep->lock);
+
+        if (status != STATUS_SUCCESS) {
+            reason = "failed to apply the log stream";
+            break;
+        }
+        dbproto_repl_ack_t ack = {.lsn = htobe64(lsn)};
+        if (lsn != 0 && send_msg(rep->fd, PROTO_VER_V3, MSG_REPL_ACK, &ack,
+                                 sizeof(ack)) != STATUS_SUCCESS) {
+            reason = "connection to primary lost";
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&rep->lock);
+    rep->connected = false;
+    pthread_mutex_unlock(&rep->lock);
+    if (!__atomic_load_n(&rep->stopping, __ATOMIC_ACQUIRE)) {
+        fprintf(stderr,
+                "Error: Replication stopped (%s); serving stale data, restart "
+                "the replica to resync\n",
+                reason);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 屏蔽所有信号后创建复制线程，再恢复调用线程的屏蔽字。
+ */
+int repl_replica_start(repl_replica_t *rep, dbmap_t *map, dbindex_t *index,
+                       pthread_rwlock_t *db_lock) {
+    rep->map = map;
+    rep->index = index;
+    rep->db_lock = db_lock;
+
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&rep->thread, NULL, replica_thread, rep);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        fprintf(stderr, "Error: pthread_create: %s\n", strerror(err));
+        return STATUS_ERROR;
+    }
+    rep->started = true;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 关闭连接的读写两端，阻塞在 recv 上的复制线程随之退出。
+ */
+void repl_replica_stop(repl_replica_t *rep) {
+    if (rep->fd == -1 && !rep->started) return;
+    // 复制线程在 recv 失败后读取这个标志，必须先于 shutdown 可见
+    __atomic_store_n(&rep->stopping, true, __ATOMIC_RELEASE);
+    if (rep->fd != -1) shutdown(rep->fd, SHUT_RDWR);
+    if (rep->started) pthread_join(rep->thread, NULL);
+    if (rep->fd != -1) close(rep->fd);
+    rep->fd = -1;
+    rep->started = false;
+    pthread_mutex_destroy(&rep->lock);
+}
+
+/**
+ * @brief 副本只知道主库最近一次通告的 LSN，落后程度以它为准。
+ */
+void repl_replica_stats(repl_replica_t *rep, repl_stats_t *out) {
+    uint64_t now = now_ms();
+    memset(out, 0, sizeof(*out));
+    out->role = REPL_ROLE_REPLICA;
+    pthread_mutex_lock(&rep->lock);
+    out->links = rep->connected ? 1 : 0;
+    out->lsn = rep->applied_lsn;
+    out->primary_lsn = rep->primary_lsn;
+    if (rep->primary_lsn > rep->applied_lsn) {
+        out->lag_lsn = rep->primary_lsn - rep->applied_lsn;
+    }
+    if (rep->behind_since != 0) out->lag_ms = now - rep->behind_since;
+    pthread_mutex_unlock(&rep->lock);
+}
@@ -0,0 +1,202 @@
+#include "../../include/snapshot.h"  // 包含 snapshot_t 声明
+
+#include <errno.h>     // For errno, EINTR, ENOENT
+#include <fcntl.h>     // For open, O_WRONLY, O_CREAT, O_TRUNC
+#include <stdio.h>     // For fprintf, snprintf, rename
+#include <sys/wait.h>  // For waitpid
+#include <unistd.h>    // For fork, fsync, unlink, _exit
+
+#include "../../include/common.h"  // 包含 STATUS_SUCCESS 等宏
+#include "../../include/dbpack.h"  // 包含 dbpack_write_image
+#include "../../include/file.h"    // 包含 fsync_parent_dir, write_all
+#include "../../include/log.h"     // 包含 log_info
+
+/**
+ * @brief 校验和文件一行的最大长度
+ */
+#define SUM_LINE_MAX 128
+
+/**
+ * @brief 追加一个字符串，返回追加之后的位置。
+ */
+static char *put_str(char *p, const char *s) {
+    while (*s != '\0') *p++ = *s++;
+    return p;
+}
+
+/**
+ * @brief 追加一个无符号整数，不足 width 位时在前面补 0，返回追加之后的
+ *        位置。子进程中不使用 stdio，避免 fork 时被其他线程持有的锁。
+ */
+static char *put_u64(char *p, uint64_t v, unsigned base, int width) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = "0123456789abcdef"[v % base];
+        v /= base;
+    } while (v > 0);
+    while (n < width) digits[n++] = '0';
+    while (n > 0) *p++ = digits[--n];
+    return p;
+}
+
+/**
+ * @brief 写出并落盘一个文件，再原子地改名为目标路径。
+ * @param tmp_path 临时文件路径
+ * @param path 目标路径
+ * @param map 为 NULL 时写入 buf，否则写入映射的打包镜像
+ * @param buf 要写入的内容
+ * @param len 内容长度
+ * @param crcOut 写入镜像时返回解包后镜像的 CRC32C
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int write_replace(const char *tmp_path, const char *path,
+                         const dbmap_t *map, const char *buf, size_t len,
+                         uint32_t *crcOut) {
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) return STATUS_ERROR;
+    int status = map != NULL ? dbpack_write_image(map, fd, crcOut, NULL)
+                             : write_all(fd, buf, len);
+    if (status == STATUS_SUCCESS && fsync(fd) == -1) status = STATUS_ERROR;
+    if (close(fd) == -1) status = STATUS_ERROR;
+    if (status == STATUS_SUCCESS && rename(tmp_path, path) == -1) {
+        status = STATUS_ERROR;
+    }
+    if (status != STATUS_SUCCESS) unlink(tmp_path);
+    return status;
+}
+
+/**
+ * @brief 快照子进程：只使用系统调用，结果通过退出码告知父进程。
+ *        先删除旧的校验和文件，再写镜像，最后写校验和，任何时刻
+ *        存在的 .sum 都与 .snap 匹配。
+ */
+static void snapshot_child(const snapshot_t *snap, const dbmap_t *map) {
+    if (unlink(snap->sum_path) == -1 && errno != ENOENT) _exit(1);
+
+    uint32_t crc = 0;
+    if (write_replace(snap->tmp_path, snap->path, map, NULL, 0, &crc) !=
+        STATUS_SUCCESS) {
+        _exit(2);
+    }
+
+    // 格式："crc32c <8 位十六进制> bytes <n> lsn <n> count <n>\n"
+    char line[SUM_LINE_MAX];
+    char *p = line;
+    p = put_str(p, "crc32c ");
+    p = put_u64(p, crc, 16, 8);
+    p = put_str(p, " bytes ");
+    p = put_u64(p, snap->info.bytes, 10, 1);
+    p = put_str(p, " lsn ");
+    p = put_u64(p, snap->info.lsn, 10, 1);
+    p = put_str(p, " count ");
+    p = put_u64(p, snap->info.count, 10, 1);
+    *p++ = '\n';
+    if (write_replace(snap->sum_tmp_path, snap->sum_path, NULL, line,
+                      (size_t)(p - line), NULL) != STATUS_SUCCESS ||
+        fsync_parent_dir(snap->path) != STATUS_SUCCESS) {
+        _exit(3);
+    }
+    _exit(0);
+}
+
+/**
+ * @brief 拼接 <db><suffix> 形式的路径。
+ */
+static int make_path(char *out, const char *db_path, const char *suffix) {
+    if (snprintf(out, PATH_MAX, "%s%s", db_path, suffix) >= PATH_MAX) {
+        fprintf(stderr, "Error: Database path too long: '%s'\n", db_path);
+        return STATUS_ERROR;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 初始化快照状态，计算各个文件的路径。
+ */
+int snapshot_init(snapshot_t *snap, const char *db_path) {
+    if (make_path(snap->path, db_path, SNAPSHOT_SUFFIX) != STATUS_SUCCESS ||
+        make_path(snap->tmp_path, db_path, SNAPSHOT_SUFFIX ".tmp") !=
+            STATUS_SUCCESS ||
+        make_path(snap->sum_path, db_path, SNAPSHOT_SUM_SUFFIX) !=
+            STATUS_SUCCESS ||
+        make_path(snap->sum_tmp_path, db_path, SNAPSHOT_SUM_SUFFIX ".tmp") !=
+            STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    snap->pid = -1;
+    snap->info = (snapshot_info_t){0};
+    pthread_mutex_init(&snap->lock, NULL);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 记录快照对应的时刻并 fork 子进程写出镜像。
+ */
+int snapshot_start(snapshot_t *snap, const dbmap_t *map, uint64_t lsn,
+                   snapshot_info_t *infoOut) {
+    int status = STATUS_SUCCESS;
+    pthread_mutex_lock(&snap->lock);
+    if (snap->pid == -1) {
+        snap->info.lsn = lsn;
+        snap->info.count = map->hdr.count;
+        snap->info.bytes = map->hdr.heap_end;
+        pid_t pid = fork();
+        if (pid == 0) snapshot_child(snap, map);  // 不会返回
+        if (pid == -1) {
+            perror("fork for snapshot");
+            status = STATUS_ERROR;
+        } else {
+            snap->pid = pid;
+            log_info("Snapshot started (pid %d, LSN %lu, %lu slots, %lu "
+                     "bytes)",
+                     pid, (unsigned long)lsn, (unsigned long)snap->info.count,
+                     (unsigned long)snap->info.bytes);
+        }
+    }
+    if (infoOut != NULL) *infoOut = snap->info;
+    pthread_mutex_unlock(&snap->lock);
+    return status;
+}
+
+/**
+ * @brief 回收快照子进程并报告结果，调用者必须持有 lock。
+ * @param snap 快照状态
+ * @param options 传给 waitpid 的选项（WNOHANG 或 0）
+ */
+static void reap_snapshot(snapshot_t *snap, int options) {
+    if (snap->pid == -1) return;
+
+    int status;
+    pid_t ret = waitpid(snap->pid, &status, options);
+    if (ret == 0) return;  // 仍在运行
+    if (ret == -1 && errno == EINTR) return;
+
+    if (ret == snap->pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        log_info("Snapshot '%s' (pid %d, LSN %lu) complete", snap->path,
+                 snap->pid, (unsigned long)snap->info.lsn);
+    } else {
+        fprintf(stderr, "Error: Snapshot (pid %d) failed, status %d\n",
+                snap->pid, ret == -1 ? -1 : status);
+    }
+    snap->pid = -1;
+}
+
+/**
+ * @brief 非阻塞地回收快照子进程。
+ */
+void snapshot_poll(snapshot_t *snap) {
+    pthread_mutex_lock(&snap->lock);
+    reap_snapshot(snap, WNOHANG);
+    pthread_mutex_unlock(&snap->lock);
+}
+
+/**
+ * @brief 等待快照子进程结束并销毁锁。
+ */
+void snapshot_destroy(snapshot_t *snap) {
+    pthread_mutex_lock(&snap->lock);
+    while (snap->pid != -1) reap_snapshot(snap, 0);
+    pthread_mutex_unlock(&snap->lock);
+    pthread_mutex_destroy(&snap->lock);
+}
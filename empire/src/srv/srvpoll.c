@@ -1,17 +1,27 @@
+#define _GNU_SOURCE  // For pthread_rwlockattr_setkind_np
+
 #include "../../include/srvpoll.h"  // 包含 srvpoll.h 声明
 
 #include <arpa/inet.h>  // For htonl, ntohl
-#include <errno.h>      // For errno, EINTR
+#include <endian.h>     // For htobe64
+#include <errno.h>      // For errno, EINTR, EAGAIN
+#include <fcntl.h>      // For fcntl, F_DUPFD_CLOEXEC
+#include <poll.h>       // For poll，在非阻塞套接字上等待就绪
+#include <pthread.h>    // For pthread_rwlock_*
+#include <stdbool.h>    // For bool
+#include <stdint.h>     // For SIZE_MAX, UINT64_MAX
 #include <stdio.h>      // For perror, fprintf
-#include <stdlib.h>     // For exit
+#include <stdlib.h>     // For malloc, free
 #include <string.h>     // For memset, memcpy
 #include <sys/socket.h>  // For send, recv (虽然 common.h 间接包含，但明确列出是好习惯)
 
 #include "../../include/common.h"  // 包含通用宏、协议结构和网络读写函数
+#include "../../include/log.h"     // 包含异步日志
 
 /**
  * @brief 阻塞式发送函数，确保完整发送所有数据。
- *        处理短写 (partial write) 和中断 (EINTR)。
+ *        处理短写 (partial write) 和中断 (EINTR)；对非阻塞套接字，
+ *        遇到 EAGAIN 时用 poll 等待其重新可写。
  * @param fd 文件描述符（套接字）
  * @param buf 要发送的数据缓冲区
  * @param len 要发送的字节数
@@ -24,7 +34,12 @@ ssize_t send_full(int fd, const void *buf, size_t len) {
         ssize_t bytes_sent = send(fd, ptr + total_sent, len - total_sent, 0);
         if (bytes_sent == -1) {
             if (errno == EINTR) continue;  // 被信号中断，重试发送
-            perror("send");                // 其他错误是实际错误
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+                poll(&pfd, 1, -1);  // 发送缓冲区已满，等待可写
+                continue;
+            }
+            perror("send");  // 其他错误是实际错误
             return STATUS_ERROR;
         }
         if (bytes_sent == 0) {  // 连接关闭
@@ -39,7 +54,8 @@ ssize_t send_full(int fd, const void *buf, size_t len) {
 
 /**
  * @brief 阻塞式读取函数，确保完整接收所有数据。
- *        处理短读 (partial read) 和中断 (EINTR)。
+ *        处理短读 (partial read) 和中断 (EINTR)；对非阻塞套接字，
+ *        遇到 EAGAIN 时用 poll 等待新数据到达。
  * @param fd 文件描述符（套接字）
  * @param buf 接收数据的缓冲区
  * @param len 要接收的字节数
@@ -52,7 +68,12 @@ ssize_t read_full(int fd, void *buf, size_t len) {
         ssize_t bytes_read = recv(fd, ptr + total_read, len - total_read, 0);
         if (bytes_read == -1) {
             if (errno == EINTR) continue;  // 被信号中断，重试读取
-            perror("recv");                // 其他错误是实际错误
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = {.fd = fd, .events = POLLIN};
+                poll(&pfd, 1, -1);  // 暂无数据，等待可读
+                continue;
+            }
+            perror("recv");  // 其他错误是实际错误
             return STATUS_ERROR;
         }
         if (bytes_read == 0) {  // 连接关闭
@@ -67,6 +88,69 @@ ssize_t read_full(int fd, void *buf, size_t len) {
     return total_read;
 }
 
+/**
+ * @brief 初始化服务器数据上下文，读写锁设置为写者优先。
+ */
+int dbctx_init(dbctx_t *db, dbmap_t *map, wal_t *wal, dbindex_t *index) {
+    db->map = map;
+    db->index = index;
+    db->wal = wal;
+
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    int err = pthread_rwlock_init(&db->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "Error: pthread_rwlock_init: %s\n", strerror(err));
+        return STATUS_ERROR;
+    }
+    if (snapshot_init(&db->snapshot, map->path) != STATUS_SUCCESS) {
+        pthread_rwlock_destroy(&db->lock);
+        return STATUS_ERROR;
+    }
+    if (repl_log_init(&db->repl, wal_synced_lsn(wal)) != STATUS_SUCCESS) {
+        snapshot_destroy(&db->snapshot);
+        pthread_rwlock_destroy(&db->lock);
+        return STATUS_ERROR;
+    }
+    db->replica = NULL;
+    db->stats = (stats_t){0};
+    db->timeouts = (client_timeouts_t){
+        .handshake_ms = CLIENT_HANDSHAKE_TIMEOUT_MS,
+        .request_ms = CLIENT_REQUEST_TIMEOUT_MS,
+        .idle_ms = CLIENT_IDLE_TIMEOUT_MS,
+    };
+    wal_set_commit_hook(wal, repl_log_append, &db->repl);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 等待正在进行的快照，解除 WAL 的提交回调，销毁复制日志与
+ *        服务器数据上下文的锁。
+ */
+void dbctx_destroy(dbctx_t *db) {
+    snapshot_destroy(&db->snapshot);
+    wal_set_commit_hook(db->wal, NULL, NULL);
+    repl_log_destroy(&db->repl);
+    pthread_rwlock_destroy(&db->lock);
+}
+
+/**
+ * @brief 持有读锁期间没有写者，提交之后已落盘的 LSN 就是此刻的最新修改。
+ */
+int dbctx_snapshot(dbctx_t *db, snapshot_info_t *infoOut) {
+    pthread_rwlock_rdlock(&db->lock);
+    int status = wal_commit(db->wal);
+    if (status == STATUS_SUCCESS) {
+        status = snapshot_start(&db->snapshot, db->map,
+                                wal_synced_lsn(db->wal), infoOut);
+    }
+    pthread_rwlock_unlock(&db->lock);
+    return status;
+}
+
 /**
  * @brief 封装关闭客户端连接的逻辑。
  *        关闭文件描述符，重置客户端状态，并清理缓冲区信息。
@@ -75,43 +159,165 @@ ssize_t read_full(int fd, void *buf, size_t len) {
  */
 void close_client_connection(clientstate_t *client) {
     if (client->fd != -1) {
-        printf("Closing connection for fd %d\n", client->fd);
+        log_debug("Closing connection for fd %d", client->fd);
         close(client->fd);                   // 关闭套接字
         client->fd = -1;                     // 标记槽位空闲
         client->state = STATE_DISCONNECTED;  // 设为断开状态
         client->buffer_pos = 0;              // 清理缓冲区位置
         client->msg_expected_len = 0;        // 清理消息预期长度
+        outq_clear(&client->outq);           // 丢弃未发送的响应
+        client->hold_from = CLIENT_NO_HOLD;
+        client->wait_lsn = 0;
+        client->rx_pending = false;
+        client->tx_blocked = false;
+        client->cursor.active = false;  // 放弃未发送完的分页列表
+        if (client->repl != NULL) {     // 副本断开，取消订阅
+            repl_log_unsubscribe(client->repl);
+            free(client->repl);
+            client->repl = NULL;
+        }
+    }
+}
+
+/**
+ * @brief 初始化连接内存：三个对象池不预先申请内存，请求内存池申请主块。
+ */
+int client_pool_init(client_pool_t *pool) {
+    memset(pool, 0, sizeof(*pool));
+    slab_init(&pool->clients, sizeof(clientstate_t));
+    slab_init(&pool->buffers, CLIENT_BUFFER_SIZE);
+    slab_init(&pool->chunks, OUTQ_POOL_OBJ_SIZE);
+    return arena_init(&pool->arena);
+}
+
+/**
+ * @brief 释放连接内存。
+ */
+void client_pool_destroy(client_pool_t *pool) {
+    slab_destroy(&pool->clients);
+    slab_destroy(&pool->buffers);
+    slab_destroy(&pool->chunks);
+    arena_destroy(&pool->arena);
+    dbindex_result_free(&pool->result);
+}
+
+/**
+ * @brief 为一个新接受的连接从连接内存中分配并初始化客户端状态，
+ *        接收缓冲区等到有数据可读时才挂上。
+ * @param pool 所属事件循环的连接内存。
+ * @param fd 客户端套接字。
+ * @return 新的客户端状态，内存不足时返回 NULL。
+ */
+clientstate_t *client_create(client_pool_t *pool, int fd) {
+    clientstate_t *client = slab_alloc(&pool->clients);
+    if (client == NULL) return NULL;
+    memset(client, 0, sizeof(*client));
+    client->pool = pool;
+    client->outq.pool = &pool->chunks;
+    client->fd = fd;
+    client->state = STATE_CONNECTED;  // 初始状态为 CONNECTED，等待 Hello
+    client->hold_from = CLIENT_NO_HOLD;
+    client->proto = PROTO_VER_V1;  // Hello 总是使用 V1 头部
+    return client;
+}
+
+/**
+ * @brief 释放客户端状态，连同接收缓冲区归还连接内存。
+ *        如果连接尚未关闭，会先关闭它。
+ * @param client 要释放的客户端状态。
+ */
+void client_destroy(clientstate_t *client) {
+    if (client == NULL) return;
+    close_client_connection(client);
+    slab_free(&client->pool->buffers, client->buffer);
+    slab_free(&client->pool->clients, client);
+}
+
+/**
+ * @brief 取得一个清空的索引查询结果，复用连接内存中的数组，
+ *        稳定状态下查询不再申请内存。结果在下一条消息之前有效。
+ * @param client 指向客户端状态。
+ * @return 查询结果。
+ */
+static dbindex_result_t *fsm_scratch_result(clientstate_t *client) {
+    dbindex_result_t *result = &client->pool->result;
+    result->len = 0;
+    return result;
+}
+
+/**
+ * @brief 一条消息处理完毕：回收请求内存池。异常大的查询结果数组
+ *        不再保留，避免一次大查询之后长期占用内存。
+ * @param client 指向客户端状态。
+ */
+static void fsm_release_request(clientstate_t *client) {
+    client_pool_t *pool = client->pool;
+    arena_reset(&pool->arena);
+    if (pool->result.cap > CLIENT_RESULT_KEEP) {
+        dbindex_result_free(&pool->result);
     }
 }
 
+/**
+ * @brief 把一条响应追加到客户端的输出队列，实际发送由 fsm_flush 完成。
+ *        lsn 非 0 表示响应依赖的 WAL 记录尚未落盘：从这条响应开始的数据
+ *        被扣留，组提交之后才发送，因此后续响应仍保持原有顺序。
+ * @param client 指向客户端状态。
+ * @param buf 完整的响应消息（已转换为网络字节序）。
+ * @param len 响应消息长度。
+ * @param lsn 响应依赖的 WAL LSN，0 表示不依赖。
+ * @return 成功时返回 STATUS_SUCCESS，内存不足时返回 STATUS_ERROR。
+ */
+static int fsm_send_reply(clientstate_t *client, const void *buf, size_t len,
+                          uint64_t lsn) {
+    if (lsn != 0) {
+        if (client->hold_from == CLIENT_NO_HOLD) {
+            client->hold_from = client->outq.appended;
+        }
+        if (lsn > client->wait_lsn) client->wait_lsn = lsn;
+    }
+    return outq_append(&client->outq, buf, len);
+}
+
+/**
+ * @brief 以非阻塞方式发送输出队列中未被扣留的数据，发送失败时关闭连接。
+ * @param client 指向客户端状态。
+ */
+static void fsm_flush(clientstate_t *client) {
+    if (client->fd == -1 || outq_pending(&client->outq) == 0) return;
+    uint64_t sent = client->outq.sent;
+    int status = outq_flush(&client->outq, client->fd, client->hold_from);
+    stats_add(&client->pool->stats->bytes_out, client->outq.sent - sent);
+    if (status == STATUS_ERROR) close_client_connection(client);
+}
+
 /**
  * @brief FSM (有限状态机) 响应客户端的 Hello 请求。
- *        发送 Hello 响应，并将客户端状态转换为 READY_FOR_MSG。
+ *        用 V1 头部发送 Hello 响应（回显客户端选择的协议版本），
+ *        之后的消息改用该版本，并将客户端状态转换为 READY_FOR_MSG。
  * @param client 指向客户端状态。
+ * @param proto 客户端选择的协议版本，调用者已确认服务器支持。
  */
-static void fsm_reply_hello(clientstate_t *client) {
+static void fsm_reply_hello(clientstate_t *client, uint16_t proto) {
     char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_hello_resp)];
     dbproto_hdr_t *hdr = (dbproto_hdr_t *)resp_buf;
     dbproto_hello_resp *hello_resp =
         (dbproto_hello_resp *)(resp_buf + sizeof(dbproto_hdr_t));
 
-    // 构造 Hello 响应头部
-    hdr->type = MSG_HELLO_RESP;
-    hdr->len = sizeof(dbproto_hello_resp);
-    hello_resp->proto = PROTO_VER;  // 服务器协议版本
+    // 构造 Hello 响应并转换为网络字节序
+    dbproto_hdr_pack(hdr, PROTO_VER_V1, MSG_HELLO_RESP,
+                     sizeof(dbproto_hello_resp));
+    hello_resp->proto = htons(proto);
 
-    // 转换为网络字节序
-    hdr->type = htonl(hdr->type);
-    hdr->len = htons(hdr->len);
-    hello_resp->proto = htons(hello_resp->proto);
-
-    // 发送完整的 Hello 响应消息
-    if (send_full(client->fd, resp_buf, sizeof(resp_buf)) == STATUS_ERROR) {
-        perror("fsm_reply_hello send_full");
-        close_client_connection(client);  // 发送失败则关闭连接
+    // 把完整的 Hello 响应消息放入输出队列
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), 0) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
     } else {
+        client->proto = proto;
         client->state = STATE_READY_FOR_MSG;  // 状态转换为就绪
-        printf("Client fd %d upgraded to STATE_READY_FOR_MSG\n", client->fd);
+        log_debug("Client fd %d upgraded to STATE_READY_FOR_MSG (protocol %u)",
+                  client->fd, proto);
     }
 }
 
@@ -126,34 +332,92 @@ static void fsm_reply_error(clientstate_t *client, const char *error_msg) {
     char resp_buf[sizeof(dbproto_hdr_t)];  // 错误消息体通常为空，只发送头部
     dbproto_hdr_t *hdr = (dbproto_hdr_t *)resp_buf;
 
-    // 构造错误消息头部
-    hdr->type = MSG_ERROR;
-    hdr->len = 0;  // 错误消息体长度为 0
+    // 构造错误消息头部，错误消息体长度为 0
+    dbproto_hdr_pack(hdr, client->proto, MSG_ERROR, 0);
+
+    stats_add(&client->pool->stats->errors, 1);
+    // 尽力发送错误消息（不等待套接字可写），随后关闭连接
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), 0) ==
+        STATUS_SUCCESS) {
+        fsm_flush(client);
+    }
+    log_warn("Client fd %d sent MSG_ERROR. Reason: %s", client->fd,
+             error_msg);
+    close_client_connection(client);  // 错误后通常关闭连接
+}
+
+/**
+ * @brief 写入一条已解析的员工记录并回复添加员工响应。
+ *        记录写入下标最小的空闲槽位（没有时追加），加入索引并写入 WAL，
+ *        响应等到日志落盘后发送。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param employee 要添加的员工，为 NULL 表示请求无效，直接回复失败。
+ */
+static void fsm_add_employee(dbctx_t *db, clientstate_t *client,
+                             const struct employee_t *employee) {
+    // 持有写锁追加员工、更新索引并写入 WAL；
+    // 任何一步失败都回滚之前的步骤，映射、索引与日志保持一致
+    uint64_t lsn = 0;
+    int status = STATUS_ERROR;
+    if (employee != NULL) {
+        pthread_rwlock_wrlock(&db->lock);
+        // 新记录追加在记录堆末尾，不会覆盖磁盘头部之内的任何字节，
+        // 复用被删除的槽位也不必等待之前的 DEL/FREE 落盘；
+        // 预留空间之后，回滚用的 dbmap_kill 不会失败
+        uint32_t slot = (uint32_t)dbmap_next_slot(db->map);
+        status = dbmap_prepare(db->map, slot);
+        if (status == STATUS_SUCCESS) {
+            status = dbmap_put(db->map, slot, employee);
+        }
+        if (status == STATUS_SUCCESS &&
+            dbindex_insert(db->index, db->map, slot) != STATUS_SUCCESS) {
+            dbmap_kill(db->map, slot);
+            status = STATUS_ERROR;
+        }
+        if (status == STATUS_SUCCESS &&
+            wal_log_add(db->wal, slot, employee, &lsn) != STATUS_SUCCESS) {
+            dbindex_remove(db->index, db->map, slot);
+            dbmap_kill(db->map, slot);
+            status = STATUS_ERROR;
+        }
+        pthread_rwlock_unlock(&db->lock);
+    }
+
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_add_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_employee_add_resp_t *add_resp =
+        (dbproto_employee_add_resp_t *)(resp_buf + sizeof(dbproto_hdr_t));
+
+    // 构造添加员工响应头部和体
+    add_resp->status = (status == STATUS_SUCCESS)
+                           ? STATUS_SUCCESS
+                           : STATUS_ERROR;  // 直接发送 STATUS_SUCCESS/ERROR
 
     // 转换为网络字节序
-    hdr->type = htonl(hdr->type);
-    hdr->len = htons(hdr->len);
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_EMPLOYEE_ADD_RESP,
+                     sizeof(dbproto_employee_add_resp_t));
+    add_resp->status = htonl(add_resp->status);
 
-    // 发送错误消息
-    if (send_full(client->fd, resp_buf, sizeof(resp_buf)) == STATUS_ERROR) {
-        perror("fsm_reply_error send_full");
+    // 把添加员工响应放入输出队列（成功时等待 WAL 落盘后才发送）
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), lsn) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+    } else {
+        log_debug("Client fd %d: Employee add request processed (status: %d).",
+                  client->fd, status);
     }
-    fprintf(stderr, "Client fd %d sent MSG_ERROR. Reason: %s\n", client->fd,
-            error_msg);
-    close_client_connection(client);  // 错误后通常关闭连接
 }
 
 /**
  * @brief FSM (有限状态机) 处理添加员工请求。
- *        解析请求中的员工数据，调用 `add_employee`，并发送响应。
- * @param dbhdr 指向数据库头部。
- * @param employees 指向员工数组的指针。
+ *        在锁外解析请求中的 "Name-Address-Hours" 字符串，解析器直接读取
+ *        接收缓冲区，最多读到消息体末尾。
+ * @param db 服务器数据上下文。
  * @param client 指向客户端状态。
  * @param req_hdr 接收到的请求头部。
  */
-static void fsm_handle_add_employee(struct dbheader_t *dbhdr,
-                                    struct employee_t **employees,
-                                    clientstate_t *client,
+static void fsm_handle_add_employee(dbctx_t *db, clientstate_t *client,
                                     dbproto_hdr_t *req_hdr) {
     // 验证消息体长度
     if (req_hdr->len != sizeof(dbproto_employee_add_req_t)) {
@@ -162,53 +426,278 @@ static void fsm_handle_add_employee(struct dbheader_t *dbhdr,
     }
 
     // 获取请求体中的员工数据字符串
-    dbproto_employee_add_req_t *add_req =
+    const dbproto_employee_add_req_t *add_req =
         (dbproto_employee_add_req_t *)(client->buffer + sizeof(dbproto_hdr_t));
 
-    printf("Client fd %d: Received add string: '%s'\n", client->fd,
-           add_req->data);
+    log_debug("Client fd %d: Received add string: '%.*s'", client->fd,
+              (int)strnlen(add_req->data, sizeof(add_req->data)),
+              add_req->data);
 
-    // 调用数据库核心函数添加员工
-    int status = add_employee(dbhdr, employees, add_req->data);
+    struct employee_t employee;
+    int status =
+        parse_employee_n(add_req->data, sizeof(add_req->data), &employee);
+    fsm_add_employee(db, client, status == STATUS_SUCCESS ? &employee : NULL);
+}
 
-    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_add_resp_t)];
+/**
+ * @brief FSM (有限状态机) 处理二进制添加员工请求。
+ *        字段已由客户端拆分好，只检查长度后直接拷贝到员工记录中。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_add_employee_v2(dbctx_t *db, clientstate_t *client,
+                                       dbproto_hdr_t *req_hdr) {
+    struct employee_t employee;
+    int status = parse_employee_fields(client->buffer + sizeof(dbproto_hdr_t),
+                                       req_hdr->len, &employee);
+    fsm_add_employee(db, client, status == STATUS_SUCCESS ? &employee : NULL);
+}
+
+/**
+ * @brief 取得第 i 条要发送的记录的槽位。
+ * @param slots 记录下标数组，为 NULL 时第 i 条就是槽位 i
+ */
+static inline size_t list_slot(const uint32_t *slots, size_t i) {
+    return slots == NULL ? i : slots[i];
+}
+
+/**
+ * @brief 把第 [from, to) 条记录中有效记录的紧凑编码直接从映射拷贝到
+ *        输出队列尾部的数据块中。调用者必须持有数据上下文的读锁。
+ * @param client 指向客户端状态。
+ * @param map 映射的数据库（只读）。
+ * @param slots 记录下标数组，为 NULL 时第 i 条就是槽位 i。
+ * @param from 第一条记录。
+ * @param to 最后一条记录之后。
+ * @param checked 调用者已在这次持有读锁期间用 dbmap_view 统计过这些记录
+ *                时为 true，拷贝时不再重复校验。
+ * @return 成功时返回 STATUS_SUCCESS，内存不足或记录损坏时返回 STATUS_ERROR。
+ */
+static int fsm_copy_records(clientstate_t *client, const dbmap_t *map,
+                            const uint32_t *slots, size_t from, size_t to,
+                            bool checked) {
+    dbrec_t rec;
+    // 记录依次拷贝到队列尾部的数据块中，当前块放不下时再预留新块
+    char *dst = NULL;
+    size_t avail = 0;
+    size_t used = 0;
+    for (size_t i = from; i < to; i++) {
+        size_t slot = list_slot(slots, i);
+        if (checked ? !dbmap_peek(map, slot, &rec)
+                    : !dbmap_view(map, slot, &rec)) {
+            // 完整列表的记录数与字节数来自统计值，已经包含了这条损坏的
+            // 记录，跳过它会让客户端错位，只能关闭连接
+            if (dbmap_is_live(map, slot)) return STATUS_ERROR;
+            continue;
+        }
+        if (dst == NULL || avail - used < rec.size) {
+            if (dst != NULL) outq_commit(&client->outq, used);
+            dst = outq_reserve(&client->outq, DBREC_MAX_SIZE, &avail);
+            if (dst == NULL) return STATUS_ERROR;
+            used = 0;
+        }
+        memcpy(dst + used, rec.raw, rec.size);
+        used += rec.size;
+    }
+    if (dst != NULL) outq_commit(&client->outq, used);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把文件中 [off, off + bytes) 的记录数据作为文件块加入输出队列，
+ *        由 sendfile 直接从页缓存发送，不经过用户态拷贝。只在记录堆恰好
+ *        是按槽位排列的全部有效记录时可行（见 dbmap_heap_is_list），此时
+ *        一段连续槽位中的有效记录在文件中也是连续的。文件块持有 dup 出的
+ *        文件描述符，之后的修改和压缩都不影响已经排队的字节段。
+ *        调用者必须持有数据上下文的读锁。
+ * @param client 指向客户端状态。
+ * @param map 映射的数据库（只读）。
+ * @param off 第一条记录的文件偏移。
+ * @param bytes 记录数据的总字节数。
+ * @return 已加入文件块时返回 true；不满足条件时返回 false，由调用者拷贝。
+ */
+static bool fsm_queue_heap(clientstate_t *client, const dbmap_t *map,
+                           uint64_t off, size_t bytes) {
+    if (bytes < CLIENT_SENDFILE_MIN || !dbmap_heap_is_list(map)) return false;
+    int fd = fcntl(map->fd, F_DUPFD_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("dup database fd for sendfile");
+        return false;
+    }
+    // 失败时 outq_append_file 已关闭 fd，由调用者退回到拷贝
+    return outq_append_file(&client->outq, fd, off, bytes) == STATUS_SUCCESS;
+}
+
+/**
+ * @brief 统计 [from, to) 中有效记录的数量和字节数，同时校验每条记录。
+ *        调用者必须持有数据上下文的读锁。
+ * @param map 映射的数据库（只读）。
+ * @param slots 记录下标数组，为 NULL 时第 i 条就是槽位 i。
+ * @param from 第一条记录。
+ * @param to 最后一条记录之后。
+ * @param limit 最多统计的有效记录数。
+ * @param count 输出参数，有效记录数。
+ * @param bytes 输出参数，有效记录的总字节数。
+ * @param first 输出参数，第一条有效记录的文件偏移，可以为 NULL。
+ * @return 统计停止处的下标；遇到损坏的记录时返回 SIZE_MAX。
+ */
+static size_t fsm_count_records(const dbmap_t *map, const uint32_t *slots,
+                                size_t from, size_t to, uint64_t limit,
+                                size_t *count, size_t *bytes,
+                                uint64_t *first) {
+    dbrec_t rec;
+    size_t i = from;
+    *count = 0;
+    *bytes = 0;
+    for (; i < to && *count < limit; i++) {
+        size_t slot = list_slot(slots, i);
+        if (!dbmap_view(map, slot, &rec)) {
+            // 损坏的记录既不能发送也不能跳过，否则客户端看到的列表会缺记录
+            if (dbmap_is_live(map, slot)) return SIZE_MAX;
+            continue;
+        }
+        if (*count == 0 && first != NULL) *first = dbmap_offset_of(map, &rec);
+        (*count)++;
+        *bytes += rec.size;
+    }
+    return i;
+}
+
+/**
+ * @brief 以 V3 格式发送列表：记录数、字节数，之后是紧凑记录本身，
+ *        直接从映射拷贝，不需要展开或转换字节序。墓碑不发送。
+ *        记录堆没有垃圾时，较大的完整列表改用 fsm_queue_heap 零拷贝发送。
+ * @param client 指向客户端状态。
+ * @param type 响应的消息类型。
+ * @param map 映射的数据库（只读）。
+ * @param slots 要发送的记录下标，为 NULL 时发送 [0, n) 中的有效记录。
+ * @param n 槽位数或 slots 的长度。
+ */
+static void fsm_queue_records(clientstate_t *client, dbproto_type_e type,
+                              const dbmap_t *map, const uint32_t *slots,
+                              size_t n) {
+    size_t count = 0;
+    size_t bytes = 0;
+    // 查询没有结果时 slots 也可能为 NULL（此时 n 为 0）
+    bool whole = slots == NULL && n == map->hdr.count;
+    if (whole) {
+        count = dbmap_live(map);
+        bytes = map->live_bytes;
+    } else if (fsm_count_records(map, slots, 0, n, UINT64_MAX, &count,
+                                 &bytes, NULL) == SIZE_MAX) {
+        close_client_connection(client);  // 记录损坏则关闭连接
+        return;
+    }
+
+    char resp_buf[sizeof(dbproto_hdr_t) +
+                  sizeof(dbproto_employee_list_resp_v3_t)];
     dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
-    dbproto_employee_add_resp_t *add_resp =
-        (dbproto_employee_add_resp_t *)(resp_buf + sizeof(dbproto_hdr_t));
+    dbproto_employee_list_resp_v3_t *list_resp =
+        (dbproto_employee_list_resp_v3_t *)(resp_buf + sizeof(dbproto_hdr_t));
+    list_resp->count = htobe64(count);
+    list_resp->bytes = htobe64(bytes);
+    dbproto_hdr_pack(resp_hdr, client->proto, type,
+                     sizeof(dbproto_employee_list_resp_v3_t));
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), 0) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+        return;
+    }
+    if (!(whole && fsm_queue_heap(client, map, DBMAP_HEAP_START, bytes)) &&
+        fsm_copy_records(client, map, slots, 0, n, !whole) == STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足或记录损坏则关闭连接
+        return;
+    }
+    log_debug("Client fd %d: Employee list queued (%zu records, %zu bytes).",
+              client->fd, count, bytes);
+}
 
-    // 构造添加员工响应头部和体
-    resp_hdr->type = MSG_EMPLOYEE_ADD_RESP;
-    resp_hdr->len = sizeof(dbproto_employee_add_resp_t);
-    add_resp->status = (status == STATUS_SUCCESS)
-                           ? STATUS_SUCCESS
-                           : STATUS_ERROR;  // 直接发送 STATUS_SUCCESS/ERROR
+/**
+ * @brief 把员工列表形式的响应（数量 + 员工数据）写入输出队列。
+ *        LIST 与索引查询共用这一格式。V3 客户端收到紧凑记录（见
+ *        fsm_queue_records）；V1/V2 客户端收到展开后的定长记录，记录数按
+ *        协商的协议版本编码，V1 客户端请求超过 UINT16_MAX 条记录时回复错误。
+ *        调用者必须持有数据上下文的读锁。
+ * @param client 指向客户端状态。
+ * @param type 响应的消息类型。
+ * @param map 映射的数据库（只读）。
+ * @param slots 要发送的记录下标，为 NULL 时发送前 count 个槽位，
+ *              V1/V2 中的墓碑以全零记录发送。
+ * @param count 要发送的记录数。
+ */
+static void fsm_queue_employees(clientstate_t *client, dbproto_type_e type,
+                                const dbmap_t *map, const uint32_t *slots,
+                                size_t count) {
+    if (client->proto == PROTO_VER_V3) {
+        fsm_queue_records(client, type, map, slots, count);
+        return;
+    }
 
-    // 转换为网络字节序
-    resp_hdr->type = htonl(resp_hdr->type);
-    resp_hdr->len = htons(resp_hdr->len);
-    add_resp->status = htonl(add_resp->status);
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_list_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    size_t body_len;
 
-    // 发送完整的添加员工响应消息
-    if (send_full(client->fd, resp_buf, sizeof(resp_buf)) == STATUS_ERROR) {
-        perror("fsm_handle_add_employee send_full");
-        close_client_connection(client);  // 发送失败则关闭连接
+    // 构造响应头部和体（包含记录数），转换为网络字节序
+    if (client->proto == PROTO_VER_V1) {
+        if (count > UINT16_MAX) {
+            fsm_reply_error(client, "Too many records for protocol v1");
+            return;
+        }
+        dbproto_employee_list_resp_v1_t *list_resp =
+            (dbproto_employee_list_resp_v1_t *)(resp_buf +
+                                                sizeof(dbproto_hdr_t));
+        list_resp->count = htons((uint16_t)count);
+        body_len = sizeof(dbproto_employee_list_resp_v1_t);
     } else {
-        printf("Client fd %d: Employee add request processed (status: %d).\n",
-               client->fd, status);
+        dbproto_employee_list_resp_t *list_resp =
+            (dbproto_employee_list_resp_t *)(resp_buf + sizeof(dbproto_hdr_t));
+        list_resp->count = htobe64(count);
+        body_len = sizeof(dbproto_employee_list_resp_t);
+    }
+    dbproto_hdr_pack(resp_hdr, client->proto, type, (uint32_t)body_len);
+
+    // 首先放入响应头部和员工数量
+    if (fsm_send_reply(client, resp_buf, sizeof(dbproto_hdr_t) + body_len,
+                       0) == STATUS_ERROR) {
+        close_client_connection(client);
+        return;
+    }
+
+    // 然后把记录展开到队列尾部的数据块中，就地转换字节序
+    size_t i = 0;
+    while (i < count) {
+        size_t avail = 0;
+        struct employee_t *dst =
+            outq_reserve(&client->outq, sizeof(struct employee_t), &avail);
+        if (dst == NULL) {
+            close_client_connection(client);  // 内存不足则关闭连接
+            return;
+        }
+        size_t batch = avail / sizeof(struct employee_t);
+        if (batch > count - i) batch = count - i;
+
+        for (size_t j = 0; j < batch; ++j) {
+            dbmap_get(map, list_slot(slots, i + j), &dst[j]);
+            dst[j].hours = htonl(dst[j].hours);  // 转换 hours 字段为网络字节序
+        }
+        outq_commit(&client->outq, batch * sizeof(struct employee_t));
+        i += batch;
     }
+    log_debug("Client fd %d: Employee list queued (%zu records).", client->fd,
+              count);
 }
 
 /**
  * @brief FSM (有限状态机) 处理列出员工请求。
- *        发送员工总数，然后逐个发送所有员工数据。
- * @param dbhdr 指向数据库头部。
- * @param employees 指向员工数组（只读）。
+ *        持有读锁，把员工总数和所有员工数据直接写入输出队列的大数据块，
+ *        由 fsm_flush 用少量 writev 调用发送，不会阻塞事件循环。
+ *        多个事件循环线程的 LIST 可以并发执行。
+ * @param db 服务器数据上下文（只读）。
  * @param client 指向客户端状态。
  * @param req_hdr 接收到的请求头部。
  */
-static void fsm_handle_list_employees(struct dbheader_t *dbhdr,
-                                      const struct employee_t *employees,
-                                      clientstate_t *client,
+static void fsm_handle_list_employees(dbctx_t *db, clientstate_t *client,
                                       dbproto_hdr_t *req_hdr) {
     // 列表请求没有消息体，req_hdr->len 应该为 0
     if (req_hdr->len != 0) {
@@ -216,65 +705,174 @@ static void fsm_handle_list_employees(struct dbheader_t *dbhdr,
         return;
     }
 
-    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_list_resp_t)];
-    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
-    dbproto_employee_list_resp_t *list_resp =
-        (dbproto_employee_list_resp_t *)(resp_buf + sizeof(dbproto_hdr_t));
+    pthread_rwlock_rdlock(&db->lock);
+    fsm_queue_employees(client, MSG_EMPLOYEE_LIST_RESP, db->map, NULL,
+                        db->map->hdr.count);
+    pthread_rwlock_unlock(&db->lock);
+}
+
+/**
+ * @brief FSM (有限状态机) 处理分页列出员工请求（只用于 V3）。
+ *        只记录服务器端游标，块由 fsm_list_next_chunk 逐个生成。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_list_page(clientstate_t *client,
+                                 dbproto_hdr_t *req_hdr) {
+    if (client->proto != PROTO_VER_V3) {
+        fsm_reply_error(client, "Paged list requires protocol v3");
+        return;
+    }
+    if (req_hdr->len != sizeof(dbproto_employee_list_page_req_t)) {
+        fsm_reply_error(client, "List page request length mismatch");
+        return;
+    }
 
-    // 构造列出员工响应头部和体（包含员工总数）
-    resp_hdr->type = MSG_EMPLOYEE_LIST_RESP;
-    resp_hdr->len = sizeof(dbproto_employee_list_resp_t);
-    list_resp->count = dbhdr->count;
+    dbproto_employee_list_page_req_t *page_req =
+        (dbproto_employee_list_page_req_t *)(client->buffer +
+                                             sizeof(dbproto_hdr_t));
+    uint64_t limit = be64toh(page_req->limit);
+    uint32_t chunk = ntohl(page_req->chunk);
+    if (chunk == 0) chunk = DBPROTO_LIST_CHUNK_DEFAULT;
+    if (chunk > DBPROTO_LIST_CHUNK_MAX) chunk = DBPROTO_LIST_CHUNK_MAX;
 
-    // 转换为网络字节序
-    resp_hdr->type = htonl(resp_hdr->type);
-    resp_hdr->len = htons(resp_hdr->len);
-    list_resp->count = htons(list_resp->count);
+    client->cursor.active = true;
+    client->cursor.next = be64toh(page_req->cursor);
+    client->cursor.left = limit == 0 ? UINT64_MAX : limit;
+    client->cursor.chunk = chunk;
+}
 
-    // 首先发送响应头部和员工数量
-    if (send_full(client->fd, resp_buf, sizeof(resp_buf)) == STATUS_ERROR) {
-        perror("fsm_handle_list_employees send_full header");
-        close_client_connection(client);
+/**
+ * @brief 为正在进行的分页列表生成下一块。每块单独持有读锁，
+ *        先统计 [next, end) 中最多 chunk 条有效记录的数量和字节数，
+ *        再把它们直接从映射拷贝到输出队列（记录堆没有垃圾时较大的块由
+ *        fsm_queue_heap 零拷贝发送）；块之间释放读锁，写者和
+ *        其他连接可以插入，因此一块内部是一致的，整个列表不是快照。
+ *        到达表尾或达到 limit 时发送最后一块并结束游标。
+ * @param db 服务器数据上下文（只读）。
+ * @param client 指向客户端状态。
+ */
+static void fsm_list_next_chunk(dbctx_t *db, clientstate_t *client) {
+    list_cursor_t *cursor = &client->cursor;
+    uint64_t want = cursor->left < cursor->chunk ? cursor->left : cursor->chunk;
+    size_t count = 0;
+    size_t bytes = 0;
+
+    pthread_rwlock_rdlock(&db->lock);
+    const dbmap_t *map = db->map;
+    size_t end = map->hdr.count;
+    size_t start = cursor->next < end ? cursor->next : end;
+    uint64_t first = 0;
+    size_t slot = fsm_count_records(map, NULL, start, end, want, &count,
+                                    &bytes, &first);
+    if (slot == SIZE_MAX) {
+        pthread_rwlock_unlock(&db->lock);
+        close_client_connection(client);  // 记录损坏则关闭连接
         return;
     }
+    cursor->left -= count;
+    bool at_end = slot >= end;
+    bool last = at_end || cursor->left == 0;
 
-    // 然后逐个发送员工数据结构
-    if (dbhdr->count > 0 && employees == NULL) {
-        fprintf(stderr,
-                "Error: dbhdr->count > 0 but employees is NULL in "
-                "fsm_handle_list_employees.\n");
-        fsm_reply_error(client,
-                        "Server internal error: Employees data missing");
+    char resp_buf[sizeof(dbproto_hdr_t) +
+                  sizeof(dbproto_employee_list_chunk_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_employee_list_chunk_t *chunk_resp =
+        (dbproto_employee_list_chunk_t *)(resp_buf + sizeof(dbproto_hdr_t));
+    chunk_resp->count = htobe64(count);
+    chunk_resp->bytes = htobe64(bytes);
+    chunk_resp->next = htobe64(at_end ? DBPROTO_CURSOR_END : slot);
+    chunk_resp->last = htonl(last ? 1 : 0);
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_EMPLOYEE_LIST_CHUNK,
+                     sizeof(dbproto_employee_list_chunk_t));
+    int status = fsm_send_reply(client, resp_buf, sizeof(resp_buf), 0);
+    if (status == STATUS_SUCCESS &&
+        !fsm_queue_heap(client, map, first, bytes)) {
+        status = fsm_copy_records(client, map, NULL, start, slot, true);
+    }
+    pthread_rwlock_unlock(&db->lock);
+
+    if (status == STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足或记录损坏则关闭连接
         return;
     }
+    cursor->next = slot;
+    cursor->active = !last;
+    if (last) {
+        log_debug("Client fd %d: Paged employee list done (next %s).",
+                  client->fd, at_end ? "end" : "pending");
+    }
+}
 
-    for (uint16_t i = 0; i < dbhdr->count; ++i) {
-        struct employee_t temp_employee = employees[i];  // 创建副本进行转换
-        temp_employee.hours =
-            htonl(temp_employee.hours);  // 转换 hours 字段为网络字节序
+/**
+ * @brief FSM (有限状态机) 处理按名字查找请求。
+ *        持有读锁查询名字哈希表，把匹配的员工按记录顺序写入输出队列。
+ * @param db 服务器数据上下文（只读）。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_get_by_name(dbctx_t *db, clientstate_t *client,
+                                   dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_employee_get_by_name_req_t)) {
+        fsm_reply_error(client, "Get by name request length mismatch");
+        return;
+    }
+    dbproto_employee_get_by_name_req_t *name_req =
+        (dbproto_employee_get_by_name_req_t *)(client->buffer +
+                                               sizeof(dbproto_hdr_t));
+    name_req->name[sizeof(name_req->name) - 1] = '\0';  // 防止越界读取
 
-        if (send_full(client->fd, &temp_employee, sizeof(struct employee_t)) ==
-            STATUS_ERROR) {
-            perror("fsm_handle_list_employees send_full employee data");
-            close_client_connection(client);  // 发送失败则关闭连接
-            return;
-        }
+    dbindex_result_t *result = fsm_scratch_result(client);
+    pthread_rwlock_rdlock(&db->lock);
+    if (dbindex_find_name(db->index, db->map, name_req->name, result) ==
+        STATUS_SUCCESS) {
+        fsm_queue_employees(client, MSG_EMPLOYEE_GET_BY_NAME_RESP, db->map,
+                            result->slots, result->len);
+    } else {
+        close_client_connection(client);  // 内存不足则关闭连接
+    }
+    pthread_rwlock_unlock(&db->lock);
+}
+
+/**
+ * @brief FSM (有限状态机) 处理按工时范围查找请求。
+ *        持有读锁扫描 hours 上的 B+ 树，把匹配的员工按 hours 升序写入输出队列。
+ * @param db 服务器数据上下文（只读）。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_range_hours(dbctx_t *db, clientstate_t *client,
+                                   dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_employee_range_hours_req_t)) {
+        fsm_reply_error(client, "Range hours request length mismatch");
+        return;
     }
-    printf("Client fd %d: Employee list sent (%hu records).\n", client->fd,
-           dbhdr->count);
+    dbproto_employee_range_hours_req_t *range_req =
+        (dbproto_employee_range_hours_req_t *)(client->buffer +
+                                               sizeof(dbproto_hdr_t));
+    uint32_t lo = ntohl(range_req->min_hours);
+    uint32_t hi = ntohl(range_req->max_hours);
+
+    dbindex_result_t *result = fsm_scratch_result(client);
+    pthread_rwlock_rdlock(&db->lock);
+    if (dbindex_range_hours(db->index, lo, hi, result) == STATUS_SUCCESS) {
+        fsm_queue_employees(client, MSG_EMPLOYEE_RANGE_HOURS_RESP, db->map,
+                            result->slots, result->len);
+    } else {
+        close_client_connection(client);  // 内存不足则关闭连接
+    }
+    pthread_rwlock_unlock(&db->lock);
 }
 
 /**
  * @brief FSM (有限状态机) 处理删除员工请求。
- *        调用 `remove_employee` 删除最后一个员工，并发送响应。
- * @param dbhdr 指向数据库头部。
- * @param employees 指向员工数组的指针。
+ *        先写入 WAL，再从索引中移除最后一个员工并截断映射中的记录数
+ *        （连同它之前的墓碑），响应等到日志落盘后发送。
+ * @param db 服务器数据上下文。
  * @param client 指向客户端状态。
  * @param req_hdr 接收到的请求头部。
  */
-static void fsm_handle_remove_employee(struct dbheader_t *dbhdr,
-                                       struct employee_t **employees,
-                                       clientstate_t *client,
+static void fsm_handle_remove_employee(dbctx_t *db, clientstate_t *client,
                                        dbproto_hdr_t *req_hdr) {
     // 删除请求没有消息体，req_hdr->len 应该为 0
     if (req_hdr->len != 0) {
@@ -283,8 +881,26 @@ static void fsm_handle_remove_employee(struct dbheader_t *dbhdr,
         return;
     }
 
-    // 调用数据库核心函数删除员工
-    int status = remove_employee(dbhdr, employees);
+    // 删除操作无法回滚，因此先预留墓碑的空间、写日志，再删除；
+    // 没有员工时直接报告失败
+    uint64_t lsn = 0;
+    int status = STATUS_ERROR;
+    pthread_rwlock_wrlock(&db->lock);
+    size_t count = db->map->hdr.count;
+    if (count == 0) {
+        log_debug("Error: No employees to remove.");
+    } else {
+        // 末尾的槽位总是有效记录，删除后再越过它之前的墓碑
+        size_t new_count = dbmap_trim_count(db->map, count - 1);
+        if (dbmap_prepare(db->map, count - 1) == STATUS_SUCCESS &&
+            wal_log_del(db->wal, (uint32_t)new_count, &lsn) == STATUS_SUCCESS) {
+            dbindex_remove(db->index, db->map, count - 1);
+            status = dbmap_truncate(db->map, new_count);
+            log_debug("Removed last employee. New count: %lu",
+                      (unsigned long)db->map->hdr.count);
+        }
+    }
+    pthread_rwlock_unlock(&db->lock);
 
     char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_del_resp_t)];
     dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
@@ -292,86 +908,759 @@ static void fsm_handle_remove_employee(struct dbheader_t *dbhdr,
         (dbproto_employee_del_resp_t *)(resp_buf + sizeof(dbproto_hdr_t));
 
     // 构造删除员工响应头部和体
-    resp_hdr->type = MSG_EMPLOYEE_DEL_RESP;
-    resp_hdr->len = sizeof(dbproto_employee_del_resp_t);
     del_resp->status = (status == STATUS_SUCCESS)
                            ? STATUS_SUCCESS
                            : STATUS_ERROR;  // 直接发送 STATUS_SUCCESS/ERROR
 
     // 转换为网络字节序
-    resp_hdr->type = htonl(resp_hdr->type);
-    resp_hdr->len = htons(resp_hdr->len);
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_EMPLOYEE_DEL_RESP,
+                     sizeof(dbproto_employee_del_resp_t));
     del_resp->status = htonl(del_resp->status);
 
-    // 发送完整的删除员工响应消息
-    if (send_full(client->fd, resp_buf, sizeof(resp_buf)) == STATUS_ERROR) {
-        perror("fsm_handle_remove_employee send_full");
-        close_client_connection(client);  // 发送失败则关闭连接
+    // 把删除员工响应放入输出队列（成功时等待 WAL 落盘后才发送）
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), lsn) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
     } else {
-        printf(
-            "Client fd %d: Employee remove request processed (status: %d).\n",
+        log_debug(
+            "Client fd %d: Employee remove request processed (status: %d).",
             client->fd, status);
     }
 }
 
 /**
- * @brief 处理单个客户端连接的有限状态机逻辑。
- *        从客户端缓冲区接收数据，解析消息，并根据客户端状态和消息类型进行处理。
- *        处理短读、连接断开和缓冲区管理。
- * @param dbhdr 指向数据库头部。
- * @param employees 指向员工数组的指针。
- * @param client 指向当前要处理的客户端状态。
+ * @brief 发送只包含状态字段的响应（更新、按 id 删除共用）。
+ * @param client 指向客户端状态。
+ * @param type 响应的消息类型。
+ * @param status 操作结果。
+ * @param lsn 响应依赖的 WAL LSN，0 表示不依赖。
  */
-void handle_client_fsm(struct dbheader_t *dbhdr, struct employee_t **employees,
-                       clientstate_t *client) {
-    ssize_t bytes_read;
-    dbproto_hdr_t *current_hdr =
-        (dbproto_hdr_t *)client->buffer;  // 指向缓冲区中当前消息头部
+static void fsm_reply_status(clientstate_t *client, dbproto_type_e type,
+                             int status, uint64_t lsn) {
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_employee_del_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_employee_del_resp_t *status_resp =
+        (dbproto_employee_del_resp_t *)(resp_buf + sizeof(dbproto_hdr_t));
 
-    // 从套接字接收数据，填充到缓冲区未使用的部分
-    bytes_read = recv(client->fd, client->buffer + client->buffer_pos,
-                      CLIENT_BUFFER_SIZE - client->buffer_pos, 0);
+    dbproto_hdr_pack(resp_hdr, client->proto, type,
+                     sizeof(dbproto_employee_del_resp_t));
+    status_resp->status =
+        htonl(status == STATUS_SUCCESS ? STATUS_SUCCESS : STATUS_ERROR);
 
-    if (bytes_read <= 0) {
-        // 连接断开或错误
-        if (bytes_read == 0) {
-            printf("Client fd %d disconnected normally.\n", client->fd);
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), lsn) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+    } else {
+        log_debug("Client fd %d: Request processed (type: %d, status: %d).",
+                  client->fd, type, status);
+    }
+}
+
+/**
+ * @brief 删除一条有效记录：写入 FREE 日志，从索引中移除并标记为墓碑。
+ *        调用者必须持有写锁，且 slot 必须是有效记录。
+ * @param db 服务器数据上下文。
+ * @param slot 要删除的槽位。
+ * @param lsnOut 输出参数，返回 FREE 记录的 LSN。
+ * @return 成功时返回 STATUS_SUCCESS，预留空间或写日志失败时返回
+ * STATUS_ERROR（此时什么也没有改变）。
+ */
+static int db_delete_slot(dbctx_t *db, uint32_t slot, uint64_t *lsnOut) {
+    size_t count = db->map->hdr.count;
+    size_t new_count =
+        (slot == count - 1) ? dbmap_trim_count(db->map, slot) : count;
+    if (dbmap_prepare(db->map, slot) != STATUS_SUCCESS ||
+        wal_log_free(db->wal, slot, (uint32_t)new_count, lsnOut) !=
+            STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    dbindex_remove(db->index, db->map, slot);
+    dbmap_kill(db->map, slot);  // 已预留，不会失败
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief FSM (有限状态机) 处理按 id 更新员工请求。
+ *        新版本追加在记录堆末尾，旧版本在检查点之前仍然有效，
+ *        因此和添加一样只需在响应前等待日志落盘。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_update_employee(dbctx_t *db, clientstate_t *client,
+                                       dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_employee_update_req_t)) {
+        fsm_reply_error(client, "Update employee request length mismatch");
+        return;
+    }
+    dbproto_employee_update_req_t *update_req =
+        (dbproto_employee_update_req_t *)(client->buffer +
+                                          sizeof(dbproto_hdr_t));
+    uint32_t id = ntohl(update_req->id);
+    update_req->data[sizeof(update_req->data) - 1] = '\0';  // 防止越界读取
+
+    log_debug("Client fd %d: Received update for id %u: '%s'", client->fd, id,
+              update_req->data);
+
+    struct employee_t employee;
+    uint64_t lsn = 0;
+    int status = parse_employee(update_req->data, &employee);
+    if (status == STATUS_SUCCESS) {
+        pthread_rwlock_wrlock(&db->lock);
+        if (!dbmap_is_live(db->map, id)) {
+            log_debug("Error: No employee with id %u", id);
+            status = STATUS_ERROR;
+        } else if (dbindex_reserve(db->index, 1) != STATUS_SUCCESS ||
+                   dbmap_prepare(db->map, id) != STATUS_SUCCESS ||
+                   wal_log_add(db->wal, id, &employee, &lsn) !=
+                       STATUS_SUCCESS) {
+            status = STATUS_ERROR;
         } else {
-            perror("recv in handle_client_fsm");
+            // 日志中已有这次更新，之后的步骤都已预留，不会失败
+            dbindex_remove(db->index, db->map, id);
+            dbmap_put(db->map, id, &employee);
+            dbindex_insert(db->index, db->map, id);
         }
-        close_client_connection(client);  // 关闭连接
+        pthread_rwlock_unlock(&db->lock);
+    }
+
+    // 成功时等待 WAL 落盘后才发送
+    fsm_reply_status(client, MSG_EMPLOYEE_UPDATE_RESP, status, lsn);
+}
+
+/**
+ * @brief FSM (有限状态机) 处理按 id 删除员工请求。
+ *        其他员工的 id 不变，响应等到日志落盘后发送。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_del_by_id(dbctx_t *db, clientstate_t *client,
+                                 dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_employee_del_by_id_req_t)) {
+        fsm_reply_error(client, "Delete by id request length mismatch");
+        return;
+    }
+    dbproto_employee_del_by_id_req_t *del_req =
+        (dbproto_employee_del_by_id_req_t *)(client->buffer +
+                                             sizeof(dbproto_hdr_t));
+    uint32_t id = ntohl(del_req->id);
+
+    uint64_t lsn = 0;
+    int status = STATUS_ERROR;
+    pthread_rwlock_wrlock(&db->lock);
+    if (!dbmap_is_live(db->map, id)) {
+        log_debug("Error: No employee with id %u", id);
+    } else {
+        status = db_delete_slot(db, id, &lsn);
+    }
+    pthread_rwlock_unlock(&db->lock);
+
+    fsm_reply_status(client, MSG_EMPLOYEE_DEL_BY_ID_RESP, status, lsn);
+}
+
+/**
+ * @brief FSM (有限状态机) 处理按名字删除员工请求。
+ *        通过名字哈希表找到所有同名的员工并逐个删除，响应中报告删除的数量。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_del_by_name(dbctx_t *db, clientstate_t *client,
+                                   dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_employee_del_by_name_req_t)) {
+        fsm_reply_error(client, "Delete by name request length mismatch");
+        return;
+    }
+    dbproto_employee_del_by_name_req_t *name_req =
+        (dbproto_employee_del_by_name_req_t *)(client->buffer +
+                                               sizeof(dbproto_hdr_t));
+    name_req->name[sizeof(name_req->name) - 1] = '\0';  // 防止越界读取
+
+    dbindex_result_t *result = fsm_scratch_result(client);
+    uint64_t lsn = 0;
+    uint32_t deleted = 0;
+    pthread_rwlock_wrlock(&db->lock);
+    int status = dbindex_find_name(db->index, db->map, name_req->name, result);
+    // 从下标最大的开始删除，末尾的墓碑可以一次截掉
+    for (size_t i = result->len; status == STATUS_SUCCESS && i > 0; i--) {
+        status = db_delete_slot(db, result->slots[i - 1], &lsn);
+        if (status == STATUS_SUCCESS) deleted++;
+    }
+    pthread_rwlock_unlock(&db->lock);
+
+    char resp_buf[sizeof(dbproto_hdr_t) +
+                  sizeof(dbproto_employee_del_by_name_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_employee_del_by_name_resp_t *del_resp =
+        (dbproto_employee_del_by_name_resp_t *)(resp_buf +
+                                                sizeof(dbproto_hdr_t));
+
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_EMPLOYEE_DEL_BY_NAME_RESP,
+                     sizeof(dbproto_employee_del_by_name_resp_t));
+    del_resp->status =
+        htonl(status == STATUS_SUCCESS ? STATUS_SUCCESS : STATUS_ERROR);
+    del_resp->count = htonl(deleted);
+
+    // 部分失败时已删除的记录仍然有效，响应同样等待日志落盘
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), lsn) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+    } else {
+        log_debug("Client fd %d: Deleted %u employees named '%s' (status: %d).",
+                  client->fd, deleted, name_req->name, status);
+    }
+}
+
+/**
+ * @brief 批量请求中解析后的一个操作。
+ */
+typedef struct {
+    uint8_t op;                  ///< 操作类型，见 dbproto_batch_op_e
+    uint32_t slot;               ///< DEL 的 id；ADD 执行时分配的槽位
+    struct employee_t employee;  ///< ADD 的新内容；DEL 删除前的内容（撤销用）
+} batch_op_t;
+
+/**
+ * @brief 解析批量请求的消息体（在锁外进行）。
+ * @param body 消息体。
+ * @param len 消息体长度。
+ * @param ops 输出参数，至少 DBPROTO_BATCH_MAX_OPS 个操作。
+ * @param nOut 输出参数，返回操作数。
+ * @param failedOut 输出参数，失败时返回第一个无效操作的下标。
+ * @return 成功时返回 STATUS_SUCCESS，格式错误时返回 STATUS_ERROR。
+ */
+static int batch_parse(const char *body, uint32_t len, batch_op_t *ops,
+                       uint32_t *nOut, uint32_t *failedOut) {
+    dbproto_batch_req_t req;
+    *nOut = 0;
+    *failedOut = 0;
+    if (len < sizeof(req)) return STATUS_ERROR;
+    memcpy(&req, body, sizeof(req));
+    uint32_t n = ntohl(req.count);
+    *failedOut = n;
+    if (n == 0 || n > DBPROTO_BATCH_MAX_OPS) {
+        log_warn("Error: Batch of %u operations (max %d)", n,
+                 DBPROTO_BATCH_MAX_OPS);
+        return STATUS_ERROR;
+    }
+
+    uint32_t off = sizeof(req);
+    for (uint32_t i = 0; i < n; i++) {
+        dbproto_batch_op_t op_hdr;
+        *failedOut = i;
+        if (len - off < sizeof(op_hdr)) return STATUS_ERROR;
+        memcpy(&op_hdr, body + off, sizeof(op_hdr));
+        off += sizeof(op_hdr);
+        uint16_t arg_len = ntohs(op_hdr.len);
+        if (len - off < arg_len) return STATUS_ERROR;
+
+        ops[i].op = op_hdr.op;
+        if (op_hdr.op == BATCH_OP_ADD || op_hdr.op == BATCH_OP_ADD_V2) {
+            // 直接在请求体上解析，参数不以 '\0' 结尾
+            int status =
+                op_hdr.op == BATCH_OP_ADD
+                    ? parse_employee_n(body + off, arg_len, &ops[i].employee)
+                    : parse_employee_fields(body + off, arg_len,
+                                            &ops[i].employee);
+            if (status != STATUS_SUCCESS) return STATUS_ERROR;
+            ops[i].op = BATCH_OP_ADD;
+        } else if (op_hdr.op == BATCH_OP_DEL && arg_len == sizeof(uint32_t)) {
+            uint32_t id;
+            memcpy(&id, body + off, sizeof(id));
+            ops[i].slot = ntohl(id);
+        } else {
+            log_warn("Error: Bad batch operation %u (type %u)", i,
+                     op_hdr.op);
+            return STATUS_ERROR;
+        }
+        off += arg_len;
+    }
+    *failedOut = n;
+    if (off != len) return STATUS_ERROR;  // 末尾有多余的数据
+    *nOut = n;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 原子地执行一批操作。调用者必须持有写锁。
+ *        先验证所有 DEL 的 id 存在且不重复，再一次预留映射、索引所需的
+ *        全部空间，此后每个操作都不会失败；执行时顺便编码 WAL 子记录，
+ *        最后作为一条 BATCH 记录写入日志。写日志失败时按相反顺序撤销。
+ * @param db 服务器数据上下文。
+ * @param arena 请求内存池，用于编码 WAL 子记录。
+ * @param ops 解析后的操作，ADD 的槽位与 DEL 的旧内容会被填入。
+ * @param n 操作数。
+ * @param failedOut 输出参数，失败时返回第一个无效操作的下标（或 n）。
+ * @param lsnOut 输出参数，返回 BATCH 记录的 LSN。
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR（此时什么
+ * 也没有改变）。
+ */
+static int db_apply_batch(dbctx_t *db, arena_t *arena, batch_op_t *ops,
+                          uint32_t n,
+                          uint32_t *failedOut, uint64_t *lsnOut) {
+    dbmap_t *map = db->map;
+    size_t adds = 0;
+    *failedOut = n;
+    for (uint32_t i = 0; i < n; i++) {
+        if (ops[i].op == BATCH_OP_ADD) {
+            adds++;
+            continue;
+        }
+        bool dup = false;
+        for (uint32_t j = 0; j < i && !dup; j++) {
+            dup = ops[j].op == BATCH_OP_DEL && ops[j].slot == ops[i].slot;
+        }
+        if (dup || !dbmap_is_live(map, ops[i].slot)) {
+            log_debug("Error: No employee with id %u in batch",
+                      ops[i].slot);
+            *failedOut = i;
+            return STATUS_ERROR;
+        }
+    }
+
+    // 每个操作最多一个 ADD 子记录那么大
+    char *wal_buf = arena_alloc(arena, n * WAL_BATCH_ADD_SIZE);
+    if (wal_buf == NULL) return STATUS_ERROR;
+    // 新记录复用空闲槽位或追加在末尾，最多用到 count + adds 个槽位
+    if (dbmap_reserve(map, map->hdr.count + adds, n) != STATUS_SUCCESS ||
+        dbindex_reserve(db->index, n) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+
+    // 已预留，以下的写入、删除与索引更新都不会失败
+    size_t wal_len = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        batch_op_t *op = &ops[i];
+        if (op->op == BATCH_OP_ADD) {
+            op->slot = (uint32_t)dbmap_next_slot(map);
+            dbmap_put(map, op->slot, &op->employee);
+            dbindex_insert(db->index, map, op->slot);
+            wal_len +=
+                wal_batch_add(wal_buf + wal_len, op->slot, &op->employee);
+        } else {
+            dbmap_get(map, op->slot, &op->employee);
+            dbindex_remove(db->index, map, op->slot);
+            dbmap_kill(map, op->slot);
+            wal_len += wal_batch_free(wal_buf + wal_len, op->slot,
+                                      (uint32_t)map->hdr.count);
+        }
+    }
+    if (wal_log_batch(db->wal, wal_buf, (uint32_t)wal_len, lsnOut) ==
+        STATUS_SUCCESS) {
+        return STATUS_SUCCESS;
+    }
+
+    for (uint32_t i = n; i-- > 0;) {
+        batch_op_t *op = &ops[i];
+        if (op->op == BATCH_OP_ADD) {
+            dbindex_remove(db->index, map, op->slot);
+            dbmap_kill(map, op->slot);
+        } else {
+            dbmap_put(map, op->slot, &op->employee);
+            dbindex_insert(db->index, map, op->slot);
+        }
+    }
+    return STATUS_ERROR;
+}
+
+/**
+ * @brief FSM (有限状态机) 处理批量添加/删除请求。
+ *        在锁外解析全部操作，持有写锁原子地执行，响应等到日志落盘后发送。
+ *        客户端可以连续发送多个批量请求（流水线），服务器按顺序处理并回复。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_batch(dbctx_t *db, clientstate_t *client,
+                             dbproto_hdr_t *req_hdr) {
+    arena_t *arena = &client->pool->arena;
+    batch_op_t *ops =
+        arena_alloc(arena, DBPROTO_BATCH_MAX_OPS * sizeof(batch_op_t));
+    if (ops == NULL) {
+        close_client_connection(client);  // 内存不足则关闭连接
+        return;
+    }
+    memset(ops, 0, DBPROTO_BATCH_MAX_OPS * sizeof(batch_op_t));
+
+    uint32_t n = 0;
+    uint32_t failed = 0;
+    uint64_t lsn = 0;
+    int status = batch_parse(client->buffer + sizeof(dbproto_hdr_t),
+                             req_hdr->len, ops, &n, &failed);
+    if (status == STATUS_SUCCESS) {
+        pthread_rwlock_wrlock(&db->lock);
+        status = db_apply_batch(db, arena, ops, n, &failed, &lsn);
+        pthread_rwlock_unlock(&db->lock);
+    }
+
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_batch_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_batch_resp_t *batch_resp =
+        (dbproto_batch_resp_t *)(resp_buf + sizeof(dbproto_hdr_t));
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_BATCH_RESP,
+                     sizeof(dbproto_batch_resp_t));
+    batch_resp->status = htonl(status);
+    batch_resp->applied = htonl(status == STATUS_SUCCESS ? n : 0);
+    batch_resp->failed = htonl(status == STATUS_SUCCESS ? 0 : failed);
+
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), lsn) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+    } else {
+        log_debug("Client fd %d: Batch of %u operations processed (status: "
+                  "%d).",
+                  client->fd, n, status);
+    }
+}
+
+/**
+ * @brief FSM (有限状态机) 处理在线快照请求。
+ *        启动快照（子进程在后台写出镜像）后立即回复，不等待镜像写完。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_snapshot(dbctx_t *db, clientstate_t *client,
+                                dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_snapshot_req_t)) {
+        fsm_reply_error(client, "Snapshot request length mismatch");
+        return;
+    }
+
+    snapshot_info_t info = {0};
+    int status = dbctx_snapshot(db, &info);
+
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_snapshot_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_snapshot_resp_t resp = {
+        .status = (int)htonl(status),
+        .lsn = htobe64(info.lsn),
+        .count = htobe64(info.count),
+        .bytes = htobe64(info.bytes),
+    };
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_SNAPSHOT_RESP,
+                     sizeof(resp));
+    memcpy(resp_buf + sizeof(dbproto_hdr_t), &resp, sizeof(resp));
+
+    // 快照之前已经提交了 WAL，响应不必再等待日志落盘
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), 0) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+    } else {
+        log_debug("Client fd %d: Snapshot request processed (status: %d).",
+                  client->fd, status);
+    }
+}
+
+/**
+ * @brief FSM (有限状态机) 处理副本的订阅请求。
+ *        持有读锁提交 WAL 后，此刻的数据库镜像恰好包含已落盘的全部修改，
+ *        在同一把锁内订阅复制日志，之后落盘的记录都会进入订阅。响应之后
+ *        紧跟镜像：头部拷贝，记录堆作为文件块用 sendfile 发送（heap_end
+ *        之前的字节不会再被修改），然后开始推送日志流。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_repl_sync(dbctx_t *db, clientstate_t *client,
+                                 dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_repl_sync_req_t)) {
+        fsm_reply_error(client, "Replication sync request length mismatch");
+        return;
+    }
+    // 镜像与日志流的消息可能超过 V1/V2 头部 16 位的长度
+    if (client->proto != PROTO_VER_V3 || client->repl != NULL) {
+        fsm_reply_error(client, "Replication requires one V3 subscription");
+        return;
+    }
+    repl_sub_t *sub = malloc(sizeof(*sub));
+    if (sub == NULL) {
+        close_client_connection(client);  // 内存不足则关闭连接
         return;
     }
 
-    client->buffer_pos += bytes_read;  // 更新缓冲区中已接收数据的末尾位置
+    struct dbheader_t image_hdr;
+    uint64_t lsn = 0;
+    int fd = -1;
+    pthread_rwlock_rdlock(&db->lock);
+    int status = wal_commit(db->wal);
+    if (status == STATUS_SUCCESS) {
+        lsn = wal_synced_lsn(db->wal);
+        dbmap_image_hdr(db->map, &image_hdr);
+        status = repl_log_subscribe(&db->repl, sub, lsn);
+    }
+    if (status == STATUS_SUCCESS) {
+        fd = fcntl(db->map->fd, F_DUPFD_CLOEXEC, 0);
+        if (fd == -1) {
+            perror("dup database fd for replication");
+            repl_log_unsubscribe(sub);
+            status = STATUS_ERROR;
+        }
+    }
+    pthread_rwlock_unlock(&db->lock);
+    if (status == STATUS_SUCCESS) {
+        client->repl = sub;
+    } else {
+        free(sub);
+    }
+
+    uint64_t heap = status == STATUS_SUCCESS
+                        ? image_hdr.heap_end - DBMAP_HEAP_START
+                        : 0;
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_repl_sync_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_repl_sync_resp_t resp = {
+        .status = (int)htonl(status),
+        .lsn = htobe64(lsn),
+        .bytes = htobe64(status == STATUS_SUCCESS ? sizeof(image_hdr) + heap
+                                                  : 0),
+    };
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_REPL_SYNC_RESP,
+                     sizeof(resp));
+    memcpy(resp_buf + sizeof(dbproto_hdr_t), &resp, sizeof(resp));
+
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), 0) ==
+        STATUS_ERROR) {
+        if (fd != -1) close(fd);
+        close_client_connection(client);  // 内存不足则关闭连接
+        return;
+    }
+    if (status != STATUS_SUCCESS) return;
+    if (outq_append(&client->outq, &image_hdr, sizeof(image_hdr)) ==
+        STATUS_ERROR) {
+        close(fd);
+        close_client_connection(client);
+        return;
+    }
+    if (heap == 0) {
+        close(fd);
+    } else if (outq_append_file(&client->outq, fd, DBMAP_HEAP_START,
+                                (size_t)heap) == STATUS_ERROR) {
+        close_client_connection(client);  // outq_append_file 已关闭 fd
+        return;
+    }
+    log_info("Client fd %d: Replica subscribed at LSN %lu (%lu byte image)",
+             client->fd, (unsigned long)lsn,
+             (unsigned long)(sizeof(image_hdr) + heap));
+    feed_replica_client(client);
+}
+
+/**
+ * @brief FSM (有限状态机) 处理副本的确认：记录它已应用的 LSN，不回复。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_repl_ack(clientstate_t *client,
+                                dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_repl_ack_t) || client->repl == NULL) {
+        fsm_reply_error(client, "Unexpected replication ack");
+        return;
+    }
+    dbproto_repl_ack_t ack;
+    memcpy(&ack, client->buffer + sizeof(dbproto_hdr_t), sizeof(ack));
+    repl_log_ack(client->repl, be64toh(ack.lsn));
+}
+
+/**
+ * @brief FSM (有限状态机) 处理复制状态查询：主库报告最慢的副本，
+ *        副本报告自己与主库的差距。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_repl_stats(dbctx_t *db, clientstate_t *client,
+                                  dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_repl_stats_req_t)) {
+        fsm_reply_error(client, "Replication stats request length mismatch");
+        return;
+    }
+
+    repl_stats_t stats;
+    if (db->replica != NULL) {
+        repl_replica_stats(db->replica, &stats);
+    } else {
+        repl_log_stats(&db->repl, &stats);
+    }
+
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_repl_stats_resp_t)];
+    dbproto_hdr_t *resp_hdr = (dbproto_hdr_t *)resp_buf;
+    dbproto_repl_stats_resp_t resp = {
+        .role = htonl(stats.role),
+        .links = htonl(stats.links),
+        .lsn = htobe64(stats.lsn),
+        .primary_lsn = htobe64(stats.primary_lsn),
+        .lag_lsn = htobe64(stats.lag_lsn),
+        .lag_ms = htobe64(stats.lag_ms),
+    };
+    dbproto_hdr_pack(resp_hdr, client->proto, MSG_REPL_STATS_RESP,
+                     sizeof(resp));
+    memcpy(resp_buf + sizeof(dbproto_hdr_t), &resp, sizeof(resp));
+
+    if (fsm_send_reply(client, resp_buf, sizeof(resp_buf), 0) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+    }
+}
+
+/**
+ * @brief 把直方图概括为统计响应中的一项（网络字节序）。
+ * @param type 请求的消息类型。
+ * @param h 这种请求的处理时间。
+ * @param out 输出参数。
+ */
+static void fsm_stats_op(uint32_t type, const hist_t *h,
+                         dbproto_stats_op_t *out) {
+    out->type = htonl(type);
+    out->reserved = 0;
+    out->count = htobe64(h->total);
+    out->mean_ns = htobe64((uint64_t)hist_mean(h));
+    out->p50_ns = htobe64(hist_percentile(h, 50));
+    out->p90_ns = htobe64(hist_percentile(h, 90));
+    out->p99_ns = htobe64(hist_percentile(h, 99));
+    out->p999_ns = htobe64(hist_percentile(h, 99.9));
+    out->max_ns = htobe64(h->total > 0 ? h->max : 0);
+}
+
+/**
+ * @brief FSM (有限状态机) 处理服务器统计请求：汇总所有事件循环的
+ *        计数器与直方图，每种处理过的请求回复一项。直方图较大，
+ *        合并用的临时空间来自请求内存池。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ * @param req_hdr 接收到的请求头部。
+ */
+static void fsm_handle_stats(dbctx_t *db, clientstate_t *client,
+                             dbproto_hdr_t *req_hdr) {
+    if (req_hdr->len != sizeof(dbproto_stats_req_t)) {
+        fsm_reply_error(client, "Stats request length mismatch");
+        return;
+    }
+    stats_totals_t *totals =
+        arena_alloc(&client->pool->arena, sizeof(stats_totals_t));
+    hist_t *op = arena_alloc(&client->pool->arena, sizeof(hist_t));
+    if (totals == NULL || op == NULL) {
+        close_client_connection(client);  // 内存不足则关闭连接
+        return;
+    }
+
+    char resp_buf[sizeof(dbproto_hdr_t) + sizeof(dbproto_stats_resp_t) +
+                  MSG_MAX * sizeof(dbproto_stats_op_t)];
+    dbproto_stats_op_t *ops =
+        (dbproto_stats_op_t *)(resp_buf + sizeof(dbproto_hdr_t) +
+                               sizeof(dbproto_stats_resp_t));
+    uint32_t ntypes = 0;
+    for (uint32_t type = 0; type < MSG_MAX && db->stats.nshards > 0; type++) {
+        stats_merge_op(&db->stats, type, op);
+        if (op->total > 0) fsm_stats_op(type, op, &ops[ntypes++]);
+    }
+
+    stats_totals(&db->stats, totals);
+    dbproto_stats_resp_t resp = {
+        .uptime_ms = htobe64(totals->uptime_ms),
+        .reactors = htonl((uint32_t)db->stats.nshards),
+        .ntypes = htonl(ntypes),
+        .conns_open = htobe64(totals->conns_open),
+        .conns_accepted = htobe64(totals->conns_accepted),
+        .bytes_in = htobe64(totals->bytes_in),
+        .bytes_out = htobe64(totals->bytes_out),
+        .errors = htobe64(totals->errors),
+        .loop_iters = htobe64(totals->loop.total),
+        .loop_mean_ns = htobe64((uint64_t)hist_mean(&totals->loop)),
+        .loop_p99_ns = htobe64(hist_percentile(&totals->loop, 99)),
+        .loop_max_ns = htobe64(totals->loop.total > 0 ? totals->loop.max : 0),
+        .events = htobe64(totals->events),
+        .events_max = htobe64(totals->events_max),
+        .commits = htobe64(totals->commits),
+        .commit_waiters = htobe64(totals->commit_waiters),
+        .commit_waiters_max = htobe64(totals->commit_waiters_max),
+    };
+    size_t body = sizeof(resp) + ntypes * sizeof(dbproto_stats_op_t);
+    dbproto_hdr_pack((dbproto_hdr_t *)resp_buf, client->proto, MSG_STATS_RESP,
+                     (uint32_t)body);
+    memcpy(resp_buf + sizeof(dbproto_hdr_t), &resp, sizeof(resp));
+
+    if (fsm_send_reply(client, resp_buf, sizeof(dbproto_hdr_t) + body, 0) ==
+        STATUS_ERROR) {
+        close_client_connection(client);  // 内存不足则关闭连接
+    }
+}
+
+/**
+ * @brief 判断消息是否会修改数据库，副本拒绝这些消息。
+ *        订阅也被拒绝：副本没有自己的复制日志，不能级联复制。
+ * @param type 消息类型。
+ * @return 修改类消息返回 true。
+ */
+static bool fsm_is_write(dbproto_type_e type) {
+    switch (type) {
+        case MSG_EMPLOYEE_ADD_REQ:
+        case MSG_EMPLOYEE_ADD_V2_REQ:
+        case MSG_EMPLOYEE_DEL_REQ:
+        case MSG_EMPLOYEE_UPDATE_REQ:
+        case MSG_EMPLOYEE_DEL_BY_ID_REQ:
+        case MSG_EMPLOYEE_DEL_BY_NAME_REQ:
+        case MSG_BATCH_REQ:
+        case MSG_REPL_SYNC_REQ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 处理客户端缓冲区中所有完整的消息。
+ *        输出队列超过高水位时暂停（背压），等待可写事件把队列发送到
+ *        低水位以下后再继续，从而限制每个连接占用的内存。
+ *        分页列表尚未发送完时先逐块发送，之后的请求排在它后面，
+ *        因此响应顺序不变，大列表也只占用高水位附近的内存。
+ * @param db 服务器数据上下文。
+ * @param client 指向当前要处理的客户端状态。
+ */
+static void fsm_process_buffer(dbctx_t *db, clientstate_t *client) {
+    dbproto_hdr_t *current_hdr =
+        (dbproto_hdr_t *)client->buffer;  // 指向缓冲区中当前消息头部
 
     // 循环处理缓冲区中的完整消息
-    while (client->buffer_pos >= sizeof(dbproto_hdr_t)) {  // 确保至少收到了头部
+    while (client->cursor.active ||
+           client->buffer_pos >= sizeof(dbproto_hdr_t)) {  // 确保至少收到了头部
+        // 客户端读取响应的速度跟不上，暂停处理它的请求
+        if (outq_pending(&client->outq) >= CLIENT_OUTQ_HIGH_WATER) {
+            client->tx_blocked = true;
+            break;
+        }
+
+        // 继续发送未完成的分页列表
+        if (client->cursor.active) {
+            fsm_list_next_chunk(db, client);
+            if (client->fd == -1) return;
+            continue;
+        }
+
         // 如果是首次处理这个消息，解析头部以获取完整消息的预期长度
         if (client->msg_expected_len == 0) {
             dbproto_hdr_t temp_hdr;
             memcpy(&temp_hdr, client->buffer,
                    sizeof(dbproto_hdr_t));  // 临时复制头部进行解析
-            temp_hdr.type = ntohl(temp_hdr.type);  // 转换为主机字节序
-            temp_hdr.len = ntohs(temp_hdr.len);
+            dbproto_hdr_unpack(&temp_hdr, client->proto);  // 转换为主机字节序
 
             // 对消息类型进行基本检查
             if (temp_hdr.type >= MSG_MAX) {
-                fprintf(stderr,
-                        "Client fd %d: Invalid message type %d. Closing "
-                        "connection.\n",
-                        client->fd, temp_hdr.type);
+                log_warn(
+                    "Client fd %d: Invalid message type %d. Closing "
+                    "connection.",
+                    client->fd, temp_hdr.type);
                 fsm_reply_error(client, "Invalid message type");
                 return;
             }
             // 检查完整消息是否能放入缓冲区
             if (sizeof(dbproto_hdr_t) + temp_hdr.len > CLIENT_BUFFER_SIZE) {
-                fprintf(stderr,
-                        "Client fd %d: Message length %u exceeds buffer size "
-                        "%d. Closing connection.\n",
-                        client->fd,
-                        (unsigned int)(sizeof(dbproto_hdr_t) + temp_hdr.len),
-                        CLIENT_BUFFER_SIZE);
+                log_warn(
+                    "Client fd %d: Message length %u exceeds buffer size "
+                    "%d. Closing connection.",
+                    client->fd,
+                    (unsigned int)(sizeof(dbproto_hdr_t) + temp_hdr.len),
+                    CLIENT_BUFFER_SIZE);
                 fsm_reply_error(client, "Message too large");
                 return;
             }
@@ -383,24 +1672,25 @@ void handle_client_fsm(struct dbheader_t *dbhdr, struct employee_t **employees,
         // 检查缓冲区是否包含完整的消息
         if (client->buffer_pos >= client->msg_expected_len) {
             // 完整消息已到达，现在可以安全地转换其头部进行处理
-            current_hdr->type = ntohl(current_hdr->type);
-            current_hdr->len = ntohs(current_hdr->len);
+            dbproto_hdr_unpack(current_hdr, client->proto);
 
-            printf(
-                "Client fd %d (state: %d) received message type: %d, len: %d\n",
+            log_debug(
+                "Client fd %d (state: %d) received message type: %d, len: %d",
                 client->fd, client->state, current_hdr->type, current_hdr->len);
 
-            // 根据客户端状态和消息类型进行分派处理
+            // 根据客户端状态和消息类型进行分派处理，并记录处理时间
+            uint32_t type = current_hdr->type;
+            uint64_t start_ns = stats_now_ns();
             switch (client->state) {
                 case STATE_CONNECTED:  // 客户端刚连接，期望 Hello 请求
                     if (current_hdr->type == MSG_HELLO_REQ) {
                         // 验证 Hello 请求体长度
                         if (current_hdr->len != sizeof(dbproto_hello_req)) {
-                            fprintf(stderr,
-                                    "Client fd %d: Hello request length "
-                                    "mismatch. Expected %zu, got %u.\n",
-                                    client->fd, sizeof(dbproto_hello_req),
-                                    current_hdr->len);
+                            log_warn(
+                                "Client fd %d: Hello request length "
+                                "mismatch. Expected %zu, got %u.",
+                                client->fd, sizeof(dbproto_hello_req),
+                                current_hdr->len);
                             fsm_reply_error(client,
                                             "Hello request length mismatch");
                             return;
@@ -410,20 +1700,24 @@ void handle_client_fsm(struct dbheader_t *dbhdr, struct employee_t **employees,
                             (dbproto_hello_req *)(client->buffer +
                                                   sizeof(dbproto_hdr_t));
                         hello_req->proto = ntohs(hello_req->proto);
-                        if (hello_req->proto != PROTO_VER) {
-                            fprintf(stderr,
-                                    "Client fd %d: Protocol mismatch. Expected "
-                                    "%u, got %u.\n",
-                                    client->fd, PROTO_VER, hello_req->proto);
+                        if (hello_req->proto != PROTO_VER_V1 &&
+                            hello_req->proto != PROTO_VER_V2 &&
+                            hello_req->proto != PROTO_VER_V3) {
+                            log_warn(
+                                "Client fd %d: Protocol mismatch. Expected "
+                                "%u, %u or %u, got %u.",
+                                client->fd, PROTO_VER_V1, PROTO_VER_V2,
+                                PROTO_VER_V3, hello_req->proto);
                             fsm_reply_error(client, "Protocol mismatch");
                             return;
                         }
-                        fsm_reply_hello(client);  // 发送 Hello 响应
+                        // 发送 Hello 响应，之后的消息使用客户端选择的版本
+                        fsm_reply_hello(client, hello_req->proto);
                     } else {
-                        fprintf(stderr,
-                                "Client fd %d: Expected MSG_HELLO_REQ, got %d. "
-                                "Disconnecting.\n",
-                                client->fd, current_hdr->type);
+                        log_warn(
+                            "Client fd %d: Expected MSG_HELLO_REQ, got %d. "
+                            "Disconnecting.",
+                            client->fd, current_hdr->type);
                         fsm_reply_error(
                             client,
                             "Unexpected message type in CONNECTED state");
@@ -432,40 +1726,87 @@ void handle_client_fsm(struct dbheader_t *dbhdr, struct employee_t **employees,
                     break;
 
                 case STATE_READY_FOR_MSG:  // 客户端已就绪，处理业务消息
+                    if (db->replica != NULL &&
+                        fsm_is_write(current_hdr->type)) {
+                        fsm_reply_error(client, "Read-only replica");
+                        return;
+                    }
                     switch (current_hdr->type) {
                         case MSG_EMPLOYEE_ADD_REQ:
-                            fsm_handle_add_employee(dbhdr, employees, client,
-                                                    current_hdr);
+                            fsm_handle_add_employee(db, client, current_hdr);
                             break;
                         case MSG_EMPLOYEE_LIST_REQ:
-                            // 传递 *employees (const struct employee_t*)
-                            // 给处理函数
-                            fsm_handle_list_employees(dbhdr, *employees, client,
-                                                      current_hdr);
+                            fsm_handle_list_employees(db, client, current_hdr);
                             break;
                         case MSG_EMPLOYEE_DEL_REQ:
-                            fsm_handle_remove_employee(dbhdr, employees, client,
+                            fsm_handle_remove_employee(db, client, current_hdr);
+                            break;
+                        case MSG_EMPLOYEE_GET_BY_NAME_REQ:
+                            fsm_handle_get_by_name(db, client, current_hdr);
+                            break;
+                        case MSG_EMPLOYEE_RANGE_HOURS_REQ:
+                            fsm_handle_range_hours(db, client, current_hdr);
+                            break;
+                        case MSG_EMPLOYEE_UPDATE_REQ:
+                            fsm_handle_update_employee(db, client,
                                                        current_hdr);
                             break;
+                        case MSG_EMPLOYEE_DEL_BY_ID_REQ:
+                            fsm_handle_del_by_id(db, client, current_hdr);
+                            break;
+                        case MSG_EMPLOYEE_DEL_BY_NAME_REQ:
+                            fsm_handle_del_by_name(db, client, current_hdr);
+                            break;
+                        case MSG_EMPLOYEE_LIST_PAGE_REQ:
+                            fsm_handle_list_page(client, current_hdr);
+                            break;
+                        case MSG_BATCH_REQ:
+                            fsm_handle_batch(db, client, current_hdr);
+                            break;
+                        case MSG_EMPLOYEE_ADD_V2_REQ:
+                            fsm_handle_add_employee_v2(db, client,
+                                                       current_hdr);
+                            break;
+                        case MSG_SNAPSHOT_REQ:
+                            fsm_handle_snapshot(db, client, current_hdr);
+                            break;
+                        case MSG_REPL_SYNC_REQ:
+                            fsm_handle_repl_sync(db, client, current_hdr);
+                            break;
+                        case MSG_REPL_ACK:
+                            fsm_handle_repl_ack(client, current_hdr);
+                            break;
+                        case MSG_REPL_STATS_REQ:
+                            fsm_handle_repl_stats(db, client, current_hdr);
+                            break;
+                        case MSG_STATS_REQ:
+                            fsm_handle_stats(db, client, current_hdr);
+                            break;
                         default:  // 未知消息类型
-                            fprintf(stderr,
-                                    "Client fd %d: Received unknown message "
-                                    "type %d in READY state. Disconnecting.\n",
-                                    client->fd, current_hdr->type);
+                            log_warn(
+                                "Client fd %d: Received unknown message "
+                                "type %d in READY state. Disconnecting.",
+                                client->fd, current_hdr->type);
                             fsm_reply_error(client, "Unknown message type");
                             return;
                     }
                     break;
 
                 default:  // 未知或异常客户端状态
-                    fprintf(stderr,
-                            "Client fd %d: Unknown state %d. Disconnecting.\n",
-                            client->fd, client->state);
+                    log_warn(
+                        "Client fd %d: Unknown state %d. Disconnecting.",
+                        client->fd, client->state);
                     fsm_reply_error(client, "Unknown client state");
                     return;
             }
 
             // 消息处理完毕，将缓冲区中剩余的未处理数据移到开头
+            if (type < MSG_MAX) {
+                stats_record_op(client->pool->stats, type,
+                                stats_now_ns() - start_ns);
+            }
+            fsm_release_request(client);
+            client->req_start_ms = 0;  // 下一条消息的接收由事件循环重新计时
             size_t remaining_bytes =
                 client->buffer_pos - client->msg_expected_len;
             if (remaining_bytes > 0) {
@@ -483,44 +1824,165 @@ void handle_client_fsm(struct dbheader_t *dbhdr, struct employee_t **employees,
 }
 
 /**
- * @brief 初始化所有客户端状态槽位。
- * @param clientStates 客户端状态数组。
- * @param max_clients 数组的最大大小。
+ * @brief 驱动客户端 FSM：先处理缓冲区中的完整消息，再从套接字读取，
+ *        如此循环直到套接字返回 EAGAIN（边沿触发要求读空），
+ *        或缓冲区已满且处理因背压而暂停。最后发送输出队列。
+ *        因背压暂停时会先尝试发送：若队列能直接降到低水位以下
+ *        （不会再有可写通知），立即继续处理。
+ * @param db 服务器数据上下文。
+ * @param client 指向当前要处理的客户端状态。
+ * @param read_socket 是否从套接字读取新数据。
  */
-void init_clients(clientstate_t *clientStates, int max_clients) {
-    for (int i = 0; i < max_clients; ++i) {
-        clientStates[i].fd = -1;  // 文件描述符初始化为 -1，表示空闲
-        clientStates[i].state = STATE_NEW;     // 初始状态为 NEW
-        clientStates[i].buffer_pos = 0;        // 缓冲区位置清零
-        clientStates[i].msg_expected_len = 0;  // 预期消息长度清零
-        memset(clientStates[i].buffer, '\0', CLIENT_BUFFER_SIZE);  // 清空缓冲区
+static void fsm_drive(dbctx_t *db, clientstate_t *client, bool read_socket) {
+    for (;;) {
+        fsm_process_buffer(db, client);
+        if (client->fd == -1) return;
+        if (client->tx_blocked) {
+            fsm_flush(client);
+            if (client->fd == -1) return;
+            if (outq_pending(&client->outq) < CLIENT_OUTQ_LOW_WATER) {
+                client->tx_blocked = false;
+                continue;
+            }
+        }
+        if (!read_socket) break;
+
+        if (client->buffer_pos == CLIENT_BUFFER_SIZE) {
+            // 缓冲区已满且消息处理被暂停，恢复时再继续读取
+            client->rx_pending = true;
+            break;
+        }
+
+        // 有数据可读时才挂上接收缓冲区
+        if (client->buffer == NULL) {
+            client->buffer = slab_alloc(&client->pool->buffers);
+            if (client->buffer == NULL) {
+                close_client_connection(client);  // 内存不足则关闭连接
+                return;
+            }
+        }
+
+        // 从套接字接收数据，填充到缓冲区未使用的部分
+        ssize_t bytes_read =
+            recv(client->fd, client->buffer + client->buffer_pos,
+                 CLIENT_BUFFER_SIZE - client->buffer_pos, 0);
+        if (bytes_read > 0) {
+            client->buffer_pos += bytes_read;  // 更新已接收数据的末尾位置
+            stats_add(&client->pool->stats->bytes_in, (uint64_t)bytes_read);
+            continue;
+        }
+        if (bytes_read == -1 && errno == EINTR) continue;
+        if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            client->rx_pending = false;  // 套接字已读空，等待下一次边沿通知
+            break;
+        }
+
+        // 连接断开或错误
+        if (bytes_read == 0) {
+            log_debug("Client fd %d disconnected normally.", client->fd);
+        } else {
+            perror("recv in handle_client_fsm");
+        }
+        close_client_connection(client);  // 关闭连接
+        return;
+    }
+    if (client->buffer_pos == 0 && client->buffer != NULL) {
+        // 没有未处理的数据，缓冲区归还对象池，空闲连接不占用它
+        slab_free(&client->pool->buffers, client->buffer);
+        client->buffer = NULL;
     }
+    fsm_flush(client);
 }
 
 /**
- * @brief 查找一个空闲的客户端状态槽位。
- * @param clientStates 客户端状态数组。
- * @param max_clients 数组的最大大小。
- * @return 空闲槽位的索引，或 STATUS_ERROR (-1) 如果没有空闲槽位。
+ * @brief 处理单个客户端连接的有限状态机逻辑（可读事件入口）。
+ * @param db 服务器数据上下文。
+ * @param client 指向当前要处理的客户端状态。
  */
-int find_free_slot(clientstate_t *clientStates, int max_clients) {
-    for (int i = 0; i < max_clients; ++i) {
-        if (clientStates[i].fd == -1) return i;  // 找到 fd 为 -1 的槽位
+void handle_client_fsm(dbctx_t *db, clientstate_t *client) {
+    fsm_drive(db, client, true);
+}
+
+/**
+ * @brief 处理可写事件：发送输出队列，降到低水位以下时恢复请求处理。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
+ */
+void handle_client_writable(dbctx_t *db, clientstate_t *client) {
+    fsm_flush(client);
+    feed_replica_client(client);
+    if (client->fd == -1 || !client->tx_blocked ||
+        outq_pending(&client->outq) >= CLIENT_OUTQ_LOW_WATER) {
+        return;
     }
-    return STATUS_ERROR;  // 没有空闲槽位
+    // 继续处理被暂停的消息；若之前因缓冲区满停止读取，则恢复读取
+    client->tx_blocked = false;
+    fsm_drive(db, client, client->rx_pending);
 }
 
 /**
- * @brief 根据文件描述符查找对应的客户端状态槽位。
- * @param clientStates 客户端状态数组。
- * @param max_clients 数组的最大大小。
- * @param fd 要查找的文件描述符。
- * @return 槽位的索引，或 STATUS_ERROR (-1) 如果未找到。
+ * @brief WAL 组提交之后放行被扣留的响应，并按可写事件的方式继续处理。
+ * @param db 服务器数据上下文。
+ * @param client 指向客户端状态。
  */
-int find_slot_by_fd(clientstate_t *clientStates, int max_clients,
-                    const int fd) {
-    for (int i = 0; i < max_clients; ++i) {
-        if (clientStates[i].fd == fd) return i;  // 找到 fd 匹配的槽位
+void resume_client_fsm(dbctx_t *db, clientstate_t *client) {
+    if (client->fd == -1) return;
+    client->hold_from = CLIENT_NO_HOLD;
+    client->wait_lsn = 0;
+    handle_client_writable(db, client);
+}
+
+/**
+ * @brief 连接超时：与协议错误一样尽力回复 MSG_ERROR 并关闭连接。
+ * @param client 指向超时的客户端状态。
+ * @param reason 超时原因。
+ */
+void expire_client(clientstate_t *client, const char *reason) {
+    if (client->fd == -1) return;
+    fsm_reply_error(client, reason);
+}
+
+/**
+ * @brief 逐条把复制日志拷贝到输出队列，达到高水位时发送一次；
+ *        发送没有遇到 EAGAIN（队列已清空）时继续，否则等待可写事件。
+ * @param client 指向副本连接的客户端状态。
+ */
+void feed_replica_client(clientstate_t *client) {
+    const size_t head = sizeof(dbproto_hdr_t) + sizeof(dbproto_repl_wal_t);
+    if (client->fd == -1 || client->repl == NULL) return;
+    for (;;) {
+        bool drained = false;
+        while (outq_pending(&client->outq) < CLIENT_OUTQ_HIGH_WATER) {
+            ssize_t n = repl_log_pending(client->repl);
+            if (n == 0) {
+                drained = true;
+                break;
+            }
+            size_t len = n > 0 && n < REPL_CHUNK ? (size_t)n : REPL_CHUNK;
+            uint64_t lsn = 0;
+            ssize_t got = -1;
+            char *dst = NULL;
+            if (n > 0) {
+                dst = outq_reserve(&client->outq, head + len, NULL);
+                if (dst == NULL) {
+                    close_client_connection(client);  // 内存不足则关闭连接
+                    return;
+                }
+                got = repl_log_read(client->repl, dst + head, len, &lsn);
+            }
+            if (got < 0) {
+                fsm_reply_error(client, "Replica fell behind the backlog");
+                return;
+            }
+            dbproto_repl_wal_t wal_hdr = {.primary_lsn = htobe64(lsn)};
+            dbproto_hdr_pack((dbproto_hdr_t *)dst, client->proto, MSG_REPL_WAL,
+                             sizeof(wal_hdr) + (uint32_t)got);
+            memcpy(dst + sizeof(dbproto_hdr_t), &wal_hdr, sizeof(wal_hdr));
+            outq_commit(&client->outq, head + (size_t)got);
+        }
+        fsm_flush(client);
+        if (client->fd == -1 || drained || outq_pending(&client->outq) > 0) {
+            return;
+        }
     }
-    return STATUS_ERROR;  // 未找到
-}
\ No newline at end of file
+}
@@ -0,0 +1,111 @@
+#include "../../include/stats.h"  // 包含 stats_t 声明
+
+#include <stdio.h>   // For perror
+#include <stdlib.h>  // For calloc, free
+#include <time.h>    // For clock_gettime
+
+/**
+ * @brief 单调时钟的纳秒数。
+ */
+uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief 分配分片，直方图清零后才可记录。
+ */
+int stats_init(stats_t *stats, int nshards) {
+    stats->shards = calloc((size_t)nshards, sizeof(stats_shard_t));
+    if (stats->shards == NULL) {
+        perror("calloc for stats");
+        return STATUS_ERROR;
+    }
+    stats->nshards = nshards;
+    for (int i = 0; i < nshards; i++) {
+        stats_shard_t *shard = &stats->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        for (int t = 0; t < MSG_MAX; t++) hist_init(&shard->ops[t]);
+        hist_init(&shard->loop);
+    }
+    stats->start_ns = stats_now_ns();
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 销毁分片的锁并释放分片数组。
+ */
+void stats_destroy(stats_t *stats) {
+    for (int i = 0; i < stats->nshards; i++) {
+        pthread_mutex_destroy(&stats->shards[i].lock);
+    }
+    free(stats->shards);
+    stats->shards = NULL;
+    stats->nshards = 0;
+}
+
+/**
+ * @brief 加锁记录到对应请求类型的直方图。
+ */
+void stats_record_op(stats_shard_t *shard, uint32_t type, uint64_t ns) {
+    pthread_mutex_lock(&shard->lock);
+    hist_record(&shard->ops[type], ns);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * @brief 累加就绪事件数并记录本轮的处理时间。
+ */
+void stats_record_loop(stats_shard_t *shard, uint64_t events, uint64_t ns) {
+    stats_add(&shard->events, events);
+    stats_max(&shard->events_max, events);
+    pthread_mutex_lock(&shard->lock);
+    hist_record(&shard->loop, ns);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * @brief 逐个分片读取计数器，计数器之间不是同一时刻的快照。
+ */
+void stats_totals(stats_t *stats, stats_totals_t *out) {
+    uint64_t closed = 0;
+    *out = (stats_totals_t){0};
+    hist_init(&out->loop);
+    out->uptime_ms = (stats_now_ns() - stats->start_ns) / 1000000;
+    for (int i = 0; i < stats->nshards; i++) {
+        stats_shard_t *shard = &stats->shards[i];
+        out->conns_accepted +=
+            __atomic_load_n(&shard->conns_accepted, __ATOMIC_RELAXED);
+        closed += __atomic_load_n(&shard->conns_closed, __ATOMIC_RELAXED);
+        out->bytes_in += __atomic_load_n(&shard->bytes_in, __ATOMIC_RELAXED);
+        out->bytes_out += __atomic_load_n(&shard->bytes_out, __ATOMIC_RELAXED);
+        out->errors += __atomic_load_n(&shard->errors, __ATOMIC_RELAXED);
+        out->events += __atomic_load_n(&shard->events, __ATOMIC_RELAXED);
+        out->commits += __atomic_load_n(&shard->commits, __ATOMIC_RELAXED);
+        out->commit_waiters +=
+            __atomic_load_n(&shard->commit_waiters, __ATOMIC_RELAXED);
+        uint64_t v = __atomic_load_n(&shard->events_max, __ATOMIC_RELAXED);
+        if (v > out->events_max) out->events_max = v;
+        v = __atomic_load_n(&shard->commit_waiters_max, __ATOMIC_RELAXED);
+        if (v > out->commit_waiters_max) out->commit_waiters_max = v;
+        pthread_mutex_lock(&shard->lock);
+        hist_merge(&out->loop, &shard->loop);
+        pthread_mutex_unlock(&shard->lock);
+    }
+    out->conns_open =
+        out->conns_accepted > closed ? out->conns_accepted - closed : 0;
+}
+
+/**
+ * @brief 逐个分片加锁合并。
+ */
+void stats_merge_op(stats_t *stats, uint32_t type, hist_t *out) {
+    hist_init(out);
+    for (int i = 0; i < stats->nshards; i++) {
+        stats_shard_t *shard = &stats->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        hist_merge(out, &shard->ops[type]);
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
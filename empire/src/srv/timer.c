@@ -0,0 +1,159 @@
+#include "../../include/timer.h"  // 包含 timer_wheel_t 声明
+
+#include <time.h>  // For clock_gettime
+
+/**
+ * @brief 单调时钟的毫秒数。
+ */
+uint64_t timer_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 清空所有槽位。
+ */
+void timer_wheel_init(timer_wheel_t *tw, uint64_t now) {
+    *tw = (timer_wheel_t){.now = now};
+}
+
+/**
+ * @brief 把 64 位位图循环右移 shift 位（0 到 63）。
+ */
+static uint64_t rotr64(uint64_t bits, unsigned shift) {
+    return shift == 0 ? bits : (bits >> shift) | (bits << (64 - shift));
+}
+
+/**
+ * @brief 按 at 时刻把节点挂到对应的层与槽位，不改变 count。
+ *        与当前时刻相差 d 的时刻放在满足 d < 64^(L+1) 的最低层 L，
+ *        槽位是 at 在该层的 6 位下标：第 L 层的槽位在低 6L 位归零、
+ *        且下标与之相同的第一个时刻被处理，恰好是 at 所在的 64^L 区间的起点。
+ * @param tw 时间轮
+ * @param node 定时器
+ * @param at 放置用的时刻，不早于 tw->now
+ */
+static void timer_place(timer_wheel_t *tw, timer_node_t *node, uint64_t at) {
+    uint64_t delta = at - tw->now;
+    if (delta >= TIMER_RANGE) {
+        at = tw->now + TIMER_RANGE - 1;  // 先放在最远处，到时重新放置
+        delta = TIMER_RANGE - 1;
+    }
+    unsigned level = 0;
+    while (delta >> ((level + 1) * TIMER_SLOT_BITS) != 0) level++;
+    unsigned slot = (at >> (level * TIMER_SLOT_BITS)) & (TIMER_SLOTS - 1);
+
+    timer_node_t **head = &tw->slots[level][slot];
+    node->next = *head;
+    if (*head) (*head)->pprev = &node->next;
+    *head = node;
+    node->pprev = head;
+    node->level = (uint8_t)level;
+    node->slot = (uint8_t)slot;
+    tw->occupied[level] |= (uint64_t)1 << slot;
+}
+
+/**
+ * @brief 把节点从所在槽位摘下，槽位变空时清除位图，不改变 count。
+ */
+static void timer_unlink(timer_wheel_t *tw, timer_node_t *node) {
+    *node->pprev = node->next;
+    if (node->next) node->next->pprev = node->pprev;
+    if (tw->slots[node->level][node->slot] == NULL) {
+        tw->occupied[node->level] &= ~((uint64_t)1 << node->slot);
+    }
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+/**
+ * @brief 已在时间轮中的节点先摘下；过去的时刻放在下一格。
+ */
+void timer_wheel_add(timer_wheel_t *tw, timer_node_t *node, uint64_t expires) {
+    if (timer_pending(node)) {
+        timer_unlink(tw, node);
+    } else {
+        tw->count++;
+    }
+    node->expires = expires;
+    timer_place(tw, node, expires > tw->now ? expires : tw->now + 1);
+}
+
+/**
+ * @brief 摘下节点并减少计数。
+ */
+void timer_wheel_del(timer_wheel_t *tw, timer_node_t *node) {
+    if (!timer_pending(node)) return;
+    timer_unlink(tw, node);
+    tw->count--;
+}
+
+/**
+ * @brief 第 0 层取当前时刻之后最近的非空槽位；更高的层取最近的非空槽位
+ *        被下放的时刻。各层都只需一次循环移位和一次 ctz。
+ */
+uint64_t timer_wheel_next(const timer_wheel_t *tw) {
+    uint64_t next = UINT64_MAX;
+    for (unsigned level = 0; level < TIMER_LEVELS; level++) {
+        uint64_t bits = tw->occupied[level];
+        if (bits == 0) continue;
+        unsigned shift = level * TIMER_SLOT_BITS;
+        uint64_t block = tw->now >> shift;  // 当前时刻在该层的区间编号
+        unsigned start = (unsigned)((block + 1) & (TIMER_SLOTS - 1));
+        uint64_t d = (uint64_t)__builtin_ctzll(rotr64(bits, start)) + 1;
+        uint64_t at = (block + d) << shift;
+        if (at < next) next = at;
+    }
+    return next;
+}
+
+/**
+ * @brief 处理 tw->now 这一格：先把低位归零的各层槽位下放，
+ *        再让第 0 层对应槽位中的定时器到期。放在最远处的定时器
+ *        若真实到期时刻未到，重新放置。
+ */
+static void timer_tick(timer_wheel_t *tw, timer_fn_t fn, void *arg) {
+    uint64_t now = tw->now;
+    for (unsigned level = 1; level < TIMER_LEVELS; level++) {
+        unsigned shift = level * TIMER_SLOT_BITS;
+        if ((now & (((uint64_t)1 << shift) - 1)) != 0) break;
+        unsigned slot = (now >> shift) & (TIMER_SLOTS - 1);
+        timer_node_t *node = tw->slots[level][slot];
+        tw->slots[level][slot] = NULL;
+        tw->occupied[level] &= ~((uint64_t)1 << slot);
+        while (node != NULL) {
+            timer_node_t *next = node->next;
+            timer_place(tw, node, node->expires > now ? node->expires : now);
+            node = next;
+        }
+    }
+
+    timer_node_t *node;
+    unsigned slot = now & (TIMER_SLOTS - 1);
+    while ((node = tw->slots[0][slot]) != NULL) {
+        timer_unlink(tw, node);
+        if (node->expires > now) {
+            timer_place(tw, node, node->expires);
+            continue;
+        }
+        tw->count--;
+        fn(node, arg);  // 回调可能重新加入或释放节点
+    }
+}
+
+/**
+ * @brief 逐个处理需要处理的时刻，其间的空格直接跳过。
+ */
+void timer_wheel_advance(timer_wheel_t *tw, uint64_t now, timer_fn_t fn,
+                         void *arg) {
+    while (tw->now < now) {
+        uint64_t next = timer_wheel_next(tw);
+        if (next > now) {
+            tw->now = now;
+            break;
+        }
+        tw->now = next;
+        timer_tick(tw, fn, arg);
+    }
+}
@@ -0,0 +1,949 @@
+#include "../../include/wal.h"  // 包含 wal_t 及 WAL 记录格式
+
+#include <arpa/inet.h>  // For htonl, ntohl, htons, ntohs
+#include <endian.h>     // For htobe64, be64toh
+#include <errno.h>      // For errno, EINTR
+#include <fcntl.h>      // For open, O_RDWR, O_CREAT
+#include <stdio.h>      // For perror, fprintf, snprintf
+#include <stdlib.h>     // For calloc, realloc, free
+#include <string.h>     // For memcpy
+#include <sys/stat.h>   // For fstat
+#include <sys/wait.h>   // For waitpid
+#include <unistd.h>     // For read, write, fdatasync, fork
+
+#include "../../include/checksum.h"  // 包含 crc32c
+#include "../../include/common.h"    // 包含 STATUS_SUCCESS 等宏
+#include "../../include/file.h"      // 包含 fsync_parent_dir, write_all
+#include "../../include/log.h"       // 包含 log_info
+
+/**
+ * @brief 计算整个文件内容的 CRC32C，用于判断检查点快照是否已经生效。
+ * @param path 文件路径
+ * @param crcOut 输出参数，返回校验和
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int crc_file(const char *path, uint32_t *crcOut) {
+    int fd __attribute__((cleanup(_cleanup_fd_))) = open(path, O_RDONLY);
+    if (fd == -1) return STATUS_ERROR;
+
+    char chunk[64 * 1024];
+    uint32_t crc = 0;
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return STATUS_ERROR;
+        }
+        crc = crc32c(crc, chunk, (size_t)n);
+    }
+    *crcOut = crc;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把一条记录编码到 dst（头部 + 负载），并计算校验和。
+ * @param dst 目标缓冲区，至少 sizeof(struct wal_rec_hdr_t) + len 字节
+ * @param type 记录类型
+ * @param lsn 记录的 LSN
+ * @param payload 负载数据，len 为 0 时可以为 NULL
+ * @param len 负载长度
+ * @return 编码后的总字节数。
+ */
+static size_t encode_record(char *dst, wal_rec_type_e type, uint64_t lsn,
+                            const void *payload, uint32_t len) {
+    struct wal_rec_hdr_t rec = {0};
+    rec.len = htonl(len);
+    rec.lsn = htobe64(lsn);
+    rec.type = htons((uint16_t)type);
+
+    memcpy(dst, &rec, sizeof(rec));
+    if (len > 0) memcpy(dst + sizeof(rec), payload, len);
+
+    // 校验和覆盖 crc 字段之后的所有字节
+    uint32_t crc = crc32c(0, dst + sizeof(rec.crc),
+                          sizeof(rec) - sizeof(rec.crc) + len);
+    rec.crc = htonl(crc);
+    memcpy(dst, &rec.crc, sizeof(rec.crc));
+    return sizeof(rec) + len;
+}
+
+/**
+ * @brief 创建（或截断）当前日志段并写入段头部。
+ * @param wal WAL 状态，成功后 wal->fd 指向新段
+ * @param base_lsn 新段第一条记录的 LSN
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int create_segment(wal_t *wal, uint64_t base_lsn) {
+    if (wal->fd != -1) {
+        close(wal->fd);
+        wal->fd = -1;
+    }
+
+    int fd = open(wal->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("open wal segment");
+        return STATUS_ERROR;
+    }
+
+    struct wal_file_hdr_t fhdr = {0};
+    fhdr.magic = htonl(WAL_MAGIC);
+    fhdr.version = htons(WAL_VERSION);
+    fhdr.base_lsn = htobe64(base_lsn);
+    if (write_all(fd, &fhdr, sizeof(fhdr)) != STATUS_SUCCESS ||
+        fdatasync(fd) == -1) {
+        perror("write wal segment header");
+        close(fd);
+        return STATUS_ERROR;
+    }
+    if (fsync_parent_dir(wal->path) != STATUS_SUCCESS) {
+        perror("fsync wal directory");
+        close(fd);
+        return STATUS_ERROR;
+    }
+
+    wal->fd = fd;
+    wal->seg_bytes = sizeof(fhdr);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 重放过程中使用的上下文。
+ */
+typedef struct {
+    uint16_t version;               ///< 期望的日志段格式版本
+    dbmap_t *map;                   ///< 重放的目标映射数据库
+    struct dbheader_t *dbhdr;       ///< 旧版重放的目标数据库头部
+    struct employee_t **employees;  ///< 旧版重放的目标员工数组
+    dbindex_t *index;  ///< 重做时同步维护的二级索引，NULL 表示不维护
+    const char *db_path;            ///< 数据库文件路径，用于计算快照校验和
+    bool have_db_crc;               ///< db_crc 是否已经计算
+    uint32_t db_crc;                ///< 当前数据库文件的 CRC32C
+    uint64_t skip_lsn;  ///< 已包含在数据库文件中的最大 LSN，不再重放
+    uint64_t next_lsn;  ///< 扫描到的下一个可用 LSN
+    size_t applied;     ///< 实际重放的记录数
+} wal_replay_t;
+
+/**
+ * @brief 扫描日志段时对每条有效记录调用的回调
+ */
+typedef int (*wal_visit_fn)(wal_replay_t *rp, uint16_t type, uint64_t lsn,
+                            const char *payload, uint32_t len);
+
+/**
+ * @brief 重做时设置记录数，截掉的有效记录先从索引中移除。
+ */
+static int redo_set_count(wal_replay_t *rp, uint32_t count) {
+    if (rp->index != NULL) {
+        for (size_t slot = count; slot < rp->map->hdr.count; slot++) {
+            if (dbmap_is_live(rp->map, slot)) {
+                dbindex_remove(rp->index, rp->map, slot);
+            }
+        }
+    }
+    return dbmap_set_count(rp->map, count);
+}
+
+/**
+ * @brief 重做一条物理记录。记录只描述结果（槽位内容、记录数），
+ *        在模糊检查点留下的任意中间状态上按顺序重做都能得到正确结果。
+ *        rp->index 不为 NULL 时，被覆盖或删除的记录先从索引中移除，
+ *        写入的有效记录随后加入索引。
+ */
+static int visit_redo(wal_replay_t *rp, uint16_t type, uint64_t lsn,
+                      const char *payload, uint32_t len) {
+    if (lsn + 1 > rp->next_lsn) rp->next_lsn = lsn + 1;
+
+    switch (type) {
+        case WAL_REC_ADD: {
+            if (len != sizeof(struct wal_add_t)) {
+                fprintf(stderr, "Error: WAL ADD record %lu has bad length %u\n",
+                        (unsigned long)lsn, len);
+                return STATUS_ERROR;
+            }
+            struct wal_add_t rec;
+            memcpy(&rec, payload, sizeof(rec));
+            rec.employee.hours = ntohl(rec.employee.hours);
+            uint32_t slot = ntohl(rec.slot);
+            if (rp->index != NULL && dbmap_is_live(rp->map, slot)) {
+                dbindex_remove(rp->index, rp->map, slot);
+            }
+            if (dbmap_put(rp->map, slot, &rec.employee) != STATUS_SUCCESS) {
+                return STATUS_ERROR;
+            }
+            if (rp->index != NULL && dbmap_is_live(rp->map, slot) &&
+                dbindex_insert(rp->index, rp->map, slot) != STATUS_SUCCESS) {
+                return STATUS_ERROR;
+            }
+            rp->applied++;
+            break;
+        }
+        case WAL_REC_DEL: {
+            if (len != sizeof(struct wal_del_t)) {
+                fprintf(stderr, "Error: WAL DEL record %lu has bad length %u\n",
+                        (unsigned long)lsn, len);
+                return STATUS_ERROR;
+            }
+            struct wal_del_t rec;
+            memcpy(&rec, payload, sizeof(rec));
+            uint32_t count = ntohl(rec.count);
+            // 磁盘上的记录数可能来自更晚的检查点，这里直接设置而不是截断
+            if (redo_set_count(rp, count) != STATUS_SUCCESS) {
+                return STATUS_ERROR;
+            }
+            rp->applied++;
+            break;
+        }
+        case WAL_REC_FREE: {
+            if (len != sizeof(struct wal_free_t)) {
+                fprintf(stderr,
+                        "Error: WAL FREE record %lu has bad length %u\n",
+                        (unsigned long)lsn, len);
+                return STATUS_ERROR;
+            }
+            struct wal_free_t rec;
+            memcpy(&rec, payload, sizeof(rec));
+            uint32_t slot = ntohl(rec.slot);
+            if (rp->index != NULL && dbmap_is_live(rp->map, slot)) {
+                dbindex_remove(rp->index, rp->map, slot);
+            }
+            if (dbmap_mark_deleted(rp->map, slot) != STATUS_SUCCESS ||
+                redo_set_count(rp, ntohl(rec.count)) != STATUS_SUCCESS) {
+                return STATUS_ERROR;
+            }
+            rp->applied++;
+            break;
+        }
+        case WAL_REC_BATCH: {
+            // 依次重做每个子记录；整批已经通过外层记录的校验和
+            uint32_t off = 0;
+            while (off < len) {
+                struct wal_sub_hdr_t sub;
+                if (len - off < sizeof(sub)) break;
+                memcpy(&sub, payload + off, sizeof(sub));
+                uint16_t sub_type = ntohs(sub.type);
+                uint16_t sub_len = ntohs(sub.len);
+                off += sizeof(sub);
+                if (len - off < sub_len ||
+                    (sub_type != WAL_REC_ADD && sub_type != WAL_REC_FREE)) {
+                    break;
+                }
+                if (visit_redo(rp, sub_type, lsn, payload + off, sub_len) !=
+                    STATUS_SUCCESS) {
+                    return STATUS_ERROR;
+                }
+                off += sub_len;
+            }
+            if (off != len) {
+                fprintf(stderr, "Error: WAL BATCH record %lu is malformed\n",
+                        (unsigned long)lsn);
+                return STATUS_ERROR;
+            }
+            break;
+        }
+        default: break;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 旧版第一遍扫描：寻找与当前数据库文件匹配的检查点标记。
+ *        匹配说明该标记之前的所有记录都已包含在数据库文件中。
+ */
+static int visit_find_ckpt(wal_replay_t *rp, uint16_t type, uint64_t lsn,
+                           const char *payload, uint32_t len) {
+    if (lsn + 1 > rp->next_lsn) rp->next_lsn = lsn + 1;
+    if (type != WAL_REC_CKPT || len != sizeof(uint32_t)) return STATUS_SUCCESS;
+
+    if (!rp->have_db_crc) {
+        if (crc_file(rp->db_path, &rp->db_crc) != STATUS_SUCCESS) {
+            perror("crc database file");
+            return STATUS_ERROR;
+        }
+        rp->have_db_crc = true;
+    }
+    uint32_t snapshot_crc;
+    memcpy(&snapshot_crc, payload, sizeof(snapshot_crc));
+    if (ntohl(snapshot_crc) == rp->db_crc && lsn > rp->skip_lsn) {
+        rp->skip_lsn = lsn;
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 旧版第二遍扫描：把检查点之后的 ADD/DEL 记录应用到内存中。
+ */
+static int visit_apply(wal_replay_t *rp, uint16_t type, uint64_t lsn,
+                       const char *payload, uint32_t len) {
+    if (lsn <= rp->skip_lsn) return STATUS_SUCCESS;
+
+    switch (type) {
+        case WAL_REC_ADD: {
+            if (len != sizeof(struct employee_t)) {
+                fprintf(stderr, "Error: WAL ADD record %lu has bad length %u\n",
+                        (unsigned long)lsn, len);
+                return STATUS_ERROR;
+            }
+            struct employee_t employee;
+            memcpy(&employee, payload, sizeof(employee));
+            employee.hours = ntohl(employee.hours);
+            if (append_employee(rp->dbhdr, rp->employees, &employee) !=
+                STATUS_SUCCESS) {
+                return STATUS_ERROR;
+            }
+            rp->applied++;
+            break;
+        }
+        case WAL_REC_DEL:
+            if (remove_employee(rp->dbhdr, rp->employees) != STATUS_SUCCESS) {
+                return STATUS_ERROR;
+            }
+            rp->applied++;
+            break;
+        default: break;  // 检查点标记等不需要重放
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 校验 data 开头的一条记录。
+ * @param data 记录的起始位置
+ * @param avail data 之后可用的字节数
+ * @param recOut 输出参数，返回转换为主机字节序的记录头部
+ * @return 记录完整且校验通过时返回它的总长度（头部 + 负载）；
+ *         记录不完整时返回 0；长度字段或校验和错误时返回 -1。
+ */
+static ssize_t check_record(const char *data, size_t avail,
+                            struct wal_rec_hdr_t *recOut) {
+    struct wal_rec_hdr_t rec;
+    if (avail < sizeof(rec)) return 0;
+    memcpy(&rec, data, sizeof(rec));
+    uint32_t len = ntohl(rec.len);
+    if (len > WAL_MAX_PAYLOAD) return -1;
+    if (avail - sizeof(rec) < len) return 0;
+
+    uint32_t crc =
+        crc32c(0, data + sizeof(rec.crc), sizeof(rec) - sizeof(rec.crc) + len);
+    if (crc != ntohl(rec.crc)) return -1;
+
+    recOut->crc = crc;
+    recOut->len = len;
+    recOut->lsn = be64toh(rec.lsn);
+    recOut->type = ntohs(rec.type);
+    recOut->reserved = 0;
+    return (ssize_t)(sizeof(rec) + len);
+}
+
+/**
+ * @brief 顺序扫描一个日志段，对每条校验通过的记录调用 visit。
+ *        遇到第一条不完整或校验失败的记录即停止（视为崩溃时的撕裂写入）。
+ * @param path 日志段路径
+ * @param rp 重放上下文
+ * @param visit 记录回调
+ * @param validEndOut 输出参数，最后一条有效记录结束处的偏移，可以为 NULL
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int scan_segment(const char *path, wal_replay_t *rp, wal_visit_fn visit,
+                        off_t *validEndOut) {
+    int fd __attribute__((cleanup(_cleanup_fd_))) = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror("open wal segment for replay");
+        return STATUS_ERROR;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat wal segment");
+        return STATUS_ERROR;
+    }
+    if (validEndOut) *validEndOut = 0;
+    if ((size_t)st.st_size < sizeof(struct wal_file_hdr_t)) {
+        return STATUS_SUCCESS;  // 段头部都没写完，视为空段
+    }
+
+    char *data __attribute__((cleanup(_cleanup_ptr_))) = malloc(st.st_size);
+    if (data == NULL) {
+        perror("malloc for wal segment");
+        return STATUS_ERROR;
+    }
+    size_t total = 0;
+    while (total < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + total, st.st_size - total);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("read wal segment");
+            return STATUS_ERROR;
+        }
+        total += n;
+    }
+
+    struct wal_file_hdr_t fhdr;
+    memcpy(&fhdr, data, sizeof(fhdr));
+    if (ntohl(fhdr.magic) != WAL_MAGIC || ntohs(fhdr.version) != rp->version) {
+        if (ntohl(fhdr.magic) == WAL_MAGIC &&
+            ntohs(fhdr.version) == WAL_VERSION_LEGACY) {
+            fprintf(stderr,
+                    "Warning: Discarding WAL segment '%s' left over from a "
+                    "format upgrade\n",
+                    path);
+        } else {
+            fprintf(stderr,
+                    "Warning: Ignoring WAL segment '%s' with bad header\n",
+                    path);
+        }
+        return STATUS_SUCCESS;
+    }
+    uint64_t base_lsn = be64toh(fhdr.base_lsn);
+    if (base_lsn > rp->next_lsn) rp->next_lsn = base_lsn;
+
+    size_t off = sizeof(fhdr);
+    for (;;) {
+        struct wal_rec_hdr_t rec;
+        ssize_t size = check_record(data + off, total - off, &rec);
+        if (size <= 0) break;
+        if (visit(rp, rec.type, rec.lsn, data + off + sizeof(rec), rec.len) !=
+            STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        off += (size_t)size;
+    }
+    if (off != total) {
+        fprintf(stderr,
+                "Warning: WAL segment '%s' has a torn tail (%zu of %zu bytes "
+                "valid)\n",
+                path, off, total);
+    }
+    if (validEndOut) *validEndOut = (off_t)off;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 把旧版数据库文件的旧版 WAL 重放到内存中的员工数组上。
+ *        旧版记录是逻辑记录，需要先用检查点标记中的快照校验和找出
+ *        已经包含在数据库文件中的部分，再重放其余记录。
+ */
+int wal_replay_legacy(const char *db_path, struct dbheader_t *dbhdr,
+                      struct employee_t **employees) {
+    char path[PATH_MAX];
+    char old_path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s.wal", db_path) >= (int)sizeof(path) ||
+        snprintf(old_path, sizeof(old_path), "%s.wal.old", db_path) >=
+            (int)sizeof(old_path)) {
+        fprintf(stderr, "Error: Database path too long for WAL: '%s'\n",
+                db_path);
+        return STATUS_ERROR;
+    }
+
+    bool has_old = access(old_path, F_OK) == 0;
+    bool has_active = access(path, F_OK) == 0;
+    wal_replay_t rp = {.version = WAL_VERSION_LEGACY,
+                       .dbhdr = dbhdr,
+                       .employees = employees,
+                       .db_path = db_path,
+                       .next_lsn = 1};
+
+    // 第一遍：找出已经包含在数据库文件中的最大 LSN
+    if (has_old && scan_segment(old_path, &rp, visit_find_ckpt, NULL) !=
+                       STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    if (has_active &&
+        scan_segment(path, &rp, visit_find_ckpt, NULL) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+
+    // 第二遍：重放其余记录
+    if (has_old &&
+        scan_segment(old_path, &rp, visit_apply, NULL) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    if (has_active &&
+        scan_segment(path, &rp, visit_apply, NULL) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+
+    if (rp.applied > 0) {
+        printf("WAL replay: applied %zu legacy records on top of '%s'\n",
+               rp.applied, db_path);
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 打开数据库对应的 WAL，并把日志重放到映射的数据库上。
+ *        恢复顺序为 <db>.wal.old（中断的检查点）然后 <db>.wal。
+ * @param db_path 数据库文件路径
+ * @param newdb 是否为新建数据库
+ * @param map 映射的数据库
+ * @param walOut 输出参数，返回打开的 WAL
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+int wal_open(const char *db_path, bool newdb, dbmap_t *map, wal_t **walOut) {
+    if (db_path == NULL || map == NULL || walOut == NULL) {
+        fprintf(stderr, "Error: Invalid arguments to wal_open\n");
+        return STATUS_ERROR;
+    }
+
+    wal_t *wal __attribute__((cleanup(_cleanup_wal_))) =
+        calloc(1, sizeof(wal_t));
+    if (wal == NULL) {
+        perror("calloc for wal");
+        return STATUS_ERROR;
+    }
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_mutex_init(&wal->commit_lock, NULL);
+    wal->fd = -1;
+    wal->ckpt_pid = -1;
+    wal->next_lsn = 1;
+    wal->map = map;
+    // 预留 ".wal.old" 后缀的空间，路径过长时直接拒绝
+    if (strlen(db_path) + sizeof(".wal.old") > sizeof(wal->path)) {
+        fprintf(stderr, "Error: Database path too long for WAL: '%s'\n",
+                db_path);
+        return STATUS_ERROR;
+    }
+    snprintf(wal->path, sizeof(wal->path), "%s.wal", db_path);
+    snprintf(wal->old_path, sizeof(wal->old_path), "%s.wal.old", db_path);
+
+    bool has_old = access(wal->old_path, F_OK) == 0;
+    bool has_active = access(wal->path, F_OK) == 0;
+    bool need_checkpoint = false;
+
+    if (newdb) {
+        // 新建的数据库不能继承同名旧库残留的日志
+        if (has_old || has_active) {
+            fprintf(stderr, "Warning: Discarding stale WAL for new db '%s'\n",
+                    db_path);
+        }
+        unlink(wal->old_path);
+        has_old = has_active = false;
+    } else if (has_old || has_active) {
+        wal_replay_t rp = {.version = WAL_VERSION, .map = map, .next_lsn = 1};
+        off_t active_end = 0;
+
+        // 物理记录是幂等的，从最老的段开始依次重做即可，不需要检查点标记
+        if (has_old && scan_segment(wal->old_path, &rp, visit_redo, NULL) !=
+                           STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+        if (has_active &&
+            scan_segment(wal->path, &rp, visit_redo, &active_end) !=
+                STATUS_SUCCESS) {
+            return STATUS_ERROR;
+        }
+
+        wal->next_lsn = rp.next_lsn;
+        need_checkpoint = has_old;
+        if (rp.applied > 0) {
+            printf("WAL replay: applied %zu records on top of '%s'\n",
+                   rp.applied, db_path);
+            need_checkpoint = true;
+        }
+        if (has_active) {
+            // 续写当前段并丢弃撕裂的尾部；在检查点生效之前绝不能截断有效记录
+            wal->fd = open(wal->path, O_RDWR);
+            if (wal->fd != -1 && active_end > 0 &&
+                ftruncate(wal->fd, active_end) == 0 &&
+                lseek(wal->fd, 0, SEEK_END) != -1) {
+                wal->seg_bytes = (size_t)active_end;
+            } else if (wal->fd != -1) {
+                close(wal->fd);  // 段头部损坏，没有可用记录，重新创建
+                wal->fd = -1;
+            }
+        }
+    }
+    wal->synced_lsn = wal->next_lsn - 1;
+
+    if (wal->fd == -1 && create_segment(wal, wal->next_lsn) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    if (need_checkpoint && wal_checkpoint_sync(wal) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+
+    *walOut = wal;
+    wal = NULL;  // 清除 cleanup 宏的作用
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 逐条校验并重做连续的记录，同时维护二级索引。
+ */
+int wal_apply_stream(dbmap_t *map, dbindex_t *index, const char *data,
+                     size_t len, size_t *usedOut, uint64_t *lsnOut) {
+    wal_replay_t rp = {
+        .version = WAL_VERSION, .map = map, .index = index, .next_lsn = 1};
+    size_t off = 0;
+    for (;;) {
+        struct wal_rec_hdr_t rec;
+        ssize_t size = check_record(data + off, len - off, &rec);
+        if (size == 0) break;  // 不完整的记录留给下一次
+        if (size < 0) {
+            fprintf(stderr, "Error: Corrupt WAL record in stream at byte %zu\n",
+                    off);
+            *usedOut = off;
+            return STATUS_ERROR;
+        }
+        if (visit_redo(&rp, rec.type, rec.lsn, data + off + sizeof(rec),
+                       rec.len) != STATUS_SUCCESS) {
+            *usedOut = off;
+            return STATUS_ERROR;
+        }
+        *lsnOut = rec.lsn;
+        off += (size_t)size;
+    }
+    *usedOut = off;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 设置组提交之后的回调。
+ */
+void wal_set_commit_hook(wal_t *wal, wal_commit_fn fn, void *arg) {
+    wal->on_commit = fn;
+    wal->on_commit_arg = arg;
+}
+
+/**
+ * @brief 向组提交缓冲区追加一条记录。
+ * @param wal WAL 状态
+ * @param type 记录类型
+ * @param payload 负载数据
+ * @param len 负载长度
+ * @param lsnOut 输出参数，返回该记录的 LSN
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int wal_append(wal_t *wal, wal_rec_type_e type, const void *payload,
+                      uint32_t len, uint64_t *lsnOut) {
+    size_t need = sizeof(struct wal_rec_hdr_t) + len;
+    pthread_mutex_lock(&wal->lock);
+    if (wal->buf_len + need > wal->buf_cap) {
+        // 按几何级数扩容，避免大批量写入时反复 realloc
+        size_t new_cap = wal->buf_cap ? wal->buf_cap * 2 : 4096;
+        while (new_cap < wal->buf_len + need) new_cap *= 2;
+        char *new_buf = realloc(wal->buf, new_cap);
+        if (new_buf == NULL) {
+            perror("realloc for wal buffer");
+            pthread_mutex_unlock(&wal->lock);
+            return STATUS_ERROR;
+        }
+        wal->buf = new_buf;
+        wal->buf_cap = new_cap;
+    }
+
+    uint64_t lsn = wal->next_lsn++;
+    wal->buf_len +=
+        encode_record(wal->buf + wal->buf_len, type, lsn, payload, len);
+    pthread_mutex_unlock(&wal->lock);
+    if (lsnOut) *lsnOut = lsn;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 记录一次写入槽位的操作。
+ */
+int wal_log_add(wal_t *wal, uint32_t slot, const struct employee_t *employee,
+                uint64_t *lsnOut) {
+    struct wal_add_t rec;
+    rec.slot = htonl(slot);
+    rec.employee = *employee;  // 创建副本进行转换
+    rec.employee.hours = htonl(rec.employee.hours);
+    return wal_append(wal, WAL_REC_ADD, &rec, sizeof(rec), lsnOut);
+}
+
+/**
+ * @brief 记录一次截断记录数的操作。
+ */
+int wal_log_del(wal_t *wal, uint32_t count, uint64_t *lsnOut) {
+    struct wal_del_t rec = {.count = htonl(count)};
+    return wal_append(wal, WAL_REC_DEL, &rec, sizeof(rec), lsnOut);
+}
+
+/**
+ * @brief 记录一次删除槽位的操作。
+ */
+int wal_log_free(wal_t *wal, uint32_t slot, uint32_t count, uint64_t *lsnOut) {
+    struct wal_free_t rec = {.slot = htonl(slot), .count = htonl(count)};
+    return wal_append(wal, WAL_REC_FREE, &rec, sizeof(rec), lsnOut);
+}
+
+/**
+ * @brief 编码一个 ADD 子记录。
+ */
+size_t wal_batch_add(char *dst, uint32_t slot,
+                     const struct employee_t *employee) {
+    struct wal_sub_hdr_t sub = {.type = htons(WAL_REC_ADD),
+                                .len = htons(sizeof(struct wal_add_t))};
+    struct wal_add_t rec;
+    rec.slot = htonl(slot);
+    rec.employee = *employee;
+    rec.employee.hours = htonl(rec.employee.hours);
+    memcpy(dst, &sub, sizeof(sub));
+    memcpy(dst + sizeof(sub), &rec, sizeof(rec));
+    return WAL_BATCH_ADD_SIZE;
+}
+
+/**
+ * @brief 编码一个 FREE 子记录。
+ */
+size_t wal_batch_free(char *dst, uint32_t slot, uint32_t count) {
+    struct wal_sub_hdr_t sub = {.type = htons(WAL_REC_FREE),
+                                .len = htons(sizeof(struct wal_free_t))};
+    struct wal_free_t rec = {.slot = htonl(slot), .count = htonl(count)};
+    memcpy(dst, &sub, sizeof(sub));
+    memcpy(dst + sizeof(sub), &rec, sizeof(rec));
+    return WAL_BATCH_FREE_SIZE;
+}
+
+/**
+ * @brief 记录一批原子的修改。
+ */
+int wal_log_batch(wal_t *wal, const char *payload, uint32_t len,
+                  uint64_t *lsnOut) {
+    if (len > WAL_MAX_PAYLOAD) {
+        fprintf(stderr, "Error: WAL batch of %u bytes is too large\n", len);
+        return STATUS_ERROR;
+    }
+    return wal_append(wal, WAL_REC_BATCH, payload, len, lsnOut);
+}
+
+/**
+ * @brief 判断组提交缓冲区中是否有尚未落盘的记录。
+ */
+bool wal_has_pending(wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    bool pending = wal->buf_len > 0;
+    pthread_mutex_unlock(&wal->lock);
+    return pending;
+}
+
+/**
+ * @brief 组提交的实现，调用者必须持有 commit_lock。
+ *        在 lock 保护下把 buf 与 flush_buf 交换，写盘时不持有 lock，
+ *        因此其他线程可以继续追加记录。
+ * @param wal WAL 状态
+ * @return 成功时返回 STATUS_SUCCESS，错误时返回 STATUS_ERROR。
+ */
+static int commit_locked(wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    if (wal->buf_len == 0) {
+        pthread_mutex_unlock(&wal->lock);
+        return STATUS_SUCCESS;
+    }
+    char *data = wal->buf;
+    size_t len = wal->buf_len;
+    size_t cap = wal->buf_cap;
+    uint64_t last_lsn = wal->next_lsn - 1;
+    wal->buf = wal->flush_buf;
+    wal->buf_cap = wal->flush_cap;
+    wal->buf_len = 0;
+    wal->flush_buf = data;
+    wal->flush_cap = cap;
+    pthread_mutex_unlock(&wal->lock);
+
+    if (write_all(wal->fd, data, len) != STATUS_SUCCESS) {
+        perror("write wal records");
+        return STATUS_ERROR;
+    }
+    if (fdatasync(wal->fd) == -1) {
+        perror("fdatasync wal");
+        return STATUS_ERROR;
+    }
+    // 仍持有 commit_lock，回调按 LSN 顺序收到每一批落盘的记录
+    if (wal->on_commit != NULL) {
+        wal->on_commit(wal->on_commit_arg, data, len, last_lsn);
+    }
+
+    pthread_mutex_lock(&wal->lock);
+    wal->seg_bytes += len;
+    wal->synced_lsn = last_lsn;
+    pthread_mutex_unlock(&wal->lock);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 组提交：一次 write 加一次 fdatasync 落盘缓冲区中的所有记录。
+ */
+int wal_commit(wal_t *wal) {
+    pthread_mutex_lock(&wal->commit_lock);
+    int status = commit_locked(wal);
+    pthread_mutex_unlock(&wal->commit_lock);
+    return status;
+}
+
+/**
+ * @brief 获取已经落盘的最大 LSN。
+ */
+uint64_t wal_synced_lsn(wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    uint64_t lsn = wal->synced_lsn;
+    pthread_mutex_unlock(&wal->lock);
+    return lsn;
+}
+
+/**
+ * @brief 判断当前日志段是否需要做后台检查点。
+ */
+bool wal_should_checkpoint(wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    bool should = !wal->ckpt_disabled && wal->ckpt_pid == -1 &&
+                  wal->seg_bytes >= WAL_CHECKPOINT_BYTES;
+    pthread_mutex_unlock(&wal->lock);
+    return should;
+}
+
+/**
+ * @brief 启动后台检查点的实现，调用者必须持有 commit_lock 和 lock。
+ */
+static int checkpoint_start_locked(wal_t *wal) {
+    if (wal->ckpt_pid != -1) return STATUS_SUCCESS;  // 已有检查点在进行
+    if (wal->buf_len > 0) {
+        fprintf(stderr, "Error: Checkpoint requested with uncommitted WAL\n");
+        return STATUS_ERROR;
+    }
+    if (access(wal->old_path, F_OK) == 0) {
+        fprintf(stderr,
+                "Error: Stale '%s' present, background checkpoints disabled "
+                "until the next restart\n",
+                wal->old_path);
+        wal->ckpt_disabled = true;
+        return STATUS_ERROR;
+    }
+
+    // 轮换日志段：.wal -> .wal.old，随后的修改写入新的 .wal
+    uint64_t ckpt_lsn = wal->next_lsn - 1;
+    uint64_t ckpt_count = wal->map->hdr.count;
+    close(wal->fd);
+    wal->fd = -1;
+    if (rename(wal->path, wal->old_path) == -1) {
+        perror("rename wal segment for checkpoint");
+        return STATUS_ERROR;
+    }
+    if (create_segment(wal, wal->next_lsn) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork for checkpoint");
+        wal->ckpt_disabled = true;  // .old 会在下次启动时重放
+        return STATUS_ERROR;
+    }
+    if (pid == 0) {
+        // 子进程：只使用系统调用，结果通过退出码告知父进程。
+        // 映射是共享的，刷盘时父进程可能正在追加记录，它们位于 fork 时刻
+        // 的记录堆末尾之后，由新段中的日志覆盖，只需保证 ckpt_lsn 之前的
+        // 修改已经落盘
+        if (dbmap_sync(wal->map, ckpt_count) != STATUS_SUCCESS) {
+            _exit(1);
+        }
+        if (unlink(wal->old_path) == -1 ||
+            fsync_parent_dir(wal->old_path) != STATUS_SUCCESS) {
+            _exit(2);
+        }
+        _exit(0);
+    }
+
+    wal->ckpt_pid = pid;
+    log_info("Background checkpoint started (pid %d, through LSN %lu)", pid,
+             (unsigned long)ckpt_lsn);
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 启动后台检查点。
+ *        父进程把当前段改名为 <db>.wal.old 并开启新段，子进程把映射的数据页
+ *        刷盘，再把轮换时的记录数写入磁盘头部并刷盘，最后删除 .old。
+ *        不需要重写整个文件；任一步骤崩溃都可由 wal_open 重做日志恢复。
+ */
+int wal_checkpoint_start(wal_t *wal) {
+    // 持有 commit_lock 期间没有线程在写当前段，可以安全地轮换
+    pthread_mutex_lock(&wal->commit_lock);
+    int status = commit_locked(wal);
+    if (status == STATUS_SUCCESS) {
+        pthread_mutex_lock(&wal->lock);
+        status = checkpoint_start_locked(wal);
+        pthread_mutex_unlock(&wal->lock);
+    }
+    pthread_mutex_unlock(&wal->commit_lock);
+    return status;
+}
+
+/**
+ * @brief 等待后台检查点子进程并报告结果。
+ * @param wal WAL 状态
+ * @param options 传给 waitpid 的选项（WNOHANG 或 0）
+ */
+static void reap_checkpoint(wal_t *wal, int options) {
+    if (wal->ckpt_pid == -1) return;
+
+    int status;
+    pid_t ret = waitpid(wal->ckpt_pid, &status, options);
+    if (ret == 0) return;  // 仍在运行
+    if (ret == -1 && errno == EINTR) return;
+
+    if (ret == wal->ckpt_pid && WIFEXITED(status) &&
+        WEXITSTATUS(status) == 0) {
+        log_info("Background checkpoint (pid %d) complete", wal->ckpt_pid);
+    } else {
+        fprintf(stderr,
+                "Error: Background checkpoint (pid %d) failed, status %d\n",
+                wal->ckpt_pid, ret == -1 ? -1 : status);
+        wal->ckpt_disabled = true;
+    }
+    wal->ckpt_pid = -1;
+}
+
+/**
+ * @brief 判断是否有后台检查点子进程在运行。
+ */
+bool wal_checkpoint_running(wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    bool running = wal->ckpt_pid != -1;
+    pthread_mutex_unlock(&wal->lock);
+    return running;
+}
+
+/**
+ * @brief 非阻塞地回收后台检查点子进程。
+ */
+void wal_checkpoint_poll(wal_t *wal) {
+    pthread_mutex_lock(&wal->lock);
+    reap_checkpoint(wal, WNOHANG);
+    pthread_mutex_unlock(&wal->lock);
+}
+
+/**
+ * @brief 同步检查点：把映射的数据库连同当前记录数一起刷盘，然后清空所有
+ *        日志段。刷盘之后、清空之前崩溃只会让幂等的记录再重做一遍。
+ */
+int wal_checkpoint_sync(wal_t *wal) {
+    reap_checkpoint(wal, 0);
+
+    if (wal_commit(wal) != STATUS_SUCCESS) return STATUS_ERROR;
+
+    if (dbmap_sync(wal->map, wal->map->hdr.count) != STATUS_SUCCESS) {
+        perror("sync database file");
+        return STATUS_ERROR;
+    }
+
+    // 数据库文件已包含全部记录，可以丢弃所有日志段
+    unlink(wal->old_path);
+    if (create_segment(wal, wal->next_lsn) != STATUS_SUCCESS) {
+        return STATUS_ERROR;
+    }
+    wal->ckpt_disabled = false;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief 关闭 WAL 并释放资源。
+ */
+void wal_close(wal_t *wal) {
+    if (wal == NULL) return;
+    reap_checkpoint(wal, 0);
+    if (wal->fd != -1) close(wal->fd);
+    free(wal->buf);
+    free(wal->flush_buf);
+    pthread_mutex_destroy(&wal->lock);
+    pthread_mutex_destroy(&wal->commit_lock);
+    free(wal);
+}
@@ -1,8 +1,12 @@
 #ifndef HTTP_SERVER_H
 #define HTTP_SERVER_H
 
+#include "static_cache.h"
 #include "storage.h"
 
-void http_server_start(Storage *store, int port);
+// threads 个线程各自运行一个事件循环，store 和 assets 由它们共享；
+// assets 中的文件优先于 API 路由，只响应 GET 和 HEAD，其他方法返回 405
+void http_server_start(Storage *store, const StaticCache *assets, int port,
+                       int threads);
 
 #endif
\ No newline at end of file
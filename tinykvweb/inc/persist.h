@@ -0,0 +1,24 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "storage.h"
+
+typedef enum { FSYNC_ALWAYS, FSYNC_EVERYSEC, FSYNC_NO } FsyncPolicy;
+
+typedef struct Persist Persist;
+
+// 从 dir 中的快照和追加日志（AOF）恢复 storage，之后的每次修改都追加到
+// AOF。后台线程按策略落盘，并在 AOF 变大后把数据重写成新的快照。
+// 数据无法恢复时返回 NULL
+Persist *persist_open(Storage *storage, const char *dir, FsyncPolicy policy);
+
+// 停止后台线程，落盘并关闭 AOF；storage 之后不再被记录
+void persist_close(Persist *persist);
+
+// 立即重写快照并截短 AOF，成功返回 0
+int persist_rewrite(Persist *persist);
+
+// "always"、"everysec" 或 "no"，成功返回 0
+int persist_parse_fsync(const char *name, FsyncPolicy *policy);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef STATIC_CACHE_H
+#define STATIC_CACHE_H
+
+#include <stddef.h>
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t head_len;  // 头部的长度，HEAD 请求只发送这一部分
+} StaticBlob;
+
+// 响应都按 [0] keep-alive、[1] close 两种 Connection 预先生成
+typedef struct {
+    char *path;  // URL 路径，如 "/app.js"
+    size_t path_len;
+    char etag[48];
+    char last_modified[32];
+    StaticBlob ok[2];            // 小文件包含响应体，大文件只有头部
+    StaticBlob not_modified[2];  // 304
+    int fd;                      // 大文件用 sendfile 从这里发送，否则为 -1
+    size_t size;
+} StaticFile;
+
+typedef struct StaticCache StaticCache;
+
+// 启动时读入 root 目录下的所有文件（不含以 '.' 开头的），之后只读，
+// 可以被多个线程同时使用。文件改动后需要重启才能生效。
+// root 无法打开时得到一个空的缓存，内存不足返回 NULL
+StaticCache *static_cache_load(const char *root);
+
+void static_cache_free(StaticCache *cache);
+
+// path 中 '?' 之后的部分被忽略，"/" 对应 "/index.html"；找不到返回 NULL
+const StaticFile *static_cache_find(const StaticCache *cache,
+                                    const char *path);
+
+size_t static_cache_count(const StaticCache *cache);
+
+#endif
@@ -1,14 +1,58 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
+#include <stddef.h>
+
 typedef struct Storage Storage;
 
 Storage *storage_create();
 
+// 键空间分成 nshards 个分片，各有一把读写锁，所有接口都可以多线程调用
+Storage *storage_create_sharded(size_t nshards);
+
 void storage_free(Storage *storage);
 
+// 修改已经生效，但日志钩子（见 storage_set_log）返回了失败：内存中的
+// 数据已经改变，只是没有持久化。storage_set 和 storage_del 都用它报告
+#define STORAGE_NOT_LOGGED (-2)
+
+// 键和值都是任意长度的字符串；成功返回 0，内存不足返回 -1，
+// 已写入但写日志失败返回 STORAGE_NOT_LOGGED
 int storage_set(Storage *storage, const char *key, const char *value);
 
-const char *storage_get(Storage *storage, const char *key);
+// 在分片锁内把值拷贝到 buf（超长时截断，总是以 '\0' 结尾），
+// 返回值的完整长度，键不存在返回 -1
+long storage_get_copy(Storage *storage, const char *key, char *buf,
+                      size_t buf_len);
+
+// 删除成功返回 0，键不存在返回 -1，
+// 已删除但写日志失败返回 STORAGE_NOT_LOGGED
+int storage_del(Storage *storage, const char *key);
+
+size_t storage_count(Storage *storage);
+
+typedef enum { STORAGE_OP_SET = 1, STORAGE_OP_DEL = 2 } StorageOp;
+
+// 每次成功的修改都在持有该键所在分片的写锁时调用，同一个键的修改
+// 按执行顺序到达；返回非 0 时 storage_set/storage_del 返回
+// STORAGE_NOT_LOGGED
+typedef int (*StorageLogFn)(void *arg, StorageOp op, const char *key,
+                            size_t key_len, const char *value,
+                            size_t value_len);
+
+void storage_set_log(Storage *storage, StorageLogFn log, void *arg);
+
+typedef int (*StorageVisitFn)(void *arg, const char *key, size_t key_len,
+                              const char *value, size_t value_len);
+
+// 逐个分片（持有读锁）访问所有键值，visit 返回非 0 时停止并返回 -1
+int storage_foreach(Storage *storage, StorageVisitFn visit, void *arg);
+
+size_t storage_shard_count(Storage *storage);
+
+// 只访问第 shard 个分片，其余同 storage_foreach。visit 运行期间这个分片
+// 上的写操作都在等待，耗时的工作应该在返回之后再做
+int storage_foreach_shard(Storage *storage, size_t shard,
+                          StorageVisitFn visit, void *arg);
 
-#endif
\ No newline at end of file
+#endif
@@ -3,27 +3,42 @@
 #include <stdio.h>
 #include <string.h>
 
+// 内存中已经修改，但没有写入 AOF，重启后会丢失
+static void not_logged(ExecutionResult *result) {
+    snprintf(result->message, sizeof(result->message),
+             "{\"error\":\"applied but not persisted\"}");
+    result->code = -1;
+}
+
 ExecutionResult engine_execute(Storage *storage, const KvCommand *cmd) {
     ExecutionResult result = {0};
 
     switch (cmd->type) {
-        case CMD_SET:
-            if (storage_set(storage, cmd->key, cmd->value) == 0) {
+        case CMD_SET: {
+            int ret = storage_set(storage, cmd->key, cmd->value);
+            if (ret == 0) {
                 snprintf(result.message, sizeof(result.message),
                          "{\"status\":\"ok\"}");
                 result.code = 0;
+            } else if (ret == STORAGE_NOT_LOGGED) {
+                not_logged(&result);
             } else {
                 snprintf(result.message, sizeof(result.message),
                          "{\"error\":\"set failed\"}");
                 result.code = -1;
             }
             break;
+        }
         case CMD_GET: {
-            const char *raw_val = storage_get(storage, cmd->key);
-            if (raw_val) {
+            // 拷贝出值再释放分片锁，其他线程可能同时修改这个键；
+            // 能放进 {"value":"..."} 的值最长 sizeof(message) - 13
+            char raw_val[sizeof(result.message) - 12];
+            long len = storage_get_copy(storage, cmd->key, raw_val,
+                                        sizeof(raw_val));
+            if (len >= 0) {
                 size_t json_prefix_len = strlen("{\"value\":\"");
                 size_t json_suffix_len = strlen("\"}");
-                size_t val_len = strlen(raw_val);
+                size_t val_len = (size_t)len;
 
                 if (json_prefix_len + val_len + json_suffix_len <
                     sizeof(result.message)) {
@@ -42,6 +57,21 @@ ExecutionResult engine_execute(Storage *storage, const KvCommand *cmd) {
             }
             break;
         }
+        case CMD_DEL: {
+            int ret = storage_del(storage, cmd->key);
+            if (ret == 0) {
+                snprintf(result.message, sizeof(result.message),
+                         "{\"status\":\"ok\"}");
+                result.code = 0;
+            } else if (ret == STORAGE_NOT_LOGGED) {
+                not_logged(&result);
+            } else {
+                snprintf(result.message, sizeof(result.message),
+                         "{\"error\":\"not found\"}");
+                result.code = -1;
+            }
+            break;
+        }
         default:
             snprintf(result.message, sizeof(result.message),
                      "{\"error\":\"unknown command\"}");
@@ -1,86 +1,490 @@
+#define _GNU_SOURCE  // memmem, accept4, MSG_MORE
+
 #include "../inc/http_server.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include "../inc/api_handler.h"
+#include "../inc/static_cache.h"
+
+#define READ_CHUNK 16384
+#define MAX_HEADER_SIZE 8192
+#define MAX_BODY_SIZE (1024 * 1024)
+#define MAX_PATH_SIZE 1024
+#define RESPONSE_SIZE 4096  // handle_api_request 的输出缓冲区
+#define MAX_EVENTS 256
+
+// 待发送的响应超过这个量时暂停处理流水线中后续的请求，等对端读走
+#define OUT_HIGH_WATER (256 * 1024)
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+typedef struct {
+    int fd;
+    Buffer in;
+    size_t in_pos;  // 已处理的请求字节数
+    Buffer out;
+    size_t out_pos;  // 已发送的响应字节数
+    // out 发完之后用 sendfile 发送的文件，没有时为 NULL
+    const StaticFile *file;
+    off_t file_pos;
+    bool closing;      // 响应发完后关闭连接
+    uint32_t watched;  // 当前注册的 epoll 事件
+} Conn;
+
+typedef enum { METHOD_GET, METHOD_HEAD, METHOD_OTHER } HttpMethod;
+
+typedef struct {
+    HttpMethod method;
+    char path[MAX_PATH_SIZE];
+    bool keep_alive;
+    size_t header_len;
+    size_t body_len;
+    // 条件请求的头部，指向输入缓冲区，没有时为 NULL
+    const char *if_none_match;
+    size_t if_none_match_len;
+    const char *if_modified_since;
+    size_t if_modified_since_len;
+} HttpRequest;
+
+typedef struct {
+    Storage *store;
+    const StaticCache *assets;
+    int server_sock;
+    pthread_t thread;
+} Worker;
+
+static int buffer_reserve(Buffer *b, size_t extra) {
+    if (b->cap - b->len >= extra) return 0;
+    size_t cap = b->cap ? b->cap * 2 : READ_CHUNK;
+    while (cap - b->len < extra) cap *= 2;
+    char *data = realloc(b->data, cap);
+    if (!data) return -1;
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+static int buffer_append(Buffer *b, const char *data, size_t len) {
+    if (buffer_reserve(b, len) != 0) return -1;
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 0;
+}
+
+static const char *status_reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 414: return "URI Too Long";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 505: return "HTTP Version Not Supported";
+        case 507: return "Insufficient Storage";
+        default: return "Unknown";
+    }
+}
+
+// headers 是若干个以 \r\n 结尾的头部行，
+// Content-Length 和 Connection 由这里生成
+static void queue_response(Conn *c, int status, const char *reason,
+                           const char *headers, const char *body,
+                           size_t body_len) {
+    char head[1024];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\n"
+                     "%s"
+                     "Content-Length: %zu\r\n"
+                     "Connection: %s\r\n"
+                     "\r\n",
+                     status, reason, headers, body_len,
+                     c->closing ? "close" : "keep-alive");
+    if (n < 0 || (size_t)n >= sizeof(head) ||
+        buffer_append(&c->out, head, (size_t)n) != 0 ||
+        buffer_append(&c->out, body, body_len) != 0) {
+        c->closing = true;  // 内存不足，发出已有的响应后关闭
+    }
+}
+
+static void queue_error(Conn *c, int status) {
+    char body[128];
+    int n = snprintf(body, sizeof(body), "{\"error\":\"%s\"}\n",
+                     status_reason(status));
+    c->closing = true;
+    queue_response(c, status, status_reason(status),
+                   "Content-Type: application/json\r\n", body, (size_t)n);
+}
+
+// 处理函数返回的完整响应（错误页等）：取出状态行和其余头部，
+// 按 HTTP/1.1 重新组装，长度以实际的响应体为准
+static void queue_full_response(Conn *c, const char *msg) {
+    int status = 500;
+    const char *line_end = strstr(msg, "\r\n");
+    const char *code = strchr(msg, ' ');
+    if (!line_end || !code || code > line_end ||
+        sscanf(code, " %3d", &status) != 1) {
+        queue_error(c, 500);
+        return;
+    }
+    char reason[64];
+    const char *r = code + 1;
+    while (r < line_end && *r != ' ') r++;
+    if (r < line_end) r++;
+    snprintf(reason, sizeof(reason), "%.*s", (int)(line_end - r), r);
+
+    char headers[1024] = {0};
+    size_t headers_len = 0;
+    const char *header_end = strstr(msg, "\r\n\r\n");
+    const char *body = header_end ? header_end + 4 : line_end + 2;
+    const char *headers_end = header_end ? header_end + 2 : line_end + 2;
+    for (const char *line = line_end + 2; line < headers_end;) {
+        const char *next = strstr(line, "\r\n") + 2;
+        size_t len = (size_t)(next - line);
+        if (strncasecmp(line, "Content-Length:", 15) != 0 &&
+            strncasecmp(line, "Connection:", 11) != 0 &&
+            headers_len + len < sizeof(headers)) {
+            memcpy(headers + headers_len, line, len);
+            headers_len += len;
+        }
+        line = next;
+    }
+    queue_response(c, status, reason, headers, body, strlen(body));
+}
+
+static bool token_eq(const char *s, size_t len, const char *token) {
+    return strlen(token) == len && strncasecmp(s, token, len) == 0;
+}
+
+// 解析 data 开头的一个请求。返回 1 表示请求完整，0 表示还需要更多数据，
+// -1 表示请求无效，*status 为应答的错误码
+static int parse_request(const char *data, size_t len, HttpRequest *req,
+                         int *status) {
+    size_t scan = len < MAX_HEADER_SIZE ? len : MAX_HEADER_SIZE;
+    const char *end = memmem(data, scan, "\r\n\r\n", 4);
+    if (!end) {
+        *status = 431;
+        return len >= MAX_HEADER_SIZE ? -1 : 0;
+    }
+    req->header_len = (size_t)(end - data) + 4;
+
+    // 请求行：方法 路径 版本
+    *status = 400;
+    const char *line_end = memmem(data, req->header_len, "\r\n", 2);
+    const char *sp1 = memchr(data, ' ', (size_t)(line_end - data));
+    if (!sp1 || sp1 == data) return -1;
+    // 方法区分大小写
+    size_t method_len = (size_t)(sp1 - data);
+    if (method_len == 3 && memcmp(data, "GET", 3) == 0)
+        req->method = METHOD_GET;
+    else if (method_len == 4 && memcmp(data, "HEAD", 4) == 0)
+        req->method = METHOD_HEAD;
+    else
+        req->method = METHOD_OTHER;
+    const char *path = sp1 + 1;
+    const char *sp2 = memchr(path, ' ', (size_t)(line_end - path));
+    if (!sp2 || sp2 == path) return -1;
+    if ((size_t)(sp2 - path) >= sizeof(req->path)) {
+        *status = 414;
+        return -1;
+    }
+    memcpy(req->path, path, (size_t)(sp2 - path));
+    req->path[sp2 - path] = '\0';
+
+    const char *version = sp2 + 1;
+    size_t version_len = (size_t)(line_end - version);
+    if (token_eq(version, version_len, "HTTP/1.1")) {
+        req->keep_alive = true;
+    } else if (token_eq(version, version_len, "HTTP/1.0")) {
+        req->keep_alive = false;
+    } else {
+        *status = 505;
+        return -1;
+    }
+
+    req->body_len = 0;
+    req->if_none_match = req->if_modified_since = NULL;
+    for (const char *line = line_end + 2; line < end + 2;) {
+        const char *next = memmem(line, (size_t)(end + 2 - line), "\r\n",
+                                  2);
+        const char *colon = memchr(line, ':', (size_t)(next - line));
+        if (!colon) return -1;
+        const char *value = colon + 1;
+        while (value < next && (*value == ' ' || *value == '\t')) value++;
+        size_t name_len = (size_t)(colon - line);
+        size_t value_len = (size_t)(next - value);
+        while (value_len > 0 && (value[value_len - 1] == ' ' ||
+                                 value[value_len - 1] == '\t'))
+            value_len--;
 
-#define BUFFER_SIZE 2048
+        if (token_eq(line, name_len, "Content-Length")) {
+            char *num_end;
+            if (value_len == 0 || *value < '0' || *value > '9') return -1;
+            unsigned long long n = strtoull(value, &num_end, 10);
+            if (num_end != value + value_len) return -1;
+            if (n > MAX_BODY_SIZE) {
+                *status = 413;
+                return -1;
+            }
+            req->body_len = (size_t)n;
+        } else if (token_eq(line, name_len, "Transfer-Encoding")) {
+            *status = 501;  // 不支持分块传输
+            return -1;
+        } else if (token_eq(line, name_len, "Connection")) {
+            if (token_eq(value, value_len, "close"))
+                req->keep_alive = false;
+            else if (token_eq(value, value_len, "keep-alive"))
+                req->keep_alive = true;
+        } else if (token_eq(line, name_len, "If-None-Match")) {
+            req->if_none_match = value;
+            req->if_none_match_len = value_len;
+        } else if (token_eq(line, name_len, "If-Modified-Since")) {
+            req->if_modified_since = value;
+            req->if_modified_since_len = value_len;
+        }
+        line = next + 2;
+    }
+    return len - req->header_len >= req->body_len ? 1 : 0;
+}
 
-void handle_client(int client_sock, Storage *store) {
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_read;
+// If-None-Match 优先；If-Modified-Since 和 nginx 默认一样要求完全相同
+static bool not_modified(const StaticFile *f, const HttpRequest *req) {
+    if (req->if_none_match) {
+        if (token_eq(req->if_none_match, req->if_none_match_len, "*"))
+            return true;
+        return memmem(req->if_none_match, req->if_none_match_len, f->etag,
+                      strlen(f->etag)) != NULL;
+    }
+    return req->if_modified_since &&
+           token_eq(req->if_modified_since, req->if_modified_since_len,
+                    f->last_modified);
+}
 
-    bytes_read = read(client_sock, buffer, sizeof(buffer) - 1);
-    if (bytes_read <= 0) {
-        perror("read");
-        close(client_sock);
+// 头部和小文件都是预先生成好的，只需一次拷贝；
+// 大文件在 conn_flush 中用 sendfile 发送。HEAD 只发送头部，
+// 多发的响应体会被对端当成下一个响应的开头
+static void queue_static(Conn *c, const StaticFile *f,
+                         const HttpRequest *req) {
+    if (!req->keep_alive) c->closing = true;
+    if (req->method != METHOD_GET && req->method != METHOD_HEAD) {
+        static const char body[] = "{\"error\":\"Method Not Allowed\"}\n";
+        queue_response(c, 405, status_reason(405),
+                       "Allow: GET, HEAD\r\n"
+                       "Content-Type: application/json\r\n",
+                       body, sizeof(body) - 1);
         return;
     }
-    buffer[bytes_read] = '\0';
-
-    char method[8], path[128];
-    if (sscanf(buffer, "%7s %63s", method, path) != 2) {
-        const char *msg = "{\"error\":\"Malformed request line\"}";
-        char response[BUFFER_SIZE];
-        snprintf(response, sizeof(response),
-                 "HTTP/1.0 400 Bad Request\r\n"
-                 "Content-Type: application/json\r\n"
-                 "Content-Length: %zu\r\n"
-                 "\r\n"
-                 "%s",
-                 strlen(msg), msg);
-        write(client_sock, response, strlen(response));
-        close(client_sock);
+    int which = c->closing ? 1 : 0;
+    const StaticBlob *b =
+        not_modified(f, req) ? &f->not_modified[which] : &f->ok[which];
+    bool head = req->method == METHOD_HEAD;
+    if (buffer_append(&c->out, b->data, head ? b->head_len : b->len) != 0) {
+        c->closing = true;
         return;
     }
+    if (!head && b == &f->ok[which] && f->fd >= 0) {
+        c->file = f;
+        c->file_pos = 0;
+    }
+}
 
-    char *body_pos = strstr(buffer, "\r\n\r\n");
-    const char *body = body_pos ? body_pos + 4 : "";
+static void handle_request(Conn *c, const Worker *w, const HttpRequest *req,
+                           char *body) {
+    const StaticFile *f = static_cache_find(w->assets, req->path);
+    if (f) {
+        queue_static(c, f, req);
+        return;
+    }
 
-    char msg[BUFFER_SIZE * 2];
-    memset(msg, 0, sizeof(msg));
+    // 处理函数需要以 '\0' 结尾的请求体，临时占用请求体之后的一个字节
+    char saved = body[req->body_len];
+    body[req->body_len] = '\0';
+    char msg[RESPONSE_SIZE];
+    msg[0] = '\0';
+    handle_api_request(w->store, req->path, body, msg, sizeof(msg));
+    body[req->body_len] = saved;
 
-    int is_full_http_resonse = 0;
-    handle_api_request(store, path, body, msg, sizeof(msg));
+    if (!req->keep_alive) c->closing = true;
+    if (strncmp(msg, "HTTP/", 5) == 0)
+        queue_full_response(c, msg);
+    else
+        queue_response(c, 200, "OK", "Content-Type: application/json\r\n",
+                       msg, strlen(msg));
+}
 
-    if (strncmp(msg, "HTTP/", 5) == 0) is_full_http_resonse = 1;
+// 依次处理缓冲区中所有完整的请求（流水线）。因为待发送的响应太多
+// 或者有文件要发送而停下时返回 true
+static bool conn_process(Conn *c, const Worker *w) {
+    while (!c->closing) {
+        if (c->file || c->out.len - c->out_pos >= OUT_HIGH_WATER)
+            return true;
+        HttpRequest req;
+        int status;
+        int r = parse_request(c->in.data + c->in_pos, c->in.len - c->in_pos,
+                              &req, &status);
+        if (r == 0) break;
+        if (r < 0) {
+            queue_error(c, status);
+            break;
+        }
+        handle_request(c, w, &req,
+                       c->in.data + c->in_pos + req.header_len);
+        c->in_pos += req.header_len + req.body_len;
+    }
+    // 未处理完的部分移到缓冲区开头
+    if (c->in_pos > 0) {
+        memmove(c->in.data, c->in.data + c->in_pos, c->in.len - c->in_pos);
+        c->in.len -= c->in_pos;
+        c->in_pos = 0;
+    }
+    return false;
+}
+
+// 返回 1 表示全部发出，0 表示内核缓冲区已满，-1 表示连接出错
+static int conn_flush(Conn *c) {
+    // 后面还有文件时让头部和文件内容合并成完整的报文段
+    int flags = MSG_NOSIGNAL | (c->file ? MSG_MORE : 0);
+    while (c->out_pos < c->out.len) {
+        ssize_t n = send(c->fd, c->out.data + c->out_pos,
+                         c->out.len - c->out_pos, flags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        c->out_pos += (size_t)n;
+    }
+    c->out.len = 0;
+    c->out_pos = 0;
+
+    while (c->file) {
+        size_t left = c->file->size - (size_t)c->file_pos;
+        ssize_t n = sendfile(c->fd, c->file->fd, &c->file_pos, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            // 对端关闭或重置连接是正常的关闭，其他错误来自文件本身
+            if (errno != EPIPE && errno != ECONNRESET) perror("sendfile");
+            return -1;
+        }
+        if (n == 0) return -1;  // 文件在启动后被截短，长度已经对不上
+        if ((size_t)n == left) c->file = NULL;
+    }
+    return 1;
+}
+
+static void conn_close(int epfd, Conn *c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in.data);
+    free(c->out.data);
+    free(c);
+}
+
+static void conn_watch(int epfd, Conn *c, uint32_t events) {
+    if (c->watched == events) return;
+    struct epoll_event ev = {.events = events, .data.ptr = c};
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->watched = events;
+}
+
+// 处理请求并发送响应。有响应没发完时只关注可写事件，
+// 不再读取新的请求，对端不读响应时不会无限堆积
+static void conn_run(int epfd, Conn *c, const Worker *w) {
+    bool more;
+    int r;
+    do {
+        more = conn_process(c, w);
+        r = conn_flush(c);
+    } while (more && r == 1);
+
+    if (r < 0 || (r == 1 && c->closing)) {
+        conn_close(epfd, c);
+        return;
+    }
+    conn_watch(epfd, c, r == 0 ? EPOLLOUT : EPOLLIN);
+}
 
-    if (is_full_http_resonse)
-        write(client_sock, msg, strlen(msg));
-    else {
-        char response[BUFFER_SIZE * 2];
-        snprintf(response, sizeof(response),
-                 "HTTP/1.0 200 OK\r\n"
-                 "Content-Type: application/json\r\n"
-                 "Content-Length: %zu\r\n"
-                 "\r\n"
-                 "%s",
-                 strlen(msg), msg);
-        write(client_sock, response, strlen(response));
+static void conn_read(int epfd, Conn *c, const Worker *w) {
+    // 多留一个字节给 handle_request 放 '\0'
+    if (buffer_reserve(&c->in, READ_CHUNK + 1) != 0) {
+        conn_close(epfd, c);
+        return;
+    }
+    ssize_t n = recv(c->fd, c->in.data + c->in.len,
+                     c->in.cap - c->in.len - 1, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return;
+    if (n <= 0) {
+        conn_close(epfd, c);
+        return;
     }
-    close(client_sock);
+    c->in.len += (size_t)n;
+    conn_run(epfd, c, w);
 }
 
-void http_server_start(Storage *store, int port) {
-    int server_sock, client_sock;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
+static void accept_clients(int epfd, int server_sock) {
+    for (;;) {
+        int fd =
+            accept4(server_sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
 
-    server_sock = socket(AF_INET, SOCK_STREAM, 0);
+        Conn *c = calloc(1, sizeof(Conn));
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+        if (!c || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl");
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->watched = EPOLLIN;
+    }
+}
+
+// 每个工作线程有自己的监听套接字（SO_REUSEPORT），
+// 由内核把新连接分给各个线程，线程之间不共享连接
+static int create_listener(int port) {
+    int server_sock;
+    struct sockaddr_in server_addr;
+
+    server_sock =
+        socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (server_sock < 0) {
         perror("socket");
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     int reuse = 1;
     setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(server_sock, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
 
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
@@ -91,26 +495,79 @@ void http_server_start(Storage *store, int port) {
              sizeof(server_addr)) < 0) {
         perror("bind");
         close(server_sock);
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
-    if (listen(server_sock, 5) < 0) {
+    if (listen(server_sock, SOMAXCONN) < 0) {
         perror("listen");
         close(server_sock);
-        exit(EXIT_FAILURE);
+        return -1;
     }
+    return server_sock;
+}
 
-    printf("HTTP server started on port %d...\n", port);
+static void *worker_loop(void *arg) {
+    Worker *w = arg;
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, w->server_sock, &ev) < 0) {
+        perror("epoll");
+        exit(EXIT_FAILURE);
+    }
 
+    struct epoll_event events[MAX_EVENTS];
     while (true) {
-        client_sock =
-            accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
-        if (client_sock < 0) {
-            perror("accept");
-            continue;
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
         }
+        for (int i = 0; i < n; ++i) {
+            Conn *c = events[i].data.ptr;
+            if (!c)
+                accept_clients(epfd, w->server_sock);
+            else if (events[i].events & EPOLLOUT)
+                conn_run(epfd, c, w);
+            else
+                conn_read(epfd, c, w);
+        }
+    }
+    close(epfd);
+    return NULL;
+}
 
-        handle_client(client_sock, store);
+void http_server_start(Storage *store, const StaticCache *assets, int port,
+                       int threads) {
+    if (threads < 1) threads = 1;
+    // sendfile 没有 MSG_NOSIGNAL，忽略 SIGPIPE，对端关闭时改为返回 EPIPE
+    signal(SIGPIPE, SIG_IGN);
+    Worker *workers = calloc((size_t)threads, sizeof(Worker));
+    if (!workers) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    // 先建好所有监听套接字，端口被占用时在启动任何线程之前退出
+    for (int i = 0; i < threads; ++i) {
+        workers[i].store = store;
+        workers[i].assets = assets;
+        workers[i].server_sock = create_listener(port);
+        if (workers[i].server_sock < 0) exit(EXIT_FAILURE);
     }
-    close(server_sock);
-}
\ No newline at end of file
+
+    printf("HTTP server started on port %d with %d thread%s...\n", port,
+           threads, threads > 1 ? "s" : "");
+
+    for (int i = 1; i < threads; ++i) {
+        if (pthread_create(&workers[i].thread, NULL, worker_loop,
+                           &workers[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    worker_loop(&workers[0]);  // 主线程是第 0 个工作线程
+
+    for (int i = 1; i < threads; ++i) pthread_join(workers[i].thread, NULL);
+    for (int i = 0; i < threads; ++i) close(workers[i].server_sock);
+    free(workers);
+}
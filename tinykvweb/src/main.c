@@ -1,3 +1,5 @@
+#include <getopt.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,14 +7,41 @@
 #include "../inc/engine.h"
 #include "../inc/http_server.h"
 #include "../inc/parser.h"
+#include "../inc/persist.h"
+#include "../inc/static_cache.h"
 #include "../inc/storage.h"
 
-int run_cli_mode() {
-    Storage *store = storage_create();
+typedef struct {
+    int threads;
+    bool persist;
+    const char *dir;
+    FsyncPolicy fsync;
+    const char *web_root;
+} Config;
+
+// 创建存储并从数据目录恢复，persist 为 NULL 表示不持久化
+static Storage *open_store(const Config *cfg, size_t nshards,
+                           Persist **persist) {
+    Storage *store = storage_create_sharded(nshards);
     if (!store) {
         perror("Failed to create storage");
-        return -1;
+        return NULL;
     }
+    *persist = NULL;
+    if (cfg->persist) {
+        *persist = persist_open(store, cfg->dir, cfg->fsync);
+        if (!*persist) {
+            storage_free(store);
+            return NULL;
+        }
+    }
+    return store;
+}
+
+int run_cli_mode(const Config *cfg) {
+    Persist *persist;
+    Storage *store = open_store(cfg, 1, &persist);
+    if (!store) return -1;
 
     char input[512];
     KvCommand cmd;
@@ -26,34 +55,106 @@ int run_cli_mode() {
             printf("Invalid command.\n");
         printf("Tinykvweb > ");
     }
+    persist_close(persist);
     storage_free(store);
     return 0;
 }
 
-int run_http_mode() {
-    Storage *store = storage_create();
-    if (!store) {
-        perror("Failed to create storage");
+int run_http_mode(const Config *cfg) {
+    // 每个线程对应一个分片
+    Persist *persist;
+    Storage *store = open_store(cfg, (size_t)cfg->threads, &persist);
+    if (!store) return -1;
+
+    StaticCache *assets = static_cache_load(cfg->web_root);
+    if (!assets) {
+        perror("Failed to load static files");
+        persist_close(persist);
+        storage_free(store);
         return -1;
     }
+    printf("Serving %zu static files from %s\n",
+           static_cache_count(assets), cfg->web_root);
 
-    http_server_start(store, 18080);
+    http_server_start(store, assets, 18080, cfg->threads);
+    static_cache_free(assets);
+    persist_close(persist);
     storage_free(store);
     return 0;
 }
 
-int main() {
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--threads N] [--dir DIR] "
+            "[--appendfsync always|everysec|no] [--no-persist] "
+            "[--web DIR]\n",
+            prog);
+    fprintf(stderr, "\t--threads N  event loop threads in HTTP mode "
+                    "(default 1)\n");
+    fprintf(stderr, "\t--dir DIR  directory for tinykv.snap and tinykv.aof "
+                    "(default .)\n");
+    fprintf(stderr, "\t--appendfsync POLICY  when to fsync the append-only "
+                    "file (default everysec)\n");
+    fprintf(stderr, "\t--no-persist  keep data in memory only\n");
+    fprintf(stderr, "\t--web DIR  static files served in HTTP mode "
+                    "(default web)\n");
+}
+
+int main(int argc, char *argv[]) {
+    Config cfg = {
+        .threads = 1,
+        .persist = true,
+        .dir = ".",
+        .fsync = FSYNC_EVERYSEC,
+        .web_root = "web",
+    };
+    static const struct option options[] = {
+        {"threads", required_argument, NULL, 't'},
+        {"dir", required_argument, NULL, 'd'},
+        {"appendfsync", required_argument, NULL, 'f'},
+        {"no-persist", no_argument, NULL, 'n'},
+        {"web", required_argument, NULL, 'w'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:d:f:nw:", options, NULL)) !=
+           -1) {
+        if (opt == 't') {
+            char *end;
+            long n = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || n < 1 || n > 1024) {
+                fprintf(stderr, "Invalid thread count: %s\n", optarg);
+                return -1;
+            }
+            cfg.threads = (int)n;
+        } else if (opt == 'd') {
+            cfg.dir = optarg;
+        } else if (opt == 'f') {
+            if (persist_parse_fsync(optarg, &cfg.fsync) != 0) {
+                fprintf(stderr, "Invalid fsync policy: %s\n", optarg);
+                return -1;
+            }
+        } else if (opt == 'n') {
+            cfg.persist = false;
+        } else if (opt == 'w') {
+            cfg.web_root = optarg;
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
     int mode;
     printf("Choose mode: 1 for CLI, 2 for HTTP: ");
     scanf("%d", &mode);
     getchar();
 
     if (mode == 1)
-        return run_cli_mode();
+        return run_cli_mode(&cfg);
     else if (mode == 2)
-        return run_http_mode();
+        return run_http_mode(&cfg);
     else {
         printf("Invalid mode selected.\n");
         return -1;
     }
-}
\ No newline at end of file
+}
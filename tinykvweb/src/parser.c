@@ -10,6 +10,9 @@ int parse_input(const char *input, KvCommand *cmd) {
     if (matched == 2 && strcmp(op, "GET") == 0) {
         cmd->type = CMD_GET;
         return 0;
+    } else if (matched == 2 && strcmp(op, "DEL") == 0) {
+        cmd->type = CMD_DEL;
+        return 0;
     } else if (matched == 3 && strcmp(op, "SET") == 0) {
         cmd->type = CMD_SET;
         return 0;
@@ -0,0 +1,258 @@
+#include "../inc/static_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// 小于这个大小的文件整个放在内存里，和头部一起一次拷贝进发送缓冲区；
+// 更大的文件由 sendfile 直接从页缓存发出
+#define STATIC_INLINE_MAX (64 * 1024)
+
+struct StaticCache {
+    StaticFile *files;  // 按 path 排序
+    size_t count;
+    size_t cap;
+};
+
+static const char *const connection_value[2] = {"keep-alive", "close"};
+
+static const char *content_type(const char *path) {
+    static const struct {
+        const char *ext;
+        const char *type;
+    } types[] = {
+        {".html", "text/html; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".js", "application/javascript; charset=utf-8"},
+        {".json", "application/json"},
+        {".txt", "text/plain; charset=utf-8"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"},
+        {".svg", "image/svg+xml"},
+        {".ico", "image/x-icon"},
+        {".woff2", "font/woff2"},
+    };
+    const char *ext = strrchr(path, '.');
+    if (ext) {
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+            if (strcmp(ext, types[i].ext) == 0) return types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+static int blob_make(StaticBlob *b, const char *head, size_t head_len,
+                     const char *body, size_t body_len) {
+    b->data = malloc(head_len + body_len);
+    if (!b->data) return -1;
+    memcpy(b->data, head, head_len);
+    if (body_len > 0) memcpy(b->data + head_len, body, body_len);
+    b->len = head_len + body_len;
+    b->head_len = head_len;
+    return 0;
+}
+
+// 预先生成 200 和 304 响应，body 为 NULL 表示响应体由 sendfile 发送
+static int build_responses(StaticFile *f, const char *body) {
+    char head[512];
+    for (int i = 0; i < 2; ++i) {
+        int n = snprintf(head, sizeof(head),
+                         "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: %s\r\n"
+                         "Content-Length: %zu\r\n"
+                         "ETag: %s\r\n"
+                         "Last-Modified: %s\r\n"
+                         "Cache-Control: no-cache\r\n"
+                         "Connection: %s\r\n"
+                         "\r\n",
+                         content_type(f->path), f->size, f->etag,
+                         f->last_modified, connection_value[i]);
+        if (n < 0 || (size_t)n >= sizeof(head) ||
+            blob_make(&f->ok[i], head, (size_t)n, body,
+                      body ? f->size : 0) != 0)
+            return -1;
+
+        n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 304 Not Modified\r\n"
+                     "ETag: %s\r\n"
+                     "Last-Modified: %s\r\n"
+                     "Cache-Control: no-cache\r\n"
+                     "Connection: %s\r\n"
+                     "\r\n",
+                     f->etag, f->last_modified, connection_value[i]);
+        if (n < 0 || (size_t)n >= sizeof(head) ||
+            blob_make(&f->not_modified[i], head, (size_t)n, NULL, 0) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void file_release(StaticFile *f) {
+    free(f->path);
+    for (int i = 0; i < 2; ++i) {
+        free(f->ok[i].data);
+        free(f->not_modified[i].data);
+    }
+    if (f->fd >= 0) close(f->fd);
+}
+
+static int read_all(int fd, char *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = read(fd, buf + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// 读取失败的文件跳过，只有内存不足时返回 -1
+static int cache_add(StaticCache *cache, const char *file, const char *url) {
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+
+    if (cache->count == cache->cap) {
+        size_t cap = cache->cap ? cache->cap * 2 : 16;
+        StaticFile *files = realloc(cache->files, cap * sizeof(StaticFile));
+        if (!files) {
+            close(fd);
+            return -1;
+        }
+        cache->files = files;
+        cache->cap = cap;
+    }
+    StaticFile *f = &cache->files[cache->count];
+    memset(f, 0, sizeof(*f));
+    f->fd = fd;
+    f->size = (size_t)st.st_size;
+    f->path = strdup(url);
+    if (!f->path) {
+        file_release(f);
+        return -1;
+    }
+    f->path_len = strlen(url);
+
+    // 与 nginx 相同的 ETag 格式：修改时间和长度
+    snprintf(f->etag, sizeof(f->etag), "\"%lx-%zx\"",
+             (unsigned long)st.st_mtime, f->size);
+    struct tm tm;
+    gmtime_r(&st.st_mtime, &tm);
+    strftime(f->last_modified, sizeof(f->last_modified),
+             "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    char *body = NULL;
+    if (f->size < STATIC_INLINE_MAX) {
+        body = malloc(f->size + 1);
+        if (!body) {
+            file_release(f);
+            return -1;
+        }
+        if (read_all(fd, body, f->size) != 0) {
+            free(body);
+            file_release(f);
+            return 0;
+        }
+        close(f->fd);
+        f->fd = -1;
+    }
+    int r = build_responses(f, body);
+    free(body);
+    if (r != 0) {
+        file_release(f);
+        return -1;
+    }
+    cache->count++;
+    return 0;
+}
+
+static int cache_scan(StaticCache *cache, const char *dir, const char *url) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Static files: cannot open %s: %s\n", dir,
+                strerror(errno));
+        return 0;
+    }
+    int r = 0;
+    struct dirent *e;
+    while (r == 0 && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char file[PATH_MAX], sub_url[PATH_MAX];
+        struct stat st;
+        if (snprintf(file, sizeof(file), "%s/%s", dir, e->d_name) >=
+                (int)sizeof(file) ||
+            snprintf(sub_url, sizeof(sub_url), "%s/%s", url, e->d_name) >=
+                (int)sizeof(sub_url) ||
+            stat(file, &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            r = cache_scan(cache, file, sub_url);
+        else if (S_ISREG(st.st_mode))
+            r = cache_add(cache, file, sub_url);
+    }
+    closedir(d);
+    return r;
+}
+
+static int file_cmp(const void *a, const void *b) {
+    return strcmp(((const StaticFile *)a)->path,
+                  ((const StaticFile *)b)->path);
+}
+
+StaticCache *static_cache_load(const char *root) {
+    StaticCache *cache = calloc(1, sizeof(StaticCache));
+    if (!cache) return NULL;
+    if (cache_scan(cache, root, "") != 0) {
+        static_cache_free(cache);
+        return NULL;
+    }
+    if (cache->count > 1)
+        qsort(cache->files, cache->count, sizeof(StaticFile), file_cmp);
+    return cache;
+}
+
+void static_cache_free(StaticCache *cache) {
+    if (!cache) return;
+    for (size_t i = 0; i < cache->count; ++i) file_release(&cache->files[i]);
+    free(cache->files);
+    free(cache);
+}
+
+const StaticFile *static_cache_find(const StaticCache *cache,
+                                    const char *path) {
+    size_t len = strcspn(path, "?");
+    if (len == 1 && path[0] == '/') {
+        path = "/index.html";
+        len = strlen(path);
+    }
+    size_t lo = 0, hi = cache->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const StaticFile *f = &cache->files[mid];
+        size_t n = len < f->path_len ? len : f->path_len;
+        int c = memcmp(f->path, path, n);
+        if (c == 0) c = (f->path_len > len) - (f->path_len < len);
+        if (c == 0) return f;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+size_t static_cache_count(const StaticCache *cache) { return cache->count; }
@@ -1,51 +1,510 @@
 #include "../inc/storage.h"
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_ITEMS 1024
-#define KEY_SIZE 128
-#define VALUE_SIZE 256
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+// 开放寻址哈希表（Swiss table 风格）：每个槽位一个控制字节，
+// 满槽位保存哈希值的低 7 位，探测时一次比较 16 个控制字节，
+// 只有控制字节匹配的槽位才去比较键
+#define GROUP_SIZE 16
+#define CTRL_EMPTY ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+#define MIN_CAPACITY GROUP_SIZE
+
+// 扩容时旧表不一次性重新哈希，每次写操作搬迁这么多个槽位
+#define MIGRATE_STEP 64
+
+// 键值记录从大块内存中按 16 字节对齐切分，释放后按大小挂到空闲链表；
+// 超过 ARENA_MAX_CLASS 的记录直接使用 malloc
+#define ARENA_CHUNK (256 * 1024)
+#define ARENA_ALIGN 16
+#define ARENA_MAX_CLASS 2048
+#define ARENA_CLASSES (ARENA_MAX_CLASS / ARENA_ALIGN)
+
+typedef struct {
+    uint64_t hash;
+    uint32_t key_len;
+    uint32_t value_cap;  // 值区能容纳的最大长度（不含 '\0'）
+    char data[];         // 键 '\0' 值 '\0'
+} KvEntry;
+
+typedef struct {
+    int8_t *ctrl;        // capacity 个控制字节，按 GROUP_SIZE 对齐
+    KvEntry **slots;     // 与控制字节一一对应
+    size_t capacity;     // 2 的幂，0 表示没有表
+    size_t used;         // 满槽位数
+    size_t growth_left;  // 还能占用的空槽位数，负载上限为 7/8
+} Table;
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t pad;  // 使数据区 16 字节对齐
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk *chunks;
+    char *cur;
+    char *end;
+    void *free_lists[ARENA_CLASSES + 1];
+} Arena;
+
+// 键空间按哈希值分成若干个分片，每个分片有自己的表、内存和读写锁，
+// 不同分片上的操作互不阻塞
 typedef struct {
-    char key[KEY_SIZE];
-    char value[VALUE_SIZE];
-} KvPair;
+    pthread_rwlock_t lock;
+    Table table;
+    Table old;  // 扩容中尚未搬迁完的旧表
+    size_t migrate_pos;
+    Arena arena;
+} Shard;
 
 struct Storage {
-    KvPair items[MAX_ITEMS];
-    int count;
+    StorageLogFn log;  // 修改成功后在分片锁内调用，用于持久化
+    void *log_arg;
+    size_t nshards;
+    Shard shards[];
 };
 
+static uint64_t hash_key(const char *key, size_t len) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t h = len * m;
+    uint64_t w;
+    for (; len >= 8; key += 8, len -= 8) {
+        memcpy(&w, key, 8);
+        h = (h ^ w) * m;
+        h ^= h >> 29;
+    }
+    w = 0;
+    memcpy(&w, key, len);
+    h = (h ^ w) * m;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline int8_t hash_h2(uint64_t hash) {
+    return (int8_t)(hash & 0x7f);
+}
+
+// 返回组内控制字节等于 c 的槽位位图
+static inline uint32_t group_match(const int8_t *group, int8_t c) {
+#ifdef __SSE2__
+    __m128i g = _mm_load_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_SIZE; ++i)
+        if (group[i] == c) mask |= 1u << i;
+    return mask;
+#endif
+}
+
+// 返回组内空槽位和墓碑的位图（它们的最高位为 1）
+static inline uint32_t group_match_free(const int8_t *group) {
+#ifdef __SSE2__
+    __m128i g = _mm_load_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(g);
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_SIZE; ++i)
+        if (group[i] < 0) mask |= 1u << i;
+    return mask;
+#endif
+}
+
+static size_t arena_size(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static void *arena_alloc(Arena *a, size_t size) {
+    size = arena_size(size);
+    if (size > ARENA_MAX_CLASS) return malloc(size);
+
+    void **list = &a->free_lists[size / ARENA_ALIGN];
+    if (*list) {
+        void *p = *list;
+        *list = *(void **)p;
+        return p;
+    }
+    if ((size_t)(a->end - a->cur) < size) {
+        ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + ARENA_CHUNK);
+        if (!chunk) return NULL;
+        chunk->next = a->chunks;
+        a->chunks = chunk;
+        a->cur = (char *)(chunk + 1);
+        a->end = a->cur + ARENA_CHUNK;
+    }
+    void *p = a->cur;
+    a->cur += size;
+    return p;
+}
+
+static void arena_free(Arena *a, void *p, size_t size) {
+    size = arena_size(size);
+    if (size > ARENA_MAX_CLASS) {
+        free(p);
+        return;
+    }
+    *(void **)p = a->free_lists[size / ARENA_ALIGN];
+    a->free_lists[size / ARENA_ALIGN] = p;
+}
+
+static size_t entry_size(const KvEntry *e) {
+    return sizeof(KvEntry) + e->key_len + 1 + e->value_cap + 1;
+}
+
+static inline char *entry_value(KvEntry *e) {
+    return e->data + e->key_len + 1;
+}
+
+static KvEntry *entry_create(Arena *a, uint64_t hash, const char *key,
+                             size_t key_len, const char *value,
+                             size_t value_len) {
+    size_t size = arena_size(sizeof(KvEntry) + key_len + 1 + value_len + 1);
+    KvEntry *e = arena_alloc(a, size);
+    if (!e) return NULL;
+    e->hash = hash;
+    e->key_len = (uint32_t)key_len;
+    e->value_cap = (uint32_t)(size - sizeof(KvEntry) - key_len - 2);
+    memcpy(e->data, key, key_len + 1);
+    memcpy(entry_value(e), value, value_len + 1);
+    return e;
+}
+
+// 新值放得下时原地覆盖，否则换一条更大的记录
+static int entry_set_value(Arena *a, KvEntry **ep, const char *value,
+                           size_t value_len) {
+    KvEntry *e = *ep;
+    if (value_len <= e->value_cap) {
+        memcpy(entry_value(e), value, value_len + 1);
+        return 0;
+    }
+    KvEntry *n = entry_create(a, e->hash, e->data, e->key_len, value,
+                              value_len);
+    if (!n) return -1;
+    arena_free(a, e, entry_size(e));
+    *ep = n;
+    return 0;
+}
+
+static int table_init(Table *t, size_t capacity) {
+    t->ctrl = aligned_alloc(GROUP_SIZE, capacity);
+    t->slots = malloc(capacity * sizeof(KvEntry *));
+    if (!t->ctrl || !t->slots) {
+        free(t->ctrl);
+        free(t->slots);
+        return -1;
+    }
+    memset(t->ctrl, CTRL_EMPTY, capacity);
+    t->capacity = capacity;
+    t->used = 0;
+    t->growth_left = capacity - capacity / 8;
+    return 0;
+}
+
+static void table_destroy(Table *t) {
+    free(t->ctrl);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+// 按组做三角探测，组数是 2 的幂时能遍历所有组；
+// 遇到含空槽位的组即可停止，返回槽位下标，找不到返回 -1
+static long table_find(const Table *t, uint64_t hash, const char *key,
+                       size_t key_len) {
+    if (t->capacity == 0) return -1;
+    size_t group_mask = t->capacity / GROUP_SIZE - 1;
+    size_t g = (hash >> 7) & group_mask;
+    int8_t h2 = hash_h2(hash);
+    for (size_t step = 1;; ++step) {
+        const int8_t *group = t->ctrl + g * GROUP_SIZE;
+        for (uint32_t m = group_match(group, h2); m; m &= m - 1) {
+            size_t i = g * GROUP_SIZE + (size_t)__builtin_ctz(m);
+            const KvEntry *e = t->slots[i];
+            if (e->hash == hash && e->key_len == key_len &&
+                memcmp(e->data, key, key_len) == 0)
+                return (long)i;
+        }
+        if (group_match(group, CTRL_EMPTY)) return -1;
+        g = (g + step) & group_mask;
+    }
+}
+
+// 调用者保证键不在表中且 growth_left > 0
+static void table_insert(Table *t, KvEntry *e) {
+    size_t group_mask = t->capacity / GROUP_SIZE - 1;
+    size_t g = (e->hash >> 7) & group_mask;
+    for (size_t step = 1;; ++step) {
+        uint32_t m = group_match_free(t->ctrl + g * GROUP_SIZE);
+        if (m) {
+            size_t i = g * GROUP_SIZE + (size_t)__builtin_ctz(m);
+            if (t->ctrl[i] == CTRL_EMPTY) t->growth_left--;
+            t->ctrl[i] = hash_h2(e->hash);
+            t->slots[i] = e;
+            t->used++;
+            return;
+        }
+        g = (g + step) & group_mask;
+    }
+}
+
+// 组内还有空槽位说明从没有探测越过这个组，可以直接置空；否则留下墓碑
+static void table_erase(Table *t, size_t i) {
+    const int8_t *group = t->ctrl + (i & ~(size_t)(GROUP_SIZE - 1));
+    if (group_match(group, CTRL_EMPTY)) {
+        t->ctrl[i] = CTRL_EMPTY;
+        t->growth_left++;
+    } else {
+        t->ctrl[i] = CTRL_DELETED;
+    }
+    t->used--;
+}
+
+// 把旧表中的至多 n 个槽位搬到新表，搬完后释放旧表。搬走的槽位从旧表
+// 中删除，计数、遍历和查找都不会再看到它，记录被释放后也不会留下悬空指针
+static void migrate(Shard *s, size_t n) {
+    Table *old = &s->old;
+    if (old->capacity == 0) return;
+    size_t end = old->capacity - s->migrate_pos < n ? old->capacity
+                                                    : s->migrate_pos + n;
+    for (; s->migrate_pos < end; ++s->migrate_pos) {
+        if (old->ctrl[s->migrate_pos] < 0) continue;
+        table_insert(&s->table, old->slots[s->migrate_pos]);
+        table_erase(old, s->migrate_pos);
+    }
+    if (s->migrate_pos == old->capacity) table_destroy(old);
+}
+
+// 保证新表还能插入一个键。表满时换一张新表，它在容纳现有键之外
+// 还能再插入搬完旧表所需的写操作次数个键，所以搬迁结束前不会再次变满；
+// 通常是扩容一倍，墓碑很多时新表可以不比旧表大
+static int reserve(Shard *s) {
+    if (s->table.growth_left > 0) return 0;
+    migrate(s, SIZE_MAX);
+
+    size_t used = s->table.used;
+    size_t steps = (s->table.capacity + MIGRATE_STEP - 1) / MIGRATE_STEP;
+    size_t need = used + (used > steps ? used : steps);
+    size_t capacity = MIN_CAPACITY;
+    while (capacity - capacity / 8 < need) capacity *= 2;
+
+    Table next;
+    if (table_init(&next, capacity) != 0) return -1;
+    s->old = s->table;
+    s->table = next;
+    s->migrate_pos = 0;
+    migrate(s, MIGRATE_STEP);
+    return 0;
+}
+
+static KvEntry *shard_find(Shard *s, uint64_t hash, const char *key,
+                           size_t key_len) {
+    long i = table_find(&s->table, hash, key, key_len);
+    if (i >= 0) return s->table.slots[i];
+    i = table_find(&s->old, hash, key, key_len);
+    if (i >= 0) return s->old.slots[i];
+    return NULL;
+}
+
+static int shard_set(Shard *s, uint64_t hash, const char *key,
+                     size_t key_len, const char *value, size_t value_len) {
+    migrate(s, MIGRATE_STEP);
+    if (reserve(s) != 0) return -1;
+
+    long i = table_find(&s->table, hash, key, key_len);
+    if (i >= 0)
+        return entry_set_value(&s->arena, &s->table.slots[i], value,
+                               value_len);
+
+    // 还在旧表中的键随这次写入搬到新表
+    i = table_find(&s->old, hash, key, key_len);
+    if (i >= 0) {
+        KvEntry *e = s->old.slots[i];
+        if (entry_set_value(&s->arena, &e, value, value_len) != 0) return -1;
+        table_erase(&s->old, (size_t)i);
+        table_insert(&s->table, e);
+        return 0;
+    }
+
+    KvEntry *e = entry_create(&s->arena, hash, key, key_len, value,
+                              value_len);
+    if (!e) return -1;
+    table_insert(&s->table, e);
+    return 0;
+}
+
+static int shard_del(Shard *s, uint64_t hash, const char *key,
+                     size_t key_len) {
+    migrate(s, MIGRATE_STEP);
+    Table *tables[] = {&s->table, &s->old};
+    for (size_t t = 0; t < 2; ++t) {
+        long i = table_find(tables[t], hash, key, key_len);
+        if (i < 0) continue;
+        KvEntry *e = tables[t]->slots[i];
+        table_erase(tables[t], (size_t)i);
+        arena_free(&s->arena, e, entry_size(e));
+        return 0;
+    }
+    return -1;
+}
+
+static void free_large_entries(Table *t) {
+    for (size_t i = 0; i < t->capacity; ++i) {
+        if (t->ctrl[i] >= 0 && entry_size(t->slots[i]) > ARENA_MAX_CLASS)
+            free(t->slots[i]);
+    }
+}
+
+static void shard_destroy(Shard *s) {
+    free_large_entries(&s->table);
+    free_large_entries(&s->old);
+    table_destroy(&s->table);
+    table_destroy(&s->old);
+    while (s->arena.chunks) {
+        ArenaChunk *next = s->arena.chunks->next;
+        free(s->arena.chunks);
+        s->arena.chunks = next;
+    }
+    pthread_rwlock_destroy(&s->lock);
+}
+
+// 用哈希值的高 32 位选分片，与表内使用的低位无关
+static Shard *shard_of(Storage *storage, uint64_t hash) {
+    size_t i = (size_t)(((hash >> 32) * storage->nshards) >> 32);
+    return &storage->shards[i];
+}
+
 Storage *storage_create() {
-    Storage *s = malloc(sizeof(Storage));
-    if (s) s->count = 0;
-    return s;
+    return storage_create_sharded(1);
+}
+
+Storage *storage_create_sharded(size_t nshards) {
+    if (nshards == 0) nshards = 1;
+    Storage *storage = calloc(1, sizeof(Storage) + nshards * sizeof(Shard));
+    if (!storage) return NULL;
+    for (size_t i = 0; i < nshards; ++i) {
+        Shard *s = &storage->shards[i];
+        if (table_init(&s->table, MIN_CAPACITY) != 0) {
+            storage_free(storage);
+            return NULL;
+        }
+        pthread_rwlock_init(&s->lock, NULL);
+        storage->nshards = i + 1;
+    }
+    return storage;
 }
 
 void storage_free(Storage *storage) {
+    if (!storage) return;
+    for (size_t i = 0; i < storage->nshards; ++i)
+        shard_destroy(&storage->shards[i]);
     free(storage);
 }
 
 int storage_set(Storage *storage, const char *key, const char *value) {
-    for (int i = 0; i < storage->count; ++i) {
-        if (strcmp(storage->items[i].key, key) == 0) {
-            strncpy(storage->items[i].value, value, VALUE_SIZE);
-            return 0;
+    size_t key_len = strlen(key);
+    size_t value_len = strlen(value);
+    if (key_len > UINT32_MAX / 2 || value_len > UINT32_MAX / 2) return -1;
+
+    uint64_t hash = hash_key(key, key_len);
+    Shard *s = shard_of(storage, hash);
+    pthread_rwlock_wrlock(&s->lock);
+    int ret = shard_set(s, hash, key, key_len, value, value_len);
+    if (ret == 0 && storage->log &&
+        storage->log(storage->log_arg, STORAGE_OP_SET, key, key_len, value,
+                     value_len) != 0)
+        ret = STORAGE_NOT_LOGGED;
+    pthread_rwlock_unlock(&s->lock);
+    return ret;
+}
+
+long storage_get_copy(Storage *storage, const char *key, char *buf,
+                      size_t buf_len) {
+    size_t key_len = strlen(key);
+    uint64_t hash = hash_key(key, key_len);
+    Shard *s = shard_of(storage, hash);
+    long len = -1;
+    pthread_rwlock_rdlock(&s->lock);
+    KvEntry *e = shard_find(s, hash, key, key_len);
+    if (e) {
+        const char *value = entry_value(e);
+        len = (long)strlen(value);
+        if (buf_len > 0) {
+            size_t n = (size_t)len < buf_len ? (size_t)len : buf_len - 1;
+            memcpy(buf, value, n);
+            buf[n] = '\0';
         }
     }
-    if (storage->count >= MAX_ITEMS) return -1;
-    strncpy(storage->items[storage->count].key, key, KEY_SIZE);
-    strncpy(storage->items[storage->count].value, value, VALUE_SIZE);
-    storage->count++;
-    return 0;
+    pthread_rwlock_unlock(&s->lock);
+    return len;
+}
+
+int storage_del(Storage *storage, const char *key) {
+    size_t key_len = strlen(key);
+    uint64_t hash = hash_key(key, key_len);
+    Shard *s = shard_of(storage, hash);
+    pthread_rwlock_wrlock(&s->lock);
+    int ret = shard_del(s, hash, key, key_len);
+    if (ret == 0 && storage->log &&
+        storage->log(storage->log_arg, STORAGE_OP_DEL, key, key_len, "", 0) !=
+            0)
+        ret = STORAGE_NOT_LOGGED;
+    pthread_rwlock_unlock(&s->lock);
+    return ret;
 }
 
-const char *storage_get(Storage *storage, const char *key) {
-    for (int i = 0; i < storage->count; ++i) {
-        if (strcmp(storage->items[i].key, key) == 0)
-            return storage->items[i].value;
+size_t storage_count(Storage *storage) {
+    size_t count = 0;
+    for (size_t i = 0; i < storage->nshards; ++i) {
+        Shard *s = &storage->shards[i];
+        pthread_rwlock_rdlock(&s->lock);
+        count += s->table.used + s->old.used;
+        pthread_rwlock_unlock(&s->lock);
     }
-    return NULL;
-}
\ No newline at end of file
+    return count;
+}
+
+void storage_set_log(Storage *storage, StorageLogFn log, void *arg) {
+    storage->log = log;
+    storage->log_arg = arg;
+}
+
+static int table_foreach(Table *t, StorageVisitFn visit, void *arg) {
+    for (size_t i = 0; i < t->capacity; ++i) {
+        if (t->ctrl[i] < 0) continue;
+        KvEntry *e = t->slots[i];
+        const char *value = entry_value(e);
+        if (visit(arg, e->data, e->key_len, value, strlen(value)) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+size_t storage_shard_count(Storage *storage) { return storage->nshards; }
+
+int storage_foreach_shard(Storage *storage, size_t shard,
+                          StorageVisitFn visit, void *arg) {
+    Shard *s = &storage->shards[shard];
+    pthread_rwlock_rdlock(&s->lock);
+    int ret = table_foreach(&s->table, visit, arg);
+    if (ret == 0) ret = table_foreach(&s->old, visit, arg);
+    pthread_rwlock_unlock(&s->lock);
+    return ret;
+}
+
+int storage_foreach(Storage *storage, StorageVisitFn visit, void *arg) {
+    int ret = 0;
+    for (size_t i = 0; i < storage->nshards && ret == 0; ++i)
+        ret = storage_foreach_shard(storage, i, visit, arg);
+    return ret;
+}
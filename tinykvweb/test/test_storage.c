@@ -1,24 +1,567 @@
 #include <check.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "../inc/persist.h"
 #include "../inc/storage.h"
 
 START_TEST(test_set_and_get) {
     Storage *s = storage_create();
+    char value[16];
     ck_assert_int_eq(storage_set(s, "hello", "world"), 0);
-    ck_assert_str_eq(storage_get(s, "hello"), "world");
+    ck_assert_int_eq(storage_get_copy(s, "hello", value, sizeof(value)), 5);
+    ck_assert_str_eq(value, "world");
     storage_free(s);
 }
 END_TEST
 
+START_TEST(test_overwrite) {
+    Storage *s = storage_create();
+    char value[64];
+    ck_assert_int_eq(storage_set(s, "k", "short"), 0);
+    ck_assert_int_eq(storage_set(s, "k", "a much longer value than before"),
+                     0);
+    storage_get_copy(s, "k", value, sizeof(value));
+    ck_assert_str_eq(value, "a much longer value than before");
+    ck_assert_int_eq(storage_set(s, "k", "x"), 0);
+    storage_get_copy(s, "k", value, sizeof(value));
+    ck_assert_str_eq(value, "x");
+    ck_assert_uint_eq(storage_count(s), 1);
+    storage_free(s);
+}
+END_TEST
+
+START_TEST(test_del) {
+    Storage *s = storage_create();
+    char value[16];
+    ck_assert_int_eq(storage_set(s, "a", "1"), 0);
+    ck_assert_int_eq(storage_del(s, "a"), 0);
+    ck_assert_int_eq(storage_get_copy(s, "a", value, sizeof(value)), -1);
+    ck_assert_int_eq(storage_del(s, "a"), -1);
+    ck_assert_int_eq(storage_set(s, "a", "2"), 0);
+    storage_get_copy(s, "a", value, sizeof(value));
+    ck_assert_str_eq(value, "2");
+    storage_free(s);
+}
+END_TEST
+
+START_TEST(test_long_key_and_value) {
+    Storage *s = storage_create();
+    size_t len = 100000;
+    char *key = malloc(len + 1);
+    char *value = malloc(len + 1);
+    char *got = malloc(len + 1);
+    memset(key, 'k', len);
+    memset(value, 'v', len);
+    key[len] = value[len] = '\0';
+    ck_assert_int_eq(storage_set(s, key, value), 0);
+    ck_assert_int_eq(storage_get_copy(s, key, got, len + 1), (long)len);
+    ck_assert_str_eq(got, value);
+    key[len - 1] = 'x';
+    ck_assert_int_eq(storage_get_copy(s, key, got, len + 1), -1);
+    free(key);
+    free(value);
+    free(got);
+    storage_free(s);
+}
+END_TEST
+
+// 跨越多次扩容，并在搬迁过程中删除和覆盖较早写入的键
+START_TEST(test_many_keys) {
+    Storage *s = storage_create();
+    const int n = 200000;
+    char key[32], value[32], got[32];
+    for (int i = 0; i < n; ++i) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ck_assert_int_eq(storage_set(s, key, value), 0);
+
+        int j = i / 2;
+        snprintf(key, sizeof(key), "key:%d", j);
+        if (i % 2 == 0 && j % 3 == 0) {
+            ck_assert_int_eq(storage_del(s, key), 0);
+        } else if (i % 2 == 1 && j % 3 == 1) {
+            snprintf(value, sizeof(value), "%d-updated", j);
+            ck_assert_int_eq(storage_set(s, key, value), 0);
+        }
+    }
+    size_t live = 0;
+    for (int j = 0; j < n; ++j) {
+        snprintf(key, sizeof(key), "key:%d", j);
+        long len = storage_get_copy(s, key, got, sizeof(got));
+        if (j % 3 == 0 && 2 * j < n) {
+            ck_assert_int_eq(len, -1);
+            continue;
+        }
+        if (j % 3 == 1 && 2 * j + 1 < n)
+            snprintf(value, sizeof(value), "%d-updated", j);
+        else
+            snprintf(value, sizeof(value), "%d", j);
+        ck_assert_str_eq(got, value);
+        live++;
+    }
+    ck_assert_uint_eq(storage_count(s), live);
+    storage_free(s);
+}
+END_TEST
+
+typedef struct {
+    int visits;
+    int bad;  // 访问到已删除或重复的键
+    char *seen;
+} Visits;
+
+static int check_visit(void *arg, const char *key, size_t key_len,
+                       const char *value, size_t value_len) {
+    (void)key_len;
+    (void)value_len;
+    Visits *v = arg;
+    int j = atoi(key + 4);
+    if (j != atoi(value) || v->seen[j]) v->bad++;
+    v->seen[j] = 1;
+    v->visits++;
+    return 0;
+}
+
+// 每次写入都可能停在扩容搬迁的中途：此时计数、遍历和删除都要
+// 把旧表和新表合起来看成一张表
+START_TEST(test_mid_migration) {
+    Storage *s = storage_create();
+    const int n = 20000;
+    char key[32], value[32];
+    char *live = calloc((size_t)n, 1);
+    char *seen = malloc((size_t)n);
+    size_t count = 0;
+    for (int i = 0; i < n; ++i) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ck_assert_int_eq(storage_set(s, key, value), 0);
+        live[i] = 1;
+        count++;
+        if (i % 3 == 2) {
+            snprintf(key, sizeof(key), "key:%d", i - 1);
+            ck_assert_int_eq(storage_del(s, key), 0);
+            ck_assert_int_eq(storage_get_copy(s, key, value, sizeof(value)),
+                             -1);
+            live[i - 1] = 0;
+            count--;
+        }
+        ck_assert_uint_eq(storage_count(s), count);
+
+        if (i % 50 == 0 || i < 200) {
+            Visits v = {0, 0, seen};
+            memset(seen, 0, (size_t)n);
+            ck_assert_int_eq(storage_foreach(s, check_visit, &v), 0);
+            ck_assert_int_eq(v.bad, 0);
+            ck_assert_uint_eq((size_t)v.visits, count);
+            for (int j = 0; j <= i; ++j) ck_assert_int_eq(seen[j], live[j]);
+        }
+    }
+    for (int j = 0; j < n; ++j) {
+        snprintf(key, sizeof(key), "key:%d", j);
+        ck_assert_int_eq(storage_get_copy(s, key, value, sizeof(value)) >= 0,
+                         live[j]);
+    }
+    free(live);
+    free(seen);
+    storage_free(s);
+}
+END_TEST
+
+#define SHARD_THREADS 4
+#define SHARD_KEYS 50000
+
+static void *shard_worker(void *arg) {
+    Storage *s = ((void **)arg)[0];
+    long id = (long)((void **)arg)[1];
+    char key[32], value[32], got[32];
+    for (int i = 0; i < SHARD_KEYS; ++i) {
+        snprintf(key, sizeof(key), "t%ld:%d", id, i);
+        snprintf(value, sizeof(value), "%d", i);
+        if (storage_set(s, key, value) != 0) return (void *)1;
+        // 所有线程都读写同一个共享的键
+        storage_set(s, "shared", value);
+        if (storage_get_copy(s, "shared", got, sizeof(got)) < 0)
+            return (void *)1;
+        if (i % 2 == 0 && storage_del(s, key) != 0) return (void *)1;
+    }
+    return NULL;
+}
+
+START_TEST(test_sharded_concurrent) {
+    Storage *s = storage_create_sharded(SHARD_THREADS);
+    pthread_t threads[SHARD_THREADS];
+    void *args[SHARD_THREADS][2];
+    for (long t = 0; t < SHARD_THREADS; ++t) {
+        args[t][0] = s;
+        args[t][1] = (void *)t;
+        pthread_create(&threads[t], NULL, shard_worker, args[t]);
+    }
+    for (int t = 0; t < SHARD_THREADS; ++t) {
+        void *ret;
+        pthread_join(threads[t], &ret);
+        ck_assert_ptr_null(ret);
+    }
+    ck_assert_uint_eq(storage_count(s), SHARD_THREADS * SHARD_KEYS / 2 + 1);
+
+    char value[32];
+    ck_assert_int_eq(storage_get_copy(s, "t2:1", value, sizeof(value)), 1);
+    ck_assert_str_eq(value, "1");
+    ck_assert_int_eq(storage_get_copy(s, "t2:2", value, sizeof(value)), -1);
+    ck_assert_int_eq(storage_get_copy(s, "t3:12345", value, 3), 5);
+    ck_assert_str_eq(value, "12");
+    storage_free(s);
+}
+END_TEST
+
+static int count_log(void *arg, StorageOp op, const char *key, size_t key_len,
+                     const char *value, size_t value_len) {
+    (void)key;
+    (void)key_len;
+    (void)value;
+    (void)value_len;
+    ((int *)arg)[op]++;
+    return 0;
+}
+
+static int sum_values(void *arg, const char *key, size_t key_len,
+                      const char *value, size_t value_len) {
+    (void)key;
+    (void)key_len;
+    (void)value_len;
+    *(long *)arg += atol(value);
+    return 0;
+}
+
+START_TEST(test_log_and_foreach) {
+    Storage *s = storage_create_sharded(4);
+    int ops[3] = {0};
+    storage_set_log(s, count_log, ops);
+    for (int i = 1; i <= 100; ++i) {
+        char key[16], value[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ck_assert_int_eq(storage_set(s, key, value), 0);
+    }
+    ck_assert_int_eq(storage_del(s, "k100"), 0);
+    ck_assert_int_eq(storage_del(s, "k100"), -1);
+    ck_assert_int_eq(ops[STORAGE_OP_SET], 100);
+    ck_assert_int_eq(ops[STORAGE_OP_DEL], 1);
+
+    long sum = 0;
+    ck_assert_int_eq(storage_foreach(s, sum_values, &sum), 0);
+    ck_assert_int_eq(sum, 99 * 100 / 2);
+    storage_free(s);
+}
+END_TEST
+
+static int fail_log(void *arg, StorageOp op, const char *key, size_t key_len,
+                    const char *value, size_t value_len) {
+    (void)arg;
+    (void)op;
+    (void)key;
+    (void)key_len;
+    (void)value;
+    (void)value_len;
+    return -1;
+}
+
+// 日志失败时修改仍然生效，set 和 del 报告同一个错误码
+START_TEST(test_log_failure) {
+    Storage *s = storage_create();
+    char value[16];
+    storage_set_log(s, fail_log, NULL);
+    ck_assert_int_eq(storage_set(s, "k", "v"), STORAGE_NOT_LOGGED);
+    ck_assert_int_eq(storage_get_copy(s, "k", value, sizeof(value)), 1);
+    ck_assert_int_eq(storage_del(s, "k"), STORAGE_NOT_LOGGED);
+    ck_assert_int_eq(storage_get_copy(s, "k", value, sizeof(value)), -1);
+    ck_assert_int_eq(storage_del(s, "k"), -1);
+    storage_free(s);
+}
+END_TEST
+
+// 持久化测试在临时目录中写入、关闭、重新打开，再检查恢复出的内容
+typedef struct {
+    char dir[32];
+    Storage *store;
+    Persist *persist;
+} Db;
+
+static void db_path(const Db *db, const char *name, char *out) {
+    snprintf(out, PATH_MAX, "%s/%s", db->dir, name);
+}
+
+static void db_open(Db *db) {
+    db->store = storage_create();
+    ck_assert_ptr_nonnull(db->store);
+    db->persist = persist_open(db->store, db->dir, FSYNC_NO);
+    ck_assert_ptr_nonnull(db->persist);
+}
+
+static void db_close(Db *db) {
+    persist_close(db->persist);
+    storage_free(db->store);
+    db->persist = NULL;
+    db->store = NULL;
+}
+
+static void db_create(Db *db) {
+    strcpy(db->dir, "/tmp/tinykv-test.XXXXXX");
+    ck_assert_ptr_nonnull(mkdtemp(db->dir));
+    db_open(db);
+}
+
+static void db_destroy(Db *db) {
+    static const char *const files[] = {
+        "tinykv.snap", "tinykv.snap.tmp", "tinykv.aof", "tinykv.aof.old",
+        "tinykv.aof.new",
+    };
+    char path[PATH_MAX];
+    if (db->persist) db_close(db);
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        db_path(db, files[i], path);
+        unlink(path);
+    }
+    rmdir(db->dir);
+}
+
+static long file_size(const Db *db, const char *name) {
+    char path[PATH_MAX];
+    db_path(db, name, path);
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void assert_value(Db *db, const char *key, const char *expect) {
+    char value[64];
+    long len = storage_get_copy(db->store, key, value, sizeof(value));
+    if (!expect) {
+        ck_assert_int_eq(len, -1);
+        return;
+    }
+    ck_assert_int_eq(len, (long)strlen(expect));
+    ck_assert_str_eq(value, expect);
+}
+
+START_TEST(test_aof_replay) {
+    Db db;
+    db_create(&db);
+    ck_assert_int_eq(storage_set(db.store, "a", "1"), 0);
+    ck_assert_int_eq(storage_set(db.store, "b", "2"), 0);
+    ck_assert_int_eq(storage_del(db.store, "a"), 0);
+    ck_assert_int_eq(storage_set(db.store, "b", "3"), 0);
+    ck_assert_int_eq(storage_set(db.store, "c", ""), 0);
+    db_close(&db);
+
+    db_open(&db);
+    assert_value(&db, "a", NULL);
+    assert_value(&db, "b", "3");
+    assert_value(&db, "c", "");
+    ck_assert_uint_eq(storage_count(db.store), 2);
+    db_destroy(&db);
+}
+END_TEST
+
+// 每条记录是 13 字节的头部加上键和值
+#define AOF_RECORD(key, value) (13 + strlen(key) + strlen(value))
+
+// 崩溃可能在最后一条记录的任意位置截断 AOF：这条记录被丢弃，
+// 文件截回到它之前，之后的追加从那里继续
+START_TEST(test_aof_truncated_record) {
+    Db db;
+    db_create(&db);
+    ck_assert_int_eq(storage_set(db.store, "k1", "one"), 0);
+    ck_assert_int_eq(storage_set(db.store, "k2", "two"), 0);
+    ck_assert_int_eq(storage_set(db.store, "k3", "three"), 0);
+    db_close(&db);
+    long full = file_size(&db, "tinykv.aof");
+    long valid = full - (long)AOF_RECORD("k3", "three");
+
+    char path[PATH_MAX];
+    db_path(&db, "tinykv.aof", path);
+    for (long cut = valid + 1; cut < full; ++cut) {
+        ck_assert_int_eq(truncate(path, cut), 0);
+        db_open(&db);
+        assert_value(&db, "k2", "two");
+        assert_value(&db, "k3", NULL);
+        ck_assert_uint_eq(storage_count(db.store), 2);
+        ck_assert_int_eq(file_size(&db, "tinykv.aof"), valid);
+        ck_assert_int_eq(storage_set(db.store, "k3", "three"), 0);
+        db_close(&db);
+        ck_assert_int_eq(file_size(&db, "tinykv.aof"), full);
+    }
+
+    db_open(&db);
+    assert_value(&db, "k1", "one");
+    assert_value(&db, "k3", "three");
+    db_destroy(&db);
+}
+END_TEST
+
+// 校验失败的记录和它之后的内容都被截掉
+START_TEST(test_aof_bad_crc) {
+    Db db;
+    db_create(&db);
+    ck_assert_int_eq(storage_set(db.store, "k1", "one"), 0);
+    ck_assert_int_eq(storage_set(db.store, "k2", "two"), 0);
+    ck_assert_int_eq(storage_set(db.store, "k3", "three"), 0);
+    db_close(&db);
+    long valid = (long)AOF_RECORD("k1", "one");
+
+    char path[PATH_MAX];
+    db_path(&db, "tinykv.aof", path);
+    FILE *f = fopen(path, "r+b");
+    ck_assert_ptr_nonnull(f);
+    fseek(f, valid + 13 + 2, SEEK_SET);  // k2 的值
+    fputc('T', f);
+    fclose(f);
+
+    db_open(&db);
+    assert_value(&db, "k1", "one");
+    assert_value(&db, "k2", NULL);
+    assert_value(&db, "k3", NULL);
+    ck_assert_int_eq(file_size(&db, "tinykv.aof"), valid);
+    db_destroy(&db);
+}
+END_TEST
+
+// 重写在切换 AOF 之后、删除 .old 之前中断：.old 先于 AOF 重放
+START_TEST(test_aof_old_leftover) {
+    Db db;
+    db_create(&db);
+    ck_assert_int_eq(storage_set(db.store, "a", "old"), 0);
+    ck_assert_int_eq(storage_set(db.store, "b", "old"), 0);
+    db_close(&db);
+
+    char aof[PATH_MAX], old[PATH_MAX];
+    db_path(&db, "tinykv.aof", aof);
+    db_path(&db, "tinykv.aof.old", old);
+    ck_assert_int_eq(rename(aof, old), 0);
+
+    db_open(&db);
+    assert_value(&db, "a", "old");
+    assert_value(&db, "b", "old");
+    ck_assert_int_eq(storage_set(db.store, "b", "new"), 0);
+    ck_assert_int_eq(storage_del(db.store, "a"), 0);
+    db_close(&db);
+
+    db_open(&db);
+    assert_value(&db, "a", NULL);
+    assert_value(&db, "b", "new");
+    ck_assert_uint_eq(storage_count(db.store), 1);
+
+    // 下一次重写写出快照并删除 .old
+    ck_assert_int_eq(persist_rewrite(db.persist), 0);
+    ck_assert_int_eq(access(old, F_OK), -1);
+    db_close(&db);
+    db_open(&db);
+    assert_value(&db, "b", "new");
+    ck_assert_uint_eq(storage_count(db.store), 1);
+    db_destroy(&db);
+}
+END_TEST
+
+// 快照之后的修改留在 AOF 中，恢复时先加载快照再重放 AOF
+START_TEST(test_snapshot_then_aof) {
+    Db db;
+    db_create(&db);
+    char key[16], value[16];
+    for (int i = 0; i < 100; ++i) {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ck_assert_int_eq(storage_set(db.store, key, value), 0);
+    }
+    ck_assert_int_eq(persist_rewrite(db.persist), 0);
+    ck_assert_int_eq(file_size(&db, "tinykv.aof"), 0);
+    ck_assert_int_eq(storage_set(db.store, "k1", "updated"), 0);
+    ck_assert_int_eq(storage_del(db.store, "k2"), 0);
+    ck_assert_int_eq(storage_set(db.store, "k100", "100"), 0);
+    db_close(&db);
+    ck_assert(file_size(&db, "tinykv.snap") > 0);
+    ck_assert(file_size(&db, "tinykv.aof") > 0);
+
+    db_open(&db);
+    assert_value(&db, "k0", "0");
+    assert_value(&db, "k1", "updated");
+    assert_value(&db, "k2", NULL);
+    assert_value(&db, "k99", "99");
+    assert_value(&db, "k100", "100");
+    ck_assert_uint_eq(storage_count(db.store), 100);
+    db_destroy(&db);
+}
+END_TEST
+
+// 重写可能发生在扩容搬迁的中途：快照里既不能有重复的键，
+// 也不能有已经删除的键，否则重启后删除的键会回来
+START_TEST(test_rewrite_mid_migration) {
+    Db db;
+    db_create(&db);
+    const int n = 3000;
+    char key[32], value[32];
+    for (int i = 0; i < n; ++i) {
+        snprintf(key, sizeof(key), "key:%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ck_assert_int_eq(storage_set(db.store, key, value), 0);
+        if (i % 3 == 2) {
+            snprintf(key, sizeof(key), "key:%d", i - 1);
+            ck_assert_int_eq(storage_del(db.store, key), 0);
+        }
+        if (i % 101 != 0) continue;
+
+        ck_assert_int_eq(persist_rewrite(db.persist), 0);
+        ck_assert_int_eq(file_size(&db, "tinykv.aof"), 0);
+        db_close(&db);
+        db_open(&db);
+        size_t live = 0;
+        for (int j = 0; j <= i; ++j) {
+            snprintf(key, sizeof(key), "key:%d", j);
+            snprintf(value, sizeof(value), "%d", j);
+            bool deleted = j % 3 == 1 && j < i;
+            assert_value(&db, key, deleted ? NULL : value);
+            live += !deleted;
+        }
+        ck_assert_uint_eq(storage_count(db.store), live);
+    }
+    db_destroy(&db);
+}
+END_TEST
+
 Suite *storage_suite(void) {
     Suite *s;
     TCase *tc_core;
+    TCase *tc_persist;
 
     s = suite_create("Storage");
     tc_core = tcase_create("Core");
     tcase_add_test(tc_core, test_set_and_get);
+    tcase_add_test(tc_core, test_overwrite);
+    tcase_add_test(tc_core, test_del);
+    tcase_add_test(tc_core, test_long_key_and_value);
+    tcase_add_test(tc_core, test_many_keys);
+    tcase_add_test(tc_core, test_mid_migration);
+    tcase_add_test(tc_core, test_sharded_concurrent);
+    tcase_add_test(tc_core, test_log_and_foreach);
+    tcase_add_test(tc_core, test_log_failure);
     suite_add_tcase(s, tc_core);
 
+    tc_persist = tcase_create("Persist");
+    tcase_add_test(tc_persist, test_aof_replay);
+    tcase_add_test(tc_persist, test_aof_truncated_record);
+    tcase_add_test(tc_persist, test_aof_bad_crc);
+    tcase_add_test(tc_persist, test_aof_old_leftover);
+    tcase_add_test(tc_persist, test_snapshot_then_aof);
+    tcase_add_test(tc_persist, test_rewrite_mid_migration);
+    suite_add_tcase(s, tc_persist);
+
     return s;
 }
 